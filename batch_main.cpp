@@ -0,0 +1,333 @@
+// STD Includes
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Library Includes
+#include <multi_res_graph/Circle.h>
+#include <multi_res_graph/Rectangle.h>
+#include <units.h>
+
+// Project Includes
+#include "Checkpoint.h"
+#include "FieldSeriesWriter.h"
+#include "FluidSimulator.h"
+#include "Profiler.h"
+
+using namespace units::literals;
+using namespace units::density;
+using namespace units::viscosity;
+using namespace units::velocity;
+using namespace units::length;
+using namespace units::time;
+
+namespace {
+    // The parameters of a batch run, defaulting to the values `main.cpp` uses
+    struct BatchParameters {
+        double density        = 1;
+        double viscosity      = 1;
+        double speed_of_sound = 100;
+        double size           = 1;
+        int resolution        = 15;
+        double dt             = 0.00001;
+        long num_steps        = 1000;
+        double end_time       = -1;
+        double max_dt         = -1;
+        int num_threads       = 1;
+        std::string restart_path;
+        std::string checkpoint_path;
+        long checkpoint_interval = 0;
+        std::string series_path;
+        int series_interval = 1;
+        std::string profile_path;
+        std::vector<std::vector<double>> rectangles;
+        std::vector<std::vector<double>> circles;
+        bool show_help = false;
+    };
+
+    /**
+     * Print how to use this program
+     *
+     * @param out the stream to print to
+     * @param program_name the name this program was run with
+     */
+    void printUsage(std::ostream& out, const char* program_name) {
+        out << "Usage: " << program_name << " [options]\n"
+            << "  --density <kg/m^3>          density of the fluid (default 1)\n"
+            << "  --viscosity <m^2/s>         viscosity of the fluid (default 1)\n"
+            << "  --speed-of-sound <m/s>      speed of sound in the fluid (default 100)\n"
+            << "  --size <m>                  side length of the simulation (default 1)\n"
+            << "  --resolution <n>            initial resolution (default 15)\n"
+            << "  --dt <s>                    time step (default 0.00001)\n"
+            << "  --steps <n>                 number of steps to run (default 1000)\n"
+            << "  --end-time <s>              run until this simulated time instead\n"
+            << "  --max-dt <s>                step adaptively, with steps up to this size\n"
+            << "  --threads <n>               number of threads to step with (default 1)\n"
+            << "  --restart <path>            start from a checkpoint file\n"
+            << "  --checkpoint <path>         write a checkpoint file when finished\n"
+            << "  --checkpoint-every <n>      also write it every n steps\n"
+            << "  --series <path>             write the fields to a time series file\n"
+            << "  --series-every <n>          steps between series frames (default 1)\n"
+            << "  --profile <path>            write a Chrome trace of every phase (needs\n"
+            << "                              SIMPLE_CFD_ENABLE_PROFILING)\n"
+            << "  --rectangle <w,h,x,y>       add a rectangular obstacle (repeatable)\n"
+            << "  --circle <r,x,y>            add a circular obstacle (repeatable)\n"
+            << "  --help, -h                  print this message and exit\n";
+    }
+
+    /**
+     * Parse a comma separated list of numbers
+     *
+     * @param list the list to parse
+     * @param expected_size how many numbers the list should have
+     *
+     * @return the numbers in the list
+     */
+    std::vector<double> parseNumberList(const std::string& list, size_t expected_size) {
+        std::vector<double> numbers;
+        std::stringstream list_stream(list);
+        std::string number;
+        while (std::getline(list_stream, number, ',')) {
+            numbers.emplace_back(std::stod(number));
+        }
+        if (numbers.size() != expected_size) {
+            throw std::invalid_argument("Expected " + std::to_string(expected_size) +
+                                        " comma separated numbers, got \"" + list +
+                                        "\"");
+        }
+        return numbers;
+    }
+
+    /**
+     * Parse the command line arguments of a batch run
+     *
+     * @param argc
+     * @param argv
+     *
+     * @return the parameters of the batch run
+     */
+    BatchParameters parseArguments(int argc, char** argv) {
+        BatchParameters parameters;
+        for (int i = 1; i < argc; i++) {
+            const std::string option = argv[i];
+            if (option == "--help" || option == "-h") {
+                parameters.show_help = true;
+                return parameters;
+            }
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("Missing value for " + option);
+            }
+            const std::string value = argv[++i];
+
+            if (option == "--density") {
+                parameters.density = std::stod(value);
+            } else if (option == "--viscosity") {
+                parameters.viscosity = std::stod(value);
+            } else if (option == "--speed-of-sound") {
+                parameters.speed_of_sound = std::stod(value);
+            } else if (option == "--size") {
+                parameters.size = std::stod(value);
+            } else if (option == "--resolution") {
+                parameters.resolution = std::stoi(value);
+            } else if (option == "--dt") {
+                parameters.dt = std::stod(value);
+            } else if (option == "--steps") {
+                parameters.num_steps = std::stol(value);
+            } else if (option == "--end-time") {
+                parameters.end_time = std::stod(value);
+            } else if (option == "--max-dt") {
+                parameters.max_dt = std::stod(value);
+            } else if (option == "--threads") {
+                parameters.num_threads = std::stoi(value);
+            } else if (option == "--restart") {
+                parameters.restart_path = value;
+            } else if (option == "--checkpoint") {
+                parameters.checkpoint_path = value;
+            } else if (option == "--checkpoint-every") {
+                parameters.checkpoint_interval = std::stol(value);
+            } else if (option == "--series") {
+                parameters.series_path = value;
+            } else if (option == "--series-every") {
+                parameters.series_interval = std::stoi(value);
+            } else if (option == "--profile") {
+                parameters.profile_path = value;
+            } else if (option == "--rectangle") {
+                parameters.rectangles.emplace_back(parseNumberList(value, 4));
+            } else if (option == "--circle") {
+                parameters.circles.emplace_back(parseNumberList(value, 3));
+            } else {
+                throw std::invalid_argument("Unknown option " + option);
+            }
+        }
+        return parameters;
+    }
+}
+
+int main(int argc, char** argv) {
+    BatchParameters parameters;
+    try {
+        parameters = parseArguments(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        printUsage(std::cerr, argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (parameters.show_help) {
+        printUsage(std::cout, argv[0]);
+        return EXIT_SUCCESS;
+    }
+
+    auto create_simulator = [&]() {
+        if (!parameters.restart_path.empty()) {
+            return FluidSimulator::restoreCheckpoint(parameters.restart_path);
+        }
+        return FluidSimulator(kg_per_cu_m_t(parameters.density),
+                              meters_squared_per_s_t(parameters.viscosity),
+                              meters_per_second_t(parameters.speed_of_sound),
+                              meter_t(parameters.size),
+                              parameters.resolution);
+    };
+    std::unique_ptr<FluidSimulator> simulator_ptr;
+    try {
+        simulator_ptr = std::make_unique<FluidSimulator>(create_simulator());
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    FluidSimulator& simulator = *simulator_ptr;
+    simulator.setNumThreads(parameters.num_threads);
+
+    for (const std::vector<double>& rectangle : parameters.rectangles) {
+        simulator.addObstacle(std::make_shared<Rectangle<ControlVolume>>(
+            rectangle[0], rectangle[1], (Coordinates){rectangle[2], rectangle[3]}));
+    }
+    for (const std::vector<double>& circle : parameters.circles) {
+        simulator.addObstacle(std::make_shared<Circle<ControlVolume>>(
+            circle[0], (Coordinates){circle[1], circle[2]}));
+    }
+
+    const size_t num_cells = simulator.getNumControlVolumes();
+    const bool adaptive    = parameters.max_dt > 0;
+
+    // Run until we've done enough steps, or simulated enough time
+    auto finished = [&](long num_steps_taken) {
+        if (parameters.end_time >= 0) {
+            return simulator.getSimulationTime().to<double>() >= parameters.end_time;
+        }
+        return num_steps_taken >= parameters.num_steps;
+    };
+
+    // Checkpoints are written in the background, so the run doesn't wait for them
+    CheckpointWriter checkpoint_writer;
+    auto write_checkpoint = [&]() {
+        CheckpointState state;
+        simulator.takeCheckpoint(state);
+        checkpoint_writer.write(parameters.checkpoint_path, std::move(state));
+    };
+
+    // Frames are written in the background too, and the run only waits for the writer
+    // if it falls behind
+    std::shared_ptr<FieldSeriesWriter> series_writer;
+    if (!parameters.series_path.empty()) {
+        try {
+            FieldSeriesParameters series_parameters;
+            series_parameters.compress = FieldSeriesWriter::isCompressionSupported();
+            series_writer = std::make_shared<FieldSeriesWriter>(
+                parameters.series_path, series_parameters);
+            simulator.setFieldOutput(series_writer, parameters.series_interval);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    long num_steps        = 0;
+    const auto start_time = std::chrono::steady_clock::now();
+    try {
+        for (; !finished(num_steps); num_steps++) {
+            if (!parameters.checkpoint_path.empty() &&
+                parameters.checkpoint_interval > 0 && num_steps > 0 &&
+                num_steps % parameters.checkpoint_interval == 0) {
+                write_checkpoint();
+            }
+            if (adaptive) {
+                double max_dt = parameters.max_dt;
+                if (parameters.end_time >= 0) {
+                    max_dt = std::min(max_dt,
+                                      parameters.end_time -
+                                          simulator.getSimulationTime().to<double>());
+                }
+                simulator.updateControlVolumesAdaptive(second_t(max_dt));
+            } else {
+                simulator.updateControlVolumes(second_t(parameters.dt));
+            }
+        }
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Stopped after " << num_steps << " steps: " << e.what()
+                  << std::endl;
+    }
+    const auto end_time = std::chrono::steady_clock::now();
+
+    if (!parameters.checkpoint_path.empty()) {
+        write_checkpoint();
+    }
+    try {
+        checkpoint_writer.wait();
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Could not write checkpoint: " << e.what() << std::endl;
+    }
+    if (series_writer) {
+        try {
+            series_writer->flush();
+        } catch (const std::runtime_error& e) {
+            std::cerr << "Could not write field series: " << e.what() << std::endl;
+        }
+        const FieldSeriesWriter::Counters counters = series_writer->getCounters();
+        std::cout << "series frames:     " << counters.frames_written << " ("
+                  << counters.frames_backpressured << " waited for the writer)\n";
+    }
+
+    const double wall_time =
+        std::chrono::duration<double>(end_time - start_time).count();
+    std::cout << "cells:             " << num_cells << "\n"
+              << "threads:           " << simulator.getNumThreads() << "\n"
+              << "steps:             " << num_steps << "\n"
+              << "rejected steps:    " << simulator.getNumRejectedSteps() << "\n"
+              << "simulated time:    " << simulator.getSimulationTime().to<double>()
+              << " s\n"
+              << "wall time:         " << wall_time << " s\n"
+              << "steps/sec:         " << num_steps / wall_time << "\n"
+              << "cell-updates/sec:  " << simulator.getNumCellUpdates() / wall_time
+              << std::endl;
+
+    if (!parameters.profile_path.empty()) {
+        if (!Profiler::isCompiledIn()) {
+            std::cerr << "Not built with SIMPLE_CFD_ENABLE_PROFILING, so no phases "
+                         "were recorded"
+                      << std::endl;
+        }
+        std::cout << "\nphase                          calls    total (s)"
+                  << "     mean (s)\n";
+        for (const ProfilePhaseStats& phase : Profiler::getPhaseStats()) {
+            std::cout << std::left << std::setw(31) << phase.name << std::right
+                      << std::setw(5) << phase.num_calls << std::setw(13)
+                      << phase.total_time << std::setw(13)
+                      << phase.total_time / phase.num_calls << "\n";
+        }
+        std::ofstream trace(parameters.profile_path);
+        Profiler::writeChromeTrace(trace);
+        if (!trace) {
+            std::cerr << "Could not write " << parameters.profile_path << std::endl;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
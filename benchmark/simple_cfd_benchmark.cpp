@@ -0,0 +1,301 @@
+// STD Includes
+#include <memory>
+#include <vector>
+
+// Library Includes
+#include <benchmark/benchmark.h>
+#include <multi_res_graph/Circle.h>
+#include <multi_res_graph/Rectangle.h>
+#include <units.h>
+
+// Project Includes
+#include "ControlVolume.h"
+#include "EnsembleRunner.h"
+#include "FluidSimulator.h"
+#ifdef SIMPLE_CFD_BENCHMARK_RENDERING
+#include "FieldRenderer.h"
+#endif
+
+using namespace units::literals;
+using namespace units::length;
+using namespace units::velocity;
+using namespace units::time;
+using namespace units::pressure;
+using namespace units::density;
+using namespace units::viscosity;
+
+namespace {
+    // The time step used when stepping simulations. This is small so the simulation
+    // stays well away from blowing up (and producing non-finite values, which would
+    // skew the timing) over the many steps a benchmark takes.
+    const second_t BENCHMARK_DT = second_t(1e-9);
+
+    /**
+     * Create a simulator with a non-trivial initial pressure field
+     *
+     * @param resolution the number of cells along each side of the simulation
+     * @param with_obstacles whether to add a couple of obstacles to the simulation
+     *
+     * @return a simulator with a non-trivial initial pressure field
+     */
+    FluidSimulator createSimulator(int resolution, bool with_obstacles) {
+        FluidSimulator simulator(kg_per_cu_m_t(1),
+                                 meters_squared_per_s_t(1),
+                                 meters_per_second_t(100),
+                                 meter_t(1),
+                                 resolution);
+        for (auto& node : simulator.getControlVolumeGraph()->getAllSubNodes()) {
+            if (node->getCoordinates().x <= 0.25) {
+                node->containedValue().setPressure(pascal_t(100));
+            }
+        }
+        if (with_obstacles) {
+            simulator.addObstacle(std::make_shared<Rectangle<ControlVolume>>(
+                0.2, 0.3, (Coordinates){0.4, 0.4}));
+            simulator.addObstacle(
+                std::make_shared<Circle<ControlVolume>>(0.15, (Coordinates){0.2, 0.7}));
+        }
+        return simulator;
+    }
+
+    /**
+     * Report the throughput of a benchmark that processes the given number of cells
+     * per iteration, as cells/sec and ns/cell
+     *
+     * @param state the state of the benchmark
+     * @param cells_per_iteration the number of cells processed per iteration
+     */
+    void setCellCounters(benchmark::State& state, size_t cells_per_iteration) {
+        const double num_cells =
+            static_cast<double>(cells_per_iteration) * state.iterations();
+        state.counters["cells"] = cells_per_iteration;
+        state.counters["cells/sec"] =
+            benchmark::Counter(num_cells, benchmark::Counter::kIsRate);
+        // An inverted rate is seconds per unit, so count billions of cells to get
+        // nanoseconds per cell
+        state.counters["ns/cell"] = benchmark::Counter(
+            num_cells * 1e-9, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    }
+
+    /**
+     * Get the points to start streamlines at, in a grid across the simulation
+     *
+     * @param num_points_per_side the number of points along each side of the grid
+     *
+     * @return the points to start streamlines at
+     */
+    std::vector<Point2d> createStreamLineStartPoints(int num_points_per_side) {
+        std::vector<Point2d> start_points;
+        for (int x_index = 0; x_index < num_points_per_side; x_index++) {
+            for (int y_index = 0; y_index < num_points_per_side; y_index++) {
+                start_points.push_back(
+                    {meter_t((x_index + 0.5) / num_points_per_side),
+                     meter_t((y_index + 0.5) / num_points_per_side)});
+            }
+        }
+        return start_points;
+    }
+}
+
+// Update a single control volume
+static void BM_ControlVolumeUpdate(benchmark::State& state) {
+    ControlVolume centre(pascal_t(1),
+                         Velocity2d{meters_per_second_t(0.1), meters_per_second_t(0.2)},
+                         kg_per_cu_m_t(1),
+                         meters_squared_per_s_t(1),
+                         meters_per_second_t(100));
+    ControlVolume left   = centre;
+    ControlVolume right  = centre;
+    ControlVolume top    = centre;
+    ControlVolume bottom = centre;
+    right.setPressure(pascal_t(10));
+    top.setVelocity({meters_per_second_t(0), meters_per_second_t(1)});
+
+    for (auto _ : state) {
+        ControlVolume cell = centre;
+        cell.update(std::make_pair(left, meter_t(0.1)),
+                    std::make_pair(right, meter_t(0.1)),
+                    std::make_pair(top, meter_t(0.1)),
+                    std::make_pair(bottom, meter_t(0.1)),
+                    BENCHMARK_DT);
+        benchmark::DoNotOptimize(cell);
+    }
+    setCellCounters(state, 1);
+}
+BENCHMARK(BM_ControlVolumeUpdate);
+
+// Step a whole simulation. Args are the resolution, whether there are obstacles, and
+// the number of threads.
+static void BM_UpdateControlVolumes(benchmark::State& state) {
+    FluidSimulator simulator = createSimulator(state.range(0), state.range(1));
+    simulator.setNumThreads(state.range(2));
+
+    // Build the mesh outside the timed loop
+    simulator.updateControlVolumes(BENCHMARK_DT);
+
+    for (auto _ : state) {
+        simulator.updateControlVolumes(BENCHMARK_DT);
+    }
+    setCellCounters(state, simulator.getNumControlVolumes());
+}
+BENCHMARK(BM_UpdateControlVolumes)
+    ->ArgNames({"resolution", "obstacles", "threads"})
+    ->ArgsProduct({{15, 64, 256, 1024}, {0, 1}, {1}})
+    ->Args({1024, 1, 4})
+    ->Unit(benchmark::kMicrosecond);
+
+// Step a whole simulation in blocks of steps with temporal blocking, to compare with
+// `BM_UpdateControlVolumes`. Args are the resolution, the steps per block, and the
+// number of threads.
+static void BM_UpdateControlVolumesBlocked(benchmark::State& state) {
+    FluidSimulator simulator = createSimulator(state.range(0), true);
+    simulator.setNumThreads(state.range(2));
+    TemporalBlockingParameters parameters;
+    parameters.steps_per_block = state.range(1);
+    simulator.setTemporalBlockingParameters(parameters);
+
+    // Build the mesh and tiles outside the timed loop
+    simulator.updateControlVolumesBlocked(BENCHMARK_DT, parameters.steps_per_block);
+
+    for (auto _ : state) {
+        simulator.updateControlVolumesBlocked(BENCHMARK_DT, parameters.steps_per_block);
+    }
+    setCellCounters(state,
+                    simulator.getNumControlVolumes() * parameters.steps_per_block);
+}
+BENCHMARK(BM_UpdateControlVolumesBlocked)
+    ->ArgNames({"resolution", "steps", "threads"})
+    ->ArgsProduct({{256, 1024}, {1, 4, 8}, {1}})
+    ->Args({1024, 4, 4})
+    ->Unit(benchmark::kMicrosecond);
+
+// Step an ensemble of members sharing one mesh, to compare with stepping as many
+// separate simulations. Args are the resolution, the number of members, and the
+// number of threads.
+static void BM_EnsembleRun(benchmark::State& state) {
+    EnsembleRunner ensemble(meter_t(1), state.range(0), state.range(2));
+    for (int i = 0; i < state.range(1); i++) {
+        EnsembleMember member;
+        member.viscosity = 1 + 0.01 * i;
+        ensemble.addMember(member);
+    }
+
+    for (auto _ : state) {
+        ensemble.run(BENCHMARK_DT, 1);
+    }
+    setCellCounters(state, ensemble.getMesh()->numCells() * ensemble.numMembers());
+}
+BENCHMARK(BM_EnsembleRun)
+    ->ArgNames({"resolution", "members", "threads"})
+    ->Args({64, 64, 1})
+    ->Args({64, 64, 4})
+    ->Args({256, 16, 4})
+    ->Unit(benchmark::kMicrosecond);
+
+// Trace a grid of streamlines one at a time with `getStreamLinePoints`. Args are the
+// resolution and the number of streamlines along each side of the grid.
+static void BM_GetStreamLinePoints(benchmark::State& state) {
+    FluidSimulator simulator = createSimulator(state.range(0), true);
+    simulator.updateControlVolumes(BENCHMARK_DT);
+    const std::vector<Point2d> start_points = createStreamLineStartPoints(state.range(1));
+
+    size_t num_points = 0;
+    for (auto _ : state) {
+        num_points = 0;
+        for (const Point2d& start_point : start_points) {
+            num_points +=
+                simulator.getStreamLinePoints(start_point, meter_t(5), meter_t(0.01))
+                    .size();
+        }
+    }
+    state.counters["points/sec"] = benchmark::Counter(
+        static_cast<double>(num_points) * state.iterations(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_GetStreamLinePoints)
+    ->ArgNames({"resolution", "lines_per_side"})
+    ->Args({256, 10})
+    ->Args({1024, 10})
+    ->Unit(benchmark::kMillisecond);
+
+// Trace a grid of streamlines as a batch with `getStreamLines`. Args are the
+// resolution, the number of streamlines along each side of the grid, and the number
+// of threads.
+static void BM_GetStreamLines(benchmark::State& state) {
+    FluidSimulator simulator = createSimulator(state.range(0), true);
+    simulator.setNumThreads(state.range(2));
+    simulator.updateControlVolumes(BENCHMARK_DT);
+    const std::vector<Point2d> start_points = createStreamLineStartPoints(state.range(1));
+
+    size_t num_points = 0;
+    for (auto _ : state) {
+        num_points = 0;
+        for (const std::vector<Point2d>& streamline :
+             simulator.getStreamLines(start_points, meter_t(5), meter_t(0.01))) {
+            num_points += streamline.size();
+        }
+    }
+    state.counters["points/sec"] = benchmark::Counter(
+        static_cast<double>(num_points) * state.iterations(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_GetStreamLines)
+    ->ArgNames({"resolution", "lines_per_side", "threads"})
+    ->Args({256, 10, 1})
+    ->Args({1024, 10, 1})
+    ->Args({1024, 10, 4})
+    ->Unit(benchmark::kMillisecond);
+
+// Reduce the fields into a field pyramid for drawing, as is done for every published
+// snapshot. Args are the resolution and the number of threads.
+static void BM_BuildFieldPyramid(benchmark::State& state) {
+    FluidSimulator simulator = createSimulator(state.range(0), true);
+    simulator.setNumThreads(state.range(1));
+    simulator.updateControlVolumes(BENCHMARK_DT);
+    FieldPyramid pyramid;
+
+    for (auto _ : state) {
+        simulator.buildFieldPyramid(pyramid);
+    }
+    setCellCounters(state, simulator.getNumControlVolumes());
+}
+BENCHMARK(BM_BuildFieldPyramid)
+    ->ArgNames({"resolution", "threads"})
+    ->Args({256, 1})
+    ->Args({1024, 1})
+    ->Args({1024, 4})
+    ->Unit(benchmark::kMillisecond);
+
+#ifdef SIMPLE_CFD_BENCHMARK_RENDERING
+// Draw a snapshot offscreen, onto an image surface. Args are the resolution, the side
+// length of the image, and the render mode.
+static void BM_DrawOffscreen(benchmark::State& state) {
+    FluidSimulator simulator = createSimulator(state.range(0), true);
+    simulator.updateControlVolumes(BENCHMARK_DT);
+    FieldSnapshot snapshot;
+    simulator.takeSnapshot(snapshot);
+    simulator.buildFieldPyramid(snapshot.pyramid);
+
+    const int image_size = state.range(1);
+    auto surface =
+        Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, image_size, image_size);
+    auto ctx = Cairo::Context::create(surface);
+    FieldRenderer field_renderer(static_cast<FieldRenderMode>(state.range(2)), 1);
+
+    for (auto _ : state) {
+        field_renderer.draw(ctx, image_size, image_size, snapshot);
+        surface->flush();
+    }
+    setCellCounters(state, snapshot.mesh->numCells());
+    state.counters["pixels/sec"] = benchmark::Counter(
+        static_cast<double>(image_size) * image_size * state.iterations(),
+        benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_DrawOffscreen)
+    ->ArgNames({"resolution", "image_size", "render_mode"})
+    ->ArgsProduct({{64, 256},
+                   {512},
+                   {static_cast<int>(FieldRenderMode::RASTERISED),
+                    static_cast<int>(FieldRenderMode::PER_CELL)}})
+    ->Unit(benchmark::kMillisecond);
+#endif
+
+BENCHMARK_MAIN();
@@ -0,0 +1,88 @@
+#pragma once
+
+// STD Includes
+#include <array>
+
+// Project Includes
+#include "ControlVolumeKernel.h"
+#include "ControlVolumeMesh.h"
+#include "ScalarStencilKernel.h"
+
+// The kinds of condition that can be applied at a side of the mesh
+enum class BoundaryType {
+    // A fixed state outside the side
+    INFLOW,
+
+    // The state just inside the side carries on outside it (zero gradient)
+    OUTFLOW,
+
+    // A no-slip wall, moving along at the given velocity. The pressure has zero
+    // gradient across it.
+    WALL,
+
+    // The state outside the side is the state just inside the opposite side. Must be
+    // applied to both sides of a pair.
+    PERIODIC
+};
+
+// The condition at one side of the mesh
+struct BoundaryCondition {
+    BoundaryType type;
+
+    // For INFLOW the state outside the side, for WALL the velocity of the wall (the
+    // pressure is unused). Unused for the other types.
+    CellState state;
+};
+
+// The conditions at every side of the mesh, applied through a `GhostCellLayer`
+struct BoundaryConditions {
+    // The condition at each side of the mesh, indexed by `Direction`
+    std::array<BoundaryCondition, NUM_DIRECTIONS> sides;
+
+    // If set, the velocity of every top neighbour that *does* exist is taken from
+    // `top_velocity_override` rather than the fields (as the legacy update does)
+    bool override_top_velocity;
+    CellState top_velocity_override;
+};
+
+/**
+ * Get the conditions the legacy (graph) update was hard-coded with: a fixed state
+ * outside every side, and the velocity of every top neighbour overridden
+ *
+ * These give the same edge states as `legacyEdgeStates`
+ *
+ * @return the conditions the legacy update was hard-coded with
+ */
+BoundaryConditions legacyBoundaryConditions();
+
+/**
+ * Check the given conditions can be applied
+ *
+ * @param conditions the conditions to check
+ *
+ * @throws std::invalid_argument if only one side of a pair is PERIODIC
+ */
+void validateBoundaryConditions(const BoundaryConditions& conditions);
+
+/**
+ * Check if every side of the given conditions is INFLOW, so the state outside the mesh
+ * doesn't depend on the fields
+ *
+ * @param conditions the conditions to check
+ *
+ * @return true if every side is INFLOW, false otherwise
+ */
+bool hasFixedEdgeStates(const BoundaryConditions& conditions);
+
+/**
+ * Get the given conditions as the edge states used by the stencil kernels
+ *
+ * NOTE: Only INFLOW sides have a fixed state outside them; the other sides are given a
+ *       zero state, so these should only be used for cells at the edge of the mesh if
+ *       `hasFixedEdgeStates(conditions)`
+ *
+ * @param conditions the conditions to convert
+ *
+ * @return the state outside every INFLOW side, and the top velocity override
+ */
+StencilEdgeStates<double> toEdgeStates(const BoundaryConditions& conditions);
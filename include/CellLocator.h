@@ -0,0 +1,79 @@
+#pragma once
+
+// STD Includes
+#include <memory>
+#include <vector>
+
+// Project Includes
+#include "ControlVolumeMesh.h"
+
+/**
+ * Finds which cell of a `ControlVolumeMesh` contains a given point
+ *
+ * The area covered by the mesh is split into a uniform grid of bins no larger than
+ * the smallest cell, with each bin storing the cells that overlap it, so locating a
+ * point only needs to check a couple of cells. Callers that locate a series of nearby
+ * points (such as along a streamline) can also pass the last cell they found as a
+ * hint, which is checked (along with it's neighbours) before the grid.
+ */
+class CellLocator {
+  public:
+    // The cell index returned when there is no cell to return
+    static constexpr int NO_CELL = -1;
+
+    CellLocator() = delete;
+
+    /**
+     * Build the lookup grid for the given mesh
+     *
+     * @param mesh the mesh to locate cells in
+     */
+    explicit CellLocator(std::shared_ptr<const ControlVolumeMesh> mesh);
+
+    /**
+     * Find the cell closest to the given point
+     *
+     * Points outside the mesh are moved to the nearest point inside it first, so this
+     * always returns a cell (unless the mesh is empty)
+     *
+     * @param x the x coordinate of the point (m)
+     * @param y the y coordinate of the point (m)
+     * @param hint a cell that is likely to contain the point, or NO_CELL
+     *
+     * @return the index of the cell closest to the given point
+     */
+    int locate(double x, double y, int hint = NO_CELL) const;
+
+    /**
+     * Get the mesh this locates cells in
+     *
+     * @return the mesh this locates cells in
+     */
+    const ControlVolumeMesh& getMesh() const { return *mesh; }
+
+  private:
+    /**
+     * Check if the given cell contains the given point
+     *
+     * @param cell the index of the cell
+     * @param x the x coordinate of the point (m)
+     * @param y the y coordinate of the point (m)
+     *
+     * @return true if the given cell contains the given point, false otherwise
+     */
+    bool contains(int cell, double x, double y) const;
+
+    // The mesh we're locating cells in
+    std::shared_ptr<const ControlVolumeMesh> mesh;
+
+    // The area covered by the mesh
+    double min_x, min_y, max_x, max_y;
+
+    // The size of each bin, and the number of bins in each direction
+    double bin_size;
+    int num_bins_x, num_bins_y;
+
+    // The cells overlapping bin `b` are `bin_cells[bin_offsets[b]:bin_offsets[b+1]]`
+    std::vector<int> bin_offsets;
+    std::vector<int> bin_cells;
+};
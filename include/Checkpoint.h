@@ -0,0 +1,290 @@
+#pragma once
+
+// STD Includes
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+// Project Includes
+#include "BoundaryConditions.h"
+#include "FieldSnapshot.h"
+#include "ImplicitDiffusionSolver.h"
+#include "ProjectionSolver.h"
+
+// The physical state of a `FluidSimulator` at one point in time, everything needed to
+// restart it
+struct CheckpointState {
+    // The mesh, fields, obstacle mask, and simulated time
+    FieldSnapshot snapshot;
+
+    // The density (kg/m^3), viscosity (m^2/s), and speed of sound (m/s) of the fluid
+    double density        = 0;
+    double viscosity      = 0;
+    double speed_of_sound = 0;
+
+    // The resolution of the graph the mesh was built from, and it's number of nodes
+    int graph_resolution   = 0;
+    size_t num_graph_nodes = 0;
+
+    // The settings that change the equations being solved, so the simulation can't
+    // carry on the same way without them
+    BoundaryConditions boundary_conditions = legacyBoundaryConditions();
+    SolverMode solver_mode                 = SolverMode::SLIGHTLY_COMPRESSIBLE;
+    bool implicit_diffusion                = false;
+    ImplicitDiffusionParameters diffusion_parameters;
+};
+
+/**
+ * Write the given state to a checkpoint file
+ *
+ * The file is written next to `path` and then renamed over it, so a crash part way
+ * through never leaves a truncated checkpoint behind
+ *
+ * File layout (version 2, native byte order):
+ *   - A fixed size header (see `CheckpointHeader` in Checkpoint.cpp) holding the
+ *     format version, the number of cells, the fluid parameters, the boundary
+ *     conditions, solver mode, and implicit diffusion settings, and the offset of
+ *     every section
+ *   - One section per per-cell array, each starting on a 64 byte boundary so the
+ *     arrays can be used straight out of a memory-mapped file: cell x, y, and scale,
+ *     the four neighbour tables, the graph node index, pressure, x and y velocity
+ *     (doubles or int32s), and the obstacle mask (one byte per cell)
+ *
+ * @param path the file to write
+ * @param state the state to write
+ *
+ * @throws std::runtime_error if the file couldn't be written
+ */
+void writeCheckpoint(const std::string& path, const CheckpointState& state);
+
+/**
+ * A checkpoint file mapped into memory, with it's per-cell arrays read in place
+ */
+class MappedCheckpoint {
+  public:
+    MappedCheckpoint() = delete;
+    MappedCheckpoint(const MappedCheckpoint&) = delete;
+    MappedCheckpoint& operator=(const MappedCheckpoint&) = delete;
+
+    /**
+     * Map the given checkpoint file into memory and check it
+     *
+     * @param path the checkpoint file to map
+     *
+     * @throws std::runtime_error if the file couldn't be mapped, isn't a checkpoint,
+     * is a different version, or is truncated, inconsistent, or has invalid settings
+     */
+    explicit MappedCheckpoint(const std::string& path);
+
+    // Unmaps the file
+    ~MappedCheckpoint();
+
+    /**
+     * Get the number of cells in the checkpointed mesh
+     *
+     * @return the number of cells in the checkpointed mesh
+     */
+    size_t numCells() const;
+
+    /**
+     * Get the number of nodes in the graph the mesh was built from
+     *
+     * @return the number of nodes in the graph the mesh was built from
+     */
+    size_t numGraphNodes() const;
+
+    /**
+     * Get the resolution of the graph the mesh was built from
+     *
+     * @return the resolution of the graph the mesh was built from
+     */
+    int getGraphResolution() const;
+
+    /**
+     * Get the side length of the area being simulated (m)
+     *
+     * @return the side length of the area being simulated (m)
+     */
+    double getSimulationSize() const;
+
+    /**
+     * Get the total amount of time that had been simulated (s)
+     *
+     * @return the total amount of time that had been simulated (s)
+     */
+    double getSimulationTime() const;
+
+    /**
+     * Get the number of steps that had been taken
+     *
+     * @return the number of steps that had been taken
+     */
+    uint64_t getNumSteps() const;
+
+    /**
+     * Get the density (kg/m^3) of the fluid
+     *
+     * @return the density (kg/m^3) of the fluid
+     */
+    double getDensity() const;
+
+    /**
+     * Get the viscosity (m^2/s) of the fluid
+     *
+     * @return the viscosity (m^2/s) of the fluid
+     */
+    double getViscosity() const;
+
+    /**
+     * Get the speed of sound (m/s) in the fluid
+     *
+     * @return the speed of sound (m/s) in the fluid
+     */
+    double getSpeedOfSound() const;
+
+    /**
+     * Get the conditions at the sides of the mesh
+     *
+     * @return the conditions at the sides of the mesh
+     */
+    BoundaryConditions getBoundaryConditions() const;
+
+    /**
+     * Get the equations that were being solved
+     *
+     * @return the equations that were being solved
+     */
+    SolverMode getSolverMode() const;
+
+    /**
+     * Check if the viscous term was being stepped implicitly
+     *
+     * @return true if the viscous term was being stepped implicitly
+     */
+    bool isImplicitDiffusionEnabled() const;
+
+    /**
+     * Get the parameters the viscous term was stepped implicitly with, if it was
+     *
+     * @return the parameters the viscous term was stepped implicitly with
+     */
+    ImplicitDiffusionParameters getDiffusionParameters() const;
+
+    /**
+     * Get the distance (m) used for "neighbours" outside the edge of the mesh
+     *
+     * @return the distance (m) used for "neighbours" outside the edge of the mesh
+     */
+    double getEdgeDistance() const;
+
+    // The per-cell arrays, each `numCells()` long and valid while this is alive
+    const double* getCellX() const;
+    const double* getCellY() const;
+    const double* getCellScale() const;
+    const int32_t* getNeighbours(Direction direction) const;
+    const int32_t* getNodeIndices() const;
+    const double* getPressure() const;
+    const double* getVelocityX() const;
+    const double* getVelocityY() const;
+    const uint8_t* getObstacleCellMask() const;
+
+  private:
+    /**
+     * Get a pointer to the start of the given section
+     *
+     * @param section the index of the section
+     *
+     * @return a pointer to the start of the given section
+     */
+    const void* getSection(int section) const;
+
+    // The mapped file, and it's size in bytes
+    const unsigned char* data;
+    size_t size;
+};
+
+/**
+ * Writes checkpoints on a background thread, so the simulation doesn't stall while
+ * they are written
+ *
+ * Checkpoints are written in the order they are queued. A write takes ownership of
+ * the state it is given, which should be taken with `FluidSimulator::takeCheckpoint`
+ * (a copy of the fields that the simulation can keep stepping past).
+ */
+class CheckpointWriter {
+  public:
+    // Starts the background thread
+    CheckpointWriter();
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    // Finishes writing every queued checkpoint, then stops the background thread
+    ~CheckpointWriter();
+
+    /**
+     * Queue the given state to be written to the given file
+     *
+     * @param path the file to write
+     * @param state the state to write
+     */
+    void write(std::string path, CheckpointState state);
+
+    /**
+     * Wait for every queued checkpoint to be written
+     *
+     * @throws std::runtime_error (or whatever else writing threw) if a checkpoint
+     * queued since the last call to this couldn't be written
+     */
+    void wait();
+
+    /**
+     * Get the number of checkpoints queued that haven't finished writing
+     *
+     * @return the number of checkpoints queued that haven't finished writing
+     */
+    size_t getNumPending();
+
+    /**
+     * Get the total number of checkpoints written successfully
+     *
+     * @return the total number of checkpoints written successfully
+     */
+    uint64_t getNumWritten();
+
+  private:
+    /**
+     * Write queued checkpoints until asked to stop
+     */
+    void run();
+
+    // Guards everything below
+    std::mutex mutex;
+
+    // Signalled when a checkpoint is queued, or the thread should stop
+    std::condition_variable queued;
+
+    // Signalled when a checkpoint has been written
+    std::condition_variable written;
+
+    // The checkpoints waiting to be written, and the number being written right now
+    std::deque<std::pair<std::string, CheckpointState>> queue;
+    size_t num_writing;
+
+    // The total number of checkpoints written successfully
+    uint64_t num_written;
+
+    // The first error writing a checkpoint since the last `wait`
+    std::exception_ptr error;
+
+    // Set to ask the background thread to stop once the queue is empty
+    bool stopping;
+
+    // Writes the queued checkpoints
+    std::thread thread;
+};
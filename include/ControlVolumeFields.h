@@ -0,0 +1,40 @@
+#pragma once
+
+// STD Includes
+#include <vector>
+
+/**
+ * The pressure and velocity of every cell in a `ControlVolumeMesh`, stored as
+ * contiguous arrays indexed by cell
+ *
+ * All values are in SI units (pascals and meters per second)
+ *
+ * @tparam Scalar the floating point type the values are stored as
+ */
+template <typename Scalar>
+struct BasicControlVolumeFields {
+    std::vector<Scalar> pressure;
+    std::vector<Scalar> velocity_x;
+    std::vector<Scalar> velocity_y;
+
+    /**
+     * Resize all the fields to hold the given number of cells
+     *
+     * @param num_cells the number of cells to hold
+     */
+    void resize(size_t num_cells) {
+        pressure.resize(num_cells);
+        velocity_x.resize(num_cells);
+        velocity_y.resize(num_cells);
+    }
+
+    /**
+     * Get the number of cells these fields hold
+     *
+     * @return the number of cells these fields hold
+     */
+    size_t size() const { return pressure.size(); }
+};
+
+// The fields the simulation is stepped with
+using ControlVolumeFields = BasicControlVolumeFields<double>;
@@ -0,0 +1,147 @@
+#pragma once
+
+// STD Includes
+#include <cmath>
+
+/**
+ * The state of a single cell, in SI units
+ *
+ * @tparam Scalar the floating point type the state is stored as
+ */
+template <typename Scalar>
+struct BasicCellState {
+    Scalar pressure;
+    Scalar velocity_x;
+    Scalar velocity_y;
+};
+
+using CellState = BasicCellState<double>;
+
+/**
+ * The (constant) properties of the fluid needed to update a cell, in SI units
+ *
+ * @tparam Scalar the floating point type the properties are stored as
+ */
+template <typename Scalar>
+struct BasicFluidCoefficients {
+    Scalar density;
+    Scalar viscosity;
+    Scalar speed_of_sound_squared;
+
+    BasicFluidCoefficients() = default;
+
+    /**
+     * Create the coefficients for a fluid with the given properties
+     *
+     * @param density the density of the fluid (kg/m^3)
+     * @param viscosity the viscosity of the fluid (m^2/s)
+     * @param speed_of_sound the speed of sound in the fluid (m/s)
+     */
+    BasicFluidCoefficients(double density, double viscosity, double speed_of_sound)
+      : density(static_cast<Scalar>(density)),
+        viscosity(static_cast<Scalar>(viscosity)),
+        // NOTE: This mirrors `units::math::pow<2>` in `ControlVolume::update`
+        speed_of_sound_squared(static_cast<Scalar>(std::pow(speed_of_sound, 2))) {}
+};
+
+using FluidCoefficients = BasicFluidCoefficients<double>;
+
+/**
+ * Compute the new state of a cell from it's current state and the state of it's
+ * neighbours
+ *
+ * This is the same calculation as `ControlVolume::update`, on plain scalars. The order
+ * of every floating point operation is kept identical so for doubles the results are
+ * bit-for-bit the same. The distances given must already be absolute.
+ *
+ * @tparam Scalar the floating point type to compute with
+ *
+ * @param centre the current state of the cell to update
+ * @param left the state of the left neighbour
+ * @param left_distance the distance to the left neighbour
+ * @param right the state of the right neighbour
+ * @param right_distance the distance to the right neighbour
+ * @param top the state of the top neighbour
+ * @param top_distance the distance to the top neighbour
+ * @param bottom the state of the bottom neighbour
+ * @param bottom_distance the distance to the bottom neighbour
+ * @param dt the amount of time to step forward by (s)
+ * @param fluid the properties of the fluid
+ *
+ * @return the new state of the cell
+ */
+template <typename Scalar>
+inline BasicCellState<Scalar>
+    computeCellState(const BasicCellState<Scalar>& centre,
+                     const BasicCellState<Scalar>& left,
+                     Scalar left_distance,
+                     const BasicCellState<Scalar>& right,
+                     Scalar right_distance,
+                     const BasicCellState<Scalar>& top,
+                     Scalar top_distance,
+                     const BasicCellState<Scalar>& bottom,
+                     Scalar bottom_distance,
+                     Scalar dt,
+                     const BasicFluidCoefficients<Scalar>& fluid) {
+    const Scalar v_dot_x = (right.velocity_x - centre.velocity_x) / right_distance;
+    const Scalar w_dot_y = (top.velocity_y - centre.velocity_y) / top_distance;
+
+    const Scalar p_dot_x = (right.pressure - centre.pressure) / right_distance;
+    const Scalar p_dot_y = (top.pressure - centre.pressure) / top_distance;
+
+    const Scalar v_dotdot_x =
+        (left.velocity_x - 2 * centre.velocity_x + right.velocity_x) /
+        (left_distance * right_distance);
+    const Scalar v_dotdot_y =
+        (bottom.velocity_x - 2 * centre.velocity_x + top.velocity_x) /
+        (bottom_distance * top_distance);
+
+    const Scalar w_dotdot_x =
+        (left.velocity_y - 2 * centre.velocity_y + right.velocity_y) /
+        (left_distance * right_distance);
+    const Scalar w_dotdot_y =
+        (bottom.velocity_y - 2 * centre.velocity_y + top.velocity_y) /
+        (bottom_distance * top_distance);
+
+    BasicCellState<Scalar> updated;
+    updated.velocity_x = centre.velocity_x - dt * (v_dot_x + w_dot_y) * centre.velocity_x -
+                         dt / fluid.density * p_dot_x +
+                         dt * fluid.viscosity * (v_dotdot_x + v_dotdot_y);
+    updated.velocity_y = centre.velocity_y - dt * (v_dot_x + w_dot_y) * centre.velocity_y -
+                         dt / fluid.density * p_dot_y +
+                         dt * fluid.viscosity * (w_dotdot_x + w_dotdot_y);
+    updated.pressure =
+        centre.pressure - dt * fluid.speed_of_sound_squared * (v_dot_x + w_dot_y);
+    return updated;
+}
+
+/**
+ * Compute the new state of a cell from it's current state and the state of it's
+ * neighbours, in double precision
+ *
+ * See `computeCellState`, this gives bit-for-bit the same results as
+ * `ControlVolume::update`
+ */
+inline CellState updateCellState(const CellState& centre,
+                                 const CellState& left,
+                                 double left_distance,
+                                 const CellState& right,
+                                 double right_distance,
+                                 const CellState& top,
+                                 double top_distance,
+                                 const CellState& bottom,
+                                 double bottom_distance,
+                                 double dt,
+                                 const FluidCoefficients& fluid) {
+    return computeCellState<double>(centre,
+                                    left,
+                                    left_distance,
+                                    right,
+                                    right_distance,
+                                    top,
+                                    top_distance,
+                                    bottom,
+                                    bottom_distance,
+                                    dt,
+                                    fluid);
+}
@@ -0,0 +1,343 @@
+#pragma once
+
+// STD Includes
+#include <array>
+#include <memory>
+#include <vector>
+
+// Library Includes
+#include <multi_res_graph/GraphNode.h>
+
+// Project Includes
+#include "ControlVolume.h"
+#include "ControlVolumeFields.h"
+#include "NodeSpan.h"
+
+// The directions a ControlVolume can have a neighbour in
+// ("top" is positive y, "right" is positive x)
+enum Direction { LEFT = 0, RIGHT = 1, TOP = 2, BOTTOM = 3, NUM_DIRECTIONS = 4 };
+
+/**
+ * The cells of a mesh that have a neighbour in every direction, all the same size as
+ * the cell itself (ie. cells in the interior of a same-resolution block)
+ *
+ * The neighbour indices and distances are stored compactly alongside each cell so
+ * these cells can be stepped several at a time
+ */
+struct UniformStencilCells {
+    // The index of each cell
+    std::vector<int> cells;
+
+    // The index of the neighbour of each cell, in each direction
+    std::array<std::vector<int>, NUM_DIRECTIONS> neighbours;
+
+    // The absolute distance from each cell to it's neighbour, in each direction. These
+    // are all (nearly) the same, but can differ in the last few bits as they are
+    // computed from the coordinates of the cells.
+    std::array<std::vector<double>, NUM_DIRECTIONS> distances;
+
+    /**
+     * Get the number of cells
+     *
+     * @return the number of cells
+     */
+    size_t size() const { return cells.size(); }
+};
+
+/**
+ * A flat, solver-side view of the topology of a `GraphNode<ControlVolume>`
+ *
+ * Every leaf node of the graph becomes a "cell" with an index in [0, numCells()). For
+ * every cell we store the index of it's neighbour in each direction along with the
+ * *absolute* distance to that neighbour, so stepping the simulation does not need to
+ * chase any `shared_ptr`s. This only needs to be rebuilt when the topology of the
+ * graph changes.
+ */
+class ControlVolumeMesh {
+  public:
+    // The neighbour index used for cells that have no neighbour in a given direction
+    static constexpr int NO_NEIGHBOUR = -1;
+
+    ControlVolumeMesh() = delete;
+
+    /**
+     * Build the neighbour index and distance tables for the given graph
+     *
+     * @param graph the graph to build the mesh from
+     */
+    explicit ControlVolumeMesh(GraphNode<ControlVolume>& graph);
+
+    /**
+     * Build a mesh from the given cells, which may subdivide the nodes of a graph
+     * (see `MeshRefiner`)
+     *
+     * @param graph_nodes every node of the graph, in the order `getAllSubNodes`
+     * returns them, or empty to build the mesh without it's nodes (see `hasNodes`)
+     * @param node_indices the index in `graph_nodes` of the node each cell lies within
+     * @param cell_x the x coordinate (in meters) of every cell
+     * @param cell_y the y coordinate (in meters) of every cell
+     * @param cell_scale the scale (in meters) of every cell
+     * @param neighbours the index of the neighbour of every cell in each direction, or
+     * NO_NEIGHBOUR for cells at the edge of the mesh
+     * @param edge_distance the distance (in meters) used for "neighbours" outside the
+     * edge of the mesh
+     */
+    ControlVolumeMesh(
+        const std::vector<std::shared_ptr<RealNode<ControlVolume>>>& graph_nodes,
+        std::vector<int> node_indices,
+        std::vector<double> cell_x,
+        std::vector<double> cell_y,
+        std::vector<double> cell_scale,
+        std::array<std::vector<int>, NUM_DIRECTIONS> neighbours,
+        double edge_distance);
+
+    /**
+     * Get the number of cells in this mesh
+     *
+     * @return the number of cells in this mesh
+     */
+    size_t numCells() const { return node_indices.size(); }
+
+    /**
+     * Get a copy of this mesh with the given graph nodes
+     *
+     * @param graph_nodes every node of the graph, in the order `getAllSubNodes`
+     * returns them
+     *
+     * @return this mesh, with the node from `graph_nodes` for every cell
+     */
+    std::shared_ptr<const ControlVolumeMesh> withGraphNodes(
+        const std::vector<std::shared_ptr<RealNode<ControlVolume>>>& graph_nodes) const;
+
+    /**
+     * Check if this mesh has the graph node of every cell
+     *
+     * A mesh built without it's nodes can be stepped, but can't gather or scatter
+     * fields, or give the graph node of any cell
+     *
+     * @return true if this mesh has the graph node of every cell
+     */
+    bool hasNodes() const { return nodes.size() == node_indices.size(); }
+
+    /**
+     * Get the graph node for every cell, in cell index order
+     *
+     * If the mesh subdivides the nodes of the graph, this is the node each cell lies
+     * within, so several cells may share a node
+     *
+     * @return the graph node for every cell
+     */
+    const std::vector<std::shared_ptr<RealNode<ControlVolume>>>& getNodes() const {
+        return nodes;
+    }
+
+    /**
+     * Get a non-owning view of the graph node for every cell, in cell index order
+     *
+     * This is the same as `getNodes()`, but iterating over it doesn't touch the
+     * reference counts of the nodes. It is valid as long as this mesh is.
+     *
+     * @return a view of the graph node for every cell
+     */
+    NodeSpan<ControlVolume> getNodeSpan() const {
+        return NodeSpan<ControlVolume>(node_pointers);
+    }
+
+    /**
+     * Get the index of the graph node for every cell, within the nodes of the graph in
+     * the order `getAllSubNodes` returns them
+     *
+     * @return the index of the graph node for every cell
+     */
+    const std::vector<int>& getNodeIndices() const { return node_indices; }
+
+    /**
+     * Get the index of the neighbour of every cell in the given direction
+     *
+     * @param direction the direction to get the neighbours in
+     *
+     * @return the index of the neighbour of every cell in the given direction, or
+     * NO_NEIGHBOUR for cells at the edge of the mesh
+     */
+    const std::vector<int>& getNeighbours(Direction direction) const {
+        return neighbours[direction];
+    }
+
+    /**
+     * Get the absolute distance from every cell to it's neighbour in the given
+     * direction
+     *
+     * For cells with no neighbour in the given direction this is the edge distance
+     *
+     * @param direction the direction to get the neighbour distances in
+     *
+     * @return the absolute distance (in meters) from every cell to it's neighbour
+     */
+    const std::vector<double>& getNeighbourDistances(Direction direction) const {
+        return neighbour_distances[direction];
+    }
+
+    /**
+     * Get the distance used for "neighbours" outside the edge of the mesh
+     *
+     * @return the distance (in meters) used for "neighbours" outside the mesh
+     */
+    double getEdgeDistance() const { return edge_distance; }
+
+    /**
+     * Get the cells that have a same-sized neighbour in every direction
+     *
+     * @return the cells that have a same-sized neighbour in every direction
+     */
+    const UniformStencilCells& getUniformCells() const { return uniform_cells; }
+
+    /**
+     * Get the index of every cell that is *not* in `getUniformCells()`, ie. cells at the
+     * edge of the mesh or at a change in resolution
+     *
+     * @return the index of every cell not in `getUniformCells()`
+     */
+    const std::vector<int>& getGeneralCells() const { return general_cells; }
+
+    /**
+     * Get the index of every cell that is missing a neighbour in at least one
+     * direction (ie. cells at the edge of the mesh)
+     *
+     * @return the index of every cell at the edge of the mesh
+     */
+    const std::vector<int>& getEdgeCells() const { return edge_cells; }
+
+    /**
+     * Get the index of every cell that has a neighbour in every direction, but not all
+     * the same size as itself (ie. cells at a change in resolution)
+     *
+     * @return the index of every cell at a change in resolution
+     */
+    const std::vector<int>& getResolutionChangeCells() const {
+        return resolution_change_cells;
+    }
+
+    /**
+     * Get the x coordinate of every cell
+     *
+     * @return the x coordinate (in meters) of every cell
+     */
+    const std::vector<double>& getCellX() const { return cell_x; }
+
+    /**
+     * Get the y coordinate of every cell
+     *
+     * @return the y coordinate (in meters) of every cell
+     */
+    const std::vector<double>& getCellY() const { return cell_y; }
+
+    /**
+     * Get the scale (side length) of every cell
+     *
+     * @return the scale (in meters) of every cell
+     */
+    const std::vector<double>& getCellScale() const { return cell_scale; }
+
+    /**
+     * Copy the pressure and velocity of every cell out of the graph
+     *
+     * Cells that subdivide a node all get the value of that node
+     *
+     * @param fields the fields to copy into, will be resized to fit this mesh
+     */
+    void gatherFields(ControlVolumeFields& fields) const;
+
+    /**
+     * Copy the pressure and velocity of the cells of every node that has been changed
+     * out of the graph, leaving the cells of every other node as they are
+     *
+     * A node has been changed if it's value is no longer the area-weighted mean of
+     * it's cells, as `scatterFields` would write. This keeps cells that subdivide a
+     * node when the graph has only been read, or when other nodes have been changed.
+     *
+     * @param fields the fields to copy into, must be the same size as this mesh
+     */
+    void gatherChangedFields(ControlVolumeFields& fields) const;
+
+    /**
+     * Copy the given pressure and velocity of every cell back into the graph
+     *
+     * Nodes subdivided into several cells get the area-weighted mean of their cells
+     *
+     * @param fields the fields to copy from, must be the same size as this mesh
+     */
+    void scatterFields(const ControlVolumeFields& fields) const;
+
+  private:
+    /**
+     * Set the nodes and node pointers of every cell from it's node index
+     *
+     * @param graph_nodes every node of the graph, in the order `getAllSubNodes`
+     * returns them
+     */
+    void assignNodes(
+        const std::vector<std::shared_ptr<RealNode<ControlVolume>>>& graph_nodes);
+
+    /**
+     * Build the neighbour distances, and split the cells by stencil, from the cell
+     * coordinates, scales, and neighbours
+     */
+    void buildStencilTables();
+
+    /**
+     * Find the area-weighted mean of the given fields over the cells in each node
+     *
+     * @param fields the fields to average, must be the same size as this mesh
+     * @param averaged_nodes set to every node, in the order they first appear
+     * @param cell_nodes set to the index in `averaged_nodes` of the node of every cell
+     * @param node_fields set to the mean fields of each of `averaged_nodes`
+     */
+    void averageNodeFields(const ControlVolumeFields& fields,
+                           std::vector<RealNode<ControlVolume>*>& averaged_nodes,
+                           std::vector<int>& cell_nodes,
+                           ControlVolumeFields& node_fields) const;
+
+    /**
+     * Write the area-weighted mean of the given fields over the cells in each node
+     * into that node
+     *
+     * @param fields the fields to copy from, must be the same size as this mesh
+     */
+    void scatterAveragedFields(const ControlVolumeFields& fields) const;
+
+    // The graph node for every cell, in cell index order
+    std::vector<std::shared_ptr<RealNode<ControlVolume>>> nodes;
+
+    // The same nodes as plain pointers, viewed by `getNodeSpan`. These stay valid as
+    // `nodes` keeps every node alive.
+    std::vector<RealNode<ControlVolume>*> node_pointers;
+
+    // The index of the graph node for every cell, within all the nodes of the graph
+    std::vector<int> node_indices;
+
+    // The index of the neighbour of every cell, in each direction
+    std::array<std::vector<int>, NUM_DIRECTIONS> neighbours;
+
+    // The absolute distance to the neighbour of every cell, in each direction
+    std::array<std::vector<double>, NUM_DIRECTIONS> neighbour_distances;
+
+    // The distance used for "neighbours" outside the edge of the mesh
+    double edge_distance;
+
+    // Whether every cell is a node of the graph, rather than part of one
+    bool one_cell_per_node;
+
+    // The cells with a same-sized neighbour in every direction
+    UniformStencilCells uniform_cells;
+
+    // Every cell not in `uniform_cells`, and those split into cells at the edge of the
+    // mesh and cells at a change in resolution
+    std::vector<int> general_cells;
+    std::vector<int> edge_cells;
+    std::vector<int> resolution_change_cells;
+
+    // The coordinates and scale of every cell
+    std::vector<double> cell_x;
+    std::vector<double> cell_y;
+    std::vector<double> cell_scale;
+};
@@ -0,0 +1,192 @@
+#pragma once
+
+// STD Includes
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Library Includes
+#include <mpi.h>
+#include <units.h>
+
+// Project Includes
+#include "ControlVolumeFields.h"
+#include "ControlVolumeKernel.h"
+#include "ControlVolumeMesh.h"
+#include "FluidSimulator.h"
+#include "ScalarStencilKernel.h"
+
+/**
+ * Steps the mesh of a `FluidSimulator` across several processes with MPI
+ *
+ * The cells are split between the ranks of a communicator with `partitionMesh`, so
+ * each rank holds the fields of it's own cells and of a one cell deep halo of the
+ * cells of other ranks they read. Every step the halos are exchanged with
+ * non-blocking messages, and the cells that don't read the halo are updated while
+ * the messages are in flight, so communication overlaps with computation.
+ *
+ * Every cell is updated with `updateCellState`, from the same neighbours and distances
+ * as `FluidSimulator::computeNextFields`, and cells covered by obstacles are zeroed
+ * after every step, so the fields are bit-identical to stepping the simulator in one
+ * process with the scalar kernels, however many ranks they are split between.
+ *
+ * NOTE: The mesh is split once, when this is created: the mesh isn't adapted while
+ *       stepping, and only SLIGHTLY_COMPRESSIBLE mode with fixed edge states (ie.
+ *       INFLOW boundaries) and explicit diffusion is supported
+ */
+class DistributedSimulator {
+  public:
+    DistributedSimulator() = delete;
+
+    /**
+     * Split the mesh of the given simulator between the ranks of the given
+     * communicator, and send every rank it's cells and halo
+     *
+     * This is collective over `communicator`.
+     *
+     * @param communicator the ranks to split the simulation between
+     * @param simulator the simulator to take the mesh, fields, and fluid from. This is
+     * only read on the root rank, and may be null on the others.
+     * @param root the rank that holds the simulator
+     *
+     * @throws std::runtime_error on every rank if the simulator can't be distributed
+     * (see the NOTE above)
+     */
+    DistributedSimulator(MPI_Comm communicator,
+                         FluidSimulator* simulator,
+                         int root = 0);
+
+    /**
+     * Step the simulation forward on every rank
+     *
+     * This is collective over the communicator.
+     *
+     * @param dt the amount of time to step forward by
+     */
+    void updateControlVolumes(units::time::second_t dt);
+
+    /**
+     * Collect the fields of every rank on the root rank
+     *
+     * This is collective over the communicator.
+     *
+     * @param fields set to the fields of every cell, in the order of the mesh the
+     * simulation was split from, on the root rank. This isn't changed on other ranks.
+     */
+    void gatherFields(ControlVolumeFields& fields) const;
+
+    /**
+     * Get the total amount of time that has been simulated
+     *
+     * @return the total amount of time that has been simulated
+     */
+    units::time::second_t getSimulationTime() const;
+
+    /**
+     * Get the number of cells this rank updates
+     *
+     * @return the number of cells this rank updates
+     */
+    size_t getNumOwnedCells() const { return num_owned_cells; }
+
+    /**
+     * Get the number of cells of other ranks this rank reads
+     *
+     * @return the number of cells in the halo of this rank
+     */
+    size_t getNumHaloCells() const { return cells.size() - num_owned_cells; }
+
+    /**
+     * Get the number of cells in the whole mesh
+     *
+     * @return the number of cells in the whole mesh
+     */
+    size_t getNumGlobalCells() const { return num_global_cells; }
+
+  private:
+    // The cells this rank exchanges with one other rank
+    struct HaloExchange {
+        // The other rank
+        int rank = 0;
+
+        // The local index of every owned cell the other rank reads, in the order it
+        // expects them
+        std::vector<int> send_cells;
+
+        // The first local index of the halo cells owned by the other rank, which are
+        // stored together
+        size_t receive_begin = 0;
+
+        // The number of halo cells owned by the other rank
+        size_t num_receive_cells = 0;
+    };
+
+    /**
+     * Update the given owned cells from the current fields into the next ones
+     *
+     * @param updated_cells the local index of every cell to update
+     * @param dt the amount of time to step forward by (s)
+     */
+    void updateCells(const std::vector<int>& updated_cells, double dt);
+
+    // The ranks the simulation is split between
+    MPI_Comm communicator;
+
+    // The rank that gathers the fields
+    int root;
+
+    // The properties of the fluid
+    FluidCoefficients fluid;
+
+    // The states used in place of missing neighbours
+    StencilEdgeStates<double> edges;
+
+    // The number of cells in the whole mesh
+    size_t num_global_cells;
+
+    // The global index of every cell this rank owns, followed by the cells in it's
+    // halo, grouped by owner
+    std::vector<int> cells;
+
+    // The number of cells this rank owns, which are the first of `cells`
+    size_t num_owned_cells;
+
+    // The local index of the neighbour of every owned cell, in each direction. Missing
+    // neighbours are given the index of the edge state in that direction, just past
+    // the halo.
+    std::array<std::vector<int>, NUM_DIRECTIONS> neighbours;
+
+    // The local index the velocity of the top neighbour of every owned cell is read
+    // from. This is the override slot for real neighbours if the top velocity is
+    // overridden, and the top neighbour otherwise.
+    std::vector<int> top_velocity_neighbours;
+
+    // The distance to the neighbour of every owned cell, in each direction
+    std::array<std::vector<double>, NUM_DIRECTIONS> distances;
+
+    // The owned cells that only read other owned cells, updated while the halo is in
+    // flight
+    std::vector<int> interior_cells;
+
+    // The owned cells that read the halo
+    std::vector<int> halo_boundary_cells;
+
+    // The local index of every owned cell covered by an obstacle
+    std::vector<int> obstacle_cells;
+
+    // Every rank this rank exchanges cells with
+    std::vector<HaloExchange> exchanges;
+
+    // The packed pressure and velocity of the cells sent to and received from each
+    // rank in `exchanges`, in the same order
+    std::vector<std::vector<double>> send_buffers;
+    std::vector<std::vector<double>> receive_buffers;
+
+    // The fields of every local cell, followed by the edge states in direction order
+    // and the top velocity override
+    ControlVolumeFields current_fields;
+    ControlVolumeFields next_fields;
+
+    // The total amount of time that has been simulated (s)
+    double simulation_time;
+};
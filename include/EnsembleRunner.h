@@ -0,0 +1,230 @@
+#pragma once
+
+// STD Includes
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Library Includes
+#include <multi_res_graph/Area.h>
+#include <multi_res_graph/GraphNode.h>
+#include <units.h>
+
+// Project Includes
+#include "ControlVolume.h"
+#include "ControlVolumeFields.h"
+#include "ControlVolumeMesh.h"
+#include "SimdStencilKernel.h"
+#include "ThreadPool.h"
+
+// One variant of the simulation run by an `EnsembleRunner`
+struct EnsembleMember {
+    // Identifies this member in it's summary
+    std::string name;
+
+    // The density (kg/m^3), viscosity (m^2/s), and speed of sound (m/s) of the fluid
+    double density        = 1;
+    double viscosity      = 1;
+    double speed_of_sound = 100;
+
+    // The speed (m/s) of the fluid entering through the left edge. The other edges
+    // are the same as `FluidSimulator`'s, which this matches at the default.
+    double inlet_speed = 1;
+
+    // Solid obstacles in this member
+    std::vector<std::shared_ptr<Area<ControlVolume>>> obstacles;
+};
+
+// The outcome of running one member of an ensemble
+struct EnsembleMemberSummary {
+    // The parameters the member was run with
+    std::string name;
+    double density        = 0;
+    double viscosity      = 0;
+    double speed_of_sound = 0;
+    double inlet_speed    = 0;
+
+    // The number of cells covered by obstacles
+    size_t num_obstacle_cells = 0;
+
+    // The number of steps taken, and the amount of time that was simulated (s)
+    uint64_t num_steps     = 0;
+    double simulation_time = 0;
+
+    // The largest and mean speed (m/s), and the range of pressure (Pa), over every
+    // cell outside the obstacles
+    double max_speed    = 0;
+    double mean_speed   = 0;
+    double min_pressure = 0;
+    double max_pressure = 0;
+
+    // Whether every value is finite (ie. the member didn't blow up)
+    bool finite = true;
+
+    // The wall clock time (s) spent stepping this member
+    double wall_time = 0;
+};
+
+/**
+ * Runs many variants of the same simulation (eg. a sweep over viscosity, density,
+ * inlet speed, or obstacle placement) on one shared mesh
+ *
+ * The graph, mesh, and neighbour tables are built once and shared read-only by every
+ * member, which only holds it's own field arrays and obstacle mask. This needs far
+ * less memory per member than a `FluidSimulator` each (which builds a graph of
+ * `ControlVolume`s and it's own neighbour tables), so many more members fit in cache
+ * and in memory.
+ *
+ * Members are independent, so they are spread across the threads whole, rather than
+ * splitting each member's cells between threads. Each member is stepped with the
+ * FLAT_ARRAYS update of `FluidSimulator` in SLIGHTLY_COMPRESSIBLE mode, so results
+ * are bit-identical to a `FluidSimulator` with the same parameters (and SIMD level),
+ * and for any number of threads.
+ */
+class EnsembleRunner {
+  public:
+    EnsembleRunner() = delete;
+    EnsembleRunner(const EnsembleRunner&) = delete;
+    EnsembleRunner& operator=(const EnsembleRunner&) = delete;
+
+    /**
+     * Create an ensemble with no members, building the mesh every member shares
+     *
+     * @param simulation_size the side length of the (square) area being simulated
+     * @param simulation_resolution the number of cells along each side of the area
+     * @param num_threads the number of threads to run members on, must be at least 1
+     */
+    EnsembleRunner(units::length::meter_t simulation_size,
+                   int simulation_resolution,
+                   int num_threads);
+
+    /**
+     * Add a member to the ensemble, starting with zero pressure and velocity
+     *
+     * @param member the parameters of the member
+     *
+     * @return the index of the new member
+     */
+    size_t addMember(EnsembleMember member);
+
+    /**
+     * Get the number of members in the ensemble
+     *
+     * @return the number of members in the ensemble
+     */
+    size_t numMembers() const;
+
+    /**
+     * Get the mesh every member is simulated on
+     *
+     * @return the mesh every member is simulated on
+     */
+    std::shared_ptr<const ControlVolumeMesh> getMesh() const;
+
+    /**
+     * Get the current fields of the given member, indexed by the cells of `getMesh()`
+     *
+     * These may be changed (eg. to set initial conditions) between runs. Values in
+     * obstacles are cleared after every step.
+     *
+     * @param member the index of the member
+     *
+     * @return the current fields of the given member
+     */
+    ControlVolumeFields& getMemberFields(size_t member);
+
+    /**
+     * Get whether each cell is covered by an obstacle in the given member
+     *
+     * @param member the index of the member
+     *
+     * @return a vector with a non-zero entry for every cell covered by an obstacle
+     */
+    const std::vector<uint8_t>& getObstacleCellMask(size_t member) const;
+
+    /**
+     * Set the instruction set used to step cells in the interior of same-resolution
+     * blocks (defaults to the best one this CPU supports)
+     *
+     * @param simd_level the instruction set to use, must be supported by this CPU
+     */
+    void setSimdLevel(SimdLevel simd_level);
+
+    /**
+     * Step every member forward by the given number of steps
+     *
+     * @param dt the amount of time to step forward by each step
+     * @param num_steps the number of steps to take
+     */
+    void run(units::time::second_t dt, long num_steps);
+
+    /**
+     * Summarise every member
+     *
+     * @return a summary of every member, in the order they were added
+     */
+    std::vector<EnsembleMemberSummary> getSummaries() const;
+
+    /**
+     * Write a summary of every member as CSV, with a header row and one row per member
+     *
+     * @param output the stream to write to
+     */
+    void writeSummaries(std::ostream& output) const;
+
+  private:
+    // The state of one member
+    struct MemberState {
+        // The parameters the member was added with
+        EnsembleMember parameters;
+
+        // The current fields, and a buffer the next step is computed into
+        ControlVolumeFields current_fields;
+        ControlVolumeFields next_fields;
+
+        // A non-zero entry for every cell covered by an obstacle, and the index of
+        // every such cell
+        std::vector<uint8_t> obstacle_cell_mask;
+        std::vector<int> obstacle_cells;
+
+        // The number of steps taken, the time simulated (s), and the wall clock time
+        // spent stepping (s)
+        uint64_t num_steps;
+        double simulation_time;
+        double wall_time;
+    };
+
+    /**
+     * Step the given member forward by one step, on the calling thread
+     *
+     * @param member the member to step
+     * @param dt the amount of time to step forward by (s)
+     */
+    void stepMember(MemberState& member, double dt) const;
+
+    /**
+     * Summarise the given member
+     *
+     * @param member the member to summarise
+     *
+     * @return a summary of the given member
+     */
+    static EnsembleMemberSummary summariseMember(const MemberState& member);
+
+    // The graph the mesh was built from, which owns the nodes the mesh refers to
+    std::shared_ptr<GraphNode<ControlVolume>> graph;
+
+    // The mesh and neighbour tables, shared by every member
+    std::shared_ptr<const ControlVolumeMesh> mesh;
+
+    // The threads members are run on
+    ThreadPool thread_pool;
+
+    // The instruction set used to step cells in the interior of same-resolution blocks
+    SimdLevel simd_level;
+
+    // Every member, in the order they were added
+    std::vector<MemberState> members;
+};
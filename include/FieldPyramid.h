@@ -0,0 +1,176 @@
+#pragma once
+
+// STD Includes
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Project Includes
+#include "ControlVolumeFields.h"
+#include "ControlVolumeMesh.h"
+#include "ThreadPool.h"
+
+// The fields of a simulation reduced over a square grid of bins
+struct FieldPyramidLevel {
+    // The number of bins along each side. Bins are stored row by row, starting from
+    // the bin at the origin.
+    int resolution = 0;
+
+    // The side length of every bin (m). The last bins along each side may reach past
+    // the far edges of the simulation.
+    double bin_size = 0;
+
+    // The smallest, largest, and (area weighted) mean pressure of the fluid in every
+    // bin (Pa). These are all zero in bins with no fluid.
+    std::vector<double> min_pressure;
+    std::vector<double> max_pressure;
+    std::vector<double> mean_pressure;
+
+    // The (area weighted) mean velocity of the fluid in every bin (m/s)
+    std::vector<double> mean_velocity_x;
+    std::vector<double> mean_velocity_y;
+
+    // The area of every bin covered by fluid, and by obstacles (m^2)
+    std::vector<double> fluid_area;
+    std::vector<double> obstacle_area;
+};
+
+/**
+ * A reduction pyramid of the fields of a simulation, for drawing meshes with more
+ * cells than there are pixels
+ *
+ * The bins of the finest level are the size of the smallest cells, so every bin lies
+ * within a single cell and drawing it is exact. If that would be more than
+ * `max_resolution` bins along each side, each bin covers a power of two of the
+ * smallest cells along each side instead. Every level above the finest halves the
+ * resolution (rounding up) down to a single bin. A view of the simulation only has to
+ * read the level with about one bin per pixel, so it takes time proportional to the
+ * size of the view rather than the number of cells.
+ *
+ * Which cells overlap which bins of the finest level only depends on the mesh, so is
+ * only worked out again when the mesh changes.
+ */
+class FieldPyramid {
+  public:
+    // The most bins along each side of the finest level, by default
+    static constexpr int DEFAULT_MAX_RESOLUTION = 1024;
+
+    /**
+     * Reduce the given fields into every level of the pyramid
+     *
+     * @param mesh the mesh the fields are for
+     * @param fields the pressure and velocity of every cell
+     * @param obstacle_cell_mask a non-zero entry for every cell covered by an obstacle
+     * @param simulation_size the side length of the area being simulated (m)
+     * @param thread_pool the threads to reduce the fields on
+     * @param max_resolution the most bins along each side of the finest level
+     *
+     * @throws std::invalid_argument if `max_resolution` is less than 1
+     */
+    void build(std::shared_ptr<const ControlVolumeMesh> mesh,
+               const ControlVolumeFields& fields,
+               const std::vector<uint8_t>& obstacle_cell_mask,
+               double simulation_size,
+               ThreadPool& thread_pool,
+               int max_resolution = DEFAULT_MAX_RESOLUTION);
+
+    /**
+     * Check whether this has been built
+     *
+     * @return true if this hasn't been built yet, false otherwise
+     */
+    bool empty() const { return levels.empty(); }
+
+    /**
+     * Get the number of levels in the pyramid
+     *
+     * @return the number of levels in the pyramid
+     */
+    size_t numLevels() const { return levels.size(); }
+
+    /**
+     * Get one level of the pyramid
+     *
+     * @param level the level to get, from 0 (the finest) to `numLevels() - 1` (a
+     * single bin)
+     *
+     * @return the level
+     */
+    const FieldPyramidLevel& getLevel(size_t level) const { return levels[level]; }
+
+    /**
+     * Find the coarsest level with at least the given number of bins across the
+     * simulation
+     *
+     * @param num_bins the number of bins wanted across the simulation, eg. the number
+     * of pixels the simulation is drawn across
+     *
+     * @return the coarsest level with at least `num_bins` bins across the simulation,
+     * or the finest level if there isn't one
+     */
+    size_t selectLevel(double num_bins) const;
+
+    /**
+     * Check whether every bin of the finest level lies within a single cell, so the
+     * cells can be drawn exactly from it
+     *
+     * @return true if the bins of the finest level are the size of the smallest cells,
+     * false if they cover several of them
+     */
+    bool isFinestLevelExact() const { return finest_level_exact; }
+
+    /**
+     * Get the mesh this was built for
+     *
+     * @return the mesh this was built for, null if this hasn't been built yet
+     */
+    const std::shared_ptr<const ControlVolumeMesh>& getMesh() const { return mesh; }
+
+    /**
+     * Get the side length of the area this covers
+     *
+     * @return the side length of the area this covers (m)
+     */
+    double getSimulationSize() const { return simulation_size; }
+
+  private:
+    // The part of a cell that lies within a bin of the finest level
+    struct BinOverlap {
+        // The column of the bin
+        int column;
+
+        // The cell
+        int cell;
+
+        // The area of the cell within the bin (m^2)
+        double area;
+    };
+
+    /**
+     * Find which cells overlap which bins of the finest level
+     *
+     * @param resolution the number of bins along each side of the finest level
+     * @param bin_size the side length of every bin of the finest level (m)
+     */
+    void findBinOverlaps(int resolution, double bin_size);
+
+    // The mesh the bin overlaps were found for
+    std::shared_ptr<const ControlVolumeMesh> mesh;
+
+    // The side length of the area this covers (m)
+    double simulation_size = 0;
+
+    // The most bins along each side of the finest level
+    int max_resolution = 0;
+
+    // Whether the bins of the finest level are the size of the smallest cells
+    bool finest_level_exact = false;
+
+    // The overlaps of every row of bins of the finest level, with row r from
+    // `row_offsets[r]` up to `row_offsets[r + 1]`
+    std::vector<size_t> row_offsets;
+    std::vector<BinOverlap> overlaps;
+
+    // Every level, from the finest to a single bin
+    std::vector<FieldPyramidLevel> levels;
+};
@@ -0,0 +1,181 @@
+#pragma once
+
+// STD Includes
+#include <cstdint>
+#include <vector>
+
+// External Library Includes
+#include <cairomm/context.h>
+#include <cairomm/surface.h>
+
+// Project Includes
+#include "FieldPyramid.h"
+#include "FieldSnapshot.h"
+#include "StreamLines.h"
+#include "ThreadPool.h"
+
+// The ways a FieldRenderer can draw the control volumes
+enum class FieldRenderMode {
+    // Write the pressure colour map straight into an image from the snapshot's
+    // `FieldPyramid`, in parallel over rows, and draw a velocity glyph for every few
+    // pixels and the streamlines as one path per style. Takes time proportional to the
+    // number of pixels rather than the number of cells. (the default)
+    RASTERISED,
+    // Draw and outline every control volume, velocity glyph, and streamline point with
+    // it's own Cairo calls. Kept for comparison.
+    PER_CELL
+};
+
+// The part of the simulation a FieldRenderer draws
+struct FieldViewport {
+    // How far to zoom in, where 1 fits the whole simulation in the area drawn in
+    double zoom = 1;
+
+    // The point drawn at the centre of the area drawn in, as a fraction of the size of
+    // the simulation along each axis
+    double centre_x = 0.5;
+    double centre_y = 0.5;
+};
+
+/**
+ * Draws snapshots of a FluidSimulator onto a Cairo context
+ *
+ * This doesn't depend on GTK, so it can also be used to draw offscreen (eg. onto an
+ * ImageSurface).
+ */
+class FieldRenderer {
+  public:
+    FieldRenderer() = delete;
+
+    /**
+     * Create a FieldRenderer
+     *
+     * @param render_mode how to draw the control volumes
+     * @param num_threads the number of threads to draw with, must be at least 1
+     */
+    FieldRenderer(FieldRenderMode render_mode, int num_threads);
+
+    /**
+     * Choose how to draw the control volumes
+     *
+     * @param render_mode how to draw the control volumes
+     */
+    void setRenderMode(FieldRenderMode render_mode);
+
+    /**
+     * Choose which part of the simulation to draw
+     *
+     * @param viewport the part of the simulation to draw
+     *
+     * @throws std::invalid_argument if the zoom isn't positive
+     */
+    void setViewport(FieldViewport viewport);
+
+    /**
+     * Get the part of the simulation being drawn
+     *
+     * @return the part of the simulation being drawn
+     */
+    const FieldViewport& getViewport() const { return viewport; }
+
+    /**
+     * Draw the part of the given snapshot in the viewport, scaled to fit within the
+     * given size
+     *
+     * The fields are read from the snapshot's pyramid. If it hasn't been built (eg.
+     * the snapshot wasn't taken by a `SimulationThread`) this builds a pyramid of it's
+     * own every time it's called, which takes time proportional to the number of cells.
+     *
+     * @param ctx the context to draw on
+     * @param width the width of the area to draw in (pixels)
+     * @param height the height of the area to draw in (pixels)
+     * @param snapshot the snapshot to draw
+     */
+    void draw(const Cairo::RefPtr<Cairo::Context>& ctx,
+              int width,
+              int height,
+              const FieldSnapshot& snapshot);
+
+  private:
+    /**
+     * Draw every control volume and velocity glyph with it's own Cairo calls
+     *
+     * @param ctx the context to draw on, translated to the viewport
+     * @param snapshot the snapshot to draw
+     * @param scaling_factor the number of pixels per meter
+     * @param max_pressure the pressure drawn at full intensity (Pa)
+     */
+    void drawCellsPerCell(const Cairo::RefPtr<Cairo::Context>& ctx,
+                          const FieldSnapshot& snapshot,
+                          double scaling_factor,
+                          double max_pressure);
+
+    /**
+     * Rasterise the pressure colour map into `pressure_surface` from the level of the
+     * pyramid with about one bin per pixel, and draw it. When zoomed in past the
+     * finest level, and it's bins cover several cells, the cells are sampled directly.
+     *
+     * @param ctx the context to draw on, untranslated
+     * @param snapshot the snapshot to draw
+     * @param pyramid the pyramid of the snapshot to draw
+     * @param graph_size the side length of the area drawn in (pixels)
+     * @param scaling_factor the number of pixels per meter
+     * @param origin_x the x position drawn at the left of the area (m)
+     * @param origin_y the y position drawn at the top of the area (m)
+     * @param max_pressure the pressure drawn at full intensity (Pa)
+     */
+    void drawRasterisedPressure(const Cairo::RefPtr<Cairo::Context>& ctx,
+                                const FieldSnapshot& snapshot,
+                                const FieldPyramid& pyramid,
+                                int graph_size,
+                                double scaling_factor,
+                                double origin_x,
+                                double origin_y,
+                                double max_pressure);
+
+    /**
+     * Draw a velocity glyph for every bin of the level of the pyramid with bins about
+     * `MIN_GLYPH_SPACING` pixels apart, as a single path
+     *
+     * @param ctx the context to draw on, translated to the viewport
+     * @param pyramid the pyramid of the snapshot to draw
+     * @param graph_size the side length of the area drawn in (pixels)
+     * @param scaling_factor the number of pixels per meter
+     * @param origin_x the x position drawn at the left of the area (m)
+     * @param origin_y the y position drawn at the top of the area (m)
+     */
+    void drawVelocityGlyphs(const Cairo::RefPtr<Cairo::Context>& ctx,
+                            const FieldPyramid& pyramid,
+                            int graph_size,
+                            double scaling_factor,
+                            double origin_x,
+                            double origin_y);
+
+    /**
+     * Draw the given streamlines
+     *
+     * @param ctx the context to draw on, translated to the viewport
+     * @param streamlines the streamlines to draw
+     * @param scaling_factor the number of pixels per meter
+     */
+    void drawStreamLines(const Cairo::RefPtr<Cairo::Context>& ctx,
+                         const std::vector<std::vector<Point2d>>& streamlines,
+                         double scaling_factor);
+
+    // How the control volumes are drawn
+    FieldRenderMode render_mode;
+
+    // The part of the simulation drawn
+    FieldViewport viewport;
+
+    // The threads used to rasterise, and trace streamlines
+    ThreadPool thread_pool;
+
+    // The image the pressure colour map is rasterised into, kept between frames so
+    // it's only reallocated when the size changes
+    Cairo::RefPtr<Cairo::ImageSurface> pressure_surface;
+
+    // The pyramid built for snapshots that don't have one, kept between frames to
+    // avoid reallocating it
+    FieldPyramid fallback_pyramid;
+};
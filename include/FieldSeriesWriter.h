@@ -0,0 +1,281 @@
+#pragma once
+
+// STD Includes
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Project Includes
+#include "FieldSnapshot.h"
+
+// What `FieldSeriesWriter` writes, and how it handles frames arriving faster than it
+// can write them
+struct FieldSeriesParameters {
+    // The most frames waiting to be written at once
+    size_t queue_capacity = 8;
+
+    // If the queue is full, whether to wait for room (backpressure) or drop the frame
+    bool block_when_full = true;
+
+    // Whether to compress every chunk with zlib (only available if built with zlib,
+    // see `FieldSeriesWriter::isCompressionSupported`)
+    bool compress = false;
+
+    // Only cells with their centre in this rectangle (m) are written
+    double region_min_x = -std::numeric_limits<double>::infinity();
+    double region_min_y = -std::numeric_limits<double>::infinity();
+    double region_max_x = std::numeric_limits<double>::infinity();
+    double region_max_y = std::numeric_limits<double>::infinity();
+
+    // If positive, rather than writing every cell in the region, the fields are
+    // sampled (from the cell containing each point) on a regular grid of points this
+    // far apart (m) covering the region, which decimates fine meshes. Points off the
+    // mesh are skipped. The region must then be finite.
+    double sample_spacing = 0;
+};
+
+// One frame read back from a field time series
+struct FieldSeriesFrame {
+    // The index of this frame in the series
+    uint64_t frame = 0;
+
+    // The number of steps and amount of time (s) that had been simulated
+    uint64_t num_steps     = 0;
+    double simulation_time = 0;
+
+    // The point every value was taken at (the cell centre, or the sample point) (m)
+    std::vector<double> x;
+    std::vector<double> y;
+
+    // The pressure and velocity at every point
+    ControlVolumeFields fields;
+};
+
+/**
+ * Writes a time series of fields to an append-only file on a background thread
+ *
+ * Frames are passed through a bounded queue, so the simulation only waits for the
+ * writer (or drops frames) when the queue is full, and are written as a series of
+ * chunks. The points the values are taken at are written in a mesh chunk whenever
+ * they change (eg. when the mesh is refined), followed by one frame chunk per frame
+ * holding the values. Chunks may be compressed.
+ *
+ * Alongside the series, `<path>.index` gets a fixed size record for every frame
+ * (pointing at it's frame and mesh chunks), so any frame can be read without reading
+ * the frames before it (see `FieldSeriesReader`). Both files are only ever appended
+ * to, so a crash loses at most the frames that hadn't been written yet.
+ */
+class FieldSeriesWriter {
+  public:
+    FieldSeriesWriter() = delete;
+    FieldSeriesWriter(const FieldSeriesWriter&) = delete;
+    FieldSeriesWriter& operator=(const FieldSeriesWriter&) = delete;
+
+    /**
+     * Create the series and it's index, and start the background thread
+     *
+     * @param path the file to write the series to, replaced if it exists
+     * @param parameters what to write, and how to handle a full queue
+     *
+     * @throws std::invalid_argument if compression was asked for but isn't supported,
+     * or the sampling grid has a non-finite region
+     * @throws std::runtime_error if the files couldn't be created
+     */
+    FieldSeriesWriter(const std::string& path, FieldSeriesParameters parameters);
+
+    // Writes every queued frame, then stops the background thread
+    ~FieldSeriesWriter();
+
+    /**
+     * Queue the given snapshot to be written as the next frame
+     *
+     * The snapshot is swapped with a spare one the writer has finished with, so
+     * taking the next snapshot into it reuses the spare's buffers rather than
+     * allocating. If the queue is full this either waits for room or drops the frame
+     * (leaving `snapshot` unchanged), depending on
+     * `FieldSeriesParameters::block_when_full`.
+     *
+     * @param snapshot the snapshot to write
+     *
+     * @return true if the frame was queued, false if it was dropped
+     */
+    bool write(FieldSnapshot& snapshot);
+
+    /**
+     * Wait for every queued frame to be written, and flush the files
+     *
+     * @throws std::runtime_error if writing failed (after which nothing more is
+     * written)
+     */
+    void flush();
+
+    // Counts of what happened to the frames given to `write`
+    struct Counters {
+        // Frames written to the file
+        uint64_t frames_written;
+        // Frames dropped because the queue was full
+        uint64_t frames_dropped;
+        // Frames that had to wait for room in the queue
+        uint64_t frames_backpressured;
+        // Bytes written to the series (not including the index)
+        uint64_t bytes_written;
+    };
+
+    /**
+     * Get counts of what happened to the frames given to `write`
+     *
+     * @return counts of what happened to the frames given to `write`
+     */
+    Counters getCounters();
+
+    /**
+     * Check if this was built with zlib, so chunks can be compressed
+     *
+     * @return true if chunks can be compressed, false otherwise
+     */
+    static bool isCompressionSupported();
+
+  private:
+    /**
+     * Write queued frames until asked to stop
+     */
+    void run();
+
+    /**
+     * Write the given snapshot as the next frame, preceded by a mesh chunk if the
+     * points have changed
+     *
+     * @param snapshot the snapshot to write
+     */
+    void writeFrame(const FieldSnapshot& snapshot);
+
+    /**
+     * Choose the points to write for the given mesh, into `cells`, `point_x`, and
+     * `point_y`
+     *
+     * @param snapshot a snapshot on the mesh to choose points for
+     */
+    void selectPoints(const FieldSnapshot& snapshot);
+
+    /**
+     * Append a chunk to the series
+     *
+     * @param type the type of chunk
+     * @param payload the contents of the chunk
+     *
+     * @return the offset of the chunk in the series
+     */
+    uint64_t writeChunk(uint32_t type, const std::vector<unsigned char>& payload);
+
+    // What to write, and how to handle a full queue
+    const FieldSeriesParameters parameters;
+
+    // The series and index files
+    std::FILE* series_file;
+    std::FILE* index_file;
+
+    // Only used by the background thread: the mesh the points were last chosen for,
+    // the cell of every point, the position of every point, and the offset of the
+    // last mesh chunk
+    std::shared_ptr<const ControlVolumeMesh> points_mesh;
+    std::vector<int> cells;
+    std::vector<double> point_x;
+    std::vector<double> point_y;
+    uint64_t mesh_chunk_offset;
+    uint64_t series_size;
+
+    // Guards everything below
+    std::mutex mutex;
+
+    // Signalled when a frame is queued, or the thread should stop
+    std::condition_variable queued;
+
+    // Signalled when a frame has been written (so there's room in the queue)
+    std::condition_variable written;
+
+    // The frames waiting to be written, the number being written right now, and
+    // written snapshots to hand back to `write` (so taking snapshots doesn't allocate)
+    std::deque<std::unique_ptr<FieldSnapshot>> queue;
+    size_t num_writing;
+    std::vector<std::unique_ptr<FieldSnapshot>> free_snapshots;
+
+    // Counts of what happened to the frames given to `write`
+    Counters counters;
+
+    // The error that stopped writing, if any
+    std::exception_ptr error;
+
+    // Set to ask the background thread to stop once the queue is empty
+    bool stopping;
+
+    // Writes the queued frames
+    std::thread thread;
+};
+
+/**
+ * Reads frames from a field time series written by `FieldSeriesWriter`, in any order
+ */
+class FieldSeriesReader {
+  public:
+    FieldSeriesReader() = delete;
+
+    /**
+     * Open the given series and read it's index
+     *
+     * @param path the series to read (the index is read from `<path>.index`)
+     *
+     * @throws std::runtime_error if the files couldn't be opened or aren't a series
+     */
+    explicit FieldSeriesReader(const std::string& path);
+
+    ~FieldSeriesReader();
+
+    /**
+     * Get the number of complete frames in the series
+     *
+     * @return the number of complete frames in the series
+     */
+    size_t numFrames() const { return index.size(); }
+
+    /**
+     * Read the given frame
+     *
+     * @param frame the index of the frame to read
+     * @param result set to the frame
+     *
+     * @throws std::out_of_range if there is no such frame
+     * @throws std::runtime_error if the frame couldn't be read
+     */
+    void readFrame(size_t frame, FieldSeriesFrame& result);
+
+  private:
+    // A record in the index
+    struct IndexRecord {
+        uint64_t frame_chunk_offset;
+        uint64_t mesh_chunk_offset;
+    };
+
+    /**
+     * Read the chunk at the given offset
+     *
+     * @param offset the offset of the chunk in the series
+     * @param type the type the chunk should be
+     *
+     * @return the (uncompressed) contents of the chunk
+     */
+    std::vector<unsigned char> readChunk(uint64_t offset, uint32_t type);
+
+    // The series file
+    std::FILE* series_file;
+
+    // Every complete record in the index
+    std::vector<IndexRecord> index;
+};
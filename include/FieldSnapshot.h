@@ -0,0 +1,77 @@
+#pragma once
+
+// STD Includes
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Project Includes
+#include "CellLocator.h"
+#include "ControlVolumeFields.h"
+#include "ControlVolumeMesh.h"
+#include "FieldPyramid.h"
+
+/**
+ * A copy of the state of a `FluidSimulator` at one point in time, that can be read
+ * while the simulator keeps stepping
+ *
+ * The mesh is immutable, so it is shared with the simulator rather than copied, and
+ * only the fields and obstacle mask are copied.
+ */
+struct FieldSnapshot {
+    // The mesh the fields are for, null if this snapshot hasn't been taken yet
+    std::shared_ptr<const ControlVolumeMesh> mesh;
+
+    // Locates cells in the mesh
+    std::shared_ptr<const CellLocator> cell_locator;
+
+    // The pressure and velocity of every cell
+    ControlVolumeFields fields;
+
+    // A non-zero entry for every cell covered by an obstacle
+    std::vector<uint8_t> obstacle_cell_mask;
+
+    // The side length of the area being simulated (m)
+    double simulation_size = 0;
+
+    // The total amount of time that had been simulated (s)
+    double simulation_time = 0;
+
+    // The number of steps that had been taken (only counted by `SimulationThread`)
+    uint64_t num_steps = 0;
+
+    // The fields reduced to screen resolution for drawing (only built by
+    // `SimulationThread`)
+    FieldPyramid pyramid;
+};
+
+/**
+ * An immutable view of the state of a `FluidSimulator` at one point in time, taken
+ * without copying any cells (see `FluidSimulator::shareSnapshot`)
+ *
+ * Everything is shared with the simulator, which writes to new buffers rather than
+ * changing ones that are still shared, so this stays valid and unchanged however long
+ * it is held, and can be read from any number of threads at once.
+ */
+struct SharedFieldSnapshot {
+    // The mesh the fields are for, null if this snapshot hasn't been taken yet
+    std::shared_ptr<const ControlVolumeMesh> mesh;
+
+    // Locates cells in the mesh
+    std::shared_ptr<const CellLocator> cell_locator;
+
+    // The pressure and velocity of every cell
+    std::shared_ptr<const ControlVolumeFields> fields;
+
+    // A non-zero entry for every cell covered by an obstacle
+    std::shared_ptr<const std::vector<uint8_t>> obstacle_cell_mask;
+
+    // The side length of the area being simulated (m)
+    double simulation_size = 0;
+
+    // The total amount of time that had been simulated (s)
+    double simulation_time = 0;
+
+    // The number of steps that had been taken, if counted by whoever took this
+    uint64_t num_steps = 0;
+};
@@ -1,7 +1,9 @@
 #pragma once
 
 // STD Includes
+#include <cstdint>
 #include <memory>
+#include <string>
 
 // Library Includes
 #include <multi_res_graph/Area.h>
@@ -9,11 +11,57 @@
 #include <units.h>
 
 // Project Includes
+#include "BoundaryConditions.h"
+#include "CellLocator.h"
+#include "Checkpoint.h"
 #include "ControlVolume.h"
+#include "ControlVolumeFields.h"
+#include "ControlVolumeMesh.h"
+#include "FieldPyramid.h"
+#include "FieldSeriesWriter.h"
+#include "FieldSnapshot.h"
+#include "GhostCellLayer.h"
+#include "ImplicitDiffusionSolver.h"
+#include "LocalTimeStepper.h"
+#include "MeshRefiner.h"
+#include "MultigridSolver.h"
+#include "NodeSpan.h"
+#include "ProjectionSolver.h"
+#include "SimdStencilKernel.h"
+#include "StreamLines.h"
+#include "TemporalBlockStepper.h"
+#include "ThreadPool.h"
 
-struct Point2d {
-    units::length::meter_t x;
-    units::length::meter_t y;
+// The ways `FluidSimulator::updateControlVolumes` can step the simulation
+enum class UpdateMethod {
+    // Step on contiguous field arrays with precomputed neighbour tables (the default)
+    FLAT_ARRAYS,
+    // Step directly on the graph, copying a `ControlVolume` for every neighbour. Kept
+    // for comparison, produces bit-identical results to FLAT_ARRAYS
+    LEGACY_GRAPH
+};
+
+// Parameters controlling `FluidSimulator::updateControlVolumesAdaptive`
+struct AdaptiveTimeStepParameters {
+    // The fraction of the largest stable (acoustic, advective, and viscous) time step
+    // to actually take
+    double cfl_number = 0.5;
+
+    // A step is rejected as unstable if it produces a non-finite value, or if the
+    // largest speed or pressure magnitude grows by more than this factor. The pressure
+    // isn't checked in PROJECTION mode, as it isn't stepped from it's previous value.
+    double max_growth_factor = 2;
+
+    // Speeds (m/s) below this are not considered when checking for growth, so fields
+    // that start out at rest aren't rejected for starting to move. The equivalent
+    // pressure floor is the acoustic pressure of this speed (density * c * speed).
+    double min_reference_speed = 1;
+
+    // How much to shrink the time step by after rejecting a step
+    double retry_factor = 0.5;
+
+    // The most times a single step is retried before giving up
+    int max_retries = 10;
 };
 
 // TODO: Descriptive comment here
@@ -45,11 +93,314 @@ class FluidSimulator {
      */
     void updateControlVolumes(units::time::second_t dt);
 
+    /**
+     * Update all the control volumes, using the largest stable time step
+     *
+     * The time step is the largest allowed by the acoustic, advective, and viscous
+     * stability limits (scaled by the CFL number), capped at `max_dt`. If the step
+     * turns out to be unstable anyway it is rolled back and retried with a smaller time
+     * step. This always steps on the flat arrays, regardless of the update method.
+     *
+     * @param max_dt the largest time step to take
+     *
+     * @throws std::runtime_error if no stable time step could be found
+     *
+     * @return the time step that was actually taken
+     */
+    units::time::second_t updateControlVolumesAdaptive(units::time::second_t max_dt);
+
+    /**
+     * Update all the control volumes with local time stepping, so smaller control
+     * volumes take several smaller steps for every step of the larger ones (see
+     * `LocalTimeStepper`)
+     *
+     * The largest control volumes step by the largest time step stable for every
+     * level (scaled by the CFL number), capped at `max_dt`, and each halving of the
+     * size of a control volume halves it's time step. On a mesh where every control
+     * volume is the same size this takes the same step as
+     * `updateControlVolumesAdaptive`, but doesn't check it or retry it. This always
+     * steps on the flat arrays, regardless of the update method.
+     *
+     * @param max_dt the largest time step for the largest control volumes to take
+     *
+     * @throws std::runtime_error if the solver mode is PROJECTION, whose pressure
+     * solve couples every control volume at the same time, or any boundary isn't INFLOW
+     *
+     * @return the time step taken by the largest control volumes, which is the amount
+     * of time that was simulated
+     */
+    units::time::second_t updateControlVolumesLocal(units::time::second_t max_dt);
+
+    /**
+     * Update all the control volumes by several steps of the same time step, stepping
+     * cache-sized tiles of the mesh several steps at a time (see
+     * `TemporalBlockStepper`)
+     *
+     * The steps are taken in blocks of up to `steps_per_block`, and give exactly the
+     * same result as taking them one at a time with `updateControlVolumes` and the
+     * scalar kernels. Blocks are cut short where the mesh is due to be adapted or a
+     * frame is due to be output, so both happen after the same steps as they would
+     * one step at a time. Adaptation compares against the fields from before the
+     * block, rather than before the last step. This always steps on the flat
+     * arrays, regardless of the update method.
+     *
+     * @param dt the amount of time to step forward by each step
+     * @param num_steps the number of steps to take
+     *
+     * @throws std::runtime_error if the solver mode is PROJECTION, implicit diffusion
+     * is enabled, or any boundary isn't INFLOW
+     */
+    void updateControlVolumesBlocked(units::time::second_t dt, int num_steps);
+
+    /**
+     * Set the size of the tiles and blocks `updateControlVolumesBlocked` steps in
+     *
+     * @param parameters the size of the tiles and blocks
+     *
+     * @throws std::invalid_argument if the tile size or steps per block is less than 1
+     */
+    void setTemporalBlockingParameters(TemporalBlockingParameters parameters);
+
+    /**
+     * Get the size of the tiles and blocks `updateControlVolumesBlocked` steps in
+     *
+     * @return the size of the tiles and blocks
+     */
+    TemporalBlockingParameters getTemporalBlockingParameters() const;
+
+    /**
+     * Compute the largest stable time step for the current state of the simulation
+     *
+     * This is the smallest of the acoustic (h / (c + |u|)), advective (h / |u|), and
+     * viscous (h^2 / (4 * viscosity)) limits over every cell, scaled by the CFL number,
+     * where h is the smallest distance from a cell to one of it's neighbours. The
+     * acoustic limit is left out in PROJECTION mode, and the viscous limit is left out
+     * with implicit diffusion.
+     *
+     * @return the largest stable time step for the current state of the simulation
+     */
+    units::time::second_t computeStableTimeStep();
+
+    /**
+     * Set the parameters used by `updateControlVolumesAdaptive`
+     *
+     * @param parameters the parameters to use
+     */
+    void setAdaptiveTimeStepParameters(AdaptiveTimeStepParameters parameters);
+
+    /**
+     * Get the total number of steps `updateControlVolumesAdaptive` has rejected as
+     * unstable and retried
+     *
+     * @return the total number of steps rejected as unstable
+     */
+    int getNumRejectedSteps() const;
+
+    /**
+     * Get the total number of times a control volume has been stepped forward, over
+     * every step (including rejected ones)
+     *
+     * @return the total number of control volume updates
+     */
+    uint64_t getNumCellUpdates() const;
+
+    /**
+     * Get the total amount of time that has been simulated
+     *
+     * @return the total amount of time that has been simulated
+     */
+    units::time::second_t getSimulationTime() const;
+
+    /**
+     * Get the number of control volumes in the simulation
+     *
+     * @return the number of control volumes in the simulation
+     */
+    size_t getNumControlVolumes();
+
+    /**
+     * Choose how `updateControlVolumes` steps the simulation
+     *
+     * NOTE: The FLAT_ARRAYS method uses the density, viscosity, and speed of sound of
+     *       this simulator for every cell, rather than the values stored in each
+     *       ControlVolume (these are the same unless the graph was replaced)
+     *
+     * @param update_method the method to use
+     */
+    void setUpdateMethod(UpdateMethod update_method);
+
+    /**
+     * Choose the equations the simulation solves
+     *
+     * @param solver_mode the equations to solve
+     */
+    void setSolverMode(SolverMode solver_mode);
+
+    /**
+     * Choose the conditions applied at each side of the mesh (see `GhostCellLayer`).
+     * These default to `legacyBoundaryConditions()`.
+     *
+     * NOTE: The legacy graph update, the projection method, local time stepping, and
+     *       implicit diffusion only support INFLOW boundaries. With any other kind, the
+     *       simulation is stepped on the flat arrays, and the rest throw.
+     *
+     * @param conditions the conditions to apply
+     *
+     * @throws std::invalid_argument if the conditions are invalid (see
+     * `validateBoundaryConditions`)
+     */
+    void setBoundaryConditions(const BoundaryConditions& conditions);
+
+    /**
+     * Get the conditions applied at each side of the mesh
+     *
+     * @return the conditions applied at each side of the mesh
+     */
+    const BoundaryConditions& getBoundaryConditions() const;
+
+    /**
+     * Get the equations the simulation solves
+     *
+     * @return the equations the simulation solves
+     */
+    SolverMode getSolverMode() const;
+
+    /**
+     * Get the outcome of the pressure solve of the last step taken in PROJECTION mode
+     *
+     * @return the outcome of the last pressure solve, with zero iterations if there
+     * hasn't been one
+     */
+    LinearSolveResult getLastPressureSolveResult() const;
+
+    /**
+     * Diffuse the velocity implicitly every step (see `ImplicitDiffusionSolver`), so
+     * the time step isn't limited by viscosity
+     *
+     * The rest of each step is taken explicitly without viscosity, then the velocity is
+     * diffused over the whole step (before the pressure is projected in PROJECTION
+     * mode). `computeStableTimeStep` leaves out the viscous limit while this is
+     * enabled, and the simulation is always stepped on the flat arrays.
+     *
+     * NOTE: The diffusion reads the top neighbour of every cell from the fields, rather
+     *       than the top velocity override of the legacy edge states
+     *
+     * @param parameters the parameters to diffuse with
+     *
+     * @throws std::invalid_argument if the implicitness is outside [0.5, 1]
+     */
+    void enableImplicitDiffusion(
+        ImplicitDiffusionParameters parameters = ImplicitDiffusionParameters());
+
+    /**
+     * Go back to diffusing the velocity explicitly, along with the rest of each step
+     */
+    void disableImplicitDiffusion();
+
+    /**
+     * Get the outcome of the diffusion solves of the last step taken with implicit
+     * diffusion
+     *
+     * @return the outcome of the last diffusion solves, with zero iterations if there
+     * haven't been any
+     */
+    DiffusionSolveResult getLastDiffusionSolveResult() const;
+
+    /**
+     * Check whether the velocity is diffused implicitly
+     *
+     * @return whether the velocity is diffused implicitly
+     */
+    bool isImplicitDiffusionEnabled() const;
+
+    /**
+     * Periodically split and merge control volumes to follow the solution, every
+     * `parameters.steps_between_adaptations` steps (see `MeshRefiner`)
+     *
+     * Refinement subdivides the nodes of the graph without changing the graph itself,
+     * so the simulation is always stepped on the flat arrays while it's enabled. When
+     * the graph is handed out each node gets the mean of the control volumes within
+     * it, and if it is then changed every control volume within a node is reset to the
+     * value of that node.
+     *
+     * @param parameters the parameters controlling when control volumes are split and
+     * merged
+     *
+     * @throws std::invalid_argument if the max level is out of range
+     */
+    void enableMeshRefinement(RefinementParameters parameters);
+
+    /**
+     * Stop refining control volumes, merging any that have been split back into the
+     * nodes of the graph
+     */
+    void disableMeshRefinement();
+
+    /**
+     * Write the fields to the given writer every `steps_per_frame` steps
+     *
+     * Each frame is a snapshot handed to the writer's queue, so stepping only waits
+     * for the writer if it's queue is full (or drops the frame, depending on how the
+     * writer was set up). The `num_steps` of each frame counts the steps taken since
+     * this was called.
+     *
+     * @param writer the writer to write frames to, or null to stop writing frames
+     * @param steps_per_frame the number of steps between frames, must be at least 1
+     *
+     * @throws std::invalid_argument if `steps_per_frame` is less than 1
+     */
+    void setFieldOutput(std::shared_ptr<FieldSeriesWriter> writer, int steps_per_frame);
+
+    /**
+     * Set the number of threads used to step the simulation
+     *
+     * Results are bit-identical for any number of threads. Only the FLAT_ARRAYS
+     * update method is run in parallel.
+     *
+     * @param num_threads the number of threads to use, must be at least 1
+     */
+    void setNumThreads(int num_threads);
+
+    /**
+     * Get the number of threads used to step the simulation
+     *
+     * @return the number of threads used to step the simulation
+     */
+    int getNumThreads() const;
+
+    /**
+     * Set the instruction set used to step cells in the interior of same-resolution
+     * blocks (defaults to the best one this CPU supports)
+     *
+     * @param simd_level the instruction set to use, must be supported by this CPU
+     */
+    void setSimdLevel(SimdLevel simd_level);
+
+    /**
+     * Get the instruction set used to step cells in the interior of same-resolution
+     * blocks
+     *
+     * @return the instruction set used to step cells in the interior of
+     * same-resolution blocks
+     */
+    SimdLevel getSimdLevel() const;
+
+    /**
+     * Indicate that the topology of the graph has changed, so any neighbour tables
+     * built from it need to be rebuilt before the next update
+     */
+    void invalidateTopology();
+
     // TODO: This should return a COPY, but we need to implement deep copy for multi-res
     // graphs first
     /**
      * Gets the multi resolution graph of all the control volumes
      *
+     * With mesh refinement enabled, each node holds the area-weighted mean of the
+     * cells it has been split into. Before the next step, the cells of every node
+     * whose value has been changed are all set to it's new value, and the cells of
+     * every other node are left as they were.
+     *
      * @return the multi resolution graph of all the control volumes
      */
     std::shared_ptr<GraphNode<ControlVolume>> getControlVolumeGraph();
@@ -75,12 +426,165 @@ class FluidSimulator {
      */
     std::vector<std::shared_ptr<Area<ControlVolume>>> getObstacles();
 
+    /**
+     * Get the graph node of every control volume, in the same order as
+     * `getObstacleCellMask()`
+     *
+     * This is cached between calls, and only changes when the topology changes. The
+     * values in the nodes are up to date, but should only be read; use
+     * `getControlVolumeGraph()` to modify them.
+     *
+     * NOTE: Kept for existing callers, `getControlVolumeCells` gives the same nodes
+     *       without handing out owning pointers
+     *
+     * @return the graph node of every control volume
+     */
+    const std::vector<std::shared_ptr<RealNode<ControlVolume>>>& getControlVolumeNodes();
+
+    /**
+     * Get a non-owning view of the graph node of every control volume, in the same
+     * order as `getObstacleCellMask()`
+     *
+     * This is cached with the mesh, so the view stays valid (and keeps pointing at the
+     * same list) until the topology changes, ie. until `invalidateTopology` or
+     * `setControlVolumeGraph` is called, the mesh is refined or coarsened, or mesh
+     * refinement is enabled or disabled. The values in the nodes are up to date, but
+     * should only be read; use `getControlVolumeGraph()` to modify them.
+     *
+     * @return a view of the graph node of every control volume
+     */
+    NodeSpan<ControlVolume> getControlVolumeCells();
+
+    /**
+     * Get whether each control volume is covered by an obstacle, in the same order as
+     * `getControlVolumeNodes()`
+     *
+     * @return a vector with a non-zero entry for every control volume covered by an
+     * obstacle
+     */
+    const std::vector<uint8_t>& getObstacleCellMask();
+
+    /**
+     * Get the size of the (square) area being simulated
+     *
+     * @return the side length of the area being simulated
+     */
+    units::length::meter_t getSimulationSize() const;
+
+    /**
+     * Get the density of the fluid being simulated
+     *
+     * @return the density of the fluid being simulated
+     */
+    units::density::kg_per_cu_m_t getDensity() const;
+
+    /**
+     * Get the viscosity of the fluid being simulated
+     *
+     * @return the viscosity of the fluid being simulated
+     */
+    units::viscosity::meters_squared_per_s_t getViscosity() const;
+
+    /**
+     * Get the speed of sound in the fluid being simulated
+     *
+     * @return the speed of sound in the fluid being simulated
+     */
+    units::velocity::meters_per_second_t getSpeedOfSound() const;
+
+    /**
+     * Copy the current state of the simulation into the given snapshot
+     *
+     * The snapshot's buffers are reused, so taking snapshots into the same snapshot
+     * repeatedly doesn't allocate unless the number of control volumes changes.
+     *
+     * @param snapshot the snapshot to copy the current state of the simulation into.
+     * It's `num_steps` is left unchanged.
+     */
+    void takeSnapshot(FieldSnapshot& snapshot);
+
+    /**
+     * Reduce the current fields into the given pyramid, on the threads used to step
+     * the simulation
+     *
+     * The pyramid's buffers are reused, so building the same pyramid repeatedly only
+     * allocates when the mesh changes.
+     *
+     * @param pyramid the pyramid to build
+     */
+    void buildFieldPyramid(FieldPyramid& pyramid);
+
+    /**
+     * Get an immutable view of the current state of the simulation, without copying
+     * it
+     *
+     * The view shares the simulator's buffers. When the simulator next changes a
+     * buffer that is still shared it writes to a new one instead (copy-on-write), so
+     * the view stays valid and unchanged while the simulation keeps stepping, and may
+     * be read from any thread without locking. Holding on to views means a step may
+     * need to allocate new buffers, so views should be released once they've been
+     * read.
+     *
+     * NOTE: This must be called on the thread stepping the simulation, but the view
+     *       it returns can be handed to any thread
+     *
+     * @return a view of the current state of the simulation. It's `num_steps` is 0.
+     */
+    SharedFieldSnapshot shareSnapshot();
+
+    /**
+     * Copy everything needed to restart the simulation into the given state, for
+     * writing with `writeCheckpoint` or a `CheckpointWriter`
+     *
+     * The boundary conditions, solver mode, and implicit diffusion settings are part of
+     * the state, as they change the equations being solved. The other run settings
+     * (update method, threads, time step parameters, temporal blocking, and mesh
+     * refinement) are not.
+     *
+     * @param state the state to copy the simulation into
+     */
+    void takeCheckpoint(CheckpointState& state);
+
+    /**
+     * Write a checkpoint of the current state of the simulation to the given file
+     *
+     * @param path the file to write
+     *
+     * @throws std::runtime_error if the file couldn't be written
+     */
+    void writeCheckpoint(const std::string& path);
+
+    /**
+     * Create a simulator from a checkpoint file
+     *
+     * The mesh and fields are read straight from the memory-mapped file, rather than
+     * rebuilt from the graph. The graph isn't built until something needs it (eg.
+     * `getControlVolumeGraph()`), so a restored simulator can be stepped straight away.
+     * Obstacles are restored as the cells they covered, so they take effect but
+     * aren't returned by `getObstacles()`. The settings stored by `takeCheckpoint` are
+     * restored, and every other run setting is left at it's default.
+     *
+     * NOTE: Only checkpoints of simulators using the graph they were constructed with
+     *       (at `initial_simulation_resolution`) can be restored
+     *
+     * @param path the checkpoint file to read
+     *
+     * @throws std::runtime_error if the file couldn't be read, or doesn't match the
+     * graph it describes
+     *
+     * @return a simulator in the state the checkpoint was taken in
+     */
+    static FluidSimulator restoreCheckpoint(const std::string& path);
+
     /**
      * Get points along a StreamLine starting from the given point
      *
+     * This steps along the velocity of the closest control volume to each point. Use
+     * `getStreamLines` for smoother (interpolated) streamlines.
+     *
      * @param start_point the point to start the streamline at
-     * @param line_length TODO
-     * @param distance_between_points TODO
+     * @param line_length the length of the streamline
+     * @param distance_between_points the distance between consecutive points
      *
      * @return a vector of points representing the streamline, with the first point on
      * the streamline being the first point in the vector
@@ -90,7 +594,205 @@ class FluidSimulator {
                             units::length::meter_t line_length,
                             units::length::meter_t distance_between_points);
 
+    /**
+     * Get the StreamLines starting from each of the given points
+     *
+     * The streamlines are traced in parallel, on the threads used to step the
+     * simulation
+     *
+     * @param start_points the points to start a streamline at
+     * @param line_length the length of each streamline
+     * @param distance_between_points the distance between consecutive points
+     * @param options how to trace the streamlines
+     *
+     * @return the points along the streamline starting at each of the given points, in
+     * the same order as the given points
+     */
+    std::vector<std::vector<Point2d>>
+        getStreamLines(const std::vector<Point2d>& start_points,
+                       units::length::meter_t line_length,
+                       units::length::meter_t distance_between_points,
+                       StreamLineOptions options = StreamLineOptions());
+
   private:
+    /**
+     * Construct a simulator for a fluid with the given properties
+     *
+     * @param density the density of the fluid
+     * @param viscosity the viscosity of the fluid
+     * @param speed_of_sound the speed of sound in the fluid
+     * @param simulation_size the width and height of the simulated area
+     * @param initial_simulation_resolution the number of graph nodes along each side
+     * @param build_graph whether to build the graph now, rather than leave it to
+     * `buildGraph` when it is first needed
+     */
+    FluidSimulator(units::density::kg_per_cu_m_t density,
+                   units::viscosity::meters_squared_per_s_t viscosity,
+                   units::velocity::meters_per_second_t speed_of_sound,
+                   units::length::meter_t simulation_size,
+                   int initial_simulation_resolution,
+                   bool build_graph);
+
+    /**
+     * Build `control_volume_graph` filled with still fluid if it hasn't been built
+     * yet, and give it's nodes to a mesh restored without them
+     */
+    void buildGraph();
+
+    /**
+     * Step the simulation on the graph itself
+     *
+     * @param dt the amount of time to step forward by
+     */
+    void updateControlVolumesLegacy(units::time::second_t dt);
+
+    /**
+     * Step the simulation on the flat field arrays
+     *
+     * @param dt the amount of time to step forward by
+     */
+    void updateControlVolumesFlat(units::time::second_t dt);
+
+    /**
+     * Compute the next value of every cell from `current_fields` into `next_fields`
+     *
+     * @param dt the amount of time to step forward by (s)
+     */
+    void computeNextFields(double dt);
+
+    /**
+     * Make `next_fields` the current fields, and clear any cells within obstacles
+     */
+    void commitNextFields();
+
+    /**
+     * Compute the largest stable time step for the current state of the simulation (see
+     * `computeStableTimeStep`), if the cells at each level take half the time step of
+     * the level before
+     *
+     * @param cell_levels the level of every cell, or null if every cell takes the same
+     * time step
+     *
+     * @return the largest stable time step for cells at level 0 (s)
+     */
+    double computeLevelTimeStep(const std::vector<int>* cell_levels);
+
+    /**
+     * Get `diffusion_solver`, building it for the current mesh and obstacles if
+     * needed
+     *
+     * @return the solver used for implicit diffusion
+     */
+    ImplicitDiffusionSolver& getDiffusionSolver();
+
+    /**
+     * Check that every boundary is INFLOW, for the parts of the simulation that read
+     * the states outside the mesh directly
+     *
+     * @param feature the part of the simulation that needs them, for the error
+     *
+     * @throws std::runtime_error if any boundary isn't INFLOW
+     */
+    void requireFixedEdgeStates(const std::string& feature) const;
+
+    // The largest magnitudes in a set of fields, and if they are all finite
+    struct FieldMagnitudes {
+        double max_speed;
+        double max_pressure;
+        bool all_finite;
+    };
+
+    /**
+     * Find the largest magnitudes in the given fields
+     *
+     * @param fields the fields to measure
+     *
+     * @return the largest magnitudes in the given fields
+     */
+    FieldMagnitudes measureFields(const ControlVolumeFields& fields);
+
+    /**
+     * Split and merge cells if mesh refinement is enabled and it's time to
+     *
+     * @param num_steps the number of steps taken since this was last called
+     */
+    void adaptMesh(int num_steps = 1);
+
+    /**
+     * Hand a snapshot to `field_output` if it's set and it's time to
+     *
+     * @param num_steps the number of steps taken since this was last called
+     */
+    void outputFields(int num_steps = 1);
+
+    /**
+     * Get `current_fields` to modify, first copying it if it is shared with a
+     * snapshot
+     *
+     * @return the current fields, not shared with any snapshot
+     */
+    ControlVolumeFields& writableCurrentFields();
+
+    /**
+     * Get `next_fields` to compute the next step into, sized to match the current
+     * fields. If it is shared with a snapshot it is replaced with a new buffer, so
+     * it's values are only valid if it wasn't.
+     *
+     * @return the next fields, not shared with any snapshot
+     */
+    ControlVolumeFields& writableNextFields();
+
+    /**
+     * Get `obstacle_cell_mask` to modify, first copying it if it is shared with a
+     * snapshot
+     *
+     * @return the obstacle cell mask, not shared with any snapshot
+     */
+    std::vector<uint8_t>& writableObstacleCellMask();
+
+    /**
+     * Throw away every solver built for the current mesh, obstacles, and settings, so
+     * they are built again when next used
+     *
+     * This must be called whenever any of those change.
+     */
+    void invalidateSolvers();
+
+    /**
+     * Rebuild `obstacle_cell_mask` and `obstacle_cells` for the current mesh
+     */
+    void rebuildObstacleMask();
+
+    /**
+     * Mark every cell covered by the given obstacle in `obstacle_cell_mask`
+     *
+     * @param obstacle the obstacle to mark the cells of
+     */
+    void addObstacleToMask(Area<ControlVolume>& obstacle);
+
+    /**
+     * Rebuild `obstacle_cells` from `obstacle_cell_mask`
+     */
+    void rebuildObstacleCellList();
+
+    /**
+     * Get every node of the graph, in the order `getAllSubNodes` returns them, built
+     * once and kept until the topology changes
+     *
+     * @return every node of the graph
+     */
+    const std::vector<RealNode<ControlVolume>*>& getGraphNodes();
+
+    /**
+     * Make sure the mesh and field arrays reflect the current graph
+     */
+    void synchroniseFields();
+
+    /**
+     * Make sure the values in the graph reflect the current field arrays
+     */
+    void synchroniseGraph();
+
     // The density of the fluid
     units::density::kg_per_cu_m_t density;
 
@@ -100,13 +802,137 @@ class FluidSimulator {
     // The speed of sound in the fluid
     units::velocity::meters_per_second_t speed_of_sound;
 
-    // The actual simulator the holds all the control volumes
+    // The actual simulator the holds all the control volumes. This is null until
+    // `buildGraph` is called for a simulator restored from a checkpoint.
     std::shared_ptr<GraphNode<ControlVolume>> control_volume_graph;
 
+    // The scale and resolution of `control_volume_graph`, kept so they are known
+    // before it has been built
+    double graph_scale;
+    int graph_resolution;
+
+    // Every node of `control_volume_graph`, which owns them, so stepping on the graph
+    // doesn't gather a new list of `std::shared_ptr`s every step. Empty if it needs to
+    // be (re)built.
+    std::vector<RealNode<ControlVolume>*> graph_nodes;
+
     // TODO: We should change this to something like `unique_ptr` or override the copy
     // constructor, because right now we can "copy" this FluidSimulator, but the copy
     // will have pointers to the same obstacles
     // TODO: Better comment here
     // Solid obstacles that may overlap control volume(s)
     std::vector<std::shared_ptr<Area<ControlVolume>>> obstacles;
+
+    // A non-zero entry for every cell covered by an obstacle, and the index of every
+    // such cell. These are built when the mesh is built, and updated as obstacles are
+    // added, so the obstacles don't need to be checked every step. The mask may be
+    // shared with snapshots, so it is only modified through
+    // `writableObstacleCellMask`.
+    std::shared_ptr<std::vector<uint8_t>> obstacle_cell_mask;
+    std::vector<int> obstacle_cells;
+
+    // A non-zero entry for every node of the graph covered by an obstacle restored
+    // from a checkpoint (whose shape isn't stored), indexed by node. Empty if there
+    // are none.
+    std::vector<uint8_t> restored_obstacle_nodes;
+
+    // How `updateControlVolumes` steps the simulation
+    UpdateMethod update_method;
+
+    // The equations the simulation solves
+    SolverMode solver_mode;
+
+    // Steps the simulation in PROJECTION mode, null if it needs to be (re)built for
+    // the current mesh and obstacles
+    std::unique_ptr<ProjectionSolver> projection_solver;
+
+    // Steps the simulation in `updateControlVolumesLocal`, null if it needs to be
+    // (re)built for the current mesh and obstacles
+    std::unique_ptr<LocalTimeStepper> local_time_stepper;
+
+    // The outcome of the last pressure solve in PROJECTION mode
+    LinearSolveResult last_pressure_solve_result;
+
+    // Splits and merges cells to follow the solution, null if mesh refinement is
+    // disabled. Rebuilt whenever the mesh is rebuilt from the graph.
+    std::unique_ptr<MeshRefiner> mesh_refiner;
+
+    // The number of steps taken since the mesh was last adapted
+    int steps_since_adaptation;
+
+    // Writes frames of the fields, null if they aren't being written
+    std::shared_ptr<FieldSeriesWriter> field_output;
+
+    // The number of steps between frames written to `field_output`, the number taken
+    // since the last one, and the number taken since `field_output` was set
+    int steps_per_output_frame;
+    int steps_since_output_frame;
+    uint64_t num_output_steps;
+
+    // The snapshot each frame is taken into before it is handed to `field_output`,
+    // which hands back one it has finished with, so taking frames doesn't allocate
+    FieldSnapshot output_snapshot;
+
+    // The threads used to step the simulation
+    std::shared_ptr<ThreadPool> thread_pool;
+
+    // The instruction set used to step cells in the interior of same-resolution blocks
+    SimdLevel simd_level;
+
+    // The neighbour tables for the graph, null if they need to be (re)built
+    std::shared_ptr<const ControlVolumeMesh> mesh;
+
+    // Locates cells in the mesh, built along with it
+    std::shared_ptr<const CellLocator> cell_locator;
+
+    // The current fields, and a buffer the next step is computed into. These are
+    // swapped after every step. Either may be shared with snapshots, so they are only
+    // modified through `writableCurrentFields` and `writableNextFields`.
+    std::shared_ptr<ControlVolumeFields> current_fields;
+    std::shared_ptr<ControlVolumeFields> next_fields;
+
+    // Whether the graph may have been changed since `current_fields` was gathered
+    // from it (ie. it has been handed out, or stepped on directly)
+    bool fields_stale;
+
+    // Whether `current_fields` has changed since it was last written to the graph
+    bool graph_stale;
+
+    // The parameters used by `updateControlVolumesAdaptive`
+    AdaptiveTimeStepParameters adaptive_parameters;
+
+    // The total number of steps rejected by `updateControlVolumesAdaptive`
+    int num_rejected_steps;
+
+    // The total number of control volume updates
+    uint64_t num_cell_updates;
+
+    // Whether the velocity is diffused implicitly, and the parameters it is diffused
+    // with
+    bool implicit_diffusion;
+    ImplicitDiffusionParameters diffusion_parameters;
+
+    // Diffuses the velocity when `implicit_diffusion` is set, null if it needs to be
+    // (re)built for the current mesh and obstacles
+    std::unique_ptr<ImplicitDiffusionSolver> diffusion_solver;
+
+    // The outcome of the last diffusion solves
+    DiffusionSolveResult last_diffusion_solve_result;
+
+    // The conditions applied at each side of the mesh
+    BoundaryConditions boundary_conditions;
+
+    // Applies `boundary_conditions` to the cells at the edge of the mesh, null if it
+    // needs to be (re)built for the current mesh and conditions
+    std::unique_ptr<GhostCellLayer> ghost_layer;
+
+    // The size of the tiles and blocks of temporal blocking
+    TemporalBlockingParameters temporal_blocking_parameters;
+
+    // Steps the mesh in blocks of steps, null if it needs to be (re)built for the
+    // current mesh, obstacles, boundaries, and parameters
+    std::unique_ptr<TemporalBlockStepper> temporal_block_stepper;
+
+    // The total amount of time that has been simulated (s)
+    double simulation_time;
 };
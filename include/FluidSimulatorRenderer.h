@@ -1,6 +1,7 @@
 #pragma once
 
 // STD Includes
+#include <memory>
 
 // External Library Includes
 #include <gtkmm/drawingarea.h>
@@ -9,14 +10,33 @@
 
 // Project Includes
 #include "ControlVolume.h"
+#include "FieldRenderer.h"
 #include "FluidSimulator.h"
+#include "SimulationThread.h"
+
+// How a FluidSimulatorRenderer runs the simulation it's rendering
+enum class SimulationMode {
+    // Take a step between every frame, on the GTK main loop
+    MAIN_LOOP,
+    // Step continuously on a dedicated thread, and draw the newest snapshot every frame
+    DEDICATED_THREAD
+};
 
 // TODO: Rename to `ControlVolumeGraphRenderer`?
 class FluidSimulatorRenderer : public Gtk::DrawingArea {
 public:
     FluidSimulatorRenderer() = delete;
 
-    FluidSimulatorRenderer(FluidSimulator simulator);
+    /**
+     * Create a FluidSimulatorRenderer
+     *
+     * @param simulator the simulator to run and render
+     * @param simulation_mode how to run the simulator
+     * @param render_mode how to draw the control volumes
+     */
+    FluidSimulatorRenderer(FluidSimulator simulator,
+                           SimulationMode simulation_mode = SimulationMode::MAIN_LOOP,
+                           FieldRenderMode render_mode = FieldRenderMode::RASTERISED);
 
     // TODO: Doc comment
     void set_simulator_to_render(FluidSimulator simulator);
@@ -25,6 +45,14 @@ protected:
     // Override default signal handler
     bool on_draw(const Cairo::RefPtr<Cairo::Context>& cr) override;
 
+    // Zoom in and out about the pointer with the scroll wheel
+    bool on_scroll_event(GdkEventScroll* event) override;
+
+    // Pan by dragging with any button held
+    bool on_button_press_event(GdkEventButton* event) override;
+    bool on_motion_notify_event(GdkEventMotion* event) override;
+    bool on_button_release_event(GdkEventButton* event) override;
+
     // TODO: Better name
     // TODO: Doc comment
     bool update();
@@ -38,6 +66,26 @@ private:
      */
     void update_graph(units::time::second_t dt);
 
-    // The FluidSimulator we're rendering
-    FluidSimulator simulator;
+    /**
+     * Get the side length of the square the simulation is drawn in
+     *
+     * @return the side length of the square the simulation is drawn in (pixels)
+     */
+    int get_graph_size();
+
+    // Runs the FluidSimulator we're rendering, and hands us snapshots of it
+    std::unique_ptr<SimulationThread> simulation_thread;
+
+    // How we're running the simulator
+    SimulationMode simulation_mode;
+
+    // Draws the snapshots of the simulator
+    FieldRenderer field_renderer;
+
+    // Whether the view is being dragged
+    bool dragging = false;
+
+    // Where the pointer was when the view was last dragged (pixels)
+    double last_drag_x = 0;
+    double last_drag_y = 0;
 };
@@ -0,0 +1,167 @@
+#pragma once
+
+// STD Includes
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Project Includes
+#include "BoundaryConditions.h"
+#include "ControlVolumeFields.h"
+#include "ControlVolumeKernel.h"
+#include "ControlVolumeMesh.h"
+
+/**
+ * Applies `BoundaryConditions` to the cells at the edge of a mesh through a layer of
+ * ghost cells, so the cells themselves are stepped without checking for missing
+ * neighbours
+ *
+ * Every cell at the edge of the mesh gets a compact copy of the state and distance of
+ * it's neighbour in each direction. Missing neighbours are ghost cells, whose state
+ * comes from the condition at that side:
+ * - INFLOW: the fixed state of the side, written once when the layer is built
+ * - OUTFLOW: the state of the cell itself
+ * - WALL: the pressure of the cell, and the velocity reflected about the velocity of
+ *   the wall (so it is the wall's half way between the cell and the ghost)
+ * - PERIODIC: the state of the cell at the opposite side of the mesh, level with the
+ *   centre of the cell
+ *
+ * `fill` gathers the neighbours (real and ghost) once per step, branching on the type
+ * of each ghost; `updateCells` then steps every edge cell with the same branch-free
+ * loop the interior cells use.
+ *
+ * NOTE: Ghost cells are the mesh's edge distance away from their cell, except periodic
+ *       ones which are half the sum of the two cells' scales away
+ */
+class GhostCellLayer {
+  public:
+    GhostCellLayer() = delete;
+
+    /**
+     * Find the neighbours of every cell at the edge of the given mesh, and the source
+     * of every ghost cell
+     *
+     * @param mesh the mesh to apply the conditions to
+     * @param conditions the conditions to apply
+     *
+     * @throws std::invalid_argument if the conditions are invalid (see
+     * `validateBoundaryConditions`)
+     */
+    GhostCellLayer(std::shared_ptr<const ControlVolumeMesh> mesh,
+                   const BoundaryConditions& conditions);
+
+    /**
+     * Gather the state of the neighbours of every edge cell from the given fields
+     *
+     * @param current the fields that will be stepped
+     */
+    void fill(const ControlVolumeFields& current);
+
+    /**
+     * Update the edge cells in the range [begin, end), from the neighbours gathered by
+     * the last call to `fill`
+     *
+     * Gives bit-for-bit the same results as `updateScalarCells` with the equivalent
+     * edge states (see `toEdgeStates`) for INFLOW sides
+     *
+     * @param begin the first edge cell to update
+     * @param end one past the last edge cell to update
+     * @param current the fields last passed to `fill`
+     * @param dt the amount of time to step forward by (s)
+     * @param fluid the properties of the fluid
+     * @param next the fields to write the updated cells into
+     */
+    void updateCells(size_t begin,
+                     size_t end,
+                     const ControlVolumeFields& current,
+                     double dt,
+                     const FluidCoefficients& fluid,
+                     ControlVolumeFields& next) const;
+
+    /**
+     * Get the number of cells at the edge of the mesh
+     *
+     * @return the number of cells at the edge of the mesh
+     */
+    size_t numCells() const { return cells.size(); }
+
+    /**
+     * Get the number of ghost cells
+     *
+     * @return the number of ghost cells
+     */
+    size_t numGhosts() const { return num_ghosts; }
+
+    /**
+     * Get the index of every cell at the edge of the mesh
+     *
+     * @return the index of every cell at the edge of the mesh
+     */
+    const std::vector<int>& getCells() const { return cells; }
+
+    /**
+     * Get the state of the neighbour of every edge cell in the given direction, as of
+     * the last call to `fill`
+     *
+     * @param direction the direction to get the neighbours in
+     *
+     * @return the state of the neighbour of every edge cell, in the order of
+     * `getCells()`
+     */
+    const ControlVolumeFields& getNeighbourStates(Direction direction) const {
+        return neighbour_states[direction];
+    }
+
+    /**
+     * Get the mesh this applies the conditions to
+     *
+     * @return the mesh this applies the conditions to
+     */
+    const std::shared_ptr<const ControlVolumeMesh>& getMesh() const { return mesh; }
+
+    /**
+     * Get the conditions this applies
+     *
+     * @return the conditions this applies
+     */
+    const BoundaryConditions& getBoundaryConditions() const { return conditions; }
+
+  private:
+    // A neighbour of an edge cell that is filled from a cell of the mesh
+    struct NeighbourSource {
+        // The index of the edge cell, in `cells`
+        int slot;
+
+        // The cell to fill it from
+        int cell;
+    };
+
+    // The mesh this applies the conditions to
+    std::shared_ptr<const ControlVolumeMesh> mesh;
+
+    // The conditions this applies
+    BoundaryConditions conditions;
+
+    // Every cell at the edge of the mesh
+    std::vector<int> cells;
+
+    // The number of ghost cells
+    size_t num_ghosts;
+
+    // The state of, and distance to, the neighbour of every edge cell in each
+    // direction
+    std::array<ControlVolumeFields, NUM_DIRECTIONS> neighbour_states;
+    std::array<std::vector<double>, NUM_DIRECTIONS> neighbour_distances;
+
+    // The neighbours in each direction copied as is from a cell (real neighbours, and
+    // OUTFLOW and PERIODIC ghosts)
+    std::array<std::vector<NeighbourSource>, NUM_DIRECTIONS> copied_neighbours;
+
+    // The WALL ghosts in each direction, reflected from their own cell
+    std::array<std::vector<NeighbourSource>, NUM_DIRECTIONS> wall_ghosts;
+
+    // The real top neighbours whose velocity is overridden, so only have their
+    // pressure copied
+    std::vector<NeighbourSource> overridden_top_neighbours;
+};
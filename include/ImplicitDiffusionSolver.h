@@ -0,0 +1,185 @@
+#pragma once
+
+// STD Includes
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Project Includes
+#include "ControlVolumeFields.h"
+#include "ControlVolumeMesh.h"
+#include "MultigridSolver.h"
+#include "ScalarStencilKernel.h"
+#include "ThreadPool.h"
+
+// Parameters controlling `ImplicitDiffusionSolver`
+struct ImplicitDiffusionParameters {
+    // The weight of the new velocity in the viscous term, from 0.5 to 1. 0.5 is
+    // Crank-Nicolson (second order in time), 1 is backward Euler (first order, but
+    // damps the shortest wavelengths rather than letting them oscillate when the time
+    // step is far beyond the explicit limit).
+    double implicitness = 0.5;
+
+    // The relative residual each solve stops at, and the most iterations it takes
+    double tolerance   = 1e-10;
+    int max_iterations = 100;
+};
+
+// The outcome of the solves of one diffusion step, one for each velocity component
+struct DiffusionSolveResult {
+    LinearSolveResult velocity_x;
+    LinearSolveResult velocity_y;
+};
+
+/**
+ * Diffuses the velocity on a mesh implicitly, so the time step isn't limited by
+ * viscosity (h^2 / (4 * viscosity))
+ *
+ * Each component of the velocity is stepped with
+ *
+ *   A (u' - u) / dt = viscosity * L (theta * u' + (1 - theta) * u)
+ *
+ * where A is the area of each cell and L is the Laplacian integrated over each cell
+ * with finite volumes: each face between two cells contributes
+ * (u_j - u_i) * face length / distance. Faces are gathered from both sides, as a large
+ * cell only stores one of it's smaller neighbours, so the system is symmetric positive
+ * definite on multi-resolution meshes and is solved with `MultigridSolver`. The
+ * velocity is held at the edge states outside the mesh, and is zero inside obstacles.
+ */
+class ImplicitDiffusionSolver {
+  public:
+    ImplicitDiffusionSolver() = delete;
+
+    /**
+     * Build the (unscaled) Laplacian for the given mesh and obstacles
+     *
+     * @param mesh the mesh to diffuse on
+     * @param obstacle_cell_mask a non-zero entry for every cell covered by an obstacle
+     * @param parameters the parameters to diffuse with
+     *
+     * @throws std::invalid_argument if the implicitness is outside [0.5, 1]
+     */
+    ImplicitDiffusionSolver(std::shared_ptr<const ControlVolumeMesh> mesh,
+                            const std::vector<uint8_t>& obstacle_cell_mask,
+                            ImplicitDiffusionParameters parameters);
+
+    /**
+     * Diffuse the velocity of the given fields
+     *
+     * The multigrid levels are rebuilt whenever `dt * viscosity` changes, so this is
+     * cheapest with a fixed time step.
+     *
+     * NOTE: `edges.override_top_velocity` is ignored, the top neighbours of cells are
+     *       always read from the fields
+     *
+     * @param fields the fields to diffuse the velocity of, in place. Cells covered by
+     * obstacles are set to zero velocity, and the pressure is left unchanged.
+     * @param edges the states used in place of missing neighbours, only the velocities
+     * are used
+     * @param dt the amount of time to diffuse for (s)
+     * @param viscosity the viscosity of the fluid (m^2/s)
+     * @param thread_pool the threads to solve on
+     *
+     * @return the outcome of the solve for each component of the velocity
+     */
+    DiffusionSolveResult diffuse(ControlVolumeFields& fields,
+                                 const StencilEdgeStates<double>& edges,
+                                 double dt,
+                                 double viscosity,
+                                 ThreadPool& thread_pool);
+
+    /**
+     * Get the mesh this diffuses on
+     *
+     * @return the mesh this diffuses on
+     */
+    const std::shared_ptr<const ControlVolumeMesh>& getMesh() const { return mesh; }
+
+    /**
+     * Get the parameters this diffuses with
+     *
+     * @return the parameters this diffuses with
+     */
+    const ImplicitDiffusionParameters& getParameters() const { return parameters; }
+
+    /**
+     * Get the outcome of the last call to `diffuse`
+     *
+     * @return the outcome of the last diffusion step, with zero iterations if there
+     * hasn't been one
+     */
+    const DiffusionSolveResult& getLastResult() const { return last_result; }
+
+  private:
+    // A face between a cell and the edge of the mesh
+    struct EdgeFace {
+        // The unknown of the cell
+        int unknown;
+
+        // The side of the mesh the face is on
+        Direction direction;
+
+        // The face length divided by the distance to the edge
+        double weight;
+    };
+
+    /**
+     * Solve for one component of the velocity
+     *
+     * @param velocity the component to diffuse, in place
+     * @param edge_velocity the value of the component outside each side of the mesh
+     * @param thread_pool the threads to solve on
+     *
+     * @return the outcome of the solve
+     */
+    LinearSolveResult
+        diffuseComponent(std::vector<double>& velocity,
+                         const std::array<double, NUM_DIRECTIONS>& edge_velocity,
+                         ThreadPool& thread_pool);
+
+    // The mesh this diffuses on
+    std::shared_ptr<const ControlVolumeMesh> mesh;
+
+    // The parameters this diffuses with
+    ImplicitDiffusionParameters parameters;
+
+    // The cells not covered by an obstacle (the unknowns, in order)
+    std::vector<int> fluid_cells;
+
+    // The area of the cell of every unknown
+    std::vector<double> areas;
+
+    // Minus the Laplacian integrated over each cell, leaving out the (fixed) velocity
+    // outside the mesh and in obstacles. Symmetric positive definite.
+    SparseMatrix stiffness;
+
+    // The index in `stiffness.values` of the diagonal of every row
+    std::vector<int> diagonal_entries;
+
+    // Every face between a cell and the edge of the mesh
+    std::vector<EdgeFace> edge_faces;
+
+    // The centre of the cell of every unknown, and the bin size of the first coarse
+    // multigrid level
+    std::vector<double> centre_x;
+    std::vector<double> centre_y;
+    double bin_size;
+
+    // Solves (A + theta * dt * viscosity * stiffness) u' = b, built for
+    // `solver_diffusion_number`. Null if it hasn't been built yet.
+    std::unique_ptr<MultigridSolver> solver;
+    double solver_diffusion_number;
+
+    // dt * viscosity for the current solve
+    double diffusion_number;
+
+    // The outcome of the last call to `diffuse`
+    DiffusionSolveResult last_result;
+
+    // Work vectors for the solves
+    std::vector<double> rhs;
+    std::vector<double> solution;
+    std::vector<double> product;
+};
@@ -0,0 +1,143 @@
+#pragma once
+
+// STD Includes
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Project Includes
+#include "ControlVolumeFields.h"
+#include "ControlVolumeKernel.h"
+#include "ControlVolumeMesh.h"
+#include "ScalarStencilKernel.h"
+#include "ThreadPool.h"
+
+/**
+ * Steps a multi-resolution mesh with local time stepping (subcycling), so each
+ * refinement level takes steps sized for it's own cells rather than every cell taking
+ * the step of the smallest one
+ *
+ * Each cell is given a level from it's size: the largest cells are level 0, and each
+ * halving of the side length is one level finer. One (coarse) step of `dt` is taken as
+ * 2^K substeps, where K is the finest level, and level k takes 2^k steps of
+ * `dt / 2^k` within it. The steps are interleaved coarse first: at each substep every
+ * level whose step starts then is stepped together, from the state of every cell at
+ * that time.
+ *
+ * When a cell is stepped, a coarser neighbour part way through it's own (longer) step
+ * has already been stepped to the end of it, so the neighbour is read as the linear
+ * interpolation in time between it's states at the start and end of it's step. Finer
+ * and same-level neighbours are always at the same time as the cell. At the end of the
+ * coarse step every level is at the same time again.
+ *
+ * Each cell is stepped with the general (`ControlVolume::update`) kernel, so on a mesh
+ * with only one level this is bit-identical to a single global step of `dt`. Every cell
+ * of a substep only reads the state at the start of the substep and writes it's own
+ * entry, so results are bit-identical for any number of threads.
+ */
+class LocalTimeStepper {
+  public:
+    LocalTimeStepper() = delete;
+
+    /**
+     * Find the level of every cell of the given mesh, and the cells read across each
+     * change in level
+     *
+     * @param mesh the mesh to step on
+     * @param obstacle_cell_mask a non-zero entry for every cell covered by an obstacle
+     */
+    LocalTimeStepper(std::shared_ptr<const ControlVolumeMesh> mesh,
+                     const std::vector<uint8_t>& obstacle_cell_mask);
+
+    /**
+     * Step the given fields forward by one coarse step
+     *
+     * @param current the current fields
+     * @param edges the states used in place of missing neighbours
+     * @param dt the amount of time to step forward by (s). Level k takes steps of
+     * `dt / 2^k`, so each level's steps must be stable for it's cells.
+     * @param fluid the properties of the fluid
+     * @param thread_pool the threads to step on
+     * @param next the fields to write the result into, the same size as `current`.
+     * Cells covered by obstacles are set to zero.
+     */
+    void step(const ControlVolumeFields& current,
+              const StencilEdgeStates<double>& edges,
+              double dt,
+              const FluidCoefficients& fluid,
+              ThreadPool& thread_pool,
+              ControlVolumeFields& next);
+
+    /**
+     * Get the mesh this steps on
+     *
+     * @return the mesh this steps on
+     */
+    const std::shared_ptr<const ControlVolumeMesh>& getMesh() const { return mesh; }
+
+    /**
+     * Get the level of every cell, 0 for the largest cells
+     *
+     * @return the level of every cell
+     */
+    const std::vector<int>& getCellLevels() const { return cell_levels; }
+
+    /**
+     * Get the number of levels
+     *
+     * @return the number of levels, one more than the finest level
+     */
+    int getNumLevels() const { return static_cast<int>(num_finer_cells.size()); }
+
+    /**
+     * Get the number of cell updates each coarse step takes
+     *
+     * @return the number of cell updates each coarse step takes
+     */
+    uint64_t getNumCellUpdatesPerStep() const { return num_cell_updates_per_step; }
+
+  private:
+    /**
+     * Get the coarsest level that starts a step at the given substep. Every finer level
+     * also starts a step then.
+     *
+     * @param substep the substep, from 0 to 2^K - 1
+     *
+     * @return the coarsest level that starts a step at the given substep
+     */
+    int coarsestActiveLevel(uint64_t substep) const;
+
+    // The mesh this steps on
+    std::shared_ptr<const ControlVolumeMesh> mesh;
+
+    // The level of every cell
+    std::vector<int> cell_levels;
+
+    // Every cell, finest level first
+    std::vector<int> cells_by_level;
+
+    // The number of cells at each level or finer, so the cells stepped when level k
+    // starts a step are the first `num_finer_cells[k]` of `cells_by_level`
+    std::vector<size_t> num_finer_cells;
+
+    // For each level k, every cell coarser than k that a cell at level k or finer
+    // reads. These are the cells that need interpolating when level k is the coarsest
+    // level stepped.
+    std::vector<std::vector<int>> interface_cells;
+
+    // A non-zero entry for every cell covered by an obstacle
+    std::vector<uint8_t> obstacle_cell_mask;
+
+    // The number of cell updates each coarse step takes
+    uint64_t num_cell_updates_per_step;
+
+    // The state of every cell at the start of it's current step, read when
+    // interpolating it
+    ControlVolumeFields start_fields;
+
+    // The result of stepping the cells of a substep, before it is committed
+    ControlVolumeFields stepped_fields;
+
+    // The uninterpolated values of the interface cells, restored after each substep
+    ControlVolumeFields saved_interface_fields;
+};
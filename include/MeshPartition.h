@@ -0,0 +1,32 @@
+#pragma once
+
+// STD Includes
+#include <vector>
+
+// Project Includes
+#include "ControlVolumeMesh.h"
+
+/**
+ * Split the cells of a mesh into parts of (nearly) equal total weight, for
+ * distributing them between processes
+ *
+ * Cells are ordered along a Morton (Z-order) curve through their centres, at the
+ * resolution of the smallest cell, and the curve is cut wherever the running weight
+ * passes a multiple of `total weight / num_parts`. Each part is a compact region of
+ * the mesh (so has a short boundary to exchange), and is sized by the cost of it's
+ * cells rather than their area, so refined regions are split between as many parts as
+ * their cells call for.
+ *
+ * @param mesh the mesh to split
+ * @param num_parts the number of parts to split it into
+ * @param cell_weights the cost of every cell, eg. 1 for every cell when every cell
+ * takes one update per step
+ *
+ * @throws std::invalid_argument if `num_parts` is less than 1, or there isn't a
+ * non-negative weight for every cell
+ *
+ * @return the part (from 0 to `num_parts - 1`) of every cell
+ */
+std::vector<int> partitionMesh(const ControlVolumeMesh& mesh,
+                               int num_parts,
+                               const std::vector<double>& cell_weights);
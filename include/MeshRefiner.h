@@ -0,0 +1,183 @@
+#pragma once
+
+// STD Includes
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Project Includes
+#include "CellLocator.h"
+#include "ControlVolumeFields.h"
+#include "ControlVolumeMesh.h"
+#include "ThreadPool.h"
+
+// The quantity `MeshRefiner` decides which cells to split or merge by
+enum class RefinementIndicator {
+    // The largest pressure difference (Pa) between a cell and one of it's neighbours
+    PRESSURE_JUMP,
+    // The largest velocity difference (m/s) between a cell and one of it's neighbours
+    VELOCITY_JUMP,
+    // The change in pressure (Pa) of a cell over the last step
+    PRESSURE_CHANGE
+};
+
+// Parameters controlling `MeshRefiner`
+struct RefinementParameters {
+    // The quantity cells are split or merged by
+    RefinementIndicator indicator = RefinementIndicator::PRESSURE_JUMP;
+
+    // Cells with an indicator above this are split into four
+    double refine_threshold = 1;
+
+    // Groups of four cells split from the same cell are merged back together if all
+    // of their indicators are below this
+    double coarsen_threshold = 0.1;
+
+    // The most times a node of the graph can be split, at most MAX_LEVEL
+    int max_level = 3;
+
+    // Cells are not split if it would take the mesh over this many cells. The cells
+    // with the largest indicators are split first.
+    size_t max_cells = 1 << 20;
+
+    // How many steps `FluidSimulator` takes between adapting the mesh
+    int steps_between_adaptations = 10;
+};
+
+/**
+ * Adapts a mesh to the solution, splitting cells where the flow changes quickly and
+ * merging them back where it doesn't
+ *
+ * Every cell lies within one node of the graph the base mesh was built from, and is
+ * found by splitting that node into quarters some number of times (it's level). The
+ * values of the fields are moved between levels conservatively: split cells copy the
+ * value of their parent to all four children, and merged cells take the mean of their
+ * four (equally sized) children, so the integral of every field over the mesh is
+ * unchanged.
+ */
+class MeshRefiner {
+  public:
+    // The most times a node of the graph can be split
+    static constexpr int MAX_LEVEL = 12;
+
+    MeshRefiner() = delete;
+
+    /**
+     * Create a MeshRefiner, with every cell of the base mesh unsplit
+     *
+     * @param base_mesh the mesh built from the graph
+     * @param parameters the parameters controlling when cells are split and merged
+     *
+     * @throws std::invalid_argument if the max level is not in [0, MAX_LEVEL]
+     */
+    MeshRefiner(std::shared_ptr<const ControlVolumeMesh> base_mesh,
+                RefinementParameters parameters);
+
+    /**
+     * Split and merge cells based on the given fields
+     *
+     * @param previous the fields one step before `fields`, only used for the
+     * PRESSURE_CHANGE indicator
+     * @param fields the current fields on the current mesh, replaced with the same
+     * fields on the adapted mesh
+     * @param thread_pool the threads to adapt on
+     *
+     * @return whether the mesh changed
+     */
+    bool adapt(const ControlVolumeFields& previous,
+               ControlVolumeFields& fields,
+               ThreadPool& thread_pool);
+
+    /**
+     * Get the current (adapted) mesh
+     *
+     * @return the current mesh
+     */
+    const std::shared_ptr<const ControlVolumeMesh>& getMesh() const { return mesh; }
+
+    /**
+     * Get the level of every cell of the current mesh (the number of times the node
+     * it lies within has been split)
+     *
+     * @return the level of every cell of the current mesh
+     */
+    std::vector<int> getCellLevels() const;
+
+    /**
+     * Get the parameters controlling when cells are split and merged
+     *
+     * @return the parameters controlling when cells are split and merged
+     */
+    const RefinementParameters& getParameters() const { return parameters; }
+
+  private:
+    // A cell, as the square (i, j) of the given base cell split into 2^level by
+    // 2^level squares
+    struct Cell {
+        int base_cell;
+        int level;
+        int i;
+        int j;
+    };
+
+    /**
+     * Get a key uniquely identifying the given cell
+     *
+     * @param base_cell the base cell the cell lies within
+     * @param level the level of the cell
+     * @param i the column of the cell within the base cell
+     * @param j the row of the cell within the base cell
+     *
+     * @return a key uniquely identifying the given cell
+     */
+    static uint64_t cellKey(int base_cell, int level, int i, int j);
+
+    /**
+     * Compute the refinement indicator of every cell of the current mesh
+     *
+     * @param previous the fields one step before `fields`
+     * @param fields the current fields
+     * @param thread_pool the threads to compute on
+     *
+     * @return the refinement indicator of every cell
+     */
+    std::vector<double> computeIndicators(const ControlVolumeFields& previous,
+                                          const ControlVolumeFields& fields,
+                                          ThreadPool& thread_pool) const;
+
+    /**
+     * Find the cell of the given base cell that contains the given point
+     *
+     * @param base_cell the base cell to search
+     * @param x the x coordinate of the point (m)
+     * @param y the y coordinate of the point (m)
+     *
+     * @return the index of the cell containing the point, or NO_NEIGHBOUR if there is
+     * none
+     */
+    int findCell(int base_cell, double x, double y) const;
+
+    /**
+     * Rebuild `cell_indices` and `mesh` from `cells`
+     *
+     * @param thread_pool the threads to build on
+     */
+    void buildMesh(ThreadPool& thread_pool);
+
+    // The mesh built from the graph, and a locator for it's cells
+    std::shared_ptr<const ControlVolumeMesh> base_mesh;
+    CellLocator base_locator;
+
+    // The parameters controlling when cells are split and merged
+    RefinementParameters parameters;
+
+    // Every cell of the current mesh, in cell index order
+    std::vector<Cell> cells;
+
+    // The index of every cell, by `cellKey`
+    std::unordered_map<uint64_t, int> cell_indices;
+
+    // The current mesh
+    std::shared_ptr<const ControlVolumeMesh> mesh;
+};
@@ -0,0 +1,172 @@
+#pragma once
+
+// STD Includes
+#include <cstddef>
+#include <vector>
+
+// Project Includes
+#include "ThreadPool.h"
+
+/**
+ * A sparse matrix, stored in compressed sparse row format
+ */
+struct SparseMatrix {
+    // The entries of row `r` are at [row_offsets[r], row_offsets[r + 1]) in `columns`
+    // and `values`
+    std::vector<int> row_offsets = {0};
+    std::vector<int> columns;
+    std::vector<double> values;
+
+    /**
+     * Get the number of rows in this matrix
+     *
+     * @return the number of rows in this matrix
+     */
+    size_t numRows() const { return row_offsets.size() - 1; }
+
+    /**
+     * Compute y = Ax, in parallel over rows
+     *
+     * @param x the vector to multiply, with one entry per row
+     * @param y the vector to write the result into, resized to fit
+     * @param thread_pool the threads to multiply on
+     */
+    void multiply(const std::vector<double>& x,
+                  std::vector<double>& y,
+                  ThreadPool& thread_pool) const;
+};
+
+// The outcome of solving a linear system
+struct LinearSolveResult {
+    // The number of iterations taken
+    int iterations = 0;
+
+    // The norm of the final residual, relative to the norm of the right hand side
+    double relative_residual = 0;
+
+    // Whether the relative residual got below the requested tolerance
+    bool converged = true;
+};
+
+/**
+ * Solves symmetric positive (semi-)definite linear systems from the mesh with
+ * conjugate gradients, preconditioned by a multigrid V-cycle
+ *
+ * The multigrid levels are built geometrically: each coarser level merges the unknowns
+ * whose positions fall in the same square bin, with bins twice the size of the last
+ * level's. On a multi-resolution mesh this follows the same quadtree the `GraphNode`
+ * hierarchy is built from. The coarse level operators are the Galerkin products
+ * (P^T A P) of piecewise constant prolongation.
+ *
+ * All reductions are done in a fixed order, so results don't depend on the number of
+ * threads.
+ */
+class MultigridSolver {
+  public:
+    MultigridSolver() = delete;
+
+    /**
+     * Build the multigrid levels for the given matrix
+     *
+     * @param matrix the matrix to solve with, must be symmetric with positive diagonal
+     * @param position_x the x coordinate of the position of each unknown (m)
+     * @param position_y the y coordinate of the position of each unknown (m)
+     * @param bin_size the size of the bins the first coarse level is built from (m),
+     * usually twice the size of the smallest cell
+     * @param singular whether the matrix is singular with the constant vector as
+     * it's null space (eg. a Laplacian with only Neumann boundaries). The right hand
+     * side is then made consistent by removing it's mean, and the solution is the one
+     * with zero mean.
+     */
+    MultigridSolver(SparseMatrix matrix,
+                    const std::vector<double>& position_x,
+                    const std::vector<double>& position_y,
+                    double bin_size,
+                    bool singular);
+
+    /**
+     * Solve Ax = b
+     *
+     * @param b the right hand side
+     * @param x the initial guess, overwritten with the solution
+     * @param tolerance the relative residual to stop at
+     * @param max_iterations the most iterations to take
+     * @param thread_pool the threads to solve on
+     *
+     * @return the outcome of the solve
+     */
+    LinearSolveResult solve(const std::vector<double>& b,
+                            std::vector<double>& x,
+                            double tolerance,
+                            int max_iterations,
+                            ThreadPool& thread_pool);
+
+    /**
+     * Get the number of multigrid levels, including the finest
+     *
+     * @return the number of multigrid levels
+     */
+    size_t numLevels() const { return levels.size(); }
+
+    /**
+     * Get the number of unknowns on the given level
+     *
+     * @param level the level, 0 being the finest
+     *
+     * @return the number of unknowns on the given level
+     */
+    size_t numUnknowns(size_t level) const { return levels[level].matrix.numRows(); }
+
+  private:
+    // A single multigrid level
+    struct Level {
+        SparseMatrix matrix;
+
+        // The reciprocal of the diagonal of `matrix`, used for Jacobi smoothing
+        std::vector<double> inverse_diagonal;
+
+        // The unknown on the next coarser level each unknown is merged into (empty on
+        // the coarsest level)
+        std::vector<int> coarse_unknown;
+
+        // Work vectors, kept to avoid reallocating them every V-cycle
+        std::vector<double> solution;
+        std::vector<double> rhs;
+        std::vector<double> product;
+    };
+
+    /**
+     * Apply one V-cycle, starting from a zero initial guess, to `levels[level].rhs`
+     * writing the result into `levels[level].solution`
+     *
+     * @param level the level to start on
+     * @param thread_pool the threads to run on
+     */
+    void vCycle(size_t level, ThreadPool& thread_pool);
+
+    /**
+     * Run damped Jacobi sweeps on the given level
+     *
+     * @param level the level to smooth
+     * @param num_sweeps the number of sweeps to run
+     * @param thread_pool the threads to run on
+     */
+    void smooth(Level& level, int num_sweeps, ThreadPool& thread_pool);
+
+    /**
+     * Remove the mean from the given vector if the matrix is singular
+     *
+     * @param vector the vector to remove the mean from
+     * @param thread_pool the threads to run on
+     */
+    void removeNullSpace(std::vector<double>& vector, ThreadPool& thread_pool);
+
+    // The multigrid levels, finest first
+    std::vector<Level> levels;
+
+    // Whether the matrix has the constant vector as it's null space
+    const bool singular;
+
+    // Work vectors for the conjugate gradient iteration
+    std::vector<double> residual, preconditioned, direction, product;
+};
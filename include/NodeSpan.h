@@ -0,0 +1,67 @@
+#pragma once
+
+// STD Includes
+#include <cstddef>
+#include <vector>
+
+// Library Includes
+#include <multi_res_graph/GraphNode.h>
+
+/**
+ * A non-owning view of a contiguous list of graph nodes
+ *
+ * Iterating over this only reads plain pointers, so unlike a vector of
+ * `std::shared_ptr`s it never touches the (atomic) reference counts of the nodes. The
+ * view doesn't keep the nodes or the list alive: it is only valid as long as whatever
+ * it was taken from is (see `ControlVolumeMesh::getNodeSpan`).
+ *
+ * @tparam T the type of value contained in the nodes
+ */
+template <typename T>
+class NodeSpan {
+  public:
+    using iterator = RealNode<T>* const*;
+
+    NodeSpan() : nodes(nullptr), num_nodes(0) {}
+
+    /**
+     * Create a view of the given nodes
+     *
+     * @param nodes the nodes to view, which must outlive the view
+     */
+    explicit NodeSpan(const std::vector<RealNode<T>*>& nodes)
+      : nodes(nodes.data()), num_nodes(nodes.size()) {}
+
+    /**
+     * Get the number of nodes
+     *
+     * @return the number of nodes
+     */
+    size_t size() const { return num_nodes; }
+
+    /**
+     * Check if there are no nodes
+     *
+     * @return true if there are no nodes, false otherwise
+     */
+    bool empty() const { return num_nodes == 0; }
+
+    /**
+     * Get the node at the given index
+     *
+     * @param i the index of the node, must be less than `size()`
+     *
+     * @return the node at the given index
+     */
+    RealNode<T>& operator[](size_t i) const { return *nodes[i]; }
+
+    iterator begin() const { return nodes; }
+    iterator end() const { return nodes + num_nodes; }
+
+  private:
+    // The first node viewed
+    RealNode<T>* const* nodes;
+
+    // The number of nodes viewed
+    size_t num_nodes;
+};
@@ -0,0 +1,198 @@
+#pragma once
+
+// STD Includes
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// The time spent in one phase (see `SIMPLE_CFD_PROFILE_SCOPE`), combined over every
+// time it ran
+struct ProfilePhaseStats {
+    // The name of the phase
+    std::string name;
+
+    // The thread the phase ran on (numbered in the order threads first recorded
+    // anything), or -1 if combined over every thread
+    int thread = -1;
+
+    // The number of times the phase ran, and the total, shortest, and longest time
+    // it took (s)
+    uint64_t num_calls = 0;
+    double total_time  = 0;
+    double min_time    = 0;
+    double max_time    = 0;
+};
+
+// The values added to one counter (see `SIMPLE_CFD_PROFILE_COUNT`)
+struct ProfileCounterStats {
+    // The name of the counter
+    std::string name;
+
+    // The thread the values were added on, or -1 if combined over every thread
+    int thread = -1;
+
+    // The number of values added, and their total
+    uint64_t num_samples = 0;
+    double total         = 0;
+};
+
+/**
+ * Records how long each phase of the simulation (and rendering) takes, on every
+ * thread
+ *
+ * Phases are timed by `SIMPLE_CFD_PROFILE_SCOPE`, and counters are added to by
+ * `SIMPLE_CFD_PROFILE_COUNT`. Both compile to nothing unless built with
+ * `SIMPLE_CFD_ENABLE_PROFILING` (the `SIMPLE_CFD_ENABLE_PROFILING` CMake option), so
+ * they cost nothing in normal builds.
+ *
+ * Every thread records into it's own buffer, so threads don't contend with each
+ * other. The results can be read per thread or combined, or written as a Chrome trace
+ * (which can be opened in Perfetto or chrome://tracing) with one track per thread.
+ * Only the first `MAX_EVENTS_PER_THREAD` phases and counter values on each thread are
+ * kept for the trace, but every one is included in the stats.
+ *
+ * Names must be string literals (or otherwise outlive the profiler), as only
+ * pointers to them are kept while recording.
+ */
+class Profiler {
+  public:
+    Profiler() = delete;
+
+    // The most phases and counter values kept for the trace per thread
+    static constexpr size_t MAX_EVENTS_PER_THREAD = 1 << 18;
+
+    /**
+     * Check if the profiling macros were compiled in
+     *
+     * @return true if built with `SIMPLE_CFD_ENABLE_PROFILING`, false otherwise
+     */
+    static constexpr bool isCompiledIn() {
+#ifdef SIMPLE_CFD_ENABLE_PROFILING
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * Start or stop recording (recording starts enabled)
+     *
+     * @param enabled whether to record
+     */
+    static void setEnabled(bool enabled);
+
+    /**
+     * Check if recording is enabled
+     *
+     * @return true if recording is enabled, false otherwise
+     */
+    static bool isEnabled();
+
+    /**
+     * Forget everything recorded so far, on every thread
+     */
+    static void reset();
+
+    /**
+     * Get the time spent in every phase recorded so far
+     *
+     * @param per_thread whether to give separate stats for each thread each phase ran
+     * on, rather than combining them
+     *
+     * @return the time spent in every phase, sorted by name (then thread)
+     */
+    static std::vector<ProfilePhaseStats> getPhaseStats(bool per_thread = false);
+
+    /**
+     * Get the values added to every counter so far
+     *
+     * @param per_thread whether to give separate stats for each thread values were
+     * added on, rather than combining them
+     *
+     * @return the values added to every counter, sorted by name (then thread)
+     */
+    static std::vector<ProfileCounterStats> getCounterStats(bool per_thread = false);
+
+    /**
+     * Write everything recorded so far as a Chrome trace (JSON)
+     *
+     * @param output the stream to write to
+     */
+    static void writeChromeTrace(std::ostream& output);
+
+    /**
+     * Record that the phase with the given name ran on this thread
+     *
+     * @param name the name of the phase
+     * @param start when the phase started
+     * @param end when the phase ended
+     */
+    static void recordPhase(const char* name,
+                            std::chrono::steady_clock::time_point start,
+                            std::chrono::steady_clock::time_point end);
+
+    /**
+     * Add the given value to the counter with the given name, on this thread
+     *
+     * @param name the name of the counter
+     * @param value the value to add
+     */
+    static void addCount(const char* name, double value);
+};
+
+/**
+ * Times the scope it is declared in as a phase (see `SIMPLE_CFD_PROFILE_SCOPE`)
+ */
+class ProfileScope {
+  public:
+    ProfileScope() = delete;
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+    /**
+     * Start timing a phase, if recording is enabled
+     *
+     * @param name the name of the phase
+     */
+    explicit ProfileScope(const char* name)
+      : name(Profiler::isEnabled() ? name : nullptr) {
+        if (this->name) {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    // Records the phase
+    ~ProfileScope() {
+        if (name) {
+            Profiler::recordPhase(name, start, std::chrono::steady_clock::now());
+        }
+    }
+
+  private:
+    // The name of the phase, null if recording was disabled when it started
+    const char* name;
+
+    // When the phase started
+    std::chrono::steady_clock::time_point start;
+};
+
+#define SIMPLE_CFD_PROFILE_CONCAT_INNER(a, b) a##b
+#define SIMPLE_CFD_PROFILE_CONCAT(a, b) SIMPLE_CFD_PROFILE_CONCAT_INNER(a, b)
+
+#ifdef SIMPLE_CFD_ENABLE_PROFILING
+// Time the rest of the enclosing scope as the phase with the given name
+#define SIMPLE_CFD_PROFILE_SCOPE(name)                                                 \
+    ProfileScope SIMPLE_CFD_PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+// Add the given value to the counter with the given name
+#define SIMPLE_CFD_PROFILE_COUNT(name, value)                                          \
+    do {                                                                               \
+        if (Profiler::isEnabled()) {                                                   \
+            Profiler::addCount(name, value);                                           \
+        }                                                                              \
+    } while (false)
+#else
+#define SIMPLE_CFD_PROFILE_SCOPE(name) static_cast<void>(0)
+#define SIMPLE_CFD_PROFILE_COUNT(name, value) static_cast<void>(0)
+#endif
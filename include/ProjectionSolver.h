@@ -0,0 +1,159 @@
+#pragma once
+
+// STD Includes
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Project Includes
+#include "ControlVolumeFields.h"
+#include "ControlVolumeMesh.h"
+#include "ImplicitDiffusionSolver.h"
+#include "MultigridSolver.h"
+#include "ScalarStencilKernel.h"
+#include "ThreadPool.h"
+
+// The equations `FluidSimulator` solves
+enum class SolverMode {
+    // Slightly compressible flow, with pressure stepped explicitly from the divergence
+    // of the velocity (the default). The time step is limited by the speed of sound.
+    SLIGHTLY_COMPRESSIBLE,
+    // Incompressible flow, with a pressure Poisson equation solved every step to
+    // project out the divergence of the velocity (see `ProjectionSolver`). The time
+    // step is only limited by advection and viscosity. Always steps on the flat arrays.
+    PROJECTION
+};
+
+/**
+ * Steps incompressible flow on a mesh with a (Chorin) projection method
+ *
+ * Each step first advects (first order upwind) and diffuses the velocity explicitly,
+ * then solves a pressure Poisson equation so that subtracting the pressure gradient
+ * removes the divergence of the velocity. Unlike the slightly compressible update
+ * there are no pressure waves, so the time step is only limited by advection and
+ * diffusion rather than the speed of sound.
+ *
+ * The Poisson equation is discretised with finite volumes (so it is symmetric on
+ * multi-resolution meshes) and solved with `MultigridSolver`. Velocity is taken from
+ * the edge states outside the mesh and is zero inside obstacles; the pressure has a
+ * zero gradient across both. The divergence and gradient are central differences on
+ * the cell centres, so this is an approximate projection: the divergence is greatly
+ * reduced, but is not exactly zero.
+ */
+class ProjectionSolver {
+  public:
+    ProjectionSolver() = delete;
+
+    /**
+     * Build the pressure Poisson equation for the given mesh and obstacles
+     *
+     * @param mesh the mesh to step on
+     * @param obstacle_cell_mask a non-zero entry for every cell covered by an obstacle
+     */
+    ProjectionSolver(std::shared_ptr<const ControlVolumeMesh> mesh,
+                     const std::vector<uint8_t>& obstacle_cell_mask);
+
+    /**
+     * Step the given fields forward
+     *
+     * NOTE: `edges.override_top_velocity` is ignored, the top neighbours of cells are
+     *       always read from the fields
+     *
+     * @param current the current fields, the pressure is used as the initial guess for
+     * the pressure solve
+     * @param edges the states used in place of missing neighbours, only the velocities
+     * are used
+     * @param dt the amount of time to step forward by (s)
+     * @param density the density of the fluid (kg/m^3)
+     * @param viscosity the viscosity of the fluid (m^2/s)
+     * @param thread_pool the threads to step on
+     * @param next the fields to write the next step into, the same size as `current`.
+     * Cells covered by obstacles are set to zero.
+     * @param diffusion_solver if set, the velocity is only advected explicitly, then
+     * diffused with this before it is projected (rather than diffused explicitly). It
+     * must be built for the same mesh and obstacles.
+     *
+     * @return the outcome of the pressure solve
+     */
+    LinearSolveResult step(const ControlVolumeFields& current,
+                           const StencilEdgeStates<double>& edges,
+                           double dt,
+                           double density,
+                           double viscosity,
+                           ThreadPool& thread_pool,
+                           ControlVolumeFields& next,
+                           ImplicitDiffusionSolver* diffusion_solver = nullptr);
+
+    /**
+     * Compute the divergence of the velocity of every cell not covered by an obstacle,
+     * with the same discretisation the projection uses
+     *
+     * @param fields the fields to compute the divergence of
+     * @param edges the states used in place of missing neighbours
+     * @param thread_pool the threads to compute on
+     * @param divergence set to the divergence (1/s) of every cell, zero for cells
+     * covered by obstacles
+     */
+    void computeDivergence(const ControlVolumeFields& fields,
+                           const StencilEdgeStates<double>& edges,
+                           ThreadPool& thread_pool,
+                           std::vector<double>& divergence) const;
+
+    /**
+     * Get the mesh this steps on
+     *
+     * @return the mesh this steps on
+     */
+    const std::shared_ptr<const ControlVolumeMesh>& getMesh() const { return mesh; }
+
+    /**
+     * Get the solver used for the pressure Poisson equation
+     *
+     * @return the solver used for the pressure Poisson equation
+     */
+    const MultigridSolver& getPressureSolver() const { return *pressure_solver; }
+
+    // The relative residual the pressure solve stops at, and the most iterations it
+    // takes
+    static constexpr double PRESSURE_TOLERANCE   = 1e-8;
+    static constexpr int MAX_PRESSURE_ITERATIONS = 200;
+
+  private:
+    // The neighbour index used in place of neighbours covered by an obstacle
+    static constexpr int OBSTACLE_NEIGHBOUR = -2;
+
+    /**
+     * Get the velocity of the given neighbour of a cell, or of the boundary if there is
+     * no (uncovered) neighbour
+     *
+     * @param fields the fields to read from
+     * @param neighbour the index of the neighbour, NO_NEIGHBOUR, or OBSTACLE_NEIGHBOUR
+     * @param edge the state to use if there is no neighbour
+     * @param velocity_x set to the x velocity of the neighbour
+     * @param velocity_y set to the y velocity of the neighbour
+     */
+    static void neighbourVelocity(const ControlVolumeFields& fields,
+                                  int neighbour,
+                                  const CellState& edge,
+                                  double& velocity_x,
+                                  double& velocity_y);
+
+    // The mesh this steps on
+    std::shared_ptr<const ControlVolumeMesh> mesh;
+
+    // The index of the neighbour of every cell in each direction, with neighbours
+    // covered by obstacles replaced by OBSTACLE_NEIGHBOUR
+    std::array<std::vector<int>, NUM_DIRECTIONS> neighbours;
+
+    // The cells not covered by an obstacle (the unknowns of the pressure solve, in
+    // order), and the unknown index of every cell (-1 for covered cells)
+    std::vector<int> fluid_cells;
+    std::vector<int> unknown_index;
+
+    // Solves the pressure Poisson equation
+    std::unique_ptr<MultigridSolver> pressure_solver;
+
+    // Work vectors for the pressure solve
+    std::vector<double> pressure_rhs;
+    std::vector<double> pressure_solution;
+};
@@ -0,0 +1,152 @@
+#pragma once
+
+// STD Includes
+#include <cstddef>
+#include <vector>
+
+// Project Includes
+#include "ControlVolumeFields.h"
+#include "ControlVolumeKernel.h"
+#include "ControlVolumeMesh.h"
+
+/**
+ * The states used in place of missing neighbours at the edge of the mesh
+ *
+ * @tparam Scalar the floating point type the states are stored as
+ */
+template <typename Scalar>
+struct StencilEdgeStates {
+    BasicCellState<Scalar> left;
+    BasicCellState<Scalar> right;
+    BasicCellState<Scalar> top;
+    BasicCellState<Scalar> bottom;
+
+    // If set, the velocity of every top neighbour that *does* exist is taken from
+    // `top_velocity_override` rather than the fields
+    bool override_top_velocity;
+    BasicCellState<Scalar> top_velocity_override;
+};
+
+/**
+ * Get the edge states the legacy (graph) update uses
+ *
+ * @return the edge states the legacy update uses
+ */
+template <typename Scalar>
+StencilEdgeStates<Scalar> legacyEdgeStates() {
+    StencilEdgeStates<Scalar> edges;
+    edges.left                  = {0, 1, 0};
+    edges.right                 = {0, 2, 0};
+    edges.top                   = {0, 0, 0};
+    edges.bottom                = {0, 0, 2};
+    edges.override_top_velocity = true;
+    edges.top_velocity_override = {0, 0, 1};
+    return edges;
+}
+
+/**
+ * Update the cells in the range [begin, end) of the given cells, on plain scalars
+ *
+ * The kernel is specialised at compile time, so cells that don't need a general
+ * stencil don't pay for one:
+ * - with UNIFORM_SPACING, every neighbour is taken to be the cell's scale away, rather
+ *   than reading the distance to each neighbour. Only valid for cells whose
+ *   neighbours are all the same size as the cell, and matches `ControlVolume::update`
+ *   to within rounding of the coordinates the neighbour distances are computed from.
+ * - without BOUNDARY, every neighbour is read straight from the fields. Only valid
+ *   for cells with a neighbour in every direction.
+ *
+ * Otherwise, the double precision kernels give bit-for-bit the same results as
+ * `ControlVolume::update`.
+ *
+ * @tparam Scalar the floating point type to compute with
+ * @tparam UNIFORM_SPACING whether all the cells are the same distance from each of
+ * their neighbours
+ * @tparam BOUNDARY whether any of the cells may be missing a neighbour
+ *
+ * @param mesh the mesh the cells are in
+ * @param cells the index of every cell to update
+ * @param begin the first index into `cells` to update
+ * @param end one past the last index into `cells` to update
+ * @param current the current fields, read from
+ * @param edges the states used in place of missing neighbours
+ * @param dt the amount of time to step forward by (s)
+ * @param fluid the properties of the fluid
+ * @param next the fields to write the updated cells into
+ */
+template <typename Scalar, bool UNIFORM_SPACING, bool BOUNDARY>
+void updateScalarCells(const ControlVolumeMesh& mesh,
+                       const std::vector<int>& cells,
+                       size_t begin,
+                       size_t end,
+                       const BasicControlVolumeFields<Scalar>& current,
+                       const StencilEdgeStates<Scalar>& edges,
+                       Scalar dt,
+                       const BasicFluidCoefficients<Scalar>& fluid,
+                       BasicControlVolumeFields<Scalar>& next) {
+    const std::vector<int>& left_neighbours     = mesh.getNeighbours(LEFT);
+    const std::vector<int>& right_neighbours    = mesh.getNeighbours(RIGHT);
+    const std::vector<int>& top_neighbours      = mesh.getNeighbours(TOP);
+    const std::vector<int>& bottom_neighbours   = mesh.getNeighbours(BOTTOM);
+    const std::vector<double>& left_distances   = mesh.getNeighbourDistances(LEFT);
+    const std::vector<double>& right_distances  = mesh.getNeighbourDistances(RIGHT);
+    const std::vector<double>& top_distances    = mesh.getNeighbourDistances(TOP);
+    const std::vector<double>& bottom_distances = mesh.getNeighbourDistances(BOTTOM);
+    const std::vector<double>& cell_scale       = mesh.getCellScale();
+
+    auto cell_state = [&current](int i) -> BasicCellState<Scalar> {
+        return {current.pressure[i], current.velocity_x[i], current.velocity_y[i]};
+    };
+
+    // Get the state of a neighbour, or the given edge state if there is no neighbour
+    auto neighbour_state = [&](int neighbour, const BasicCellState<Scalar>& edge) {
+        if constexpr (BOUNDARY) {
+            if (neighbour == ControlVolumeMesh::NO_NEIGHBOUR) {
+                return edge;
+            }
+        }
+        return cell_state(neighbour);
+    };
+
+    for (size_t k = begin; k < end; k++) {
+        const int i = cells[k];
+
+        BasicCellState<Scalar> top_state =
+            neighbour_state(top_neighbours[i], edges.top);
+        const bool has_top =
+            !BOUNDARY || top_neighbours[i] != ControlVolumeMesh::NO_NEIGHBOUR;
+        if (has_top && edges.override_top_velocity) {
+            top_state.velocity_x = edges.top_velocity_override.velocity_x;
+            top_state.velocity_y = edges.top_velocity_override.velocity_y;
+        }
+
+        Scalar left_distance, right_distance, top_distance, bottom_distance;
+        if constexpr (UNIFORM_SPACING) {
+            left_distance   = static_cast<Scalar>(cell_scale[i]);
+            right_distance  = left_distance;
+            top_distance    = left_distance;
+            bottom_distance = left_distance;
+        } else {
+            left_distance   = static_cast<Scalar>(left_distances[i]);
+            right_distance  = static_cast<Scalar>(right_distances[i]);
+            top_distance    = static_cast<Scalar>(top_distances[i]);
+            bottom_distance = static_cast<Scalar>(bottom_distances[i]);
+        }
+
+        const BasicCellState<Scalar> updated = computeCellState<Scalar>(
+            cell_state(i),
+            neighbour_state(left_neighbours[i], edges.left),
+            left_distance,
+            neighbour_state(right_neighbours[i], edges.right),
+            right_distance,
+            top_state,
+            top_distance,
+            neighbour_state(bottom_neighbours[i], edges.bottom),
+            bottom_distance,
+            dt,
+            fluid);
+        next.pressure[i]   = updated.pressure;
+        next.velocity_x[i] = updated.velocity_x;
+        next.velocity_y[i] = updated.velocity_y;
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+// STD Includes
+#include <cstddef>
+
+// Project Includes
+#include "ControlVolumeFields.h"
+#include "ControlVolumeKernel.h"
+#include "ControlVolumeMesh.h"
+
+// The instruction sets the uniform stencil kernel can be run with
+enum class SimdLevel { SCALAR, AVX2, AVX512 };
+
+// The maximum difference, in units in the last place, between the results of the
+// vectorised and scalar kernels. The vectorised kernels perform the same IEEE
+// operations in the same order as the scalar kernel (and are compiled without
+// contracting them into fused multiply-adds), so in practice they match exactly.
+const int SIMD_STENCIL_ULP_TOLERANCE = 2;
+
+/**
+ * Get the best instruction set supported by the CPU we're running on
+ *
+ * @return the best instruction set supported by the CPU we're running on
+ */
+SimdLevel getBestSimdLevel();
+
+/**
+ * Check if the CPU we're running on supports the given instruction set
+ *
+ * @param simd_level the instruction set to check
+ *
+ * @return true if the CPU supports the given instruction set, false otherwise
+ */
+bool isSimdLevelSupported(SimdLevel simd_level);
+
+/**
+ * Update the cells in the range [begin, end) of the given uniform stencil cells
+ *
+ * Gives the same results as `updateCellState` to within SIMD_STENCIL_ULP_TOLERANCE
+ *
+ * @param simd_level the instruction set to use, must be supported by this CPU
+ * @param uniform_cells the cells to update
+ * @param begin the first index into `uniform_cells` to update
+ * @param end one past the last index into `uniform_cells` to update
+ * @param current the current fields, read from
+ * @param top_velocity_override if not null, the velocity of every top neighbour is
+ * taken from this state rather than the current fields (as the legacy update does)
+ * @param dt the amount of time to step forward by (s)
+ * @param fluid the properties of the fluid
+ * @param next the fields to write the updated cells into
+ */
+void updateUniformCells(SimdLevel simd_level,
+                        const UniformStencilCells& uniform_cells,
+                        size_t begin,
+                        size_t end,
+                        const ControlVolumeFields& current,
+                        const CellState* top_velocity_override,
+                        double dt,
+                        const FluidCoefficients& fluid,
+                        ControlVolumeFields& next);
@@ -0,0 +1,121 @@
+#pragma once
+
+// STD Includes
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+// Library Includes
+#include <units.h>
+
+// Project Includes
+#include "FieldSnapshot.h"
+#include "FluidSimulator.h"
+#include "TripleBuffer.h"
+
+/**
+ * Runs a `FluidSimulator` in frames of several steps, publishing a snapshot of the
+ * fields (with it's `FieldPyramid` built, ready to draw) after every frame
+ *
+ * Frames can either be run continuously on a dedicated thread (see `start`), or one
+ * at a time by the caller (see `runFrame`). Snapshots are passed through a lock-free
+ * triple buffer, so a reader (eg. a renderer) can always get the newest complete
+ * snapshot without blocking the simulation or seeing a half-updated state.
+ */
+class SimulationThread {
+  public:
+    SimulationThread() = delete;
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+
+    /**
+     * Create a SimulationThread, and publish a snapshot of the initial state
+     *
+     * The thread isn't started until `start` is called
+     *
+     * @param simulator the simulator to run
+     * @param dt the time step to take every step
+     * @param steps_per_frame the number of steps to take between snapshots, must be at
+     * least 1
+     */
+    SimulationThread(FluidSimulator simulator,
+                     units::time::second_t dt,
+                     int steps_per_frame);
+
+    // Stops the thread, if it is running
+    ~SimulationThread();
+
+    /**
+     * Start running frames continuously on a dedicated thread
+     *
+     * Does nothing if the thread is already running
+     */
+    void start();
+
+    /**
+     * Stop the dedicated thread, waiting for it to finish it's current frame
+     *
+     * Does nothing if the thread isn't running
+     */
+    void stop();
+
+    /**
+     * Check if frames are being run on the dedicated thread
+     *
+     * @return true if frames are being run on the dedicated thread, false otherwise
+     */
+    bool isRunning() const;
+
+    /**
+     * Run one frame on the calling thread, and publish a snapshot of the result
+     *
+     * Must not be called while the dedicated thread is running
+     */
+    void runFrame();
+
+    /**
+     * Get the newest complete snapshot
+     *
+     * Only one thread may read snapshots. The returned snapshot stays valid (and
+     * unchanged) until the next call to this.
+     *
+     * @return the newest complete snapshot
+     */
+    const FieldSnapshot& getLatestSnapshot();
+
+    /**
+     * Get the simulator being run
+     *
+     * Must not be used while the dedicated thread is running
+     *
+     * @return the simulator being run
+     */
+    FluidSimulator& getSimulator();
+
+  private:
+    /**
+     * Take a snapshot of the simulator and publish it
+     */
+    void publishSnapshot();
+
+    // The simulator being run
+    FluidSimulator simulator;
+
+    // The time step to take every step (s)
+    const units::time::second_t dt;
+
+    // The number of steps to take between snapshots
+    const int steps_per_frame;
+
+    // The number of steps taken so far
+    uint64_t num_steps;
+
+    // The snapshots being passed from the simulation to the reader
+    TripleBuffer<FieldSnapshot> snapshots;
+
+    // The dedicated thread, if it has been started
+    std::thread thread;
+
+    // Cleared to ask the dedicated thread to stop
+    std::atomic<bool> running;
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+// STD Includes
+#include <vector>
+
+// Library Includes
+#include <units.h>
+
+// Project Includes
+#include "CellLocator.h"
+#include "ControlVolumeFields.h"
+#include "ThreadPool.h"
+
+struct Point2d {
+    units::length::meter_t x;
+    units::length::meter_t y;
+};
+
+// The ways a streamline can be stepped from one point to the next
+enum class StreamLineIntegrator {
+    // Step along the direction of the flow at the current point
+    EULER,
+    // Step along a 4th order Runge-Kutta estimate of the direction of the flow
+    RK4
+};
+
+// The ways the velocity at a point along a streamline can be found
+enum class VelocitySampling {
+    // Use the velocity of the cell containing the point
+    NEAREST_CELL,
+    // Interpolate linearly between the cell containing the point and the neighbours
+    // closest to the point
+    INTERPOLATED
+};
+
+// Options controlling how streamlines are traced
+struct StreamLineOptions {
+    StreamLineIntegrator integrator = StreamLineIntegrator::RK4;
+    VelocitySampling velocity_sampling = VelocitySampling::INTERPOLATED;
+};
+
+/**
+ * Trace a streamline through the given fields
+ *
+ * Points are `distance_between_points` apart along the direction of the flow. If
+ * the flow is stopped at a point, that point is repeated for the rest of the line.
+ *
+ * @param locator locates cells in the mesh the fields are for
+ * @param fields the fields to trace the streamline through
+ * @param start_point the point to start the streamline at
+ * @param line_length the length of the streamline
+ * @param distance_between_points the distance between consecutive points
+ * @param options how to trace the streamline
+ *
+ * @return a vector of points representing the streamline, with the first point on
+ * the streamline being the first point in the vector
+ */
+std::vector<Point2d> traceStreamLine(const CellLocator& locator,
+                                     const ControlVolumeFields& fields,
+                                     Point2d start_point,
+                                     units::length::meter_t line_length,
+                                     units::length::meter_t distance_between_points,
+                                     StreamLineOptions options);
+
+/**
+ * Trace a streamline from each of the given points, in parallel
+ *
+ * @param locator locates cells in the mesh the fields are for
+ * @param fields the fields to trace the streamlines through
+ * @param start_points the points to start a streamline at
+ * @param line_length the length of each streamline
+ * @param distance_between_points the distance between consecutive points
+ * @param options how to trace the streamlines
+ * @param thread_pool the threads to trace the streamlines on
+ *
+ * @return the streamline starting at each of the given points, in the same order
+ */
+std::vector<std::vector<Point2d>>
+    traceStreamLines(const CellLocator& locator,
+                     const ControlVolumeFields& fields,
+                     const std::vector<Point2d>& start_points,
+                     units::length::meter_t line_length,
+                     units::length::meter_t distance_between_points,
+                     StreamLineOptions options,
+                     ThreadPool& thread_pool);
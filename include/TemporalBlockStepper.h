@@ -0,0 +1,177 @@
+#pragma once
+
+// STD Includes
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Project Includes
+#include "ControlVolumeFields.h"
+#include "ControlVolumeKernel.h"
+#include "ControlVolumeMesh.h"
+#include "ScalarStencilKernel.h"
+#include "ThreadPool.h"
+
+// Parameters controlling `TemporalBlockStepper`
+struct TemporalBlockingParameters {
+    // The side length of each tile, in units of the smallest cell. Tiles should be
+    // small enough for their fields (and halo) to stay in cache while they are stepped.
+    int tile_size = 64;
+
+    // The most steps each tile takes before moving on to the next, which is also the
+    // depth of the halo around each tile. Deeper halos mean fewer passes over memory,
+    // but more redundant updates.
+    int steps_per_block = 4;
+};
+
+/**
+ * Steps a mesh several steps at a time with temporal blocking, so the fields of each
+ * part of the mesh are streamed through memory once per block rather than once per
+ * step
+ *
+ * The mesh is split into square tiles, each of which is stepped on it's own with
+ * overlapped tiling: a tile is copied into a small local buffer along with every cell
+ * within `steps_per_block` hops of it (following the neighbours each cell reads), then
+ * each step updates the cells still within reach of the tile, one hop fewer than the
+ * step before. After the last step only the tile itself is left, and is written out.
+ * The cells in the halo are updated redundantly by every tile that reaches them, but
+ * only the tile that owns a cell writes it, so tiles can be stepped in any order on
+ * any number of threads.
+ *
+ * Every cell is updated with `updateCellState`, from the same neighbours and distances
+ * as `FluidSimulator::computeNextFields`, and cells covered by obstacles are zeroed
+ * after every step. A block of n steps is therefore bit-identical to n steps taken
+ * one at a time with the scalar kernels, and within SIMD_STENCIL_ULP_TOLERANCE of
+ * them with the vectorised kernels.
+ *
+ * NOTE: The states outside the mesh must be fixed (ie. `StencilEdgeStates`), as they
+ *       are written into the local buffers once per block
+ */
+class TemporalBlockStepper {
+  public:
+    TemporalBlockStepper() = delete;
+
+    /**
+     * Split the given mesh into tiles, and find the halo of every tile
+     *
+     * @param mesh the mesh to step on
+     * @param obstacle_cell_mask a non-zero entry for every cell covered by an obstacle
+     * @param edges the states used in place of missing neighbours
+     * @param parameters the size of the tiles and blocks
+     *
+     * @throws std::invalid_argument if the tile size or steps per block is less than 1
+     */
+    TemporalBlockStepper(std::shared_ptr<const ControlVolumeMesh> mesh,
+                         const std::vector<uint8_t>& obstacle_cell_mask,
+                         const StencilEdgeStates<double>& edges,
+                         TemporalBlockingParameters parameters);
+
+    /**
+     * Step the given fields forward by a block of steps
+     *
+     * @param current the current fields
+     * @param dt the amount of time to step forward by each step (s)
+     * @param fluid the properties of the fluid
+     * @param num_steps the number of steps to take, from 1 to `steps_per_block`
+     * @param thread_pool the threads to step the tiles on
+     * @param next the fields to write the result into, the same size as `current`
+     */
+    void step(const ControlVolumeFields& current,
+              double dt,
+              const FluidCoefficients& fluid,
+              int num_steps,
+              ThreadPool& thread_pool,
+              ControlVolumeFields& next) const;
+
+    /**
+     * Get the number of cell updates a block of the given number of steps takes,
+     * including the redundant updates of the halos
+     *
+     * @param num_steps the number of steps in the block
+     *
+     * @return the number of cell updates the block takes
+     */
+    uint64_t getNumCellUpdates(int num_steps) const;
+
+    /**
+     * Get the number of tiles the mesh is split into
+     *
+     * @return the number of tiles the mesh is split into
+     */
+    size_t getNumTiles() const { return tiles.size(); }
+
+    /**
+     * Get the mesh this steps on
+     *
+     * @return the mesh this steps on
+     */
+    const std::shared_ptr<const ControlVolumeMesh>& getMesh() const { return mesh; }
+
+    /**
+     * Get the size of the tiles and blocks
+     *
+     * @return the size of the tiles and blocks
+     */
+    const TemporalBlockingParameters& getParameters() const { return parameters; }
+
+  private:
+    // A tile of the mesh, and it's halo
+    struct Tile {
+        // The cells of the tile followed by the cells of it's halo, ordered by the
+        // number of hops from the tile
+        std::vector<int> cells;
+
+        // The number of cells within each number of hops of the tile, so the tile
+        // itself is the first `hop_offsets[0]` of `cells`
+        std::vector<size_t> hop_offsets;
+
+        // The local index of the neighbour of every cell within `steps_per_block - 1`
+        // hops, in each direction. Missing neighbours are given the index of the edge
+        // state in that direction, just past the cells.
+        std::array<std::vector<int>, NUM_DIRECTIONS> neighbours;
+
+        // The local index the velocity of the top neighbour of every cell is read
+        // from. This is the override slot for real neighbours if the top velocity is
+        // overridden, and the top neighbour otherwise.
+        std::vector<int> top_velocity_neighbours;
+
+        // The distance to the neighbour of every cell within `steps_per_block - 1`
+        // hops, in each direction
+        std::array<std::vector<double>, NUM_DIRECTIONS> distances;
+
+        // The local index of every cell covered by an obstacle, in order
+        std::vector<int> obstacle_cells;
+    };
+
+    /**
+     * Step one tile forward by a block of steps
+     *
+     * @param tile the tile to step
+     * @param current the current fields
+     * @param dt the amount of time to step forward by each step (s)
+     * @param fluid the properties of the fluid
+     * @param num_steps the number of steps to take
+     * @param buffers the local buffers to step the tile in
+     * @param next the fields to write the tile into
+     */
+    void stepTile(const Tile& tile,
+                  const ControlVolumeFields& current,
+                  double dt,
+                  const FluidCoefficients& fluid,
+                  int num_steps,
+                  std::array<ControlVolumeFields, 2>& buffers,
+                  ControlVolumeFields& next) const;
+
+    // The mesh this steps on
+    std::shared_ptr<const ControlVolumeMesh> mesh;
+
+    // The states used in place of missing neighbours
+    StencilEdgeStates<double> edges;
+
+    // The size of the tiles and blocks
+    TemporalBlockingParameters parameters;
+
+    // Every tile of the mesh
+    std::vector<Tile> tiles;
+};
@@ -0,0 +1,139 @@
+#pragma once
+
+// STD Includes
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A persistent pool of worker threads for running loops over cell ranges in parallel
+ *
+ * The range of items given to `parallelFor` is split into a number of contiguous
+ * chunks that depends only on the number of items and threads. Threads (including
+ * the calling thread) then claim chunks until all of them have been run, so faster
+ * threads pick up more of the work.
+ *
+ * NOTE: Only one loop runs on a pool at a time, so calling `parallelFor` or
+ *       `parallelReduce` from inside a loop running on the same pool deadlocks
+ */
+class ThreadPool {
+  public:
+    ThreadPool() = delete;
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * Create a ThreadPool
+     *
+     * @param num_threads the total number of threads to run loops on, including the
+     * thread calling `parallelFor`. Must be at least 1.
+     */
+    explicit ThreadPool(int num_threads);
+
+    ~ThreadPool();
+
+    /**
+     * Get the total number of threads loops are run on
+     *
+     * @return the total number of threads loops are run on
+     */
+    int getNumThreads() const { return num_threads; }
+
+    /**
+     * Run the given function over contiguous chunks of [0, num_items) in parallel
+     *
+     * Returns once the function has been run over every chunk. Chunks are disjoint,
+     * so the function may write to per-item outputs without synchronisation.
+     *
+     * If the function throws, no more chunks are started, and the first exception
+     * thrown is rethrown once every thread has stopped running the function.
+     *
+     * @param num_items the number of items to run over
+     * @param function called with the [begin, end) item range of each chunk
+     *
+     * @throws the first exception thrown by `function`, if any
+     */
+    void parallelFor(size_t num_items,
+                     const std::function<void(size_t begin, size_t end)>& function);
+
+    /**
+     * Reduce over [0, num_items) in parallel
+     *
+     * NOTE: Chunks are combined in whatever order they finish in, so the result is
+     *       only deterministic if `combine` is exactly associative and commutative
+     *       (eg. min, max, logical and), which floating point addition is not
+     *
+     * @param num_items the number of items to reduce over
+     * @param identity the identity value of `combine`
+     * @param reduce_chunk called with the [begin, end) item range of each chunk,
+     * returns the reduction of that chunk
+     * @param combine combines the reductions of two chunks
+     *
+     * @return the reduction over every item
+     *
+     * @throws the first exception thrown by `reduce_chunk` or `combine`, if any
+     */
+    template <typename T, typename ReduceChunk, typename Combine>
+    T parallelReduce(size_t num_items,
+                     T identity,
+                     const ReduceChunk& reduce_chunk,
+                     const Combine& combine) {
+        T result = identity;
+        std::mutex result_mutex;
+        parallelFor(num_items, [&](size_t begin, size_t end) {
+            T chunk_result = reduce_chunk(begin, end);
+            std::lock_guard<std::mutex> result_lock(result_mutex);
+            result = combine(result, chunk_result);
+        });
+        return result;
+    }
+
+  private:
+    /**
+     * The loop each worker thread runs until the pool is destroyed
+     */
+    void workerLoop();
+
+    /**
+     * Claim and run chunks of the current job until there are none left
+     */
+    void runChunks();
+
+    // The total number of threads loops are run on, including the calling thread
+    const int num_threads;
+
+    // The worker threads
+    std::vector<std::thread> workers;
+
+    // Only one `parallelFor` may run at a time
+    std::mutex job_mutex;
+
+    // Guards the job state below, and is used to wake/wait on workers
+    std::mutex state_mutex;
+    std::condition_variable job_available;
+    std::condition_variable job_finished;
+
+    // The current job
+    const std::function<void(size_t, size_t)>* job_function;
+    size_t job_num_items;
+    size_t job_num_chunks;
+
+    // Incremented whenever a new job is started
+    size_t job_generation;
+
+    // The next chunk of the current job to be claimed
+    std::atomic<size_t> next_chunk;
+
+    // The number of workers still running chunks of the current job
+    int num_busy_workers;
+
+    // The first exception thrown by a chunk of the current job
+    std::exception_ptr job_exception;
+
+    // Set when the pool is being destroyed
+    bool stopping;
+};
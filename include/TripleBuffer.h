@@ -0,0 +1,91 @@
+#pragma once
+
+// STD Includes
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * A lock-free triple buffer, for passing the latest value from one writer thread to
+ * one reader thread
+ *
+ * The writer fills in the back buffer and publishes it, and the reader swaps in the
+ * most recently published buffer. Neither side ever waits on the other, and the
+ * reader never sees a buffer the writer is part way through writing. Values the
+ * reader doesn't pick up in time are simply overwritten, so the writer never falls
+ * behind.
+ *
+ * Only one thread may call the writer methods, and only one thread may call the
+ * reader methods.
+ *
+ * @tparam T the type of value to pass between the threads
+ */
+template <typename T>
+class TripleBuffer {
+  public:
+    TripleBuffer() : middle_state(1), back_index(0), front_index(2) {}
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    /**
+     * Get the buffer the writer should fill in before calling `publish` (writer only)
+     *
+     * @return the buffer the writer should fill in
+     */
+    T& getWriteBuffer() { return buffers[back_index]; }
+
+    /**
+     * Make the write buffer the latest value, and get a new write buffer (writer only)
+     *
+     * NOTE: The new write buffer holds an older value, and is not cleared
+     */
+    void publish() {
+        const uint8_t old_middle_state =
+            middle_state.exchange(back_index | FRESH_BIT, std::memory_order_acq_rel);
+        back_index = old_middle_state & INDEX_MASK;
+    }
+
+    /**
+     * Swap in the latest published value, if there is one the reader hasn't seen
+     * (reader only)
+     *
+     * @return true if there was a new value, false otherwise
+     */
+    bool update() {
+        if (!(middle_state.load(std::memory_order_relaxed) & FRESH_BIT)) {
+            return false;
+        }
+        const uint8_t old_middle_state =
+            middle_state.exchange(front_index, std::memory_order_acq_rel);
+        front_index = old_middle_state & INDEX_MASK;
+        return true;
+    }
+
+    /**
+     * Get the latest value the reader has swapped in with `update` (reader only)
+     *
+     * @return the latest value the reader has swapped in
+     */
+    const T& getReadBuffer() const { return buffers[front_index]; }
+
+  private:
+    // The bits of `middle_state` holding the index of the middle buffer
+    static constexpr uint8_t INDEX_MASK = 0x3;
+
+    // Set in `middle_state` when the middle buffer has been published, but not read
+    static constexpr uint8_t FRESH_BIT = 0x4;
+
+    std::array<T, 3> buffers;
+
+    // The index of the buffer between the writer and the reader, and whether it
+    // holds a value the reader hasn't seen yet. This is the only state shared
+    // between the writer and the reader.
+    std::atomic<uint8_t> middle_state;
+
+    // The index of the buffer being written to, only used by the writer
+    uint8_t back_index;
+
+    // The index of the buffer being read from, only used by the reader
+    uint8_t front_index;
+};
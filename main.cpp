@@ -1,5 +1,6 @@
 // STD Includes
 #include <iostream>
+#include <utility>
 
 // Library Includes
 #include <multi_res_graph/GraphNode.h>
@@ -39,7 +40,8 @@ int main(int argc, char** argv) {
 //    auto obstacle1 = std::make_shared<Circle<ControlVolume>>(1, (Coordinates){2, 3.5});
 //    simulator.addObstacle(obstacle1);
 
-    FluidSimulatorRenderer graph_renderer(simulator);
+    FluidSimulatorRenderer graph_renderer(std::move(simulator),
+                                          SimulationMode::DEDICATED_THREAD);
     window.add(graph_renderer);
     graph_renderer.show();
 
@@ -0,0 +1,56 @@
+#include "BoundaryConditions.h"
+
+// STD Includes
+#include <stdexcept>
+
+BoundaryConditions legacyBoundaryConditions() {
+    const StencilEdgeStates<double> edges = legacyEdgeStates<double>();
+
+    BoundaryConditions conditions;
+    conditions.sides[LEFT]           = {BoundaryType::INFLOW, edges.left};
+    conditions.sides[RIGHT]          = {BoundaryType::INFLOW, edges.right};
+    conditions.sides[TOP]            = {BoundaryType::INFLOW, edges.top};
+    conditions.sides[BOTTOM]         = {BoundaryType::INFLOW, edges.bottom};
+    conditions.override_top_velocity = edges.override_top_velocity;
+    conditions.top_velocity_override = edges.top_velocity_override;
+    return conditions;
+}
+
+void validateBoundaryConditions(const BoundaryConditions& conditions) {
+    auto is_periodic = [&](Direction direction) {
+        return conditions.sides[direction].type == BoundaryType::PERIODIC;
+    };
+    if (is_periodic(LEFT) != is_periodic(RIGHT) ||
+        is_periodic(TOP) != is_periodic(BOTTOM)) {
+        throw std::invalid_argument(
+            "Periodic boundaries must be applied to both opposite sides");
+    }
+}
+
+bool hasFixedEdgeStates(const BoundaryConditions& conditions) {
+    for (const BoundaryCondition& side : conditions.sides) {
+        if (side.type != BoundaryType::INFLOW) {
+            return false;
+        }
+    }
+    return true;
+}
+
+StencilEdgeStates<double> toEdgeStates(const BoundaryConditions& conditions) {
+    auto edge_state = [&](Direction direction) -> CellState {
+        const BoundaryCondition& side = conditions.sides[direction];
+        if (side.type == BoundaryType::INFLOW) {
+            return side.state;
+        }
+        return {0, 0, 0};
+    };
+
+    StencilEdgeStates<double> edges;
+    edges.left                  = edge_state(LEFT);
+    edges.right                 = edge_state(RIGHT);
+    edges.top                   = edge_state(TOP);
+    edges.bottom                = edge_state(BOTTOM);
+    edges.override_top_velocity = conditions.override_top_velocity;
+    edges.top_velocity_override = conditions.top_velocity_override;
+    return edges;
+}
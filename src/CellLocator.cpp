@@ -0,0 +1,149 @@
+#include "CellLocator.h"
+
+// STD Includes
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+    // The most bins the lookup grid may have. If the smallest cell is very small
+    // compared to the whole mesh, bins are made larger than it to stay under this.
+    const double MAX_NUM_BINS = 1 << 22;
+}
+
+CellLocator::CellLocator(std::shared_ptr<const ControlVolumeMesh> mesh)
+  : mesh(std::move(mesh)),
+    min_x(0),
+    min_y(0),
+    max_x(0),
+    max_y(0),
+    bin_size(1),
+    num_bins_x(0),
+    num_bins_y(0) {
+    const std::vector<double>& cell_x     = this->mesh->getCellX();
+    const std::vector<double>& cell_y     = this->mesh->getCellY();
+    const std::vector<double>& cell_scale = this->mesh->getCellScale();
+    const size_t num_cells                = this->mesh->numCells();
+    if (num_cells == 0) {
+        bin_offsets.assign(1, 0);
+        return;
+    }
+
+    // Figure out the area covered by the mesh, and the size of the smallest cell
+    min_x             = std::numeric_limits<double>::infinity();
+    min_y             = std::numeric_limits<double>::infinity();
+    max_x             = -std::numeric_limits<double>::infinity();
+    max_y             = -std::numeric_limits<double>::infinity();
+    double min_scale  = std::numeric_limits<double>::infinity();
+    for (size_t i = 0; i < num_cells; i++) {
+        min_x     = std::min(min_x, cell_x[i]);
+        min_y     = std::min(min_y, cell_y[i]);
+        max_x     = std::max(max_x, cell_x[i] + cell_scale[i]);
+        max_y     = std::max(max_y, cell_y[i] + cell_scale[i]);
+        min_scale = std::min(min_scale, cell_scale[i]);
+    }
+
+    bin_size = std::max(
+        min_scale, std::sqrt((max_x - min_x) * (max_y - min_y) / MAX_NUM_BINS));
+    num_bins_x = std::max(1, static_cast<int>(std::ceil((max_x - min_x) / bin_size)));
+    num_bins_y = std::max(1, static_cast<int>(std::ceil((max_y - min_y) / bin_size)));
+
+    auto bin_range = [&](size_t i, int& bin_x_min, int& bin_x_max, int& bin_y_min,
+                         int& bin_y_max) {
+        bin_x_min = std::max(0, static_cast<int>((cell_x[i] - min_x) / bin_size));
+        bin_y_min = std::max(0, static_cast<int>((cell_y[i] - min_y) / bin_size));
+        bin_x_max = std::min(
+            num_bins_x - 1,
+            static_cast<int>((cell_x[i] + cell_scale[i] - min_x) / bin_size));
+        bin_y_max = std::min(
+            num_bins_y - 1,
+            static_cast<int>((cell_y[i] + cell_scale[i] - min_y) / bin_size));
+    };
+
+    // Count how many cells overlap each bin, then fill them in
+    const size_t num_bins = static_cast<size_t>(num_bins_x) * num_bins_y;
+    bin_offsets.assign(num_bins + 1, 0);
+    int bin_x_min, bin_x_max, bin_y_min, bin_y_max;
+    for (size_t i = 0; i < num_cells; i++) {
+        bin_range(i, bin_x_min, bin_x_max, bin_y_min, bin_y_max);
+        for (int bin_y = bin_y_min; bin_y <= bin_y_max; bin_y++) {
+            for (int bin_x = bin_x_min; bin_x <= bin_x_max; bin_x++) {
+                bin_offsets[static_cast<size_t>(bin_y) * num_bins_x + bin_x + 1]++;
+            }
+        }
+    }
+    for (size_t bin = 0; bin < num_bins; bin++) {
+        bin_offsets[bin + 1] += bin_offsets[bin];
+    }
+
+    bin_cells.resize(bin_offsets.back());
+    std::vector<int> bin_fill(bin_offsets.begin(), bin_offsets.end() - 1);
+    for (size_t i = 0; i < num_cells; i++) {
+        bin_range(i, bin_x_min, bin_x_max, bin_y_min, bin_y_max);
+        for (int bin_y = bin_y_min; bin_y <= bin_y_max; bin_y++) {
+            for (int bin_x = bin_x_min; bin_x <= bin_x_max; bin_x++) {
+                const size_t bin = static_cast<size_t>(bin_y) * num_bins_x + bin_x;
+                bin_cells[bin_fill[bin]++] = static_cast<int>(i);
+            }
+        }
+    }
+}
+
+bool CellLocator::contains(int cell, double x, double y) const {
+    const double cell_x     = mesh->getCellX()[cell];
+    const double cell_y     = mesh->getCellY()[cell];
+    const double cell_scale = mesh->getCellScale()[cell];
+    return x >= cell_x && x < cell_x + cell_scale && y >= cell_y &&
+           y < cell_y + cell_scale;
+}
+
+int CellLocator::locate(double x, double y, int hint) const {
+    if (mesh->numCells() == 0) {
+        return NO_CELL;
+    }
+
+    // Move points outside the mesh to the closest point inside it
+    x = std::min(std::max(x, min_x), std::nextafter(max_x, min_x));
+    y = std::min(std::max(y, min_y), std::nextafter(max_y, min_y));
+
+    // Points along a streamline are usually in the same cell as the last point, or
+    // one of it's neighbours
+    if (hint != NO_CELL) {
+        if (contains(hint, x, y)) {
+            return hint;
+        }
+        for (int direction = 0; direction < NUM_DIRECTIONS; direction++) {
+            const int neighbour =
+                mesh->getNeighbours(static_cast<Direction>(direction))[hint];
+            if (neighbour != ControlVolumeMesh::NO_NEIGHBOUR &&
+                contains(neighbour, x, y)) {
+                return neighbour;
+            }
+        }
+    }
+
+    const int bin_x = std::min(num_bins_x - 1, static_cast<int>((x - min_x) / bin_size));
+    const int bin_y = std::min(num_bins_y - 1, static_cast<int>((y - min_y) / bin_size));
+    const size_t bin = static_cast<size_t>(bin_y) * num_bins_x + bin_x;
+    for (int k = bin_offsets[bin]; k < bin_offsets[bin + 1]; k++) {
+        if (contains(bin_cells[k], x, y)) {
+            return bin_cells[k];
+        }
+    }
+
+    // The point is in a gap between cells (or on a boundary that rounding put in the
+    // wrong bin), so fall back to the closest cell centre in this bin
+    int closest_cell        = NO_CELL;
+    double closest_distance = std::numeric_limits<double>::infinity();
+    for (int k = bin_offsets[bin]; k < bin_offsets[bin + 1]; k++) {
+        const int cell          = bin_cells[k];
+        const double half_scale = mesh->getCellScale()[cell] / 2;
+        const double distance   = std::hypot(mesh->getCellX()[cell] + half_scale - x,
+                                           mesh->getCellY()[cell] + half_scale - y);
+        if (distance < closest_distance) {
+            closest_cell     = cell;
+            closest_distance = distance;
+        }
+    }
+    return closest_cell;
+}
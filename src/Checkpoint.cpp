@@ -0,0 +1,512 @@
+#include "Checkpoint.h"
+
+// STD Includes
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+// Library Includes
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+// Identifies checkpoint files, and the version of the layout they were written with
+constexpr char CHECKPOINT_MAGIC[8]    = {'S', 'C', 'F', 'D', 'C', 'K', 'P', 'T'};
+constexpr uint32_t CHECKPOINT_VERSION = 2;
+
+// Written as a native integer, so a file written with a different byte order can be
+// recognised rather than misread
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+// Every section starts on a multiple of this many bytes (a cache line, and enough for
+// any SIMD load)
+constexpr uint64_t SECTION_ALIGNMENT = 64;
+
+// The per-cell arrays stored in a checkpoint, in the order they are written
+enum Section {
+    CELL_X,
+    CELL_Y,
+    CELL_SCALE,
+    LEFT_NEIGHBOURS,
+    RIGHT_NEIGHBOURS,
+    TOP_NEIGHBOURS,
+    BOTTOM_NEIGHBOURS,
+    NODE_INDICES,
+    PRESSURE,
+    VELOCITY_X,
+    VELOCITY_Y,
+    OBSTACLE_CELL_MASK,
+    NUM_SECTIONS
+};
+
+// The size in bytes of each cell's entry in every section
+constexpr uint64_t SECTION_ENTRY_SIZES[NUM_SECTIONS] = {sizeof(double),
+                                                        sizeof(double),
+                                                        sizeof(double),
+                                                        sizeof(int32_t),
+                                                        sizeof(int32_t),
+                                                        sizeof(int32_t),
+                                                        sizeof(int32_t),
+                                                        sizeof(int32_t),
+                                                        sizeof(double),
+                                                        sizeof(double),
+                                                        sizeof(double),
+                                                        sizeof(uint8_t)};
+
+// The neighbour tables are written straight from the mesh
+static_assert(sizeof(int) == sizeof(int32_t), "Neighbour indices must be 32 bit");
+
+// The fixed size header at the start of every checkpoint file
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order_mark;
+    uint64_t header_size;
+    uint64_t file_size;
+
+    uint64_t num_cells;
+    uint64_t num_graph_nodes;
+    int64_t graph_resolution;
+    uint64_t num_steps;
+
+    double simulation_size;
+    double simulation_time;
+    double density;
+    double viscosity;
+    double speed_of_sound;
+    double edge_distance;
+
+    // The type of the condition at each side and the state outside it (pressure, x and
+    // y velocity), then whether the velocity of every top neighbour is overridden and
+    // what with
+    int32_t boundary_types[NUM_DIRECTIONS];
+    double boundary_states[NUM_DIRECTIONS][3];
+    uint32_t override_top_velocity;
+    double top_velocity_override[3];
+
+    // The solver mode, and whether (and how) the viscous term is stepped implicitly
+    uint32_t solver_mode;
+    uint32_t implicit_diffusion;
+    double diffusion_implicitness;
+    double diffusion_tolerance;
+    int64_t diffusion_max_iterations;
+
+    // The offset of every section from the start of the file, in bytes
+    uint64_t section_offsets[NUM_SECTIONS];
+};
+static_assert(std::is_trivially_copyable<CheckpointHeader>::value,
+              "The header is written and read as raw bytes");
+
+/**
+ * Copy the given state into the given values
+ *
+ * @param state the state to copy
+ * @param values set to the pressure, x velocity, and y velocity of the state
+ */
+void storeCellState(const CellState& state, double (&values)[3]) {
+    values[0] = state.pressure;
+    values[1] = state.velocity_x;
+    values[2] = state.velocity_y;
+}
+
+/**
+ * Get the state stored in the given values
+ *
+ * @param values the pressure, x velocity, and y velocity of the state
+ *
+ * @return the state stored in the given values
+ */
+CellState loadCellState(const double (&values)[3]) {
+    return {values[0], values[1], values[2]};
+}
+
+/**
+ * Round the given offset up to the next multiple of SECTION_ALIGNMENT
+ *
+ * @param offset the offset to round up
+ *
+ * @return the offset rounded up to the next multiple of SECTION_ALIGNMENT
+ */
+uint64_t alignOffset(uint64_t offset) {
+    return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+
+/**
+ * Fill in the section offsets and file size of the given header from it's number of
+ * cells
+ *
+ * @param header the header to fill in
+ */
+void layOutSections(CheckpointHeader& header) {
+    uint64_t offset = alignOffset(sizeof(CheckpointHeader));
+    for (int section = 0; section < NUM_SECTIONS; section++) {
+        header.section_offsets[section] = offset;
+        offset = alignOffset(offset + header.num_cells * SECTION_ENTRY_SIZES[section]);
+    }
+    header.file_size = offset;
+}
+} // namespace
+
+void writeCheckpoint(const std::string& path, const CheckpointState& state) {
+    const FieldSnapshot& snapshot = state.snapshot;
+    if (!snapshot.mesh) {
+        throw std::runtime_error("Can't write a checkpoint of an empty snapshot");
+    }
+    const ControlVolumeMesh& mesh = *snapshot.mesh;
+
+    CheckpointHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version          = CHECKPOINT_VERSION;
+    header.byte_order_mark  = BYTE_ORDER_MARK;
+    header.header_size      = sizeof(CheckpointHeader);
+    header.num_cells        = mesh.numCells();
+    header.num_graph_nodes  = state.num_graph_nodes;
+    header.graph_resolution = state.graph_resolution;
+    header.num_steps        = snapshot.num_steps;
+    header.simulation_size  = snapshot.simulation_size;
+    header.simulation_time  = snapshot.simulation_time;
+    header.density          = state.density;
+    header.viscosity        = state.viscosity;
+    header.speed_of_sound   = state.speed_of_sound;
+    header.edge_distance    = mesh.getEdgeDistance();
+
+    const BoundaryConditions& conditions = state.boundary_conditions;
+    for (int side = 0; side < NUM_DIRECTIONS; side++) {
+        header.boundary_types[side] = static_cast<int32_t>(conditions.sides[side].type);
+        storeCellState(conditions.sides[side].state, header.boundary_states[side]);
+    }
+    header.override_top_velocity = conditions.override_top_velocity;
+    storeCellState(conditions.top_velocity_override, header.top_velocity_override);
+    header.solver_mode              = static_cast<uint32_t>(state.solver_mode);
+    header.implicit_diffusion       = state.implicit_diffusion;
+    header.diffusion_implicitness   = state.diffusion_parameters.implicitness;
+    header.diffusion_tolerance      = state.diffusion_parameters.tolerance;
+    header.diffusion_max_iterations = state.diffusion_parameters.max_iterations;
+    layOutSections(header);
+
+    const void* sections[NUM_SECTIONS] = {mesh.getCellX().data(),
+                                          mesh.getCellY().data(),
+                                          mesh.getCellScale().data(),
+                                          mesh.getNeighbours(LEFT).data(),
+                                          mesh.getNeighbours(RIGHT).data(),
+                                          mesh.getNeighbours(TOP).data(),
+                                          mesh.getNeighbours(BOTTOM).data(),
+                                          mesh.getNodeIndices().data(),
+                                          snapshot.fields.pressure.data(),
+                                          snapshot.fields.velocity_x.data(),
+                                          snapshot.fields.velocity_y.data(),
+                                          snapshot.obstacle_cell_mask.data()};
+
+    // Write everything to a temporary file first, so the checkpoint at `path` is
+    // always either the old one or the complete new one
+    const std::string temporary_path = path + ".tmp";
+    {
+        std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            throw std::runtime_error("Could not open " + temporary_path);
+        }
+
+        const std::vector<char> padding(SECTION_ALIGNMENT, 0);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        uint64_t offset = sizeof(header);
+        for (int section = 0; section < NUM_SECTIONS; section++) {
+            file.write(padding.data(), header.section_offsets[section] - offset);
+            const uint64_t section_size =
+                header.num_cells * SECTION_ENTRY_SIZES[section];
+            file.write(static_cast<const char*>(sections[section]), section_size);
+            offset = header.section_offsets[section] + section_size;
+        }
+        file.write(padding.data(), header.file_size - offset);
+
+        file.close();
+        if (!file) {
+            throw std::runtime_error("Could not write " + temporary_path);
+        }
+    }
+    if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Could not move " + temporary_path + " to " + path);
+    }
+}
+
+MappedCheckpoint::MappedCheckpoint(const std::string& path)
+  : data(nullptr), size(0) {
+    const int file = open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        throw std::runtime_error("Could not open " + path);
+    }
+    struct stat file_status;
+    if (fstat(file, &file_status) != 0 ||
+        static_cast<size_t>(file_status.st_size) < sizeof(CheckpointHeader)) {
+        close(file);
+        throw std::runtime_error(path + " is not a checkpoint");
+    }
+    size = file_status.st_size;
+
+    // The file stays mapped after it is closed
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Could not map " + path);
+    }
+    data = static_cast<const unsigned char*>(mapping);
+
+    // Everything is checked here, so nothing read from the file later can be out of
+    // bounds
+    auto fail = [&](const std::string& reason) {
+        munmap(const_cast<unsigned char*>(data), size);
+        throw std::runtime_error(path + ": " + reason);
+    };
+    const CheckpointHeader& header = *reinterpret_cast<const CheckpointHeader*>(data);
+    if (std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0) {
+        fail("not a checkpoint");
+    }
+    if (header.byte_order_mark != BYTE_ORDER_MARK) {
+        fail("written with a different byte order");
+    }
+    if (header.version != CHECKPOINT_VERSION ||
+        header.header_size != sizeof(CheckpointHeader)) {
+        fail("unsupported checkpoint version " + std::to_string(header.version));
+    }
+
+    CheckpointHeader expected_layout = header;
+    layOutSections(expected_layout);
+    if (header.file_size != size || expected_layout.file_size != size ||
+        std::memcmp(header.section_offsets,
+                    expected_layout.section_offsets,
+                    sizeof(header.section_offsets)) != 0) {
+        fail("truncated or corrupt");
+    }
+
+    const int64_t num_cells = static_cast<int64_t>(numCells());
+    for (int direction = 0; direction < NUM_DIRECTIONS; direction++) {
+        const int32_t* neighbours = getNeighbours(static_cast<Direction>(direction));
+        for (int64_t i = 0; i < num_cells; i++) {
+            if (neighbours[i] < -1 || neighbours[i] >= num_cells) {
+                fail("neighbour index out of range");
+            }
+        }
+    }
+    const int32_t* node_indices = getNodeIndices();
+    for (int64_t i = 0; i < num_cells; i++) {
+        if (node_indices[i] < 0 ||
+            static_cast<uint64_t>(node_indices[i]) >= header.num_graph_nodes) {
+            fail("graph node index out of range");
+        }
+    }
+
+    const int32_t last_boundary_type = static_cast<int32_t>(BoundaryType::PERIODIC);
+    for (int side = 0; side < NUM_DIRECTIONS; side++) {
+        if (header.boundary_types[side] < 0 ||
+            header.boundary_types[side] > last_boundary_type) {
+            fail("unknown boundary condition");
+        }
+    }
+    try {
+        validateBoundaryConditions(getBoundaryConditions());
+    } catch (const std::invalid_argument& e) {
+        fail(e.what());
+    }
+    if (header.solver_mode > static_cast<uint32_t>(SolverMode::PROJECTION) ||
+        header.override_top_velocity > 1 || header.implicit_diffusion > 1 ||
+        !(header.diffusion_implicitness >= 0.5 && header.diffusion_implicitness <= 1)) {
+        fail("invalid solver settings");
+    }
+}
+
+MappedCheckpoint::~MappedCheckpoint() {
+    munmap(const_cast<unsigned char*>(data), size);
+}
+
+size_t MappedCheckpoint::numCells() const {
+    return reinterpret_cast<const CheckpointHeader*>(data)->num_cells;
+}
+
+size_t MappedCheckpoint::numGraphNodes() const {
+    return reinterpret_cast<const CheckpointHeader*>(data)->num_graph_nodes;
+}
+
+int MappedCheckpoint::getGraphResolution() const {
+    return static_cast<int>(
+        reinterpret_cast<const CheckpointHeader*>(data)->graph_resolution);
+}
+
+double MappedCheckpoint::getSimulationSize() const {
+    return reinterpret_cast<const CheckpointHeader*>(data)->simulation_size;
+}
+
+double MappedCheckpoint::getSimulationTime() const {
+    return reinterpret_cast<const CheckpointHeader*>(data)->simulation_time;
+}
+
+uint64_t MappedCheckpoint::getNumSteps() const {
+    return reinterpret_cast<const CheckpointHeader*>(data)->num_steps;
+}
+
+double MappedCheckpoint::getDensity() const {
+    return reinterpret_cast<const CheckpointHeader*>(data)->density;
+}
+
+double MappedCheckpoint::getViscosity() const {
+    return reinterpret_cast<const CheckpointHeader*>(data)->viscosity;
+}
+
+double MappedCheckpoint::getSpeedOfSound() const {
+    return reinterpret_cast<const CheckpointHeader*>(data)->speed_of_sound;
+}
+
+BoundaryConditions MappedCheckpoint::getBoundaryConditions() const {
+    const CheckpointHeader& header = *reinterpret_cast<const CheckpointHeader*>(data);
+    BoundaryConditions conditions;
+    for (int side = 0; side < NUM_DIRECTIONS; side++) {
+        conditions.sides[side].type =
+            static_cast<BoundaryType>(header.boundary_types[side]);
+        conditions.sides[side].state = loadCellState(header.boundary_states[side]);
+    }
+    conditions.override_top_velocity = header.override_top_velocity != 0;
+    conditions.top_velocity_override = loadCellState(header.top_velocity_override);
+    return conditions;
+}
+
+SolverMode MappedCheckpoint::getSolverMode() const {
+    return static_cast<SolverMode>(
+        reinterpret_cast<const CheckpointHeader*>(data)->solver_mode);
+}
+
+bool MappedCheckpoint::isImplicitDiffusionEnabled() const {
+    return reinterpret_cast<const CheckpointHeader*>(data)->implicit_diffusion != 0;
+}
+
+ImplicitDiffusionParameters MappedCheckpoint::getDiffusionParameters() const {
+    const CheckpointHeader& header = *reinterpret_cast<const CheckpointHeader*>(data);
+    ImplicitDiffusionParameters parameters;
+    parameters.implicitness   = header.diffusion_implicitness;
+    parameters.tolerance      = header.diffusion_tolerance;
+    parameters.max_iterations = static_cast<int>(header.diffusion_max_iterations);
+    return parameters;
+}
+
+double MappedCheckpoint::getEdgeDistance() const {
+    return reinterpret_cast<const CheckpointHeader*>(data)->edge_distance;
+}
+
+const double* MappedCheckpoint::getCellX() const {
+    return static_cast<const double*>(getSection(CELL_X));
+}
+
+const double* MappedCheckpoint::getCellY() const {
+    return static_cast<const double*>(getSection(CELL_Y));
+}
+
+const double* MappedCheckpoint::getCellScale() const {
+    return static_cast<const double*>(getSection(CELL_SCALE));
+}
+
+const int32_t* MappedCheckpoint::getNeighbours(Direction direction) const {
+    return static_cast<const int32_t*>(getSection(LEFT_NEIGHBOURS + direction));
+}
+
+const int32_t* MappedCheckpoint::getNodeIndices() const {
+    return static_cast<const int32_t*>(getSection(NODE_INDICES));
+}
+
+const double* MappedCheckpoint::getPressure() const {
+    return static_cast<const double*>(getSection(PRESSURE));
+}
+
+const double* MappedCheckpoint::getVelocityX() const {
+    return static_cast<const double*>(getSection(VELOCITY_X));
+}
+
+const double* MappedCheckpoint::getVelocityY() const {
+    return static_cast<const double*>(getSection(VELOCITY_Y));
+}
+
+const uint8_t* MappedCheckpoint::getObstacleCellMask() const {
+    return static_cast<const uint8_t*>(getSection(OBSTACLE_CELL_MASK));
+}
+
+const void* MappedCheckpoint::getSection(int section) const {
+    return data +
+           reinterpret_cast<const CheckpointHeader*>(data)->section_offsets[section];
+}
+
+CheckpointWriter::CheckpointWriter()
+  : num_writing(0),
+    num_written(0),
+    stopping(false),
+    thread(&CheckpointWriter::run, this) {}
+
+CheckpointWriter::~CheckpointWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    queued.notify_one();
+    thread.join();
+}
+
+void CheckpointWriter::write(std::string path, CheckpointState state) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.emplace_back(std::move(path), std::move(state));
+    }
+    queued.notify_one();
+}
+
+void CheckpointWriter::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    written.wait(lock, [&]() { return queue.empty() && num_writing == 0; });
+    if (error) {
+        std::exception_ptr last_error = error;
+        error                         = nullptr;
+        std::rethrow_exception(last_error);
+    }
+}
+
+size_t CheckpointWriter::getNumPending() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return queue.size() + num_writing;
+}
+
+uint64_t CheckpointWriter::getNumWritten() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return num_written;
+}
+
+void CheckpointWriter::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        queued.wait(lock, [&]() { return stopping || !queue.empty(); });
+        if (queue.empty()) {
+            return;
+        }
+
+        std::pair<std::string, CheckpointState> checkpoint = std::move(queue.front());
+        queue.pop_front();
+        num_writing++;
+
+        // Don't hold the lock while writing, so more checkpoints can be queued
+        lock.unlock();
+        std::exception_ptr write_error;
+        try {
+            writeCheckpoint(checkpoint.first, checkpoint.second);
+        } catch (...) {
+            write_error = std::current_exception();
+        }
+        lock.lock();
+
+        num_writing--;
+        if (write_error) {
+            error = error ? error : write_error;
+        } else {
+            num_written++;
+        }
+        written.notify_all();
+    }
+}
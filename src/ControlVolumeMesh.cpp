@@ -0,0 +1,278 @@
+#include "ControlVolumeMesh.h"
+
+// STD Includes
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <unordered_map>
+#include <utility>
+
+using namespace units::pressure;
+using namespace units::velocity;
+
+ControlVolumeMesh::ControlVolumeMesh(GraphNode<ControlVolume>& graph)
+  : nodes(graph.getAllSubNodes()),
+    node_indices(nodes.size()),
+    edge_distance(graph.getScale() / graph.getResolution()),
+    one_cell_per_node(true) {
+    const size_t num_cells = nodes.size();
+    std::iota(node_indices.begin(), node_indices.end(), 0);
+
+    std::unordered_map<RealNode<ControlVolume>*, int> cell_indices;
+    cell_indices.reserve(num_cells);
+    for (size_t i = 0; i < num_cells; i++) {
+        cell_indices[nodes[i].get()] = static_cast<int>(i);
+    }
+
+    cell_x.resize(num_cells);
+    cell_y.resize(num_cells);
+    cell_scale.resize(num_cells);
+    for (int direction = 0; direction < NUM_DIRECTIONS; direction++) {
+        neighbours[direction].resize(num_cells);
+    }
+
+    for (size_t i = 0; i < num_cells; i++) {
+        RealNode<ControlVolume>& node = *nodes[i];
+        cell_x[i]                     = node.getCoordinates().x;
+        cell_y[i]                     = node.getCoordinates().y;
+        cell_scale[i]                 = node.getScale();
+
+        std::array<std::shared_ptr<RealNode<ControlVolume>>, NUM_DIRECTIONS>
+            neighbour_ptrs;
+        neighbour_ptrs[LEFT]   = node.getLeftNeighbour();
+        neighbour_ptrs[RIGHT]  = node.getRightNeighbour();
+        neighbour_ptrs[TOP]    = node.getTopNeighbour();
+        neighbour_ptrs[BOTTOM] = node.getBottomNeighbour();
+
+        for (int direction = 0; direction < NUM_DIRECTIONS; direction++) {
+            const std::shared_ptr<RealNode<ControlVolume>>& neighbour_ptr =
+                neighbour_ptrs[direction];
+            neighbours[direction][i] = neighbour_ptr
+                                           ? cell_indices.at(neighbour_ptr.get())
+                                           : NO_NEIGHBOUR;
+        }
+    }
+
+    node_pointers.resize(num_cells);
+    for (size_t i = 0; i < num_cells; i++) {
+        node_pointers[i] = nodes[i].get();
+    }
+    buildStencilTables();
+}
+
+ControlVolumeMesh::ControlVolumeMesh(
+    const std::vector<std::shared_ptr<RealNode<ControlVolume>>>& graph_nodes,
+    std::vector<int> node_indices,
+    std::vector<double> cell_x,
+    std::vector<double> cell_y,
+    std::vector<double> cell_scale,
+    std::array<std::vector<int>, NUM_DIRECTIONS> neighbours,
+    double edge_distance)
+  : node_indices(std::move(node_indices)),
+    neighbours(std::move(neighbours)),
+    edge_distance(edge_distance),
+    one_cell_per_node(true),
+    cell_x(std::move(cell_x)),
+    cell_y(std::move(cell_y)),
+    cell_scale(std::move(cell_scale)) {
+    // The graph nodes may not be given, so the number of them is found from the cells
+    int num_graph_nodes = 0;
+    for (const int node_index : this->node_indices) {
+        num_graph_nodes = std::max(num_graph_nodes, node_index + 1);
+    }
+    std::vector<uint8_t> node_used(num_graph_nodes, 0);
+    for (const int node_index : this->node_indices) {
+        one_cell_per_node     = one_cell_per_node && !node_used[node_index];
+        node_used[node_index] = 1;
+    }
+
+    if (!graph_nodes.empty()) {
+        assignNodes(graph_nodes);
+    }
+    buildStencilTables();
+}
+
+std::shared_ptr<const ControlVolumeMesh> ControlVolumeMesh::withGraphNodes(
+    const std::vector<std::shared_ptr<RealNode<ControlVolume>>>& graph_nodes) const {
+    auto mesh = std::make_shared<ControlVolumeMesh>(*this);
+    mesh->assignNodes(graph_nodes);
+    return mesh;
+}
+
+void ControlVolumeMesh::assignNodes(
+    const std::vector<std::shared_ptr<RealNode<ControlVolume>>>& graph_nodes) {
+    const size_t num_cells = node_indices.size();
+    nodes.resize(num_cells);
+    node_pointers.resize(num_cells);
+    for (size_t i = 0; i < num_cells; i++) {
+        nodes[i]         = graph_nodes[node_indices[i]];
+        node_pointers[i] = nodes[i].get();
+    }
+}
+
+void ControlVolumeMesh::buildStencilTables() {
+    const size_t num_cells = node_indices.size();
+    for (int direction = 0; direction < NUM_DIRECTIONS; direction++) {
+        neighbour_distances[direction].resize(num_cells);
+    }
+
+    for (size_t i = 0; i < num_cells; i++) {
+        for (int direction = 0; direction < NUM_DIRECTIONS; direction++) {
+            const int neighbour = neighbours[direction][i];
+            if (neighbour == NO_NEIGHBOUR) {
+                neighbour_distances[direction][i] = edge_distance;
+                continue;
+            }
+
+            // Left/right neighbours are displaced in x, top/bottom neighbours in y
+            if (direction == LEFT || direction == RIGHT) {
+                neighbour_distances[direction][i] =
+                    std::abs(cell_x[neighbour] - cell_x[i]);
+            } else {
+                neighbour_distances[direction][i] =
+                    std::abs(cell_y[neighbour] - cell_y[i]);
+            }
+        }
+    }
+
+    // Split the cells into those that can use the uniform stencil and those that can't
+    for (size_t i = 0; i < num_cells; i++) {
+        bool is_edge    = false;
+        bool is_uniform = true;
+        for (int direction = 0; direction < NUM_DIRECTIONS; direction++) {
+            const int neighbour = neighbours[direction][i];
+            is_edge             = is_edge || neighbour == NO_NEIGHBOUR;
+            is_uniform          = is_uniform && neighbour != NO_NEIGHBOUR &&
+                         cell_scale[neighbour] == cell_scale[i];
+        }
+
+        if (!is_uniform) {
+            general_cells.emplace_back(i);
+            if (is_edge) {
+                edge_cells.emplace_back(i);
+            } else {
+                resolution_change_cells.emplace_back(i);
+            }
+            continue;
+        }
+        uniform_cells.cells.emplace_back(i);
+        for (int direction = 0; direction < NUM_DIRECTIONS; direction++) {
+            uniform_cells.neighbours[direction].emplace_back(neighbours[direction][i]);
+            uniform_cells.distances[direction].emplace_back(
+                neighbour_distances[direction][i]);
+        }
+    }
+}
+
+void ControlVolumeMesh::gatherFields(ControlVolumeFields& fields) const {
+    fields.resize(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        ControlVolume& control_volume = nodes[i]->containedValue();
+        Velocity2d velocity           = control_volume.getVelocity();
+        fields.pressure[i]            = control_volume.getPressure().to<double>();
+        fields.velocity_x[i]          = velocity.x.to<double>();
+        fields.velocity_y[i]          = velocity.y.to<double>();
+    }
+}
+
+void ControlVolumeMesh::scatterFields(const ControlVolumeFields& fields) const {
+    if (!one_cell_per_node) {
+        scatterAveragedFields(fields);
+        return;
+    }
+
+    for (size_t i = 0; i < nodes.size(); i++) {
+        ControlVolume& control_volume = nodes[i]->containedValue();
+        control_volume.setPressure(pascal_t(fields.pressure[i]));
+        control_volume.setVelocity({meters_per_second_t(fields.velocity_x[i]),
+                                    meters_per_second_t(fields.velocity_y[i])});
+    }
+}
+
+void ControlVolumeMesh::gatherChangedFields(ControlVolumeFields& fields) const {
+    if (one_cell_per_node) {
+        gatherFields(fields);
+        return;
+    }
+
+    std::vector<RealNode<ControlVolume>*> averaged_nodes;
+    std::vector<int> cell_nodes;
+    ControlVolumeFields node_fields;
+    averageNodeFields(fields, averaged_nodes, cell_nodes, node_fields);
+
+    // The mean is computed exactly as `scatterFields` computed it, so a node that
+    // hasn't been changed since matches it exactly
+    std::vector<uint8_t> node_changed(averaged_nodes.size());
+    for (size_t n = 0; n < averaged_nodes.size(); n++) {
+        ControlVolume& control_volume = averaged_nodes[n]->containedValue();
+        Velocity2d velocity           = control_volume.getVelocity();
+        node_changed[n] =
+            control_volume.getPressure().to<double>() != node_fields.pressure[n] ||
+            velocity.x.to<double>() != node_fields.velocity_x[n] ||
+            velocity.y.to<double>() != node_fields.velocity_y[n];
+    }
+
+    for (size_t i = 0; i < nodes.size(); i++) {
+        const int n = cell_nodes[i];
+        if (!node_changed[n]) {
+            continue;
+        }
+        ControlVolume& control_volume = averaged_nodes[n]->containedValue();
+        Velocity2d velocity           = control_volume.getVelocity();
+        fields.pressure[i]            = control_volume.getPressure().to<double>();
+        fields.velocity_x[i]          = velocity.x.to<double>();
+        fields.velocity_y[i]          = velocity.y.to<double>();
+    }
+}
+
+void ControlVolumeMesh::averageNodeFields(
+    const ControlVolumeFields& fields,
+    std::vector<RealNode<ControlVolume>*>& averaged_nodes,
+    std::vector<int>& cell_nodes,
+    ControlVolumeFields& node_fields) const {
+    // The area of, and area-weighted sum of the fields over, the cells in each node
+    std::unordered_map<RealNode<ControlVolume>*, int> node_indices;
+    std::vector<double> node_areas;
+    averaged_nodes.clear();
+    cell_nodes.resize(nodes.size());
+    node_fields.resize(0);
+    for (size_t i = 0; i < nodes.size(); i++) {
+        auto inserted = node_indices.emplace(nodes[i].get(), averaged_nodes.size());
+        if (inserted.second) {
+            averaged_nodes.push_back(nodes[i].get());
+            node_areas.push_back(0);
+            node_fields.pressure.push_back(0);
+            node_fields.velocity_x.push_back(0);
+            node_fields.velocity_y.push_back(0);
+        }
+        const int n       = inserted.first->second;
+        const double area = cell_scale[i] * cell_scale[i];
+        cell_nodes[i]     = n;
+
+        node_areas[n] += area;
+        node_fields.pressure[n] += area * fields.pressure[i];
+        node_fields.velocity_x[n] += area * fields.velocity_x[i];
+        node_fields.velocity_y[n] += area * fields.velocity_y[i];
+    }
+
+    for (size_t n = 0; n < averaged_nodes.size(); n++) {
+        node_fields.pressure[n] /= node_areas[n];
+        node_fields.velocity_x[n] /= node_areas[n];
+        node_fields.velocity_y[n] /= node_areas[n];
+    }
+}
+
+void ControlVolumeMesh::scatterAveragedFields(const ControlVolumeFields& fields) const {
+    std::vector<RealNode<ControlVolume>*> averaged_nodes;
+    std::vector<int> cell_nodes;
+    ControlVolumeFields node_fields;
+    averageNodeFields(fields, averaged_nodes, cell_nodes, node_fields);
+
+    for (size_t n = 0; n < averaged_nodes.size(); n++) {
+        ControlVolume& control_volume = averaged_nodes[n]->containedValue();
+        control_volume.setPressure(pascal_t(node_fields.pressure[n]));
+        control_volume.setVelocity({meters_per_second_t(node_fields.velocity_x[n]),
+                                    meters_per_second_t(node_fields.velocity_y[n])});
+    }
+}
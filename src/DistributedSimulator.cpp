@@ -0,0 +1,395 @@
+#include "DistributedSimulator.h"
+
+// STD Includes
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+// Project Includes
+#include "BoundaryConditions.h"
+#include "FieldSnapshot.h"
+#include "MeshPartition.h"
+
+using namespace units::time;
+
+namespace {
+
+// The tag of every halo message
+constexpr int HALO_TAG = 0;
+
+/**
+ * Send a vector from the root rank to every other rank
+ *
+ * @tparam T the type of the values in the vector
+ *
+ * @param values the vector to send on the root rank, set to the vector sent on the
+ * others
+ * @param type the MPI type matching `T`
+ * @param root the rank to send from
+ * @param communicator the ranks to send to
+ */
+template <typename T>
+void broadcastVector(std::vector<T>& values,
+                     MPI_Datatype type,
+                     int root,
+                     MPI_Comm communicator) {
+    uint64_t size = values.size();
+    MPI_Bcast(&size, 1, MPI_UINT64_T, root, communicator);
+    values.resize(size);
+    MPI_Bcast(values.data(), static_cast<int>(size), type, root, communicator);
+}
+
+}  // namespace
+
+DistributedSimulator::DistributedSimulator(MPI_Comm communicator,
+                                           FluidSimulator* simulator,
+                                           int root)
+  : communicator(communicator), root(root), num_owned_cells(0), simulation_time(0) {
+    int rank      = 0;
+    int num_ranks = 0;
+    MPI_Comm_rank(communicator, &rank);
+    MPI_Comm_size(communicator, &num_ranks);
+
+    // Check the simulator on the root, then make every rank fail together
+    std::string error;
+    if (rank == root) {
+        if (!simulator) {
+            error = "The root rank must hold a simulator";
+        } else if (simulator->getSolverMode() == SolverMode::PROJECTION) {
+            error = "Distributed simulation is only available in "
+                    "SLIGHTLY_COMPRESSIBLE mode";
+        } else if (simulator->isImplicitDiffusionEnabled()) {
+            error = "Distributed simulation isn't available with implicit diffusion";
+        } else if (!hasFixedEdgeStates(simulator->getBoundaryConditions())) {
+            error = "Distributed simulation only supports INFLOW boundaries";
+        }
+    }
+    std::vector<char> error_message(error.begin(), error.end());
+    broadcastVector(error_message, MPI_CHAR, root, communicator);
+    if (!error_message.empty()) {
+        throw std::runtime_error(
+            std::string(error_message.begin(), error_message.end()));
+    }
+
+    // The whole mesh is sent to every rank while setting up, and each rank only keeps
+    // the cells it owns or reads
+    std::array<double, 3> fluid_properties = {0, 0, 0};
+    std::array<std::vector<int>, NUM_DIRECTIONS> global_neighbours;
+    std::array<std::vector<double>, NUM_DIRECTIONS> global_distances;
+    std::vector<int> parts;
+    std::vector<uint8_t> obstacle_cell_mask;
+    ControlVolumeFields global_fields;
+    if (rank == root) {
+        FieldSnapshot snapshot;
+        simulator->takeSnapshot(snapshot);
+        const ControlVolumeMesh& mesh = *snapshot.mesh;
+
+        fluid_properties = {simulator->getDensity().to<double>(),
+                            simulator->getViscosity().to<double>(),
+                            simulator->getSpeedOfSound().to<double>()};
+        edges            = toEdgeStates(simulator->getBoundaryConditions());
+        for (int direction = 0; direction < NUM_DIRECTIONS; direction++) {
+            const Direction side         = static_cast<Direction>(direction);
+            global_neighbours[direction] = mesh.getNeighbours(side);
+            global_distances[direction]  = mesh.getNeighbourDistances(side);
+        }
+        // Every cell costs one update per step
+        parts = partitionMesh(
+            mesh, num_ranks, std::vector<double>(mesh.numCells(), 1.0));
+        obstacle_cell_mask = std::move(snapshot.obstacle_cell_mask);
+        global_fields      = std::move(snapshot.fields);
+        simulation_time    = snapshot.simulation_time;
+    }
+    MPI_Bcast(fluid_properties.data(), 3, MPI_DOUBLE, root, communicator);
+    MPI_Bcast(&edges, sizeof(edges), MPI_BYTE, root, communicator);
+    MPI_Bcast(&simulation_time, 1, MPI_DOUBLE, root, communicator);
+    for (int direction = 0; direction < NUM_DIRECTIONS; direction++) {
+        broadcastVector(global_neighbours[direction], MPI_INT, root, communicator);
+        broadcastVector(global_distances[direction], MPI_DOUBLE, root, communicator);
+    }
+    broadcastVector(parts, MPI_INT, root, communicator);
+    broadcastVector(obstacle_cell_mask, MPI_UINT8_T, root, communicator);
+    broadcastVector(global_fields.pressure, MPI_DOUBLE, root, communicator);
+    broadcastVector(global_fields.velocity_x, MPI_DOUBLE, root, communicator);
+    broadcastVector(global_fields.velocity_y, MPI_DOUBLE, root, communicator);
+    fluid = FluidCoefficients(
+        fluid_properties[0], fluid_properties[1], fluid_properties[2]);
+
+    // The cells this rank owns, then the cells of other ranks they read, grouped by
+    // owner
+    num_global_cells = parts.size();
+    std::vector<int> halo;
+    for (size_t i = 0; i < num_global_cells; i++) {
+        if (parts[i] != rank) {
+            continue;
+        }
+        cells.emplace_back(i);
+        for (int direction = 0; direction < NUM_DIRECTIONS; direction++) {
+            const int neighbour = global_neighbours[direction][i];
+            if (neighbour != ControlVolumeMesh::NO_NEIGHBOUR &&
+                parts[neighbour] != rank) {
+                halo.emplace_back(neighbour);
+            }
+        }
+    }
+    std::sort(halo.begin(), halo.end(), [&](int a, int b) {
+        return std::make_pair(parts[a], a) < std::make_pair(parts[b], b);
+    });
+    halo.erase(std::unique(halo.begin(), halo.end()), halo.end());
+    num_owned_cells = cells.size();
+    cells.insert(cells.end(), halo.begin(), halo.end());
+
+    std::vector<int> local_index(num_global_cells, -1);
+    for (size_t k = 0; k < cells.size(); k++) {
+        local_index[cells[k]] = static_cast<int>(k);
+    }
+
+    // The halo of every other rank holds the owned cells it's cells read, in order
+    std::map<int, HaloExchange> rank_exchanges;
+    for (size_t k = num_owned_cells; k < cells.size(); k++) {
+        HaloExchange& exchange = rank_exchanges[parts[cells[k]]];
+        if (exchange.num_receive_cells++ == 0) {
+            exchange.receive_begin = k;
+        }
+    }
+    std::map<int, std::vector<int>> sent_cells;
+    for (size_t i = 0; i < num_global_cells; i++) {
+        if (parts[i] == rank) {
+            continue;
+        }
+        for (int direction = 0; direction < NUM_DIRECTIONS; direction++) {
+            const int neighbour = global_neighbours[direction][i];
+            if (neighbour != ControlVolumeMesh::NO_NEIGHBOUR &&
+                parts[neighbour] == rank) {
+                sent_cells[parts[i]].emplace_back(neighbour);
+            }
+        }
+    }
+    for (auto& [other_rank, sent] : sent_cells) {
+        std::sort(sent.begin(), sent.end());
+        sent.erase(std::unique(sent.begin(), sent.end()), sent.end());
+        HaloExchange& exchange = rank_exchanges[other_rank];
+        for (const int cell : sent) {
+            exchange.send_cells.emplace_back(local_index[cell]);
+        }
+    }
+    for (auto& [other_rank, exchange] : rank_exchanges) {
+        exchange.rank = other_rank;
+        send_buffers.emplace_back(3 * exchange.send_cells.size());
+        receive_buffers.emplace_back(3 * exchange.num_receive_cells);
+        exchanges.emplace_back(std::move(exchange));
+    }
+
+    // The neighbours of every owned cell, with missing neighbours read from the edge
+    // states just past the halo
+    const int num_local     = static_cast<int>(cells.size());
+    const int num_owned     = static_cast<int>(num_owned_cells);
+    const int override_slot = num_local + NUM_DIRECTIONS;
+    for (int k = 0; k < num_owned; k++) {
+        const int i     = cells[k];
+        bool reads_halo = false;
+        for (int direction = 0; direction < NUM_DIRECTIONS; direction++) {
+            const int neighbour = global_neighbours[direction][i];
+            const int local     = neighbour == ControlVolumeMesh::NO_NEIGHBOUR
+                                      ? num_local + direction
+                                      : local_index[neighbour];
+            neighbours[direction].emplace_back(local);
+            distances[direction].emplace_back(global_distances[direction][i]);
+            reads_halo |= local >= num_owned && local < num_local;
+        }
+        const bool has_top =
+            global_neighbours[TOP][i] != ControlVolumeMesh::NO_NEIGHBOUR;
+        top_velocity_neighbours.emplace_back(has_top && edges.override_top_velocity
+                                                 ? override_slot
+                                                 : neighbours[TOP].back());
+
+        (reads_halo ? halo_boundary_cells : interior_cells).emplace_back(k);
+        if (obstacle_cell_mask[i]) {
+            obstacle_cells.emplace_back(k);
+        }
+    }
+
+    // The edge states never change, so are written into both buffers once
+    const std::array<CellState, NUM_DIRECTIONS + 1> edge_states = {
+        edges.left, edges.right, edges.top, edges.bottom, edges.top_velocity_override};
+    for (ControlVolumeFields* fields : {&current_fields, &next_fields}) {
+        fields->resize(cells.size() + edge_states.size());
+        for (size_t slot = 0; slot < edge_states.size(); slot++) {
+            fields->pressure[num_local + slot]   = edge_states[slot].pressure;
+            fields->velocity_x[num_local + slot] = edge_states[slot].velocity_x;
+            fields->velocity_y[num_local + slot] = edge_states[slot].velocity_y;
+        }
+    }
+    for (size_t k = 0; k < cells.size(); k++) {
+        current_fields.pressure[k]   = global_fields.pressure[cells[k]];
+        current_fields.velocity_x[k] = global_fields.velocity_x[cells[k]];
+        current_fields.velocity_y[k] = global_fields.velocity_y[cells[k]];
+    }
+}
+
+void DistributedSimulator::updateControlVolumes(second_t dt) {
+    const double step_dt = dt.to<double>();
+
+    // Start the halo exchange...
+    std::vector<MPI_Request> receive_requests;
+    std::vector<MPI_Request> send_requests;
+    for (size_t x = 0; x < exchanges.size(); x++) {
+        const HaloExchange& exchange = exchanges[x];
+        if (exchange.num_receive_cells > 0) {
+            MPI_Irecv(receive_buffers[x].data(),
+                      static_cast<int>(receive_buffers[x].size()),
+                      MPI_DOUBLE,
+                      exchange.rank,
+                      HALO_TAG,
+                      communicator,
+                      &receive_requests.emplace_back());
+        }
+    }
+    for (size_t x = 0; x < exchanges.size(); x++) {
+        const HaloExchange& exchange = exchanges[x];
+        if (exchange.send_cells.empty()) {
+            continue;
+        }
+        std::vector<double>& buffer = send_buffers[x];
+        for (size_t n = 0; n < exchange.send_cells.size(); n++) {
+            const int k       = exchange.send_cells[n];
+            buffer[3 * n]     = current_fields.pressure[k];
+            buffer[3 * n + 1] = current_fields.velocity_x[k];
+            buffer[3 * n + 2] = current_fields.velocity_y[k];
+        }
+        MPI_Isend(buffer.data(),
+                  static_cast<int>(buffer.size()),
+                  MPI_DOUBLE,
+                  exchange.rank,
+                  HALO_TAG,
+                  communicator,
+                  &send_requests.emplace_back());
+    }
+
+    // ...update the cells that don't need it while it is in flight...
+    updateCells(interior_cells, step_dt);
+
+    // ...then the rest once it has arrived
+    MPI_Waitall(static_cast<int>(receive_requests.size()),
+                receive_requests.data(),
+                MPI_STATUSES_IGNORE);
+    for (size_t x = 0; x < exchanges.size(); x++) {
+        const HaloExchange& exchange      = exchanges[x];
+        const std::vector<double>& buffer = receive_buffers[x];
+        for (size_t n = 0; n < exchange.num_receive_cells; n++) {
+            const size_t k               = exchange.receive_begin + n;
+            current_fields.pressure[k]   = buffer[3 * n];
+            current_fields.velocity_x[k] = buffer[3 * n + 1];
+            current_fields.velocity_y[k] = buffer[3 * n + 2];
+        }
+    }
+    updateCells(halo_boundary_cells, step_dt);
+    MPI_Waitall(static_cast<int>(send_requests.size()),
+                send_requests.data(),
+                MPI_STATUSES_IGNORE);
+
+    // As `FluidSimulator::commitNextFields` does after every step
+    for (const int k : obstacle_cells) {
+        next_fields.pressure[k]   = 0;
+        next_fields.velocity_x[k] = 0;
+        next_fields.velocity_y[k] = 0;
+    }
+    std::swap(current_fields, next_fields);
+    simulation_time += step_dt;
+}
+
+void DistributedSimulator::gatherFields(ControlVolumeFields& fields) const {
+    int rank      = 0;
+    int num_ranks = 0;
+    MPI_Comm_rank(communicator, &rank);
+    MPI_Comm_size(communicator, &num_ranks);
+
+    const int num_owned = static_cast<int>(num_owned_cells);
+    std::vector<double> values(3 * num_owned_cells);
+    for (size_t k = 0; k < num_owned_cells; k++) {
+        values[3 * k]     = current_fields.pressure[k];
+        values[3 * k + 1] = current_fields.velocity_x[k];
+        values[3 * k + 2] = current_fields.velocity_y[k];
+    }
+
+    std::vector<int> counts(num_ranks);
+    MPI_Gather(&num_owned, 1, MPI_INT, counts.data(), 1, MPI_INT, root, communicator);
+    std::vector<int> offsets(num_ranks, 0);
+    std::vector<int> value_counts(num_ranks);
+    std::vector<int> value_offsets(num_ranks);
+    for (int r = 0; r < num_ranks; r++) {
+        if (r > 0) {
+            offsets[r] = offsets[r - 1] + counts[r - 1];
+        }
+        value_counts[r]  = 3 * counts[r];
+        value_offsets[r] = 3 * offsets[r];
+    }
+
+    std::vector<int> all_cells(rank == root ? num_global_cells : 0);
+    std::vector<double> all_values(3 * all_cells.size());
+    MPI_Gatherv(cells.data(),
+                num_owned,
+                MPI_INT,
+                all_cells.data(),
+                counts.data(),
+                offsets.data(),
+                MPI_INT,
+                root,
+                communicator);
+    MPI_Gatherv(values.data(),
+                3 * num_owned,
+                MPI_DOUBLE,
+                all_values.data(),
+                value_counts.data(),
+                value_offsets.data(),
+                MPI_DOUBLE,
+                root,
+                communicator);
+
+    if (rank != root) {
+        return;
+    }
+    fields.resize(num_global_cells);
+    for (size_t n = 0; n < all_cells.size(); n++) {
+        const int i          = all_cells[n];
+        fields.pressure[i]   = all_values[3 * n];
+        fields.velocity_x[i] = all_values[3 * n + 1];
+        fields.velocity_y[i] = all_values[3 * n + 2];
+    }
+}
+
+second_t DistributedSimulator::getSimulationTime() const {
+    return second_t(simulation_time);
+}
+
+void DistributedSimulator::updateCells(const std::vector<int>& updated_cells,
+                                       double dt) {
+    auto state = [](const ControlVolumeFields& fields, int k) -> CellState {
+        return {fields.pressure[k], fields.velocity_x[k], fields.velocity_y[k]};
+    };
+    const ControlVolumeFields& in = current_fields;
+    ControlVolumeFields& out      = next_fields;
+
+    for (const int k : updated_cells) {
+        const int top             = neighbours[TOP][k];
+        const int top_velocity    = top_velocity_neighbours[k];
+        const CellState top_state = {
+            in.pressure[top], in.velocity_x[top_velocity], in.velocity_y[top_velocity]};
+        const CellState updated = updateCellState(state(in, k),
+                                                  state(in, neighbours[LEFT][k]),
+                                                  distances[LEFT][k],
+                                                  state(in, neighbours[RIGHT][k]),
+                                                  distances[RIGHT][k],
+                                                  top_state,
+                                                  distances[TOP][k],
+                                                  state(in, neighbours[BOTTOM][k]),
+                                                  distances[BOTTOM][k],
+                                                  dt,
+                                                  fluid);
+        out.pressure[k]   = updated.pressure;
+        out.velocity_x[k] = updated.velocity_x;
+        out.velocity_y[k] = updated.velocity_y;
+    }
+}
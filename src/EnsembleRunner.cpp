@@ -0,0 +1,203 @@
+#include "EnsembleRunner.h"
+
+// STD Includes
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+// Project Includes
+#include "ControlVolumeKernel.h"
+#include "ScalarStencilKernel.h"
+
+EnsembleRunner::EnsembleRunner(units::length::meter_t simulation_size,
+                               int simulation_resolution,
+                               int num_threads)
+  : graph(std::make_shared<GraphNode<ControlVolume>>(simulation_resolution,
+                                                     simulation_size.to<double>())),
+    mesh(std::make_shared<const ControlVolumeMesh>(*graph)),
+    thread_pool(num_threads),
+    simd_level(getBestSimdLevel()) {}
+
+size_t EnsembleRunner::addMember(EnsembleMember member) {
+    MemberState state;
+    state.current_fields.resize(mesh->numCells());
+    state.next_fields.resize(mesh->numCells());
+    state.num_steps       = 0;
+    state.simulation_time = 0;
+    state.wall_time       = 0;
+
+    const std::vector<std::shared_ptr<RealNode<ControlVolume>>>& nodes =
+        mesh->getNodes();
+    state.obstacle_cell_mask.assign(mesh->numCells(), 0);
+    for (size_t i = 0; i < nodes.size(); i++) {
+        for (auto& obstacle : member.obstacles) {
+            if (obstacle->overlapsNode(*nodes[i])) {
+                state.obstacle_cell_mask[i] = 1;
+                state.obstacle_cells.emplace_back(i);
+                break;
+            }
+        }
+    }
+
+    state.parameters = std::move(member);
+    members.emplace_back(std::move(state));
+    return members.size() - 1;
+}
+
+size_t EnsembleRunner::numMembers() const {
+    return members.size();
+}
+
+std::shared_ptr<const ControlVolumeMesh> EnsembleRunner::getMesh() const {
+    return mesh;
+}
+
+ControlVolumeFields& EnsembleRunner::getMemberFields(size_t member) {
+    return members.at(member).current_fields;
+}
+
+const std::vector<uint8_t>& EnsembleRunner::getObstacleCellMask(size_t member) const {
+    return members.at(member).obstacle_cell_mask;
+}
+
+void EnsembleRunner::setSimdLevel(SimdLevel simd_level) {
+    if (!isSimdLevelSupported(simd_level)) {
+        throw std::invalid_argument("SIMD level not supported by this CPU");
+    }
+    this->simd_level = simd_level;
+}
+
+void EnsembleRunner::run(units::time::second_t dt, long num_steps) {
+    // Each member is run start to finish on one thread, so it's fields stay in that
+    // core's cache between steps
+    thread_pool.parallelFor(members.size(), [&](size_t begin, size_t end) {
+        for (size_t m = begin; m < end; m++) {
+            MemberState& member   = members[m];
+            const auto start_time = std::chrono::steady_clock::now();
+            for (long step = 0; step < num_steps; step++) {
+                stepMember(member, dt.to<double>());
+            }
+            member.wall_time += std::chrono::duration<double>(
+                                    std::chrono::steady_clock::now() - start_time)
+                                    .count();
+        }
+    });
+}
+
+void EnsembleRunner::stepMember(MemberState& member, double dt) const {
+    const EnsembleMember& parameters = member.parameters;
+    const FluidCoefficients fluid(
+        parameters.density, parameters.viscosity, parameters.speed_of_sound);
+    StencilEdgeStates<double> edges = legacyEdgeStates<double>();
+    edges.left.velocity_x           = parameters.inlet_speed;
+
+    // This is `FluidSimulator::computeNextFields`, with every group of cells run on
+    // this thread
+    const std::vector<int>& edge_cells = mesh->getEdgeCells();
+    updateScalarCells<double, false, true>(*mesh,
+                                           edge_cells,
+                                           0,
+                                           edge_cells.size(),
+                                           member.current_fields,
+                                           edges,
+                                           dt,
+                                           fluid,
+                                           member.next_fields);
+    const std::vector<int>& resolution_change_cells = mesh->getResolutionChangeCells();
+    updateScalarCells<double, false, false>(*mesh,
+                                            resolution_change_cells,
+                                            0,
+                                            resolution_change_cells.size(),
+                                            member.current_fields,
+                                            edges,
+                                            dt,
+                                            fluid,
+                                            member.next_fields);
+    const UniformStencilCells& uniform_cells = mesh->getUniformCells();
+    updateUniformCells(simd_level,
+                       uniform_cells,
+                       0,
+                       uniform_cells.size(),
+                       member.current_fields,
+                       &edges.top_velocity_override,
+                       dt,
+                       fluid,
+                       member.next_fields);
+
+    std::swap(member.current_fields, member.next_fields);
+    for (const int i : member.obstacle_cells) {
+        member.current_fields.pressure[i]   = 0;
+        member.current_fields.velocity_x[i] = 0;
+        member.current_fields.velocity_y[i] = 0;
+    }
+
+    member.num_steps++;
+    member.simulation_time += dt;
+}
+
+std::vector<EnsembleMemberSummary> EnsembleRunner::getSummaries() const {
+    std::vector<EnsembleMemberSummary> summaries;
+    summaries.reserve(members.size());
+    for (const MemberState& member : members) {
+        summaries.emplace_back(summariseMember(member));
+    }
+    return summaries;
+}
+
+void EnsembleRunner::writeSummaries(std::ostream& output) const {
+    output << "name,density,viscosity,speed_of_sound,inlet_speed,obstacle_cells,"
+              "steps,simulation_time,max_speed,mean_speed,min_pressure,"
+              "max_pressure,finite,wall_time\n";
+    for (const EnsembleMemberSummary& summary : getSummaries()) {
+        output << summary.name << "," << summary.density << "," << summary.viscosity
+               << "," << summary.speed_of_sound << "," << summary.inlet_speed << ","
+               << summary.num_obstacle_cells << "," << summary.num_steps << ","
+               << summary.simulation_time << "," << summary.max_speed << ","
+               << summary.mean_speed << "," << summary.min_pressure << ","
+               << summary.max_pressure << "," << summary.finite << ","
+               << summary.wall_time << "\n";
+    }
+}
+
+EnsembleMemberSummary EnsembleRunner::summariseMember(const MemberState& member) {
+    EnsembleMemberSummary summary;
+    summary.name               = member.parameters.name;
+    summary.density            = member.parameters.density;
+    summary.viscosity          = member.parameters.viscosity;
+    summary.speed_of_sound     = member.parameters.speed_of_sound;
+    summary.inlet_speed        = member.parameters.inlet_speed;
+    summary.num_obstacle_cells = member.obstacle_cells.size();
+    summary.num_steps          = member.num_steps;
+    summary.simulation_time    = member.simulation_time;
+    summary.wall_time          = member.wall_time;
+
+    const ControlVolumeFields& fields = member.current_fields;
+    double total_speed                = 0;
+    size_t num_fluid_cells            = 0;
+    summary.min_pressure              = std::numeric_limits<double>::infinity();
+    summary.max_pressure              = -std::numeric_limits<double>::infinity();
+    for (size_t i = 0; i < fields.size(); i++) {
+        if (member.obstacle_cell_mask[i]) {
+            continue;
+        }
+        const double speed = std::hypot(fields.velocity_x[i], fields.velocity_y[i]);
+        if (!std::isfinite(speed) || !std::isfinite(fields.pressure[i])) {
+            summary.finite = false;
+            continue;
+        }
+        summary.max_speed    = std::max(summary.max_speed, speed);
+        summary.min_pressure = std::min(summary.min_pressure, fields.pressure[i]);
+        summary.max_pressure = std::max(summary.max_pressure, fields.pressure[i]);
+        total_speed += speed;
+        num_fluid_cells++;
+    }
+    if (num_fluid_cells == 0) {
+        summary.min_pressure = 0;
+        summary.max_pressure = 0;
+    } else {
+        summary.mean_speed = total_speed / num_fluid_cells;
+    }
+    return summary;
+}
@@ -0,0 +1,279 @@
+#include "FieldPyramid.h"
+
+// STD Includes
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+// How far (as a fraction of a bin) a cell edge can be from a bin edge and still be
+// treated as lying on it
+const double EDGE_TOLERANCE = 1e-9;
+
+/**
+ * Empty the given bin, ready to add fluid to
+ *
+ * @param level the level the bin is in
+ * @param bin the bin to empty
+ */
+void resetBin(FieldPyramidLevel& level, size_t bin) {
+    level.min_pressure[bin]    = std::numeric_limits<double>::infinity();
+    level.max_pressure[bin]    = -std::numeric_limits<double>::infinity();
+    level.mean_pressure[bin]   = 0;
+    level.mean_velocity_x[bin] = 0;
+    level.mean_velocity_y[bin] = 0;
+    level.fluid_area[bin]      = 0;
+    level.obstacle_area[bin]   = 0;
+}
+
+/**
+ * Add some fluid to the given bin. Until `finishBin` is called the means of the bin
+ * hold the area weighted sums.
+ *
+ * @param level the level the bin is in
+ * @param bin the bin to add to
+ * @param min_pressure the smallest pressure of the fluid (Pa)
+ * @param max_pressure the largest pressure of the fluid (Pa)
+ * @param pressure the mean pressure of the fluid (Pa)
+ * @param velocity_x the mean x velocity of the fluid (m/s)
+ * @param velocity_y the mean y velocity of the fluid (m/s)
+ * @param area the area of the fluid (m^2)
+ */
+void addToBin(FieldPyramidLevel& level,
+              size_t bin,
+              double min_pressure,
+              double max_pressure,
+              double pressure,
+              double velocity_x,
+              double velocity_y,
+              double area) {
+    level.min_pressure[bin] = std::min(level.min_pressure[bin], min_pressure);
+    level.max_pressure[bin] = std::max(level.max_pressure[bin], max_pressure);
+    level.mean_pressure[bin] += pressure * area;
+    level.mean_velocity_x[bin] += velocity_x * area;
+    level.mean_velocity_y[bin] += velocity_y * area;
+    level.fluid_area[bin] += area;
+}
+
+/**
+ * Turn the sums of the given bin into means, once all the fluid has been added
+ *
+ * @param level the level the bin is in
+ * @param bin the bin to finish
+ */
+void finishBin(FieldPyramidLevel& level, size_t bin) {
+    const double area = level.fluid_area[bin];
+    if (area <= 0) {
+        level.min_pressure[bin]    = 0;
+        level.max_pressure[bin]    = 0;
+        level.mean_pressure[bin]   = 0;
+        level.mean_velocity_x[bin] = 0;
+        level.mean_velocity_y[bin] = 0;
+        return;
+    }
+    level.mean_pressure[bin] /= area;
+    level.mean_velocity_x[bin] /= area;
+    level.mean_velocity_y[bin] /= area;
+}
+
+}  // namespace
+
+void FieldPyramid::build(std::shared_ptr<const ControlVolumeMesh> mesh,
+                         const ControlVolumeFields& fields,
+                         const std::vector<uint8_t>& obstacle_cell_mask,
+                         double simulation_size,
+                         ThreadPool& thread_pool,
+                         int max_resolution) {
+    if (max_resolution < 1) {
+        throw std::invalid_argument("Pyramid resolution must be at least 1");
+    }
+
+    // Only work out the layout of the pyramid again if the mesh has changed
+    if (mesh != this->mesh || simulation_size != this->simulation_size ||
+        max_resolution != this->max_resolution) {
+        this->mesh            = std::move(mesh);
+        this->simulation_size = simulation_size;
+        this->max_resolution  = max_resolution;
+
+        // Cells are only ever split in half, so every cell edge lies on the grid of the
+        // smallest cells, and bins that size never straddle a cell edge. If there are
+        // too many of them, each bin covers a power of two of them along each side
+        // instead.
+        const std::vector<double>& cell_scale = this->mesh->getCellScale();
+        const double min_scale =
+            cell_scale.empty()
+                ? simulation_size
+                : *std::min_element(cell_scale.begin(), cell_scale.end());
+        const int num_finest_cells =
+            std::max(1, static_cast<int>(std::lround(simulation_size / min_scale)));
+        int resolution  = num_finest_cells;
+        double bin_size = simulation_size / num_finest_cells;
+        while (resolution > max_resolution) {
+            resolution = (resolution + 1) / 2;
+            bin_size *= 2;
+        }
+        finest_level_exact = resolution == num_finest_cells;
+        findBinOverlaps(resolution, bin_size);
+
+        // Every level halves the one below it, rounding up, so the last bins along
+        // each side may reach past the far edges of the simulation
+        levels.clear();
+        while (true) {
+            FieldPyramidLevel& level = levels.emplace_back();
+            const size_t num_bins =
+                static_cast<size_t>(resolution) * static_cast<size_t>(resolution);
+            level.resolution = resolution;
+            level.bin_size   = bin_size;
+            level.min_pressure.resize(num_bins);
+            level.max_pressure.resize(num_bins);
+            level.mean_pressure.resize(num_bins);
+            level.mean_velocity_x.resize(num_bins);
+            level.mean_velocity_y.resize(num_bins);
+            level.fluid_area.resize(num_bins);
+            level.obstacle_area.resize(num_bins);
+            if (resolution == 1) {
+                break;
+            }
+            resolution = (resolution + 1) / 2;
+            bin_size *= 2;
+        }
+    }
+
+    // Every row of the finest level only reads it's own overlaps, so the rows can be
+    // reduced in parallel
+    FieldPyramidLevel& finest = levels.front();
+    const size_t resolution   = finest.resolution;
+    thread_pool.parallelFor(resolution, [&](size_t begin, size_t end) {
+        for (size_t row = begin; row < end; row++) {
+            const size_t first_bin = row * resolution;
+            for (size_t bin = first_bin; bin < first_bin + resolution; bin++) {
+                resetBin(finest, bin);
+            }
+            for (size_t k = row_offsets[row]; k < row_offsets[row + 1]; k++) {
+                const BinOverlap& overlap = overlaps[k];
+                const size_t bin          = first_bin + overlap.column;
+                if (obstacle_cell_mask[overlap.cell]) {
+                    finest.obstacle_area[bin] += overlap.area;
+                    continue;
+                }
+                const double pressure = fields.pressure[overlap.cell];
+                addToBin(finest,
+                         bin,
+                         pressure,
+                         pressure,
+                         pressure,
+                         fields.velocity_x[overlap.cell],
+                         fields.velocity_y[overlap.cell],
+                         overlap.area);
+            }
+            for (size_t bin = first_bin; bin < first_bin + resolution; bin++) {
+                finishBin(finest, bin);
+            }
+        }
+    });
+
+    // Then every other level from the four bins below each of it's bins
+    for (size_t l = 1; l < levels.size(); l++) {
+        const FieldPyramidLevel& below = levels[l - 1];
+        FieldPyramidLevel& level       = levels[l];
+        const size_t level_resolution  = level.resolution;
+        const size_t below_resolution  = below.resolution;
+        thread_pool.parallelFor(level_resolution, [&](size_t begin, size_t end) {
+            for (size_t row = begin; row < end; row++) {
+                for (size_t column = 0; column < level_resolution; column++) {
+                    const size_t bin = row * level_resolution + column;
+                    resetBin(level, bin);
+                    for (int k = 0; k < 4; k++) {
+                        const size_t child_row    = 2 * row + k / 2;
+                        const size_t child_column = 2 * column + k % 2;
+                        if (child_row >= below_resolution ||
+                            child_column >= below_resolution) {
+                            continue;
+                        }
+                        const size_t child =
+                            child_row * below_resolution + child_column;
+                        level.obstacle_area[bin] += below.obstacle_area[child];
+                        if (below.fluid_area[child] > 0) {
+                            addToBin(level,
+                                     bin,
+                                     below.min_pressure[child],
+                                     below.max_pressure[child],
+                                     below.mean_pressure[child],
+                                     below.mean_velocity_x[child],
+                                     below.mean_velocity_y[child],
+                                     below.fluid_area[child]);
+                        }
+                    }
+                    finishBin(level, bin);
+                }
+            }
+        });
+    }
+}
+
+size_t FieldPyramid::selectLevel(double num_bins) const {
+    for (size_t level = levels.size(); level-- > 0;) {
+        if (simulation_size / levels[level].bin_size >= num_bins) {
+            return level;
+        }
+    }
+    return 0;
+}
+
+void FieldPyramid::findBinOverlaps(int resolution, double bin_size) {
+    const ControlVolumeMesh& cells        = *mesh;
+    const std::vector<double>& cell_x     = cells.getCellX();
+    const std::vector<double>& cell_y     = cells.getCellY();
+    const std::vector<double>& cell_scale = cells.getCellScale();
+
+    // The bins a cell starting at `start` of the given length reaches into, along one
+    // axis. Cell edges lie on bin edges up to rounding, which mustn't count as
+    // reaching into the next bin.
+    auto first_bin = [&](double start) {
+        const double bin = start / bin_size + EDGE_TOLERANCE;
+        return std::clamp(static_cast<int>(std::floor(bin)), 0, resolution - 1);
+    };
+    auto last_bin = [&](double start, double length) {
+        const double bin = (start + length) / bin_size - EDGE_TOLERANCE;
+        return std::clamp(
+            static_cast<int>(std::ceil(bin)) - 1, first_bin(start), resolution - 1);
+    };
+    auto overlap_length = [&](double start, double length, int bin) {
+        return std::max(0.0,
+                        std::min(start + length, (bin + 1) * bin_size) -
+                            std::max(start, bin * bin_size));
+    };
+
+    // Count the overlaps in every row, then fill them in
+    row_offsets.assign(resolution + 1, 0);
+    for (size_t i = 0; i < cells.numCells(); i++) {
+        const int num_columns =
+            last_bin(cell_x[i], cell_scale[i]) - first_bin(cell_x[i]) + 1;
+        for (int row = first_bin(cell_y[i]); row <= last_bin(cell_y[i], cell_scale[i]);
+             row++) {
+            row_offsets[row + 1] += num_columns;
+        }
+    }
+    for (int row = 0; row < resolution; row++) {
+        row_offsets[row + 1] += row_offsets[row];
+    }
+
+    overlaps.resize(row_offsets.back());
+    std::vector<size_t> row_ends(row_offsets.begin(), row_offsets.end() - 1);
+    for (size_t i = 0; i < cells.numCells(); i++) {
+        for (int row = first_bin(cell_y[i]); row <= last_bin(cell_y[i], cell_scale[i]);
+             row++) {
+            const double height = overlap_length(cell_y[i], cell_scale[i], row);
+            for (int column = first_bin(cell_x[i]);
+                 column <= last_bin(cell_x[i], cell_scale[i]);
+                 column++) {
+                overlaps[row_ends[row]++] = {
+                    column,
+                    static_cast<int>(i),
+                    overlap_length(cell_x[i], cell_scale[i], column) * height};
+            }
+        }
+    }
+}
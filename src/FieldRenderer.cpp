@@ -0,0 +1,384 @@
+#include "FieldRenderer.h"
+
+// STD Includes
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+// External Library Includes
+#include <units.h>
+
+// Project Includes
+#include "Profiler.h"
+
+using namespace units::length;
+
+namespace {
+    // The number of streamlines drawn along each side of the simulation
+    const int NUM_STREAMLINES_PER_SIDE = 10;
+
+    // The length of each streamline, and the distance between the points on it (m)
+    const meter_t STREAMLINE_LENGTH           = meter_t(5);
+    const meter_t STREAMLINE_POINT_SEPARATION = meter_t(0.1);
+
+    // The side length of the square drawn at every point on a streamline (pixels)
+    const double STREAMLINE_POINT_SIZE = 4;
+
+    // The closest velocity glyphs are drawn together (pixels)
+    const double MIN_GLYPH_SPACING = 8;
+
+    /**
+     * Convert a colour to Cairo's (native endian, premultiplied) ARGB32 pixel format
+     *
+     * @param red the red component, in [0, 1]
+     * @param green the green component, in [0, 1]
+     * @param blue the blue component, in [0, 1]
+     * @param alpha the alpha component, in [0, 1]
+     *
+     * @return the colour as an ARGB32 pixel
+     */
+    uint32_t toArgb32(double red, double green, double blue, double alpha) {
+        auto to_byte = [](double component) {
+            return static_cast<uint32_t>(std::lround(component * 255));
+        };
+        return to_byte(alpha) << 24 | to_byte(red * alpha) << 16 |
+               to_byte(green * alpha) << 8 | to_byte(blue * alpha);
+    }
+
+    /**
+     * Get the colour fluid at the given pressure is drawn in
+     *
+     * @param pressure the pressure of the fluid (Pa)
+     * @param max_pressure the pressure drawn at full intensity (Pa)
+     *
+     * @return the colour as an ARGB32 pixel
+     */
+    uint32_t pressureToArgb32(double pressure, double max_pressure) {
+        // Cairo clamps colour components, so we do too
+        double intensity = pressure / max_pressure;
+        intensity        = intensity > 0 ? std::min(intensity, 1.0) : 0;
+        return toArgb32(intensity, 0, 0, 0.8);
+    }
+}
+
+FieldRenderer::FieldRenderer(FieldRenderMode render_mode, int num_threads)
+  : render_mode(render_mode), thread_pool(num_threads) {}
+
+void FieldRenderer::setRenderMode(FieldRenderMode render_mode) {
+    this->render_mode = render_mode;
+}
+
+void FieldRenderer::setViewport(FieldViewport viewport) {
+    if (!(viewport.zoom > 0)) {
+        throw std::invalid_argument("Viewport zoom must be positive");
+    }
+    this->viewport = viewport;
+}
+
+void FieldRenderer::draw(const Cairo::RefPtr<Cairo::Context>& ctx,
+                         int width,
+                         int height,
+                         const FieldSnapshot& snapshot) {
+    SIMPLE_CFD_PROFILE_SCOPE("FieldRenderer::draw");
+    if (!snapshot.mesh || snapshot.mesh->numCells() == 0) {
+        return;
+    }
+    const double simulation_size = snapshot.simulation_size;
+
+    // Everything is read from the pyramid, rather than every cell
+    const FieldPyramid* pyramid = &snapshot.pyramid;
+    if (pyramid->getMesh() != snapshot.mesh ||
+        pyramid->getSimulationSize() != simulation_size) {
+        fallback_pyramid.build(snapshot.mesh,
+                               snapshot.fields,
+                               snapshot.obstacle_cell_mask,
+                               simulation_size,
+                               thread_pool);
+        pyramid = &fallback_pyramid;
+    }
+
+    ctx->save();
+
+    // Draw all the nodes in the simulator
+    ctx->set_line_width(1);
+
+    // The simulator should fit the smaller of the width and height when fully zoomed
+    // out, with the centre of the viewport in the middle
+    const int graph_size        = std::min(width, height);
+    const double scaling_factor = graph_size * viewport.zoom / simulation_size;
+    const double origin_x =
+        viewport.centre_x * simulation_size - graph_size / 2.0 / scaling_factor;
+    const double origin_y =
+        viewport.centre_y * simulation_size - graph_size / 2.0 / scaling_factor;
+
+    // Zoomed in, the simulation would otherwise spill out of the area
+    ctx->rectangle(0, 0, graph_size, graph_size);
+    ctx->clip();
+
+    // The scale for the pressures is the largest pressure of the fluid, which the top
+    // of the pyramid already holds
+    const FieldPyramidLevel& top = pyramid->getLevel(pyramid->numLevels() - 1);
+    const double max_pressure    = top.max_pressure[0];
+
+    if (render_mode == FieldRenderMode::RASTERISED) {
+        drawRasterisedPressure(ctx,
+                               snapshot,
+                               *pyramid,
+                               graph_size,
+                               scaling_factor,
+                               origin_x,
+                               origin_y,
+                               max_pressure);
+    }
+    ctx->translate(-origin_x * scaling_factor, -origin_y * scaling_factor);
+    if (render_mode == FieldRenderMode::PER_CELL) {
+        drawCellsPerCell(ctx, snapshot, scaling_factor, max_pressure);
+    } else {
+        drawVelocityGlyphs(
+            ctx, *pyramid, graph_size, scaling_factor, origin_x, origin_y);
+    }
+
+    // Draw streamlines from a grid of points across the simulation
+    std::vector<Point2d> start_points;
+    for (int x_index = 0; x_index < NUM_STREAMLINES_PER_SIDE; x_index++) {
+        for (int y_index = 0; y_index < NUM_STREAMLINES_PER_SIDE; y_index++) {
+            start_points.push_back(
+                {meter_t(x_index * snapshot.simulation_size / NUM_STREAMLINES_PER_SIDE),
+                 meter_t(y_index * snapshot.simulation_size / NUM_STREAMLINES_PER_SIDE)});
+        }
+    }
+    const std::vector<std::vector<Point2d>> streamlines =
+        traceStreamLines(*snapshot.cell_locator,
+                         snapshot.fields,
+                         start_points,
+                         STREAMLINE_LENGTH,
+                         STREAMLINE_POINT_SEPARATION,
+                         StreamLineOptions(),
+                         thread_pool);
+    drawStreamLines(ctx, streamlines, scaling_factor);
+
+    ctx->fill_preserve();
+    ctx->restore();
+    ctx->stroke_preserve();
+    ctx->clip();
+}
+
+void FieldRenderer::drawCellsPerCell(const Cairo::RefPtr<Cairo::Context>& ctx,
+                                     const FieldSnapshot& snapshot,
+                                     double scaling_factor,
+                                     double max_pressure) {
+    SIMPLE_CFD_PROFILE_SCOPE("FieldRenderer::drawCellsPerCell");
+    const ControlVolumeMesh& mesh     = *snapshot.mesh;
+    const ControlVolumeFields& fields = snapshot.fields;
+
+    for (size_t cell = 0; cell < mesh.numCells(); cell++) {
+        // Reset drawing stuff
+        ctx->move_to(0, 0);
+
+        double scaled_node_pos_x = mesh.getCellX()[cell] * scaling_factor;
+        double scaled_node_pos_y = mesh.getCellY()[cell] * scaling_factor;
+        double scaled_node_scale = mesh.getCellScale()[cell] * scaling_factor;
+
+        // Draw the Node itself
+        ctx->rectangle(
+            scaled_node_pos_x, scaled_node_pos_y, scaled_node_scale, scaled_node_scale);
+
+        // Indicate the pressure (or that this is an obstacle) by coloring the Node
+        if (snapshot.obstacle_cell_mask[cell]) {
+            ctx->set_source_rgba(0, 1, 0, 0.5);
+        } else {
+            ctx->set_source_rgba(fields.pressure[cell] / max_pressure, 0, 0, 0.8);
+        }
+        ctx->fill_preserve();
+
+        // Draw the velocity as a line
+        double velocity_x         = fields.velocity_x[cell];
+        double velocity_y         = fields.velocity_y[cell];
+        double velocity_magnitude = std::pow(velocity_x, 2) + std::pow(velocity_y, 2);
+
+        if (velocity_magnitude != 0) {
+            velocity_x = velocity_x / velocity_magnitude;
+            velocity_y = velocity_y / velocity_magnitude;
+        }
+        ctx->move_to(scaled_node_pos_x + scaled_node_scale / 2,
+                     scaled_node_pos_y + scaled_node_scale / 2);
+        ctx->line_to(scaled_node_pos_x + scaled_node_scale / 2 + velocity_x,
+                     scaled_node_pos_y + scaled_node_scale / 2 + velocity_y);
+
+        ctx->set_source_rgba(1.0, 1.0, 1.0, 0.8);
+        ctx->set_line_width(1);
+        ctx->stroke();
+    }
+}
+
+void FieldRenderer::drawRasterisedPressure(const Cairo::RefPtr<Cairo::Context>& ctx,
+                                           const FieldSnapshot& snapshot,
+                                           const FieldPyramid& pyramid,
+                                           int graph_size,
+                                           double scaling_factor,
+                                           double origin_x,
+                                           double origin_y,
+                                           double max_pressure) {
+    SIMPLE_CFD_PROFILE_SCOPE("FieldRenderer::drawRasterisedPressure");
+    if (graph_size <= 0) {
+        return;
+    }
+
+    if (!pressure_surface || pressure_surface->get_width() != graph_size ||
+        pressure_surface->get_height() != graph_size) {
+        pressure_surface =
+            Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, graph_size, graph_size);
+    }
+
+    // The coarsest level with at least one bin per pixel. If even the finest level
+    // is coarser than that and it's bins cover several cells, the cells are sampled
+    // directly instead.
+    const double simulation_size   = pyramid.getSimulationSize();
+    const double num_pixels        = graph_size * viewport.zoom;
+    const FieldPyramidLevel& level = pyramid.getLevel(pyramid.selectLevel(num_pixels));
+    const CellLocator* locator = snapshot.cell_locator.get();
+    const bool sample_cells    = locator && !pyramid.isFinestLevelExact() &&
+                              simulation_size / level.bin_size < num_pixels;
+    const std::vector<double>& pressure = snapshot.fields.pressure;
+    auto bin_index                      = [&](double position) {
+        return std::min(static_cast<int>(position / level.bin_size),
+                        level.resolution - 1);
+    };
+
+    // Colour every pixel by the bin (or cell) under it's centre, leaving pixels
+    // outside the simulation clear. Neighbouring pixels are almost always in the same
+    // cell, so we use the last cell as a hint.
+    pressure_surface->flush();
+    unsigned char* data            = pressure_surface->get_data();
+    const int stride               = pressure_surface->get_stride();
+    const uint32_t obstacle_colour = toArgb32(0, 1, 0, 0.5);
+    thread_pool.parallelFor(graph_size, [&](size_t begin, size_t end) {
+        for (size_t row = begin; row < end; row++) {
+            uint32_t* pixels = reinterpret_cast<uint32_t*>(data + row * stride);
+            const double y   = origin_y + (row + 0.5) / scaling_factor;
+            int cell         = CellLocator::NO_CELL;
+            for (int column = 0; column < graph_size; column++) {
+                const double x = origin_x + (column + 0.5) / scaling_factor;
+                if (x < 0 || y < 0 || x >= simulation_size || y >= simulation_size) {
+                    pixels[column] = 0;
+                    continue;
+                }
+                if (sample_cells) {
+                    cell = locator->locate(x, y, cell);
+                    if (snapshot.obstacle_cell_mask[cell]) {
+                        pixels[column] = obstacle_colour;
+                    } else {
+                        pixels[column] = pressureToArgb32(pressure[cell], max_pressure);
+                    }
+                    continue;
+                }
+                const size_t bin =
+                    static_cast<size_t>(bin_index(y)) * level.resolution + bin_index(x);
+                if (level.obstacle_area[bin] > level.fluid_area[bin]) {
+                    pixels[column] = obstacle_colour;
+                } else {
+                    pixels[column] =
+                        pressureToArgb32(level.mean_pressure[bin], max_pressure);
+                }
+            }
+        }
+    });
+    pressure_surface->mark_dirty();
+
+    ctx->set_source(pressure_surface, 0, 0);
+    ctx->paint();
+}
+
+void FieldRenderer::drawVelocityGlyphs(const Cairo::RefPtr<Cairo::Context>& ctx,
+                                       const FieldPyramid& pyramid,
+                                       int graph_size,
+                                       double scaling_factor,
+                                       double origin_x,
+                                       double origin_y) {
+    SIMPLE_CFD_PROFILE_SCOPE("FieldRenderer::drawVelocityGlyphs");
+
+    // The finest level with bins at least `MIN_GLYPH_SPACING` pixels apart (or the
+    // coarsest level, if even that is too fine)
+    const double max_bins = graph_size * viewport.zoom / MIN_GLYPH_SPACING;
+    size_t level_index    = pyramid.selectLevel(max_bins);
+    const double num_bins =
+        pyramid.getSimulationSize() / pyramid.getLevel(level_index).bin_size;
+    if (num_bins > max_bins && level_index + 1 < pyramid.numLevels()) {
+        level_index++;
+    }
+    const FieldPyramidLevel& level = pyramid.getLevel(level_index);
+    const int resolution           = level.resolution;
+    const double bin_size          = level.bin_size;
+
+    // Only the bins in the viewport are drawn
+    const double view_size = graph_size / scaling_factor;
+    auto visible_bins      = [&](double origin) {
+        const int first = static_cast<int>(std::floor(origin / bin_size));
+        const int end   = static_cast<int>(std::ceil((origin + view_size) / bin_size));
+        return std::make_pair(std::max(0, first), std::min(resolution, end));
+    };
+    const auto [first_row, end_row]       = visible_bins(origin_y);
+    const auto [first_column, end_column] = visible_bins(origin_x);
+
+    ctx->begin_new_path();
+    for (int row = first_row; row < end_row; row++) {
+        for (int column = first_column; column < end_column; column++) {
+            const size_t bin = static_cast<size_t>(row) * resolution + column;
+            if (level.fluid_area[bin] <= 0) {
+                continue;
+            }
+            const double centre_x = (column + 0.5) * bin_size * scaling_factor;
+            const double centre_y = (row + 0.5) * bin_size * scaling_factor;
+
+            double velocity_x = level.mean_velocity_x[bin];
+            double velocity_y = level.mean_velocity_y[bin];
+            double velocity_magnitude =
+                std::pow(velocity_x, 2) + std::pow(velocity_y, 2);
+            if (velocity_magnitude != 0) {
+                velocity_x = velocity_x / velocity_magnitude;
+                velocity_y = velocity_y / velocity_magnitude;
+            }
+
+            ctx->move_to(centre_x, centre_y);
+            ctx->line_to(centre_x + velocity_x, centre_y + velocity_y);
+        }
+    }
+    ctx->set_source_rgba(1.0, 1.0, 1.0, 0.8);
+    ctx->set_line_width(1);
+    ctx->stroke();
+}
+
+void FieldRenderer::drawStreamLines(const Cairo::RefPtr<Cairo::Context>& ctx,
+                                    const std::vector<std::vector<Point2d>>& streamlines,
+                                    double scaling_factor) {
+    SIMPLE_CFD_PROFILE_SCOPE("FieldRenderer::drawStreamLines");
+    ctx->set_source_rgba(1.0, 0.0, 1.0, 0.8);
+
+    if (render_mode == FieldRenderMode::PER_CELL) {
+        for (const std::vector<Point2d>& streamline : streamlines) {
+            for (const Point2d& point : streamline) {
+                ctx->set_source_rgba(1.0, 0.0, 1.0, 0.8);
+                ctx->rectangle(point.x.to<double>() * scaling_factor,
+                               point.y.to<double>() * scaling_factor,
+                               STREAMLINE_POINT_SIZE,
+                               STREAMLINE_POINT_SIZE);
+                ctx->fill_preserve();
+                ctx->stroke();
+            }
+        }
+        return;
+    }
+
+    ctx->begin_new_path();
+    for (const std::vector<Point2d>& streamline : streamlines) {
+        for (const Point2d& point : streamline) {
+            ctx->rectangle(point.x.to<double>() * scaling_factor,
+                           point.y.to<double>() * scaling_factor,
+                           STREAMLINE_POINT_SIZE,
+                           STREAMLINE_POINT_SIZE);
+        }
+    }
+    ctx->fill_preserve();
+    ctx->stroke();
+}
@@ -0,0 +1,445 @@
+#include "FieldSeriesWriter.h"
+
+// STD Includes
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+// Library Includes
+#ifdef SIMPLE_CFD_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+// Identify series and index files, and the version of the layout they were written
+// with
+constexpr char SERIES_MAGIC[8]    = {'S', 'C', 'F', 'D', 'S', 'E', 'R', 'S'};
+constexpr char INDEX_MAGIC[8]     = {'S', 'C', 'F', 'D', 'S', 'I', 'D', 'X'};
+constexpr uint32_t SERIES_VERSION = 1;
+
+// The types of chunk in a series
+constexpr uint32_t MESH_CHUNK  = 1;
+constexpr uint32_t FRAME_CHUNK = 2;
+
+// The header at the start of both files
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+// The header before every chunk in the series
+struct ChunkHeader {
+    uint32_t type;
+    uint32_t compressed;
+    uint64_t size;
+    uint64_t stored_size;
+};
+
+/**
+ * Append the raw bytes of the given values to a buffer
+ *
+ * @param buffer the buffer to append to
+ * @param values the values to append
+ * @param num_values the number of values to append
+ */
+template <typename T>
+void appendValues(std::vector<unsigned char>& buffer,
+                  const T* values,
+                  size_t num_values) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(values);
+    buffer.insert(buffer.end(), bytes, bytes + num_values * sizeof(T));
+}
+
+/**
+ * Read values out of a buffer, advancing past them
+ *
+ * @param buffer the buffer to read from
+ * @param offset the offset to read at, advanced past the values
+ * @param values the values to read into
+ * @param num_values the number of values to read
+ *
+ * @throws std::runtime_error if the buffer is too short
+ */
+template <typename T>
+void readValues(const std::vector<unsigned char>& buffer,
+                size_t& offset,
+                T* values,
+                size_t num_values) {
+    if (num_values > (buffer.size() - offset) / sizeof(T)) {
+        throw std::runtime_error("Field series chunk is too short");
+    }
+    std::memcpy(values, buffer.data() + offset, num_values * sizeof(T));
+    offset += num_values * sizeof(T);
+}
+} // namespace
+
+FieldSeriesWriter::FieldSeriesWriter(const std::string& path,
+                                     FieldSeriesParameters parameters)
+  : parameters(parameters),
+    series_file(nullptr),
+    index_file(nullptr),
+    mesh_chunk_offset(0),
+    series_size(0),
+    num_writing(0),
+    counters{0, 0, 0, 0},
+    stopping(false) {
+    if (parameters.compress && !isCompressionSupported()) {
+        throw std::invalid_argument("Field series compression needs zlib");
+    }
+    if (parameters.sample_spacing > 0 &&
+        !(std::isfinite(parameters.region_min_x) &&
+          std::isfinite(parameters.region_min_y) &&
+          std::isfinite(parameters.region_max_x) &&
+          std::isfinite(parameters.region_max_y))) {
+        throw std::invalid_argument("Field series sampling needs a finite region");
+    }
+    if (parameters.queue_capacity == 0) {
+        throw std::invalid_argument("Field series queue capacity must be at least 1");
+    }
+
+    series_file = std::fopen(path.c_str(), "wb");
+    index_file  = std::fopen((path + ".index").c_str(), "wb");
+    if (!series_file || !index_file) {
+        if (series_file) {
+            std::fclose(series_file);
+        }
+        if (index_file) {
+            std::fclose(index_file);
+        }
+        throw std::runtime_error("Could not create field series " + path);
+    }
+
+    FileHeader header = {{}, SERIES_VERSION, 0};
+    std::memcpy(header.magic, SERIES_MAGIC, sizeof(header.magic));
+    std::fwrite(&header, sizeof(header), 1, series_file);
+    series_size = sizeof(header);
+    std::memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+    std::fwrite(&header, sizeof(header), 1, index_file);
+
+    thread = std::thread(&FieldSeriesWriter::run, this);
+}
+
+FieldSeriesWriter::~FieldSeriesWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    queued.notify_one();
+    thread.join();
+
+    std::fclose(series_file);
+    std::fclose(index_file);
+}
+
+bool FieldSeriesWriter::write(FieldSnapshot& snapshot) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (queue.size() >= parameters.queue_capacity) {
+        if (!parameters.block_when_full) {
+            counters.frames_dropped++;
+            return false;
+        }
+        counters.frames_backpressured++;
+        written.wait(lock, [&]() { return queue.size() < parameters.queue_capacity; });
+    }
+
+    std::unique_ptr<FieldSnapshot> frame;
+    if (free_snapshots.empty()) {
+        frame = std::make_unique<FieldSnapshot>();
+    } else {
+        frame = std::move(free_snapshots.back());
+        free_snapshots.pop_back();
+    }
+    std::swap(*frame, snapshot);
+    queue.emplace_back(std::move(frame));
+    lock.unlock();
+
+    queued.notify_one();
+    return true;
+}
+
+void FieldSeriesWriter::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    written.wait(lock, [&]() { return queue.empty() && num_writing == 0; });
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+FieldSeriesWriter::Counters FieldSeriesWriter::getCounters() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+bool FieldSeriesWriter::isCompressionSupported() {
+#ifdef SIMPLE_CFD_HAVE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+void FieldSeriesWriter::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        queued.wait(lock, [&]() { return stopping || !queue.empty(); });
+        if (queue.empty()) {
+            return;
+        }
+
+        std::unique_ptr<FieldSnapshot> frame = std::move(queue.front());
+        queue.pop_front();
+        num_writing++;
+        const bool failed = static_cast<bool>(error);
+
+        // Don't hold the lock while writing, so more frames can be queued
+        lock.unlock();
+        std::exception_ptr write_error;
+        if (!failed) {
+            try {
+                writeFrame(*frame);
+            } catch (...) {
+                write_error = std::current_exception();
+            }
+        }
+        lock.lock();
+
+        num_writing--;
+        if (write_error) {
+            error = write_error;
+        }
+        free_snapshots.emplace_back(std::move(frame));
+        written.notify_all();
+    }
+}
+
+void FieldSeriesWriter::writeFrame(const FieldSnapshot& snapshot) {
+    if (snapshot.mesh != points_mesh) {
+        selectPoints(snapshot);
+
+        std::vector<unsigned char> payload;
+        const uint64_t num_points = cells.size();
+        appendValues(payload, &num_points, 1);
+        appendValues(payload, point_x.data(), num_points);
+        appendValues(payload, point_y.data(), num_points);
+        mesh_chunk_offset = writeChunk(MESH_CHUNK, payload);
+    }
+
+    uint64_t frame;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        frame = counters.frames_written;
+    }
+
+    // The values are gathered one field at a time, so each is contiguous in the chunk
+    std::vector<unsigned char> payload;
+    const uint64_t num_points = cells.size();
+    appendValues(payload, &frame, 1);
+    appendValues(payload, &snapshot.num_steps, 1);
+    appendValues(payload, &snapshot.simulation_time, 1);
+    appendValues(payload, &num_points, 1);
+    std::vector<double> values(num_points);
+    for (const std::vector<double>* field : {&snapshot.fields.pressure,
+                                             &snapshot.fields.velocity_x,
+                                             &snapshot.fields.velocity_y}) {
+        for (size_t k = 0; k < num_points; k++) {
+            values[k] = (*field)[cells[k]];
+        }
+        appendValues(payload, values.data(), num_points);
+    }
+    const uint64_t frame_chunk_offset = writeChunk(FRAME_CHUNK, payload);
+
+    // The frame must be in the series before the index points at it
+    if (std::fflush(series_file) != 0) {
+        throw std::runtime_error("Could not write field series");
+    }
+    const uint64_t record[2] = {frame_chunk_offset, mesh_chunk_offset};
+    if (std::fwrite(record, sizeof(record), 1, index_file) != 1 ||
+        std::fflush(index_file) != 0) {
+        throw std::runtime_error("Could not write field series index");
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.frames_written++;
+    counters.bytes_written = series_size;
+}
+
+void FieldSeriesWriter::selectPoints(const FieldSnapshot& snapshot) {
+    const ControlVolumeMesh& mesh = *snapshot.mesh;
+    points_mesh                   = snapshot.mesh;
+    cells.clear();
+    point_x.clear();
+    point_y.clear();
+
+    if (parameters.sample_spacing > 0) {
+        const double spacing = parameters.sample_spacing;
+        const double width   = parameters.region_max_x - parameters.region_min_x;
+        const double height  = parameters.region_max_y - parameters.region_min_y;
+        const int num_x      = static_cast<int>(std::floor(width / spacing)) + 1;
+        const int num_y      = static_cast<int>(std::floor(height / spacing)) + 1;
+
+        int hint = CellLocator::NO_CELL;
+        for (int j = 0; j < num_y; j++) {
+            for (int i = 0; i < num_x; i++) {
+                const double x = parameters.region_min_x + i * spacing;
+                const double y = parameters.region_min_y + j * spacing;
+                const int cell = snapshot.cell_locator->locate(x, y, hint);
+                if (cell == CellLocator::NO_CELL) {
+                    // Points off the mesh have no values to sample
+                    continue;
+                }
+                hint = cell;
+                cells.emplace_back(cell);
+                point_x.emplace_back(x);
+                point_y.emplace_back(y);
+            }
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < mesh.numCells(); i++) {
+        const double x = mesh.getCellX()[i] + mesh.getCellScale()[i] / 2;
+        const double y = mesh.getCellY()[i] + mesh.getCellScale()[i] / 2;
+        if (x >= parameters.region_min_x && x <= parameters.region_max_x &&
+            y >= parameters.region_min_y && y <= parameters.region_max_y) {
+            cells.emplace_back(i);
+            point_x.emplace_back(x);
+            point_y.emplace_back(y);
+        }
+    }
+}
+
+uint64_t FieldSeriesWriter::writeChunk(uint32_t type,
+                                       const std::vector<unsigned char>& payload) {
+    ChunkHeader header = {type, 0, payload.size(), payload.size()};
+    const unsigned char* stored = payload.data();
+
+#ifdef SIMPLE_CFD_HAVE_ZLIB
+    std::vector<unsigned char> compressed;
+    if (parameters.compress) {
+        uLongf compressed_size = compressBound(payload.size());
+        compressed.resize(compressed_size);
+        if (compress2(compressed.data(),
+                      &compressed_size,
+                      payload.data(),
+                      payload.size(),
+                      Z_BEST_SPEED) != Z_OK) {
+            throw std::runtime_error("Could not compress field series chunk");
+        }
+        header.compressed  = 1;
+        header.stored_size = compressed_size;
+        stored             = compressed.data();
+    }
+#endif
+
+    const uint64_t offset = series_size;
+    if (std::fwrite(&header, sizeof(header), 1, series_file) != 1 ||
+        std::fwrite(stored, 1, header.stored_size, series_file) != header.stored_size) {
+        throw std::runtime_error("Could not write field series");
+    }
+    series_size += sizeof(header) + header.stored_size;
+    return offset;
+}
+
+FieldSeriesReader::FieldSeriesReader(const std::string& path)
+  : series_file(std::fopen(path.c_str(), "rb")) {
+    if (!series_file) {
+        throw std::runtime_error("Could not open field series " + path);
+    }
+    std::FILE* index_file = std::fopen((path + ".index").c_str(), "rb");
+    if (!index_file) {
+        std::fclose(series_file);
+        throw std::runtime_error("Could not open field series index " + path +
+                                 ".index");
+    }
+
+    FileHeader series_header, index_header;
+    const bool headers_read =
+        std::fread(&series_header, sizeof(series_header), 1, series_file) == 1 &&
+        std::fread(&index_header, sizeof(index_header), 1, index_file) == 1;
+    if (!headers_read ||
+        std::memcmp(series_header.magic, SERIES_MAGIC, sizeof(SERIES_MAGIC)) != 0 ||
+        std::memcmp(index_header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 ||
+        series_header.version != SERIES_VERSION ||
+        index_header.version != SERIES_VERSION) {
+        std::fclose(series_file);
+        std::fclose(index_file);
+        throw std::runtime_error(path + " is not a field series");
+    }
+
+    // A partly written record at the end (eg. from a crash) is ignored
+    IndexRecord record;
+    while (std::fread(&record, sizeof(record), 1, index_file) == 1) {
+        index.emplace_back(record);
+    }
+    std::fclose(index_file);
+}
+
+FieldSeriesReader::~FieldSeriesReader() {
+    std::fclose(series_file);
+}
+
+void FieldSeriesReader::readFrame(size_t frame, FieldSeriesFrame& result) {
+    if (frame >= index.size()) {
+        throw std::out_of_range("No frame " + std::to_string(frame) +
+                                " in field series");
+    }
+
+    const std::vector<unsigned char> mesh_payload =
+        readChunk(index[frame].mesh_chunk_offset, MESH_CHUNK);
+    size_t offset       = 0;
+    uint64_t num_points = 0;
+    readValues(mesh_payload, offset, &num_points, 1);
+    result.x.resize(num_points);
+    result.y.resize(num_points);
+    readValues(mesh_payload, offset, result.x.data(), num_points);
+    readValues(mesh_payload, offset, result.y.data(), num_points);
+
+    const std::vector<unsigned char> frame_payload =
+        readChunk(index[frame].frame_chunk_offset, FRAME_CHUNK);
+    uint64_t num_frame_points = 0;
+    offset                    = 0;
+    readValues(frame_payload, offset, &result.frame, 1);
+    readValues(frame_payload, offset, &result.num_steps, 1);
+    readValues(frame_payload, offset, &result.simulation_time, 1);
+    readValues(frame_payload, offset, &num_frame_points, 1);
+    if (num_frame_points != num_points) {
+        throw std::runtime_error("Field series frame doesn't match it's mesh");
+    }
+    result.fields.resize(num_points);
+    readValues(frame_payload, offset, result.fields.pressure.data(), num_points);
+    readValues(frame_payload, offset, result.fields.velocity_x.data(), num_points);
+    readValues(frame_payload, offset, result.fields.velocity_y.data(), num_points);
+}
+
+std::vector<unsigned char> FieldSeriesReader::readChunk(uint64_t offset,
+                                                        uint32_t type) {
+    ChunkHeader header;
+    if (std::fseek(series_file, static_cast<long>(offset), SEEK_SET) != 0 ||
+        std::fread(&header, sizeof(header), 1, series_file) != 1 ||
+        header.type != type) {
+        throw std::runtime_error("Could not read field series chunk");
+    }
+
+    std::vector<unsigned char> stored(header.stored_size);
+    if (std::fread(stored.data(), 1, stored.size(), series_file) != stored.size()) {
+        throw std::runtime_error("Could not read field series chunk");
+    }
+    if (!header.compressed) {
+        return stored;
+    }
+
+#ifdef SIMPLE_CFD_HAVE_ZLIB
+    std::vector<unsigned char> payload(header.size);
+    uLongf payload_size = header.size;
+    if (uncompress(payload.data(), &payload_size, stored.data(), stored.size()) !=
+            Z_OK ||
+        payload_size != header.size) {
+        throw std::runtime_error("Could not decompress field series chunk");
+    }
+    return payload;
+#else
+    throw std::runtime_error("Reading compressed field series needs zlib");
+#endif
+}
@@ -3,6 +3,20 @@
 
 #include "FluidSimulator.h"
 
+// STD Includes
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+
+// Project Includes
+#include "ControlVolumeKernel.h"
+#include "Profiler.h"
+#include "ScalarStencilKernel.h"
+#include "SimdStencilKernel.h"
+
 using namespace units;
 using namespace units::literals;
 using namespace units::time;
@@ -13,16 +27,85 @@ using namespace units::pressure;
 using namespace units::velocity;
 using namespace units::math;
 
+namespace {
+    /**
+     * Check whether the simulator holds the only reference to the given buffer, so
+     * it can be written to in place
+     *
+     * `use_count` is only a relaxed load, so on it's own it doesn't order the reads
+     * another thread made through a view it has just released before our writes. The
+     * release in `shared_ptr`'s decrement pairs with the acquire fence here, so once
+     * the count is seen to be 1 every read through a released view happens before
+     * anything written to the buffer afterwards.
+     *
+     * @param buffer the buffer to check
+     *
+     * @return true if `buffer` isn't shared with any view, false otherwise
+     */
+    template <typename T>
+    bool isUniquelyOwned(const std::shared_ptr<T>& buffer) {
+        if (buffer.use_count() > 1) {
+            return false;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return true;
+    }
+}
+
 FluidSimulator::FluidSimulator(units::density::kg_per_cu_m_t density,
                                units::viscosity::meters_squared_per_s_t viscosity,
                                units::velocity::meters_per_second_t speed_of_sound,
                                units::length::meter_t simulation_size,
                                int initial_simulation_resolution)
+  : FluidSimulator(density,
+                   viscosity,
+                   speed_of_sound,
+                   simulation_size,
+                   initial_simulation_resolution,
+                   true) {}
+
+FluidSimulator::FluidSimulator(units::density::kg_per_cu_m_t density,
+                               units::viscosity::meters_squared_per_s_t viscosity,
+                               units::velocity::meters_per_second_t speed_of_sound,
+                               units::length::meter_t simulation_size,
+                               int initial_simulation_resolution,
+                               bool build_graph)
   : density(density),
     viscosity(viscosity),
     speed_of_sound(speed_of_sound),
-    control_volume_graph(std::make_shared<GraphNode<ControlVolume>>(
-        initial_simulation_resolution, simulation_size.to<double>())) {
+    graph_scale(simulation_size.to<double>()),
+    graph_resolution(initial_simulation_resolution),
+    obstacle_cell_mask(std::make_shared<std::vector<uint8_t>>()),
+    update_method(UpdateMethod::FLAT_ARRAYS),
+    solver_mode(SolverMode::SLIGHTLY_COMPRESSIBLE),
+    steps_since_adaptation(0),
+    steps_per_output_frame(1),
+    steps_since_output_frame(0),
+    num_output_steps(0),
+    thread_pool(std::make_shared<ThreadPool>(1)),
+    simd_level(getBestSimdLevel()),
+    current_fields(std::make_shared<ControlVolumeFields>()),
+    next_fields(std::make_shared<ControlVolumeFields>()),
+    fields_stale(true),
+    graph_stale(false),
+    num_rejected_steps(0),
+    num_cell_updates(0),
+    implicit_diffusion(false),
+    boundary_conditions(legacyBoundaryConditions()),
+    simulation_time(0) {
+    if (build_graph) {
+        buildGraph();
+    }
+}
+
+void FluidSimulator::buildGraph() {
+    if (control_volume_graph) {
+        return;
+    }
+    SIMPLE_CFD_PROFILE_SCOPE("build graph");
+    control_volume_graph =
+        std::make_shared<GraphNode<ControlVolume>>(graph_resolution, graph_scale);
+
     // TODO: This is a sub-ideal way to do things... we should really just set these
     // on every ControlVolume when they are constructed with the graph, but we need
     // to add the capability to multi_res_graph for non-default constructors for
@@ -36,20 +119,690 @@ FluidSimulator::FluidSimulator(units::density::kg_per_cu_m_t density,
                                                viscosity,
                                                speed_of_sound);
     }
+
+    // A restored mesh was built without the graph, so it gets it's nodes now. The
+    // fields are scattered into them when the graph is next synchronised.
+    if (mesh) {
+        mesh         = mesh->withGraphNodes(all_nodes);
+        cell_locator = std::make_shared<const CellLocator>(mesh);
+        invalidateSolvers();
+        graph_stale = true;
+    }
 }
 
 void FluidSimulator::updateControlVolumes(units::time::second_t dt) {
-    auto nodes = control_volume_graph->getAllSubNodes();
-
-    // TODO: Define as class member constants?
-    // A edge volume (currently just a static wall)
-    ControlVolume edge_volume(pascal_t(0),
-                              Velocity2d({0_m / 1_s, 0_m / 1_s}),
-                              density,
-                              viscosity,
-                              speed_of_sound);
-    auto edge_volume_displacement = meter_t(control_volume_graph->getScale() /
-                                            control_volume_graph->getResolution());
+    SIMPLE_CFD_PROFILE_SCOPE("updateControlVolumes");
+
+    // The projection method, mesh refinement, implicit diffusion, and boundaries that
+    // depend on the fields are only implemented on the flat arrays
+    const UpdateMethod method =
+        solver_mode == SolverMode::PROJECTION || mesh_refiner || implicit_diffusion ||
+                !hasFixedEdgeStates(boundary_conditions)
+            ? UpdateMethod::FLAT_ARRAYS
+            : update_method;
+    switch (method) {
+        case UpdateMethod::FLAT_ARRAYS:
+            updateControlVolumesFlat(dt);
+            break;
+        case UpdateMethod::LEGACY_GRAPH:
+            updateControlVolumesLegacy(dt);
+            break;
+    }
+    simulation_time += dt.to<double>();
+    outputFields();
+}
+
+second_t FluidSimulator::updateControlVolumesAdaptive(second_t max_dt) {
+    SIMPLE_CFD_PROFILE_SCOPE("updateControlVolumesAdaptive");
+
+    synchroniseFields();
+
+    double dt =
+        std::min(max_dt.to<double>(), computeStableTimeStep().to<double>());
+    const FieldMagnitudes current_magnitudes = measureFields(*current_fields);
+
+    // The stable time step is only an estimate, so we check the result of each step
+    // and retry with a smaller time step if it looks like it's blowing up
+    const double min_reference_speed = adaptive_parameters.min_reference_speed;
+    const double min_reference_pressure =
+        density.to<double>() * speed_of_sound.to<double>() * min_reference_speed;
+    const double max_speed =
+        adaptive_parameters.max_growth_factor *
+        std::max(current_magnitudes.max_speed, min_reference_speed);
+    const double max_pressure =
+        adaptive_parameters.max_growth_factor *
+        std::max(current_magnitudes.max_pressure, min_reference_pressure);
+    for (int attempt = 0;; attempt++) {
+        computeNextFields(dt);
+
+        const FieldMagnitudes next_magnitudes = measureFields(*next_fields);
+        const bool pressure_bounded = solver_mode == SolverMode::PROJECTION ||
+                                      next_magnitudes.max_pressure <= max_pressure;
+        if (next_magnitudes.all_finite && next_magnitudes.max_speed <= max_speed &&
+            pressure_bounded) {
+            break;
+        }
+        if (attempt >= adaptive_parameters.max_retries) {
+            throw std::runtime_error(
+                "Could not find a stable time step, last tried " +
+                std::to_string(dt) + "s");
+        }
+
+        // Nothing has been committed yet, so rolling back is just trying again
+        num_rejected_steps++;
+        SIMPLE_CFD_PROFILE_COUNT("rejected steps", 1);
+        dt *= adaptive_parameters.retry_factor;
+    }
+
+    commitNextFields();
+    simulation_time += dt;
+    adaptMesh();
+    outputFields();
+
+    return second_t(dt);
+}
+
+second_t FluidSimulator::updateControlVolumesLocal(second_t max_dt) {
+    SIMPLE_CFD_PROFILE_SCOPE("updateControlVolumesLocal");
+
+    if (solver_mode == SolverMode::PROJECTION) {
+        throw std::runtime_error(
+            "Local time stepping is only available in SLIGHTLY_COMPRESSIBLE mode");
+    }
+    requireFixedEdgeStates("Local time stepping");
+
+    synchroniseFields();
+    if (!local_time_stepper) {
+        local_time_stepper =
+            std::make_unique<LocalTimeStepper>(mesh, *obstacle_cell_mask);
+    }
+    const double dt =
+        std::min(max_dt.to<double>(),
+                 computeLevelTimeStep(&local_time_stepper->getCellLevels()));
+
+    // With implicit diffusion every level is stepped inviscid, then the velocity is
+    // diffused over the whole step at once
+    const FluidCoefficients fluid(density.to<double>(),
+                                  implicit_diffusion ? 0 : viscosity.to<double>(),
+                                  speed_of_sound.to<double>());
+    const StencilEdgeStates<double> edges = toEdgeStates(boundary_conditions);
+
+    const ControlVolumeFields& current = *current_fields;
+    ControlVolumeFields& next          = writableNextFields();
+    {
+        SIMPLE_CFD_PROFILE_SCOPE("local time step");
+        SIMPLE_CFD_PROFILE_COUNT("cells updated",
+                                 local_time_stepper->getNumCellUpdatesPerStep());
+        local_time_stepper->step(current, edges, dt, fluid, *thread_pool, next);
+    }
+    if (implicit_diffusion) {
+        SIMPLE_CFD_PROFILE_SCOPE("implicit diffusion");
+        last_diffusion_solve_result = getDiffusionSolver().diffuse(
+            next, edges, dt, viscosity.to<double>(), *thread_pool);
+    }
+    num_cell_updates += local_time_stepper->getNumCellUpdatesPerStep();
+
+    commitNextFields();
+    simulation_time += dt;
+    adaptMesh();
+    outputFields();
+
+    return second_t(dt);
+}
+
+void FluidSimulator::updateControlVolumesBlocked(second_t dt, int num_steps) {
+    SIMPLE_CFD_PROFILE_SCOPE("updateControlVolumesBlocked");
+
+    if (solver_mode == SolverMode::PROJECTION) {
+        throw std::runtime_error(
+            "Temporal blocking is only available in SLIGHTLY_COMPRESSIBLE mode");
+    }
+    if (implicit_diffusion) {
+        throw std::runtime_error("Temporal blocking isn't available with implicit "
+                                 "diffusion");
+    }
+    requireFixedEdgeStates("Temporal blocking");
+
+    const FluidCoefficients fluid(density.to<double>(),
+                                  viscosity.to<double>(),
+                                  speed_of_sound.to<double>());
+    const StencilEdgeStates<double> edges = toEdgeStates(boundary_conditions);
+    for (int step = 0; step < num_steps;) {
+        synchroniseFields();
+        if (!temporal_block_stepper) {
+            temporal_block_stepper = std::make_unique<TemporalBlockStepper>(
+                mesh, *obstacle_cell_mask, edges, temporal_blocking_parameters);
+        }
+        // Blocks end where a step would adapt the mesh or output a frame, so those
+        // happen after the same steps as when stepping one at a time
+        int block_steps =
+            std::min(num_steps - step, temporal_blocking_parameters.steps_per_block);
+        if (mesh_refiner) {
+            const int steps_between_adaptations =
+                mesh_refiner->getParameters().steps_between_adaptations;
+            block_steps = std::min(block_steps,
+                                   steps_between_adaptations - steps_since_adaptation);
+        }
+        if (field_output) {
+            block_steps = std::min(block_steps,
+                                   steps_per_output_frame - steps_since_output_frame);
+        }
+
+        const TemporalBlockStepper& stepper = *temporal_block_stepper;
+        const ControlVolumeFields& current  = *current_fields;
+        ControlVolumeFields& next           = writableNextFields();
+        {
+            SIMPLE_CFD_PROFILE_SCOPE("temporal block");
+            SIMPLE_CFD_PROFILE_COUNT("cells updated",
+                                     stepper.getNumCellUpdates(block_steps));
+            stepper.step(
+                current, dt.to<double>(), fluid, block_steps, *thread_pool, next);
+        }
+        num_cell_updates += mesh->numCells() * block_steps;
+
+        commitNextFields();
+        simulation_time += dt.to<double>() * block_steps;
+        adaptMesh(block_steps);
+        outputFields(block_steps);
+        step += block_steps;
+    }
+}
+
+void FluidSimulator::setTemporalBlockingParameters(
+    TemporalBlockingParameters parameters) {
+    if (parameters.tile_size < 1) {
+        throw std::invalid_argument("Tile size must be at least 1");
+    }
+    if (parameters.steps_per_block < 1) {
+        throw std::invalid_argument("Steps per block must be at least 1");
+    }
+    temporal_blocking_parameters = parameters;
+    invalidateSolvers();
+}
+
+TemporalBlockingParameters FluidSimulator::getTemporalBlockingParameters() const {
+    return temporal_blocking_parameters;
+}
+
+second_t FluidSimulator::computeStableTimeStep() {
+    synchroniseFields();
+    return second_t(computeLevelTimeStep(nullptr));
+}
+
+double FluidSimulator::computeLevelTimeStep(const std::vector<int>* cell_levels) {
+    // Implicit diffusion is stable for any time step
+    const double c  = speed_of_sound.to<double>();
+    const double nu = implicit_diffusion ? 0 : viscosity.to<double>();
+
+    // There are no pressure waves to resolve in incompressible flow
+    const bool acoustic_limit = solver_mode != SolverMode::PROJECTION;
+
+    std::array<const std::vector<double>*, NUM_DIRECTIONS> distances;
+    for (int direction = 0; direction < NUM_DIRECTIONS; direction++) {
+        distances[direction] =
+            &mesh->getNeighbourDistances(static_cast<Direction>(direction));
+    }
+
+    const double min_dt = thread_pool->parallelReduce(
+        mesh->numCells(),
+        std::numeric_limits<double>::infinity(),
+        [&](size_t begin, size_t end) {
+            double chunk_min_dt = std::numeric_limits<double>::infinity();
+            for (size_t i = begin; i < end; i++) {
+                double h = (*distances[LEFT])[i];
+                for (int direction = 1; direction < NUM_DIRECTIONS; direction++) {
+                    h = std::min(h, (*distances[direction])[i]);
+                }
+                const double speed = std::hypot(current_fields->velocity_x[i],
+                                                current_fields->velocity_y[i]);
+
+                const double acoustic_dt =
+                    acoustic_limit ? h / (c + speed)
+                                   : std::numeric_limits<double>::infinity();
+                const double advective_dt = speed > 0
+                                                ? h / speed
+                                                : std::numeric_limits<double>::infinity();
+                const double viscous_dt = nu > 0
+                                              ? h * h / (4 * nu)
+                                              : std::numeric_limits<double>::infinity();
+                const double cell_dt =
+                    std::min({acoustic_dt, advective_dt, viscous_dt});
+
+                // A cell at level k only has to be stable for 1 / 2^k of the step
+                const int level = cell_levels ? (*cell_levels)[i] : 0;
+                chunk_min_dt    = std::min(chunk_min_dt, std::ldexp(cell_dt, level));
+            }
+            return chunk_min_dt;
+        },
+        [](double a, double b) { return std::min(a, b); });
+
+    return adaptive_parameters.cfl_number * min_dt;
+}
+
+FluidSimulator::FieldMagnitudes
+    FluidSimulator::measureFields(const ControlVolumeFields& fields) {
+    return thread_pool->parallelReduce(
+        fields.size(),
+        FieldMagnitudes{0, 0, true},
+        [&](size_t begin, size_t end) {
+            FieldMagnitudes chunk_magnitudes = {0, 0, true};
+            for (size_t i = begin; i < end; i++) {
+                const double speed =
+                    std::hypot(fields.velocity_x[i], fields.velocity_y[i]);
+                const double pressure = std::abs(fields.pressure[i]);
+                chunk_magnitudes.all_finite = chunk_magnitudes.all_finite &&
+                                              std::isfinite(speed) &&
+                                              std::isfinite(pressure);
+                chunk_magnitudes.max_speed = std::max(chunk_magnitudes.max_speed, speed);
+                chunk_magnitudes.max_pressure =
+                    std::max(chunk_magnitudes.max_pressure, pressure);
+            }
+            return chunk_magnitudes;
+        },
+        [](const FieldMagnitudes& a, const FieldMagnitudes& b) {
+            return FieldMagnitudes{std::max(a.max_speed, b.max_speed),
+                                   std::max(a.max_pressure, b.max_pressure),
+                                   a.all_finite && b.all_finite};
+        });
+}
+
+void FluidSimulator::setAdaptiveTimeStepParameters(
+    AdaptiveTimeStepParameters parameters) {
+    adaptive_parameters = parameters;
+}
+
+int FluidSimulator::getNumRejectedSteps() const {
+    return num_rejected_steps;
+}
+
+uint64_t FluidSimulator::getNumCellUpdates() const {
+    return num_cell_updates;
+}
+
+second_t FluidSimulator::getSimulationTime() const {
+    return second_t(simulation_time);
+}
+
+size_t FluidSimulator::getNumControlVolumes() {
+    synchroniseFields();
+    return mesh->numCells();
+}
+
+void FluidSimulator::setUpdateMethod(UpdateMethod update_method) {
+    this->update_method = update_method;
+}
+
+void FluidSimulator::setSolverMode(SolverMode solver_mode) {
+    this->solver_mode = solver_mode;
+}
+
+SolverMode FluidSimulator::getSolverMode() const {
+    return solver_mode;
+}
+
+LinearSolveResult FluidSimulator::getLastPressureSolveResult() const {
+    return last_pressure_solve_result;
+}
+
+void FluidSimulator::setBoundaryConditions(const BoundaryConditions& conditions) {
+    validateBoundaryConditions(conditions);
+    boundary_conditions = conditions;
+    invalidateSolvers();
+}
+
+const BoundaryConditions& FluidSimulator::getBoundaryConditions() const {
+    return boundary_conditions;
+}
+
+void FluidSimulator::enableImplicitDiffusion(ImplicitDiffusionParameters parameters) {
+    if (!(parameters.implicitness >= 0.5 && parameters.implicitness <= 1)) {
+        throw std::invalid_argument("Implicitness must be between 0.5 and 1");
+    }
+    implicit_diffusion   = true;
+    diffusion_parameters = parameters;
+    invalidateSolvers();
+}
+
+void FluidSimulator::disableImplicitDiffusion() {
+    implicit_diffusion = false;
+    invalidateSolvers();
+}
+
+DiffusionSolveResult FluidSimulator::getLastDiffusionSolveResult() const {
+    return last_diffusion_solve_result;
+}
+
+bool FluidSimulator::isImplicitDiffusionEnabled() const {
+    return implicit_diffusion;
+}
+
+void FluidSimulator::enableMeshRefinement(RefinementParameters parameters) {
+    // Start again from the graph, so the refiner starts from the unrefined mesh
+    invalidateTopology();
+    synchroniseFields();
+    mesh_refiner           = std::make_unique<MeshRefiner>(mesh, parameters);
+    steps_since_adaptation = 0;
+}
+
+void FluidSimulator::disableMeshRefinement() {
+    invalidateTopology();
+    mesh_refiner = nullptr;
+}
+
+void FluidSimulator::setFieldOutput(std::shared_ptr<FieldSeriesWriter> writer,
+                                    int steps_per_frame) {
+    if (steps_per_frame < 1) {
+        throw std::invalid_argument("Steps per frame must be at least 1");
+    }
+    field_output             = std::move(writer);
+    steps_per_output_frame   = steps_per_frame;
+    steps_since_output_frame = 0;
+    num_output_steps         = 0;
+}
+
+void FluidSimulator::setNumThreads(int num_threads) {
+    if (num_threads != thread_pool->getNumThreads()) {
+        thread_pool = std::make_shared<ThreadPool>(num_threads);
+    }
+}
+
+int FluidSimulator::getNumThreads() const {
+    return thread_pool->getNumThreads();
+}
+
+void FluidSimulator::setSimdLevel(SimdLevel simd_level) {
+    if (!isSimdLevelSupported(simd_level)) {
+        throw std::invalid_argument("SIMD level not supported by this CPU");
+    }
+    this->simd_level = simd_level;
+}
+
+SimdLevel FluidSimulator::getSimdLevel() const {
+    return simd_level;
+}
+
+void FluidSimulator::invalidateTopology() {
+    synchroniseGraph();
+    mesh         = nullptr;
+    fields_stale = true;
+    graph_nodes.clear();
+}
+
+void FluidSimulator::synchroniseFields() {
+    const bool new_mesh = !mesh;
+    if (new_mesh) {
+        SIMPLE_CFD_PROFILE_SCOPE("build mesh");
+        mesh         = std::make_shared<const ControlVolumeMesh>(*control_volume_graph);
+        cell_locator = std::make_shared<const CellLocator>(mesh);
+        fields_stale = true;
+
+        invalidateSolvers();
+        if (mesh_refiner) {
+            mesh_refiner =
+                std::make_unique<MeshRefiner>(mesh, mesh_refiner->getParameters());
+        }
+
+        rebuildObstacleMask();
+    }
+    if (fields_stale) {
+        SIMPLE_CFD_PROFILE_SCOPE("gather fields");
+        // Only the nodes changed through the graph are gathered into an existing
+        // mesh, so the cells of a refined mesh keep their values when the graph has
+        // only been read
+        if (new_mesh) {
+            mesh->gatherFields(writableCurrentFields());
+        } else {
+            mesh->gatherChangedFields(writableCurrentFields());
+        }
+        fields_stale = false;
+    }
+}
+
+void FluidSimulator::synchroniseGraph() {
+    buildGraph();
+    if (graph_stale) {
+        SIMPLE_CFD_PROFILE_SCOPE("scatter fields");
+        mesh->scatterFields(*current_fields);
+        graph_stale = false;
+    }
+}
+
+ControlVolumeFields& FluidSimulator::writableCurrentFields() {
+    if (!isUniquelyOwned(current_fields)) {
+        current_fields = std::make_shared<ControlVolumeFields>(*current_fields);
+    }
+    return *current_fields;
+}
+
+ControlVolumeFields& FluidSimulator::writableNextFields() {
+    // Every value of the next fields is overwritten, so a shared buffer is replaced
+    // rather than copied
+    if (!isUniquelyOwned(next_fields)) {
+        next_fields = std::make_shared<ControlVolumeFields>();
+    }
+    next_fields->resize(current_fields->size());
+    return *next_fields;
+}
+
+std::vector<uint8_t>& FluidSimulator::writableObstacleCellMask() {
+    if (!isUniquelyOwned(obstacle_cell_mask)) {
+        obstacle_cell_mask =
+            std::make_shared<std::vector<uint8_t>>(*obstacle_cell_mask);
+    }
+    return *obstacle_cell_mask;
+}
+
+void FluidSimulator::updateControlVolumesFlat(units::time::second_t dt) {
+    synchroniseFields();
+    computeNextFields(dt.to<double>());
+    commitNextFields();
+    adaptMesh();
+}
+
+void FluidSimulator::adaptMesh(int num_steps) {
+    if (!mesh_refiner) {
+        return;
+    }
+    const RefinementParameters& parameters = mesh_refiner->getParameters();
+    steps_since_adaptation += num_steps;
+    if (steps_since_adaptation < parameters.steps_between_adaptations) {
+        return;
+    }
+    steps_since_adaptation = 0;
+    SIMPLE_CFD_PROFILE_SCOPE("adapt mesh");
+
+    // `next_fields` holds the fields from before the last step
+    if (!mesh_refiner->adapt(*next_fields, writableCurrentFields(), *thread_pool)) {
+        return;
+    }
+
+    // Cells lie within the graph node they were split from, so they are covered by
+    // the same obstacles
+    mesh         = mesh_refiner->getMesh();
+    cell_locator = std::make_shared<const CellLocator>(mesh);
+    invalidateSolvers();
+    rebuildObstacleMask();
+    graph_stale = true;
+}
+
+void FluidSimulator::outputFields(int num_steps) {
+    if (!field_output) {
+        return;
+    }
+    num_output_steps += num_steps;
+    steps_since_output_frame += num_steps;
+    if (steps_since_output_frame < steps_per_output_frame) {
+        return;
+    }
+    steps_since_output_frame = 0;
+    SIMPLE_CFD_PROFILE_SCOPE("output fields");
+
+    takeSnapshot(output_snapshot);
+    output_snapshot.num_steps = num_output_steps;
+    field_output->write(output_snapshot);
+}
+
+void FluidSimulator::computeNextFields(double dt) {
+    SIMPLE_CFD_PROFILE_SCOPE("compute next fields");
+    if (solver_mode == SolverMode::PROJECTION) {
+        requireFixedEdgeStates("PROJECTION mode");
+    }
+    if (implicit_diffusion) {
+        requireFixedEdgeStates("Implicit diffusion");
+    }
+    SIMPLE_CFD_PROFILE_COUNT("cells updated", mesh->numCells());
+    num_cell_updates += mesh->numCells();
+
+    // With implicit diffusion the explicit part of the step is inviscid
+    const FluidCoefficients fluid(density.to<double>(),
+                                  implicit_diffusion ? 0 : viscosity.to<double>(),
+                                  speed_of_sound.to<double>());
+
+    // The edge cells go through the ghost layer, so outside the projection step and
+    // implicit diffusion only the top velocity override of these is read
+    const StencilEdgeStates<double> edges = toEdgeStates(boundary_conditions);
+
+    const ControlVolumeFields& current = *current_fields;
+    ControlVolumeFields& next          = writableNextFields();
+
+    if (solver_mode == SolverMode::PROJECTION) {
+        SIMPLE_CFD_PROFILE_SCOPE("projection step");
+        if (!projection_solver) {
+            projection_solver =
+                std::make_unique<ProjectionSolver>(mesh, *obstacle_cell_mask);
+        }
+        ImplicitDiffusionSolver* diffusion =
+            implicit_diffusion ? &getDiffusionSolver() : nullptr;
+        last_pressure_solve_result = projection_solver->step(current,
+                                                             edges,
+                                                             dt,
+                                                             fluid.density,
+                                                             viscosity.to<double>(),
+                                                             *thread_pool,
+                                                             next,
+                                                             diffusion);
+        if (diffusion) {
+            last_diffusion_solve_result = diffusion->getLastResult();
+        }
+        return;
+    }
+
+    // Every cell only reads `current_fields` and writes it's own entry in
+    // `next_fields`, so any split of the cells between threads gives the same result
+
+    // Cells at the edge of the mesh, with their neighbours (and the ghost cells beyond
+    // the edge) gathered up front
+    if (!ghost_layer) {
+        ghost_layer = std::make_unique<GhostCellLayer>(mesh, boundary_conditions);
+    }
+    {
+        SIMPLE_CFD_PROFILE_SCOPE("fill ghost cells");
+        ghost_layer->fill(current);
+    }
+    thread_pool->parallelFor(ghost_layer->numCells(), [&](size_t begin, size_t end) {
+        SIMPLE_CFD_PROFILE_SCOPE("edge cells");
+        ghost_layer->updateCells(begin, end, current, dt, fluid, next);
+    });
+
+    // Cells at a change in resolution
+    const std::vector<int>& resolution_change_cells = mesh->getResolutionChangeCells();
+    thread_pool->parallelFor(
+        resolution_change_cells.size(), [&](size_t begin, size_t end) {
+            SIMPLE_CFD_PROFILE_SCOPE("resolution change cells");
+            updateScalarCells<double, false, false>(*mesh,
+                                                    resolution_change_cells,
+                                                    begin,
+                                                    end,
+                                                    current,
+                                                    edges,
+                                                    dt,
+                                                    fluid,
+                                                    next);
+        });
+
+    // Cells in the interior of same-resolution blocks, several at a time
+    const UniformStencilCells& uniform_cells = mesh->getUniformCells();
+    thread_pool->parallelFor(uniform_cells.size(), [&](size_t begin, size_t end) {
+        SIMPLE_CFD_PROFILE_SCOPE("uniform cells");
+        updateUniformCells(simd_level,
+                           uniform_cells,
+                           begin,
+                           end,
+                           current,
+                           edges.override_top_velocity ? &edges.top_velocity_override
+                                                       : nullptr,
+                           dt,
+                           fluid,
+                           next);
+    });
+
+    if (implicit_diffusion) {
+        SIMPLE_CFD_PROFILE_SCOPE("implicit diffusion");
+        last_diffusion_solve_result = getDiffusionSolver().diffuse(
+            next, edges, dt, viscosity.to<double>(), *thread_pool);
+    }
+}
+
+void FluidSimulator::requireFixedEdgeStates(const std::string& feature) const {
+    if (!hasFixedEdgeStates(boundary_conditions)) {
+        throw std::runtime_error(feature + " only supports INFLOW boundaries");
+    }
+}
+
+ImplicitDiffusionSolver& FluidSimulator::getDiffusionSolver() {
+    if (!diffusion_solver) {
+        diffusion_solver = std::make_unique<ImplicitDiffusionSolver>(
+            mesh, *obstacle_cell_mask, diffusion_parameters);
+    }
+    return *diffusion_solver;
+}
+
+void FluidSimulator::commitNextFields() {
+    SIMPLE_CFD_PROFILE_SCOPE("commit next fields");
+
+    // After figuring out new values for every cell, they become the current values
+    std::swap(current_fields, next_fields);
+
+    // Set fluid velocity and pressure to 0 for all cells within obstacles. The new
+    // current fields were written by this step, so they aren't shared yet.
+    ControlVolumeFields& current = *current_fields;
+    thread_pool->parallelFor(obstacle_cells.size(), [&](size_t begin, size_t end) {
+        SIMPLE_CFD_PROFILE_SCOPE("obstacle masking");
+        for (size_t k = begin; k < end; k++) {
+            const int i           = obstacle_cells[k];
+            current.pressure[i]   = 0;
+            current.velocity_x[i] = 0;
+            current.velocity_y[i] = 0;
+        }
+    });
+
+    graph_stale = true;
+}
+
+void FluidSimulator::updateControlVolumesLegacy(units::time::second_t dt) {
+    SIMPLE_CFD_PROFILE_SCOPE("legacy update");
+    synchroniseGraph();
+    fields_stale = true;
+
+    const std::vector<RealNode<ControlVolume>*>& nodes = getGraphNodes();
+    num_cell_updates += nodes.size();
+
+    // The volumes outside each edge. This is only used with INFLOW boundaries, so
+    // they have a fixed state.
+    const StencilEdgeStates<double> edges = toEdgeStates(boundary_conditions);
+    auto edge_volume = [&](const CellState& state) {
+        return ControlVolume(pascal_t(state.pressure),
+                             Velocity2d({meters_per_second_t(state.velocity_x),
+                                         meters_per_second_t(state.velocity_y)}),
+                             density,
+                             viscosity,
+                             speed_of_sound);
+    };
+    const ControlVolume left_edge_volume   = edge_volume(edges.left);
+    const ControlVolume right_edge_volume  = edge_volume(edges.right);
+    const ControlVolume top_edge_volume    = edge_volume(edges.top);
+    const ControlVolume bottom_edge_volume = edge_volume(edges.bottom);
+    auto edge_volume_displacement = meter_t(graph_scale / graph_resolution);
 
     // NOTE: This is a bit of a hack, but it'll become irrelevant eventually anyhow
     for (auto& node : nodes) {
@@ -57,7 +810,7 @@ void FluidSimulator::updateControlVolumes(units::time::second_t dt) {
         node->containedValue().new_velocity = node->containedValue().getVelocity();
     }
 
-    for (auto& node : nodes) {
+    for (RealNode<ControlVolume>* node : nodes) {
         std::shared_ptr<RealNode<ControlVolume>> left_neighbour_ptr =
             node->getLeftNeighbour();
         std::shared_ptr<RealNode<ControlVolume>> right_neighbour_ptr =
@@ -78,28 +831,28 @@ void FluidSimulator::updateControlVolumes(units::time::second_t dt) {
             left_neighbour_distance = meter_t(std::abs(
                 left_neighbour_ptr->getCoordinates().x - node->getCoordinates().x));
         } else {
-            left_neighbour          = edge_volume;
+            left_neighbour          = left_edge_volume;
             left_neighbour_distance = edge_volume_displacement;
-            // TODO: Delete me
-            left_neighbour.setVelocity({meters_per_second_t(1), meters_per_second_t(0)});
         }
         if (right_neighbour_ptr) {
             right_neighbour          = right_neighbour_ptr->containedValue();
             right_neighbour_distance = meter_t(std::abs(
                 right_neighbour_ptr->getCoordinates().x - node->getCoordinates().x));
         } else {
-            right_neighbour          = edge_volume;
+            right_neighbour          = right_edge_volume;
             right_neighbour_distance = edge_volume_displacement;
-            // TODO: Delete me
-            right_neighbour.setVelocity({meters_per_second_t(2), meters_per_second_t(0)});
         }
         if (top_neighbour_ptr) {
             top_neighbour          = top_neighbour_ptr->containedValue();
             top_neighbour_distance = meter_t(std::abs(
                 top_neighbour_ptr->getCoordinates().y - node->getCoordinates().y));
-            top_neighbour.setVelocity({meters_per_second_t(0), meters_per_second_t(1)});
+            if (edges.override_top_velocity) {
+                top_neighbour.setVelocity(
+                    {meters_per_second_t(edges.top_velocity_override.velocity_x),
+                     meters_per_second_t(edges.top_velocity_override.velocity_y)});
+            }
         } else {
-            top_neighbour          = edge_volume;
+            top_neighbour          = top_edge_volume;
             top_neighbour_distance = edge_volume_displacement;
         }
         if (bottom_neighbour_ptr) {
@@ -107,9 +860,8 @@ void FluidSimulator::updateControlVolumes(units::time::second_t dt) {
             bottom_neighbour_distance = meter_t(std::abs(
                 bottom_neighbour_ptr->getCoordinates().y - node->getCoordinates().y));
         } else {
-            bottom_neighbour          = edge_volume;
+            bottom_neighbour          = bottom_edge_volume;
             bottom_neighbour_distance = edge_volume_displacement;
-            bottom_neighbour.setVelocity({meters_per_second_t(0), meters_per_second_t(2)});
         }
 
         // Figure out new values for the volume
@@ -130,7 +882,14 @@ void FluidSimulator::updateControlVolumes(units::time::second_t dt) {
     }
 
     // Set fluid velocity and pressure to 0 for all control volumes within obstacles
-    for (auto& node : nodes) {
+    for (size_t n = 0; n < nodes.size(); n++) {
+        auto& node = nodes[n];
+        if (!restored_obstacle_nodes.empty() && restored_obstacle_nodes[n]) {
+            node->containedValue().setVelocity(
+                {meters_per_second_t(0), meters_per_second_t(0)});
+            node->containedValue().setPressure(pascal_t(0));
+            continue;
+        }
         for (auto& obstacle : obstacles) {
             if (obstacle->overlapsNode(*node)) {
                 ControlVolume& control_volume = node->containedValue();
@@ -145,16 +904,267 @@ void FluidSimulator::updateControlVolumes(units::time::second_t dt) {
 }
 
 std::shared_ptr<GraphNode<ControlVolume>> FluidSimulator::getControlVolumeGraph() {
+    synchroniseGraph();
+
+    // The caller may modify the values in the graph
+    fields_stale = true;
+
     return control_volume_graph;
 }
 
 void FluidSimulator::setControlVolumeGraph(
     std::shared_ptr<GraphNode<ControlVolume>> graph) {
+    // There's no old graph to bring up to date if it was never built
+    if (control_volume_graph) {
+        synchroniseGraph();
+    }
+
     control_volume_graph = std::move(graph);
+    graph_scale          = control_volume_graph->getScale();
+    graph_resolution     = control_volume_graph->getResolution();
+    mesh                 = nullptr;
+    graph_nodes.clear();
+    fields_stale         = true;
+    graph_stale          = false;
+    restored_obstacle_nodes.clear();
 }
 
 void FluidSimulator::addObstacle(std::shared_ptr<Area<ControlVolume>> obstacle) {
+    // The cells an obstacle covers are found from their graph nodes
+    buildGraph();
     obstacles.emplace_back(std::shared_ptr(obstacle->clone()));
+
+    // If the mesh hasn't been built yet, the mask will be built along with it
+    if (mesh) {
+        addObstacleToMask(*obstacles.back());
+        rebuildObstacleCellList();
+        invalidateSolvers();
+    }
+}
+
+void FluidSimulator::invalidateSolvers() {
+    projection_solver      = nullptr;
+    local_time_stepper     = nullptr;
+    diffusion_solver       = nullptr;
+    ghost_layer            = nullptr;
+    temporal_block_stepper = nullptr;
+}
+
+void FluidSimulator::rebuildObstacleMask() {
+    // The old mask may be shared with a snapshot, so this always starts a new one
+    obstacle_cell_mask = std::make_shared<std::vector<uint8_t>>(mesh->numCells(), 0);
+    if (!restored_obstacle_nodes.empty()) {
+        const std::vector<int>& node_indices = mesh->getNodeIndices();
+        for (size_t i = 0; i < node_indices.size(); i++) {
+            (*obstacle_cell_mask)[i] = restored_obstacle_nodes[node_indices[i]];
+        }
+    }
+    for (auto& obstacle : obstacles) {
+        addObstacleToMask(*obstacle);
+    }
+    rebuildObstacleCellList();
+}
+
+void FluidSimulator::addObstacleToMask(Area<ControlVolume>& obstacle) {
+    const std::vector<std::shared_ptr<RealNode<ControlVolume>>>& nodes =
+        mesh->getNodes();
+    std::vector<uint8_t>& mask = writableObstacleCellMask();
+    thread_pool->parallelFor(nodes.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            if (!mask[i] && obstacle.overlapsNode(*nodes[i])) {
+                mask[i] = 1;
+            }
+        }
+    });
+}
+
+void FluidSimulator::rebuildObstacleCellList() {
+    const std::vector<uint8_t>& mask = *obstacle_cell_mask;
+    obstacle_cells.clear();
+    for (size_t i = 0; i < mask.size(); i++) {
+        if (mask[i]) {
+            obstacle_cells.emplace_back(i);
+        }
+    }
+}
+
+const std::vector<std::shared_ptr<RealNode<ControlVolume>>>&
+    FluidSimulator::getControlVolumeNodes() {
+    synchroniseFields();
+    synchroniseGraph();
+    return mesh->getNodes();
+}
+
+NodeSpan<ControlVolume> FluidSimulator::getControlVolumeCells() {
+    synchroniseFields();
+    synchroniseGraph();
+    return mesh->getNodeSpan();
+}
+
+const std::vector<RealNode<ControlVolume>*>& FluidSimulator::getGraphNodes() {
+    if (graph_nodes.empty()) {
+        for (const std::shared_ptr<RealNode<ControlVolume>>& node :
+             control_volume_graph->getAllSubNodes()) {
+            graph_nodes.emplace_back(node.get());
+        }
+    }
+    return graph_nodes;
+}
+
+const std::vector<uint8_t>& FluidSimulator::getObstacleCellMask() {
+    synchroniseFields();
+    return *obstacle_cell_mask;
+}
+
+meter_t FluidSimulator::getSimulationSize() const {
+    return meter_t(graph_scale);
+}
+
+kg_per_cu_m_t FluidSimulator::getDensity() const {
+    return density;
+}
+
+meters_squared_per_s_t FluidSimulator::getViscosity() const {
+    return viscosity;
+}
+
+meters_per_second_t FluidSimulator::getSpeedOfSound() const {
+    return speed_of_sound;
+}
+
+void FluidSimulator::takeSnapshot(FieldSnapshot& snapshot) {
+    synchroniseFields();
+
+    snapshot.mesh               = mesh;
+    snapshot.cell_locator       = cell_locator;
+    snapshot.fields             = *current_fields;
+    snapshot.obstacle_cell_mask = *obstacle_cell_mask;
+    snapshot.simulation_size    = graph_scale;
+    snapshot.simulation_time    = simulation_time;
+}
+
+void FluidSimulator::buildFieldPyramid(FieldPyramid& pyramid) {
+    SIMPLE_CFD_PROFILE_SCOPE("buildFieldPyramid");
+    synchroniseFields();
+
+    pyramid.build(mesh,
+                  *current_fields,
+                  *obstacle_cell_mask,
+                  graph_scale,
+                  *thread_pool);
+}
+
+SharedFieldSnapshot FluidSimulator::shareSnapshot() {
+    synchroniseFields();
+
+    SharedFieldSnapshot snapshot;
+    snapshot.mesh               = mesh;
+    snapshot.cell_locator       = cell_locator;
+    snapshot.fields             = current_fields;
+    snapshot.obstacle_cell_mask = obstacle_cell_mask;
+    snapshot.simulation_size    = graph_scale;
+    snapshot.simulation_time    = simulation_time;
+    return snapshot;
+}
+
+void FluidSimulator::takeCheckpoint(CheckpointState& state) {
+    takeSnapshot(state.snapshot);
+    state.density          = density.to<double>();
+    state.viscosity        = viscosity.to<double>();
+    state.speed_of_sound   = speed_of_sound.to<double>();
+    state.graph_resolution = graph_resolution;
+
+    state.boundary_conditions  = boundary_conditions;
+    state.solver_mode          = solver_mode;
+    state.implicit_diffusion   = implicit_diffusion;
+    state.diffusion_parameters = diffusion_parameters;
+
+    // A graph that hasn't been built yet would be built with a node in every cell of
+    // it's grid
+    const size_t grid_size = static_cast<size_t>(graph_resolution) * graph_resolution;
+    state.num_graph_nodes  = control_volume_graph ? getGraphNodes().size() : grid_size;
+}
+
+void FluidSimulator::writeCheckpoint(const std::string& path) {
+    CheckpointState state;
+    takeCheckpoint(state);
+    ::writeCheckpoint(path, state);
+}
+
+FluidSimulator FluidSimulator::restoreCheckpoint(const std::string& path) {
+    const MappedCheckpoint checkpoint(path);
+    // The graph is left to be built when it's needed, as building it costs about as
+    // much as a step
+    FluidSimulator simulator(kg_per_cu_m_t(checkpoint.getDensity()),
+                             meters_squared_per_s_t(checkpoint.getViscosity()),
+                             meters_per_second_t(checkpoint.getSpeedOfSound()),
+                             meter_t(checkpoint.getSimulationSize()),
+                             checkpoint.getGraphResolution(),
+                             false);
+
+    // The graph will be built with a node in every cell of it's grid. The checkpoint
+    // has already checked every cell's node index is within it's number of nodes.
+    const size_t num_graph_nodes = static_cast<size_t>(simulator.graph_resolution) *
+                                   simulator.graph_resolution;
+    if (num_graph_nodes != checkpoint.numGraphNodes()) {
+        throw std::runtime_error(path + ": the checkpoint doesn't match it's graph");
+    }
+
+    const size_t num_cells      = checkpoint.numCells();
+    const int32_t* node_indices = checkpoint.getNodeIndices();
+
+    std::array<std::vector<int>, NUM_DIRECTIONS> neighbours;
+    for (int direction = 0; direction < NUM_DIRECTIONS; direction++) {
+        const int32_t* direction_neighbours =
+            checkpoint.getNeighbours(static_cast<Direction>(direction));
+        neighbours[direction].assign(direction_neighbours,
+                                     direction_neighbours + num_cells);
+    }
+    simulator.mesh = std::make_shared<const ControlVolumeMesh>(
+        std::vector<std::shared_ptr<RealNode<ControlVolume>>>(),
+        std::vector<int>(node_indices, node_indices + num_cells),
+        std::vector<double>(checkpoint.getCellX(), checkpoint.getCellX() + num_cells),
+        std::vector<double>(checkpoint.getCellY(), checkpoint.getCellY() + num_cells),
+        std::vector<double>(checkpoint.getCellScale(),
+                            checkpoint.getCellScale() + num_cells),
+        std::move(neighbours),
+        checkpoint.getEdgeDistance());
+    simulator.cell_locator = std::make_shared<const CellLocator>(simulator.mesh);
+
+    ControlVolumeFields& fields = *simulator.current_fields;
+    fields.pressure.assign(checkpoint.getPressure(),
+                           checkpoint.getPressure() + num_cells);
+    fields.velocity_x.assign(checkpoint.getVelocityX(),
+                             checkpoint.getVelocityX() + num_cells);
+    fields.velocity_y.assign(checkpoint.getVelocityY(),
+                             checkpoint.getVelocityY() + num_cells);
+
+    // Obstacles are restored as the graph nodes they covered, so they still apply if
+    // the mesh is rebuilt from the graph
+    const uint8_t* cell_mask                 = checkpoint.getObstacleCellMask();
+    std::vector<uint8_t>& restored_obstacles = simulator.restored_obstacle_nodes;
+    bool any_obstacles                       = false;
+    restored_obstacles.assign(num_graph_nodes, 0);
+    for (size_t i = 0; i < num_cells; i++) {
+        if (cell_mask[i]) {
+            restored_obstacles[node_indices[i]] = 1;
+            any_obstacles                       = true;
+        }
+    }
+    if (!any_obstacles) {
+        restored_obstacles.clear();
+    }
+    simulator.rebuildObstacleMask();
+
+    simulator.boundary_conditions  = checkpoint.getBoundaryConditions();
+    simulator.solver_mode          = checkpoint.getSolverMode();
+    simulator.implicit_diffusion   = checkpoint.isImplicitDiffusionEnabled();
+    simulator.diffusion_parameters = checkpoint.getDiffusionParameters();
+
+    simulator.simulation_time = checkpoint.getSimulationTime();
+    simulator.fields_stale    = false;
+    simulator.graph_stale     = true;
+    return simulator;
 }
 
 std::vector<std::shared_ptr<Area<ControlVolume>>> FluidSimulator::getObstacles() {
@@ -169,37 +1179,23 @@ std::vector<std::shared_ptr<Area<ControlVolume>>> FluidSimulator::getObstacles()
 
 std::vector<Point2d> FluidSimulator::getStreamLinePoints(
     Point2d start_point, meter_t line_length, meter_t distance_between_points) {
-    int num_points = ceil(line_length / distance_between_points);
-
-    std::vector<Point2d> points;
-    Point2d curr_point = start_point;
-
-    for (int point_index = 0; point_index < num_points; point_index++) {
-        points.emplace_back(curr_point);
-
-        // Figure out what control volume we're currently in
-        std::shared_ptr<RealNode<ControlVolume>> control_volume_node =
-            *(control_volume_graph->getClosestNodeToCoordinates(
-                {curr_point.x.to<double>(), curr_point.y.to<double>()}));
-        ControlVolume& control_volume = control_volume_node->containedValue();
-
-        // Figure out the direction the particle should be traveling in
-        Velocity2d velocity = control_volume.getVelocity();
-        double velocity_magnitude =
-            sqrt(pow<2>(velocity.x) + pow<2>(velocity.y)).to<double>();
-        if (velocity_magnitude == 0) {
-            // TODO: Comment here or do this more elegantly,
-            // we basically just add the same point a bunch of times to the return list
-            continue;
-        }
-        // TODO: Better variable names here
-        double velocity_x_unit = velocity.x.to<double>() / velocity_magnitude;
-        double velocity_y_unit = velocity.y.to<double>() / velocity_magnitude;
+    SIMPLE_CFD_PROFILE_SCOPE("getStreamLinePoints");
+    synchroniseFields();
 
-        // Update the current point
-        curr_point.x += velocity_x_unit * distance_between_points;
-        curr_point.y += velocity_y_unit * distance_between_points;
-    }
+    StreamLineOptions options;
+    options.integrator        = StreamLineIntegrator::EULER;
+    options.velocity_sampling = VelocitySampling::NEAREST_CELL;
+    return traceStreamLine(*cell_locator, *current_fields, start_point, line_length,
+                           distance_between_points, options);
+}
+
+std::vector<std::vector<Point2d>>
+    FluidSimulator::getStreamLines(const std::vector<Point2d>& start_points,
+                                   meter_t line_length,
+                                   meter_t distance_between_points,
+                                   StreamLineOptions options) {
+    synchroniseFields();
 
-    return points;
+    return traceStreamLines(*cell_locator, *current_fields, start_points, line_length,
+                            distance_between_points, options, *thread_pool);
 }
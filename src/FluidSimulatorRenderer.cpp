@@ -1,9 +1,11 @@
 // STD Includes
+#include <algorithm>
 #include <cmath>
 #include <ctime>
 #include <experimental/optional>
 #include <iostream>
 #include <math.h>
+#include <thread>
 
 // External Library Includes
 #include <cairomm/context.h>
@@ -14,6 +16,7 @@
 // Project Includes
 #include "ControlVolume.h"
 #include "FluidSimulatorRenderer.h"
+#include "Profiler.h"
 
 using namespace units;
 using namespace units::literals;
@@ -24,156 +27,156 @@ using namespace units::density;
 using namespace units::pressure;
 using namespace units::velocity;
 
-FluidSimulatorRenderer::FluidSimulatorRenderer(FluidSimulator simulator)
-  : simulator(std::move(simulator)) {
-    // We will update and re-draw the simulator whenever there is nothing going on
-    // (and so presumably when the last update loop has finished)
-    Glib::signal_idle().connect(sigc::mem_fun(*this, &FluidSimulatorRenderer::update));
+namespace {
+    // The number of steps to take between snapshots when stepping on a dedicated thread
+    const int DEDICATED_THREAD_STEPS_PER_FRAME = 10;
+
+    // How often to redraw when stepping on a dedicated thread (ms)
+    const unsigned int DEDICATED_THREAD_FRAME_INTERVAL = 16;
+
+    // The time step the simulator is stepped with
+    const second_t SIMULATION_DT = second_t(0.00001);
+
+    // How much each click of the scroll wheel zooms by
+    const double ZOOM_STEP = 1.25;
+
+    // The furthest the view can be zoomed in
+    const double MAX_ZOOM = 4096;
+
+    /**
+     * Create a SimulationThread to run the given simulator in the given mode
+     *
+     * @param simulator the simulator to run
+     * @param simulation_mode how to run the simulator
+     *
+     * @return a SimulationThread, already started if the simulator should run on
+     * it's own thread
+     */
+    std::unique_ptr<SimulationThread> createSimulationThread(
+        FluidSimulator simulator, SimulationMode simulation_mode) {
+        const int steps_per_frame = simulation_mode == SimulationMode::DEDICATED_THREAD
+                                        ? DEDICATED_THREAD_STEPS_PER_FRAME
+                                        : 1;
+        auto simulation_thread = std::make_unique<SimulationThread>(
+            std::move(simulator), SIMULATION_DT, steps_per_frame);
+        if (simulation_mode == SimulationMode::DEDICATED_THREAD) {
+            simulation_thread->start();
+        }
+        return simulation_thread;
+    }
 }
 
-bool FluidSimulatorRenderer::on_draw(const Cairo::RefPtr<Cairo::Context>& ctx) {
-    Gtk::Allocation window_allocation = get_allocation();
-    const int window_width            = window_allocation.get_width();
-    const int window_height           = window_allocation.get_height();
-
-    ctx->save();
-
-    // Draw all the nodes in the simulator
-    ctx->set_line_width(1);
-
-    std::shared_ptr<GraphNode<ControlVolume>> control_volume_graph =
-        simulator.getControlVolumeGraph();
-
-    std::vector<std::shared_ptr<RealNode<ControlVolume>>> all_nodes =
-        control_volume_graph->getAllSubNodes();
-
-    std::vector<std::shared_ptr<Area<ControlVolume>>> obstacles =
-        simulator.getObstacles();
-
-    // The simulator should fit the smaller of the width and height
-    const int graph_size  = std::min(window_width, window_height);
-    double scaling_factor = graph_size / control_volume_graph->getScale();
-
-    // Figure out the appropriate scale for the temperatures
-    double max_pressure = all_nodes[0]->containedValue().getPressure().to<double>();
-    for (const auto& node : all_nodes) {
-        double pressure = node->containedValue().getPressure().to<double>();
-        max_pressure    = std::max(pressure, max_pressure);
+FluidSimulatorRenderer::FluidSimulatorRenderer(FluidSimulator simulator,
+                                               SimulationMode simulation_mode,
+                                               FieldRenderMode render_mode)
+  : simulation_thread(createSimulationThread(std::move(simulator), simulation_mode)),
+    simulation_mode(simulation_mode),
+    field_renderer(render_mode,
+                   std::max(1, static_cast<int>(std::thread::hardware_concurrency()))) {
+    add_events(Gdk::SCROLL_MASK | Gdk::BUTTON_PRESS_MASK | Gdk::BUTTON_RELEASE_MASK |
+               Gdk::BUTTON_MOTION_MASK);
+
+    if (simulation_mode == SimulationMode::DEDICATED_THREAD) {
+        // The simulation runs on it's own, so we just need to re-draw the newest
+        // snapshot regularly
+        Glib::signal_timeout().connect(
+            sigc::mem_fun(*this, &FluidSimulatorRenderer::update),
+            DEDICATED_THREAD_FRAME_INTERVAL);
+    } else {
+        // We will update and re-draw the simulator whenever there is nothing going on
+        // (and so presumably when the last update loop has finished)
+        Glib::signal_idle().connect(
+            sigc::mem_fun(*this, &FluidSimulatorRenderer::update));
     }
+}
 
-    // Draw all control volumes
-    for (const std::shared_ptr<RealNode<ControlVolume>>& node : all_nodes) {
-        // Check if this node is within an obstacle
-        bool is_obstacle = false;
-        for (auto& obstacle : obstacles) {
-            if (obstacle->overlapsNode(*node)) {
-                is_obstacle = true;
-                break;
-            }
-        }
-
-        // Reset drawing stuff
-        ctx->move_to(0, 0);
-
-        double scaled_node_pos_x = node->getCoordinates().x * scaling_factor;
-        double scaled_node_pos_y = node->getCoordinates().y * scaling_factor;
-        double scaled_node_scale = node->getScale() * scaling_factor;
-
-        // Draw the Node itself
-        ctx->rectangle(
-            scaled_node_pos_x, scaled_node_pos_y, scaled_node_scale, scaled_node_scale);
+bool FluidSimulatorRenderer::on_draw(const Cairo::RefPtr<Cairo::Context>& ctx) {
+    SIMPLE_CFD_PROFILE_SCOPE("on_draw");
+    Gtk::Allocation window_allocation = get_allocation();
 
-        // TODO: Break out drawing pressure/velocity into their own functions
+    // The newest complete state of the simulation. This is never changed while we're
+    // drawing it, even if the simulation is running on another thread.
+    const FieldSnapshot& snapshot = simulation_thread->getLatestSnapshot();
 
-        // Indicate the pressure (or that this is an obstacle) by coloring the Node
-        if (is_obstacle) {
-            ctx->set_source_rgba(0, 1, 0, 0.5);
-        } else {
-            auto pressure = unit_cast<double>(node->containedValue().getPressure());
-            ctx->set_source_rgba(pressure / max_pressure, 0, 0, 0.8);
-        }
-        ctx->fill_preserve();
+    field_renderer.draw(ctx,
+                        window_allocation.get_width(),
+                        window_allocation.get_height(),
+                        snapshot);
 
-        // Draw the velocity as a line
-        Velocity2d velocity = node->containedValue().getVelocity();
-        auto velocity_magnitude =
-            units::math::pow<2>(velocity.x) + units::math::pow<2>(velocity.y);
+    return true;
+}
 
-        if (velocity_magnitude.to<double>() != 0) {
-            velocity.x = velocity.x / velocity_magnitude.to<double>();
-            velocity.y = velocity.y / velocity_magnitude.to<double>();
-        }
-        ctx->move_to(scaled_node_pos_x + scaled_node_scale / 2,
-                     scaled_node_pos_y + scaled_node_scale / 2);
-        ctx->line_to(
-            scaled_node_pos_x + scaled_node_scale / 2 + unit_cast<double>(velocity.x),
-            scaled_node_pos_y + scaled_node_scale / 2 + unit_cast<double>(velocity.y));
-
-        ctx->set_source_rgba(1.0, 1.0, 1.0, 0.8);
-        ctx->set_line_width(1);
-        ctx->stroke();
+bool FluidSimulatorRenderer::on_scroll_event(GdkEventScroll* event) {
+    double zoom_factor = 1;
+    if (event->direction == GDK_SCROLL_UP) {
+        zoom_factor = ZOOM_STEP;
+    } else if (event->direction == GDK_SCROLL_DOWN) {
+        zoom_factor = 1 / ZOOM_STEP;
+    } else {
+        return false;
     }
 
-    // Draw streamlines
-//    int num_streamlines = 10;
-    std::vector<std::vector<Point2d>> streamlines;
-//    for (int i = 0; i < num_streamlines; i++) {
-//        Point2d start_point = {meter_t(0.1), meter_t(15.0 / num_streamlines * i)};
-//        streamlines.emplace_back(
-//            simulator.getStreamLinePoints(start_point, meter_t(10), meter_t(0.2)));
-//    }
-
-    meter_t actual_graph_size = meter_t(1);
-    double num_streamlines = 10;
-
-    std::vector<Point2d> start_points;
-    for (int x_index = 0; x_index < num_streamlines; x_index++){
-        for (int y_index = 0; y_index < num_streamlines; y_index++){
-            Point2d start_point = {x_index * actual_graph_size / num_streamlines, y_index * actual_graph_size / num_streamlines};
-            start_points.emplace_back(start_point);
-        }
+    const int graph_size = get_graph_size();
+    if (graph_size <= 0) {
+        return false;
     }
+    FieldViewport viewport = field_renderer.getViewport();
+
+    // Keep the point under the pointer where it is
+    const double offset_x  = (event->x - graph_size / 2.0) / graph_size;
+    const double offset_y  = (event->y - graph_size / 2.0) / graph_size;
+    const double pointer_x = viewport.centre_x + offset_x / viewport.zoom;
+    const double pointer_y = viewport.centre_y + offset_y / viewport.zoom;
+    viewport.zoom     = std::clamp(viewport.zoom * zoom_factor, 1.0, MAX_ZOOM);
+    viewport.centre_x = pointer_x - offset_x / viewport.zoom;
+    viewport.centre_y = pointer_y - offset_y / viewport.zoom;
+
+    field_renderer.setViewport(viewport);
+    queue_draw();
+    return true;
+}
 
+bool FluidSimulatorRenderer::on_button_press_event(GdkEventButton* event) {
+    dragging    = true;
+    last_drag_x = event->x;
+    last_drag_y = event->y;
+    return true;
+}
 
-//    Point2d start_point = {meter_t(0.1), meter_t(0.9)};
-//    Point2d start_point = {meter_t(3), meter_t(5)};
-//    streamlines.emplace_back(
-//            simulator.getStreamLinePoints(start_point, meter_t(10), meter_t(0.2)));
-
-    for (auto& start_point : start_points) {
-        streamlines.emplace_back(
-                simulator.getStreamLinePoints(start_point, meter_t(5), meter_t(0.1)));
+bool FluidSimulatorRenderer::on_motion_notify_event(GdkEventMotion* event) {
+    const int graph_size = get_graph_size();
+    if (!dragging || graph_size <= 0) {
+        return false;
     }
 
-    for (auto& streamline : streamlines) {
-        for (auto& point : streamline) {
-            ctx->set_source_rgba(1.0, 0.0, 1.0, 0.8);
-            ctx->rectangle(
-                    point.x.to<double>() * scaling_factor, point.y.to<double>() * scaling_factor, 4, 4);
-            ctx->fill_preserve();
-            ctx->stroke();
-        }
-//        for (int i = 0; i < streamline.size() - 1; i++) {
-//            ctx->move_to(streamline[i].x.to<double>() * scaling_factor,
-//                         streamline[i].y.to<double>() * scaling_factor);
-//            ctx->line_to(streamline[i + 1].x.to<double>() * scaling_factor,
-//                         streamline[i + 1].y.to<double>() * scaling_factor);
-//            ctx->set_source_rgba(1.0, 0.0, 1.0, 0.8);
-//            ctx->set_line_width(4);
-//            ctx->stroke();
-//        }
-    }
+    // Move the view with the pointer
+    FieldViewport viewport = field_renderer.getViewport();
+    viewport.centre_x -= (event->x - last_drag_x) / (graph_size * viewport.zoom);
+    viewport.centre_y -= (event->y - last_drag_y) / (graph_size * viewport.zoom);
+    last_drag_x = event->x;
+    last_drag_y = event->y;
 
-    ctx->fill_preserve();
-    ctx->restore();
-    ctx->stroke_preserve();
-    ctx->clip();
+    field_renderer.setViewport(viewport);
+    queue_draw();
+    return true;
+}
 
+bool FluidSimulatorRenderer::on_button_release_event(GdkEventButton*) {
+    dragging = false;
     return true;
 }
 
+int FluidSimulatorRenderer::get_graph_size() {
+    // This matches how FieldRenderer fits the simulation in the window
+    Gtk::Allocation window_allocation = get_allocation();
+    return std::min(window_allocation.get_width(), window_allocation.get_height());
+}
+
 bool FluidSimulatorRenderer::update() {
-    simulator.updateControlVolumes(second_t(0.00001));
+    // When running on a dedicated thread the simulation steps on it's own
+    if (simulation_mode == SimulationMode::MAIN_LOOP) {
+        simulation_thread->runFrame();
+    }
 
     // Invalidate the entire window to force a full re-draw
     auto window = get_window();
@@ -182,9 +185,12 @@ bool FluidSimulatorRenderer::update() {
             0, 0, get_allocation().get_width(), get_allocation().get_height());
         window->invalidate_rect(r, false);
     }
+
+    return true;
 }
 
 void FluidSimulatorRenderer::set_simulator_to_render(FluidSimulator simulator) {
-    // Save the simulator to draw
-    this->simulator = std::move(simulator);
+    // Stop running the old simulator before we start running the new one
+    simulation_thread->stop();
+    simulation_thread = createSimulationThread(std::move(simulator), simulation_mode);
 }
@@ -0,0 +1,183 @@
+#include "GhostCellLayer.h"
+
+// STD Includes
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace {
+
+/**
+ * Get the direction opposite the given one
+ *
+ * @param direction the direction to get the opposite of
+ *
+ * @return the direction opposite the given one
+ */
+Direction oppositeDirection(Direction direction) {
+    switch (direction) {
+        case LEFT:
+            return RIGHT;
+        case RIGHT:
+            return LEFT;
+        case TOP:
+            return BOTTOM;
+        default:
+            return TOP;
+    }
+}
+
+}  // namespace
+
+GhostCellLayer::GhostCellLayer(std::shared_ptr<const ControlVolumeMesh> mesh,
+                               const BoundaryConditions& conditions)
+  : mesh(std::move(mesh)), conditions(conditions), num_ghosts(0) {
+    validateBoundaryConditions(conditions);
+
+    const ControlVolumeMesh& cells_mesh   = *this->mesh;
+    const std::vector<double>& cell_x     = cells_mesh.getCellX();
+    const std::vector<double>& cell_y     = cells_mesh.getCellY();
+    const std::vector<double>& cell_scale = cells_mesh.getCellScale();
+    cells                                 = cells_mesh.getEdgeCells();
+
+    // The cells along each side of the mesh, sorted by where they start along it, for
+    // finding the partners of periodic ghosts
+    auto position_along_side = [&](Direction side, int cell) {
+        return side == LEFT || side == RIGHT ? cell_y[cell] : cell_x[cell];
+    };
+    std::array<std::vector<std::pair<double, int>>, NUM_DIRECTIONS> side_cells;
+    for (const int cell : cells) {
+        for (int direction = 0; direction < NUM_DIRECTIONS; direction++) {
+            const Direction side = static_cast<Direction>(direction);
+            const int neighbour  = cells_mesh.getNeighbours(side)[cell];
+            if (neighbour == ControlVolumeMesh::NO_NEIGHBOUR) {
+                side_cells[side].emplace_back(position_along_side(side, cell), cell);
+            }
+        }
+    }
+    for (std::vector<std::pair<double, int>>& side : side_cells) {
+        std::sort(side.begin(), side.end());
+    }
+
+    for (int direction = 0; direction < NUM_DIRECTIONS; direction++) {
+        const Direction side                 = static_cast<Direction>(direction);
+        const BoundaryCondition& condition   = conditions.sides[side];
+        const std::vector<int>& neighbours   = cells_mesh.getNeighbours(side);
+        const std::vector<double>& distances = cells_mesh.getNeighbourDistances(side);
+        const bool overridden = side == TOP && conditions.override_top_velocity;
+
+        ControlVolumeFields& states = neighbour_states[side];
+        states.resize(cells.size());
+        neighbour_distances[side].resize(cells.size());
+
+        for (size_t k = 0; k < cells.size(); k++) {
+            const int slot               = static_cast<int>(k);
+            const int cell               = cells[k];
+            const int neighbour          = neighbours[cell];
+            neighbour_distances[side][k] = distances[cell];
+
+            if (neighbour != ControlVolumeMesh::NO_NEIGHBOUR) {
+                if (overridden) {
+                    states.velocity_x[k] = conditions.top_velocity_override.velocity_x;
+                    states.velocity_y[k] = conditions.top_velocity_override.velocity_y;
+                    overridden_top_neighbours.push_back({slot, neighbour});
+                } else {
+                    copied_neighbours[side].push_back({slot, neighbour});
+                }
+                continue;
+            }
+
+            num_ghosts++;
+            switch (condition.type) {
+                case BoundaryType::INFLOW:
+                    states.pressure[k]   = condition.state.pressure;
+                    states.velocity_x[k] = condition.state.velocity_x;
+                    states.velocity_y[k] = condition.state.velocity_y;
+                    break;
+                case BoundaryType::OUTFLOW:
+                    copied_neighbours[side].push_back({slot, cell});
+                    break;
+                case BoundaryType::WALL:
+                    wall_ghosts[side].push_back({slot, cell});
+                    break;
+                case BoundaryType::PERIODIC: {
+                    // The last cell on the opposite side starting at or before the
+                    // centre of this one
+                    const std::vector<std::pair<double, int>>& opposite_cells =
+                        side_cells[oppositeDirection(side)];
+                    const double centre =
+                        position_along_side(side, cell) + cell_scale[cell] / 2;
+                    auto partner = std::upper_bound(
+                        opposite_cells.begin(),
+                        opposite_cells.end(),
+                        std::make_pair(centre, std::numeric_limits<int>::max()));
+                    if (partner != opposite_cells.begin()) {
+                        partner--;
+                    }
+                    const int partner_cell = partner->second;
+                    copied_neighbours[side].push_back({slot, partner_cell});
+                    neighbour_distances[side][k] =
+                        (cell_scale[cell] + cell_scale[partner_cell]) / 2;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void GhostCellLayer::fill(const ControlVolumeFields& current) {
+    for (int direction = 0; direction < NUM_DIRECTIONS; direction++) {
+        ControlVolumeFields& states = neighbour_states[direction];
+        for (const NeighbourSource& source : copied_neighbours[direction]) {
+            states.pressure[source.slot]   = current.pressure[source.cell];
+            states.velocity_x[source.slot] = current.velocity_x[source.cell];
+            states.velocity_y[source.slot] = current.velocity_y[source.cell];
+        }
+
+        const CellState& wall = conditions.sides[direction].state;
+        for (const NeighbourSource& source : wall_ghosts[direction]) {
+            states.pressure[source.slot] = current.pressure[source.cell];
+            states.velocity_x[source.slot] =
+                2 * wall.velocity_x - current.velocity_x[source.cell];
+            states.velocity_y[source.slot] =
+                2 * wall.velocity_y - current.velocity_y[source.cell];
+        }
+    }
+
+    ControlVolumeFields& top_states = neighbour_states[TOP];
+    for (const NeighbourSource& source : overridden_top_neighbours) {
+        top_states.pressure[source.slot] = current.pressure[source.cell];
+    }
+}
+
+void GhostCellLayer::updateCells(size_t begin,
+                                 size_t end,
+                                 const ControlVolumeFields& current,
+                                 double dt,
+                                 const FluidCoefficients& fluid,
+                                 ControlVolumeFields& next) const {
+    auto state = [](const ControlVolumeFields& fields, size_t i) -> CellState {
+        return {fields.pressure[i], fields.velocity_x[i], fields.velocity_y[i]};
+    };
+
+    // Every neighbour (real or ghost) was gathered by `fill`, so there is nothing to
+    // check for here
+    for (size_t k = begin; k < end; k++) {
+        const int i = cells[k];
+
+        const CellState updated = updateCellState(state(current, i),
+                                                  state(neighbour_states[LEFT], k),
+                                                  neighbour_distances[LEFT][k],
+                                                  state(neighbour_states[RIGHT], k),
+                                                  neighbour_distances[RIGHT][k],
+                                                  state(neighbour_states[TOP], k),
+                                                  neighbour_distances[TOP][k],
+                                                  state(neighbour_states[BOTTOM], k),
+                                                  neighbour_distances[BOTTOM][k],
+                                                  dt,
+                                                  fluid);
+        next.pressure[i]   = updated.pressure;
+        next.velocity_x[i] = updated.velocity_x;
+        next.velocity_y[i] = updated.velocity_y;
+    }
+}
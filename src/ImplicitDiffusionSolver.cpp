@@ -0,0 +1,198 @@
+#include "ImplicitDiffusionSolver.h"
+
+// STD Includes
+#include <algorithm>
+#include <limits>
+#include <set>
+#include <stdexcept>
+
+ImplicitDiffusionSolver::ImplicitDiffusionSolver(
+    std::shared_ptr<const ControlVolumeMesh> mesh,
+    const std::vector<uint8_t>& obstacle_cell_mask,
+    ImplicitDiffusionParameters parameters)
+  : mesh(std::move(mesh)),
+    parameters(parameters),
+    solver_diffusion_number(0),
+    diffusion_number(0) {
+    if (!(parameters.implicitness >= 0.5 && parameters.implicitness <= 1)) {
+        throw std::invalid_argument("Implicitness must be between 0.5 and 1");
+    }
+
+    const ControlVolumeMesh& cells        = *this->mesh;
+    const size_t num_cells                = cells.numCells();
+    const std::vector<double>& cell_x     = cells.getCellX();
+    const std::vector<double>& cell_y     = cells.getCellY();
+    const std::vector<double>& cell_scale = cells.getCellScale();
+
+    std::vector<int> unknown_index(num_cells, -1);
+    for (size_t i = 0; i < num_cells; i++) {
+        if (!obstacle_cell_mask[i]) {
+            unknown_index[i] = static_cast<int>(fluid_cells.size());
+            fluid_cells.emplace_back(i);
+        }
+    }
+
+    // Every face touching an uncovered cell contributes
+    // (u_j - u_i) * face length / distance to it. On a multi-resolution mesh a large
+    // cell only stores one of it's smaller neighbours, so faces are gathered from both
+    // sides (including from covered cells, whose uncovered neighbours may not store
+    // them).
+    std::set<std::pair<int, int>> faces;
+    std::vector<std::vector<std::pair<int, double>>> couplings(fluid_cells.size());
+    std::vector<double> fixed_weight(fluid_cells.size(), 0);
+    for (size_t i = 0; i < num_cells; i++) {
+        const int cell = static_cast<int>(i);
+        for (int direction = 0; direction < NUM_DIRECTIONS; direction++) {
+            const int neighbour =
+                cells.getNeighbours(static_cast<Direction>(direction))[cell];
+            const double distance =
+                cells.getNeighbourDistances(static_cast<Direction>(direction))[cell];
+
+            if (neighbour == ControlVolumeMesh::NO_NEIGHBOUR) {
+                if (unknown_index[cell] >= 0) {
+                    const double weight = cell_scale[cell] / distance;
+                    edge_faces.push_back({unknown_index[cell],
+                                          static_cast<Direction>(direction),
+                                          weight});
+                    fixed_weight[unknown_index[cell]] += weight;
+                }
+                continue;
+            }
+            if (!faces.emplace(std::min(cell, neighbour), std::max(cell, neighbour))
+                     .second) {
+                continue;
+            }
+
+            const double weight =
+                std::min(cell_scale[cell], cell_scale[neighbour]) / distance;
+            const int cell_unknown      = unknown_index[cell];
+            const int neighbour_unknown = unknown_index[neighbour];
+            if (cell_unknown >= 0 && neighbour_unknown >= 0) {
+                couplings[cell_unknown].emplace_back(neighbour_unknown, weight);
+                couplings[neighbour_unknown].emplace_back(cell_unknown, weight);
+            } else if (cell_unknown >= 0) {
+                fixed_weight[cell_unknown] += weight;
+            } else if (neighbour_unknown >= 0) {
+                fixed_weight[neighbour_unknown] += weight;
+            }
+        }
+    }
+
+    // The fixed velocities outside the mesh and in obstacles only add to the
+    // diagonal, which makes the matrix definite
+    for (size_t row = 0; row < couplings.size(); row++) {
+        std::vector<std::pair<int, double>>& row_couplings = couplings[row];
+        std::sort(row_couplings.begin(), row_couplings.end());
+
+        double diagonal = fixed_weight[row];
+        for (const std::pair<int, double>& coupling : row_couplings) {
+            diagonal += coupling.second;
+        }
+
+        bool diagonal_added = false;
+        for (const std::pair<int, double>& coupling : row_couplings) {
+            if (!diagonal_added && coupling.first > static_cast<int>(row)) {
+                diagonal_entries.emplace_back(stiffness.columns.size());
+                stiffness.columns.emplace_back(row);
+                stiffness.values.emplace_back(diagonal);
+                diagonal_added = true;
+            }
+            stiffness.columns.emplace_back(coupling.first);
+            stiffness.values.emplace_back(-coupling.second);
+        }
+        if (!diagonal_added) {
+            diagonal_entries.emplace_back(stiffness.columns.size());
+            stiffness.columns.emplace_back(row);
+            stiffness.values.emplace_back(diagonal);
+        }
+        stiffness.row_offsets.emplace_back(stiffness.columns.size());
+    }
+
+    areas.resize(fluid_cells.size());
+    centre_x.resize(fluid_cells.size());
+    centre_y.resize(fluid_cells.size());
+    double min_scale = std::numeric_limits<double>::infinity();
+    for (size_t k = 0; k < fluid_cells.size(); k++) {
+        const int i = fluid_cells[k];
+        areas[k]    = cell_scale[i] * cell_scale[i];
+        centre_x[k] = cell_x[i] + cell_scale[i] / 2;
+        centre_y[k] = cell_y[i] + cell_scale[i] / 2;
+        min_scale   = std::min(min_scale, cell_scale[i]);
+    }
+    bin_size = 2 * min_scale;
+}
+
+DiffusionSolveResult ImplicitDiffusionSolver::diffuse(
+    ControlVolumeFields& fields,
+    const StencilEdgeStates<double>& edges,
+    double dt,
+    double viscosity,
+    ThreadPool& thread_pool) {
+    diffusion_number = dt * viscosity;
+
+    // The multigrid levels are built from the matrix, so have to be rebuilt whenever
+    // it is rescaled
+    if (!solver || solver_diffusion_number != diffusion_number) {
+        SparseMatrix matrix = stiffness;
+        const double scale  = parameters.implicitness * diffusion_number;
+        for (double& value : matrix.values) {
+            value *= scale;
+        }
+        for (size_t row = 0; row < diagonal_entries.size(); row++) {
+            matrix.values[diagonal_entries[row]] += areas[row];
+        }
+        solver = std::make_unique<MultigridSolver>(
+            std::move(matrix), centre_x, centre_y, bin_size, false);
+        solver_diffusion_number = diffusion_number;
+    }
+
+    last_result.velocity_x = diffuseComponent(fields.velocity_x,
+                                              {edges.left.velocity_x,
+                                               edges.right.velocity_x,
+                                               edges.top.velocity_x,
+                                               edges.bottom.velocity_x},
+                                              thread_pool);
+    last_result.velocity_y = diffuseComponent(fields.velocity_y,
+                                              {edges.left.velocity_y,
+                                               edges.right.velocity_y,
+                                               edges.top.velocity_y,
+                                               edges.bottom.velocity_y},
+                                              thread_pool);
+    return last_result;
+}
+
+LinearSolveResult ImplicitDiffusionSolver::diffuseComponent(
+    std::vector<double>& velocity,
+    const std::array<double, NUM_DIRECTIONS>& edge_velocity,
+    ThreadPool& thread_pool) {
+    const size_t num_unknowns = fluid_cells.size();
+    solution.resize(num_unknowns);
+    for (size_t k = 0; k < num_unknowns; k++) {
+        solution[k] = velocity[fluid_cells[k]];
+    }
+
+    // b = A u - (1 - theta) * dt * viscosity * stiffness * u + dt * viscosity * (the
+    // flux from the fixed velocities, which is the same at both ends of the step)
+    stiffness.multiply(solution, product, thread_pool);
+    const double explicit_scale = (1 - parameters.implicitness) * diffusion_number;
+    rhs.resize(num_unknowns);
+    thread_pool.parallelFor(num_unknowns, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            rhs[k] = areas[k] * solution[k] - explicit_scale * product[k];
+        }
+    });
+    for (const EdgeFace& face : edge_faces) {
+        rhs[face.unknown] +=
+            diffusion_number * face.weight * edge_velocity[face.direction];
+    }
+
+    // The velocity before diffusing is the initial guess
+    const LinearSolveResult result = solver->solve(
+        rhs, solution, parameters.tolerance, parameters.max_iterations, thread_pool);
+
+    std::fill(velocity.begin(), velocity.end(), 0);
+    for (size_t k = 0; k < num_unknowns; k++) {
+        velocity[fluid_cells[k]] = solution[k];
+    }
+    return result;
+}
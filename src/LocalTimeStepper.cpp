@@ -0,0 +1,176 @@
+#include "LocalTimeStepper.h"
+
+// STD Includes
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+LocalTimeStepper::LocalTimeStepper(std::shared_ptr<const ControlVolumeMesh> mesh,
+                                   const std::vector<uint8_t>& obstacle_cell_mask)
+  : mesh(std::move(mesh)), obstacle_cell_mask(obstacle_cell_mask) {
+    const ControlVolumeMesh& cells        = *this->mesh;
+    const size_t num_cells                = cells.numCells();
+    const std::vector<double>& cell_scale = cells.getCellScale();
+
+    // Cells are halved when refined, so the ratio of scales is an exact power of two
+    const double largest_scale =
+        num_cells > 0 ? *std::max_element(cell_scale.begin(), cell_scale.end()) : 0;
+    cell_levels.resize(num_cells);
+    int finest_level = 0;
+    for (size_t i = 0; i < num_cells; i++) {
+        const double scale_ratio = largest_scale / cell_scale[i];
+        cell_levels[i] = static_cast<int>(std::lround(std::log2(scale_ratio)));
+        finest_level   = std::max(finest_level, cell_levels[i]);
+    }
+
+    // Sort the cells by level, finest first (keeping them in order within a level)
+    std::vector<size_t> num_level_cells(finest_level + 1, 0);
+    for (const int level : cell_levels) {
+        num_level_cells[level]++;
+    }
+    num_finer_cells.assign(finest_level + 1, 0);
+    size_t num_finer = 0;
+    for (int level = finest_level; level >= 0; level--) {
+        num_finer += num_level_cells[level];
+        num_finer_cells[level] = num_finer;
+    }
+    std::vector<size_t> level_offsets(finest_level + 1, 0);
+    for (int level = 0; level < finest_level; level++) {
+        level_offsets[level] = num_finer_cells[level + 1];
+    }
+    cells_by_level.resize(num_cells);
+    for (size_t i = 0; i < num_cells; i++) {
+        cells_by_level[level_offsets[cell_levels[i]]++] = static_cast<int>(i);
+    }
+
+    // Level k starts a step 2^k times per coarse step, along with every finer level
+    num_cell_updates_per_step = 0;
+    for (int level = 0; level <= finest_level; level++) {
+        num_cell_updates_per_step += static_cast<uint64_t>(num_level_cells[level])
+                                     << level;
+    }
+
+    // A cell needs interpolating whenever the finest level that reads it is stepped
+    // without it's own level
+    std::vector<int> finest_reader(num_cells, -1);
+    for (size_t i = 0; i < num_cells; i++) {
+        for (int direction = 0; direction < NUM_DIRECTIONS; direction++) {
+            const int neighbour =
+                cells.getNeighbours(static_cast<Direction>(direction))[i];
+            if (neighbour != ControlVolumeMesh::NO_NEIGHBOUR &&
+                cell_levels[neighbour] < cell_levels[i]) {
+                finest_reader[neighbour] =
+                    std::max(finest_reader[neighbour], cell_levels[i]);
+            }
+        }
+    }
+    interface_cells.resize(finest_level + 1);
+    for (size_t i = 0; i < num_cells; i++) {
+        for (int level = cell_levels[i] + 1; level <= finest_reader[i]; level++) {
+            interface_cells[level].emplace_back(i);
+        }
+    }
+}
+
+void LocalTimeStepper::step(const ControlVolumeFields& current,
+                            const StencilEdgeStates<double>& edges,
+                            double dt,
+                            const FluidCoefficients& fluid,
+                            ThreadPool& thread_pool,
+                            ControlVolumeFields& next) {
+    const int finest_level      = getNumLevels() - 1;
+    const uint64_t num_substeps = uint64_t(1) << finest_level;
+
+    // `next` holds the latest state of every cell, which for a cell part way through
+    // it's step is the state at the end of it
+    next = current;
+    start_fields.resize(current.size());
+    stepped_fields.resize(current.size());
+
+    for (uint64_t substep = 0; substep < num_substeps; substep++) {
+        const int coarsest_level = coarsestActiveLevel(substep);
+
+        // Bring the coarser cells read by this substep back to the time it starts at
+        const std::vector<int>& interpolated = interface_cells[coarsest_level];
+        saved_interface_fields.resize(interpolated.size());
+        for (size_t k = 0; k < interpolated.size(); k++) {
+            const int i                = interpolated[k];
+            const uint64_t step_length = num_substeps >> cell_levels[i];
+            const double alpha         = static_cast<double>(substep % step_length) /
+                                 static_cast<double>(step_length);
+            auto interpolate = [&](std::vector<double>& end_values,
+                                   const std::vector<double>& start_values,
+                                   std::vector<double>& saved_values) {
+                saved_values[k] = end_values[i];
+                end_values[i] =
+                    start_values[i] + alpha * (saved_values[k] - start_values[i]);
+            };
+            interpolate(next.pressure,
+                        start_fields.pressure,
+                        saved_interface_fields.pressure);
+            interpolate(next.velocity_x,
+                        start_fields.velocity_x,
+                        saved_interface_fields.velocity_x);
+            interpolate(next.velocity_y,
+                        start_fields.velocity_y,
+                        saved_interface_fields.velocity_y);
+        }
+
+        // Step every level that starts a step now, each by it's own step
+        for (int level = finest_level; level >= coarsest_level; level--) {
+            const size_t first = level == finest_level ? 0 : num_finer_cells[level + 1];
+            const size_t last  = num_finer_cells[level];
+
+            const double level_dt = std::ldexp(dt, -level);
+            thread_pool.parallelFor(last - first, [&](size_t begin, size_t end) {
+                updateScalarCells<double, false, true>(*mesh,
+                                                       cells_by_level,
+                                                       first + begin,
+                                                       first + end,
+                                                       next,
+                                                       edges,
+                                                       level_dt,
+                                                       fluid,
+                                                       stepped_fields);
+            });
+        }
+
+        // The interpolated cells are still part way through their step
+        for (size_t k = 0; k < interpolated.size(); k++) {
+            const int i        = interpolated[k];
+            next.pressure[i]   = saved_interface_fields.pressure[k];
+            next.velocity_x[i] = saved_interface_fields.velocity_x[k];
+            next.velocity_y[i] = saved_interface_fields.velocity_y[k];
+        }
+
+        // The stepped cells start their next step from where this one ended
+        thread_pool.parallelFor(
+            num_finer_cells[coarsest_level], [&](size_t begin, size_t end) {
+                for (size_t k = begin; k < end; k++) {
+                    const int i                = cells_by_level[k];
+                    start_fields.pressure[i]   = next.pressure[i];
+                    start_fields.velocity_x[i] = next.velocity_x[i];
+                    start_fields.velocity_y[i] = next.velocity_y[i];
+                    if (obstacle_cell_mask[i]) {
+                        next.pressure[i]   = 0;
+                        next.velocity_x[i] = 0;
+                        next.velocity_y[i] = 0;
+                    } else {
+                        next.pressure[i]   = stepped_fields.pressure[i];
+                        next.velocity_x[i] = stepped_fields.velocity_x[i];
+                        next.velocity_y[i] = stepped_fields.velocity_y[i];
+                    }
+                }
+            });
+    }
+}
+
+int LocalTimeStepper::coarsestActiveLevel(uint64_t substep) const {
+    // Level k starts a step every 2^(K - k) substeps
+    int level = getNumLevels() - 1;
+    while (level > 0 && substep % 2 == 0) {
+        substep /= 2;
+        level--;
+    }
+    return level;
+}
@@ -0,0 +1,80 @@
+#include "MeshPartition.h"
+
+// STD Includes
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+
+/**
+ * Spread the bits of the given value out to every other bit
+ *
+ * @param value the value to spread
+ *
+ * @return the value with bit i moved to bit 2 * i
+ */
+uint64_t spreadBits(uint32_t value) {
+    uint64_t spread = value;
+    spread          = (spread | (spread << 16)) & 0x0000FFFF0000FFFF;
+    spread          = (spread | (spread << 8)) & 0x00FF00FF00FF00FF;
+    spread          = (spread | (spread << 4)) & 0x0F0F0F0F0F0F0F0F;
+    spread          = (spread | (spread << 2)) & 0x3333333333333333;
+    spread          = (spread | (spread << 1)) & 0x5555555555555555;
+    return spread;
+}
+
+}  // namespace
+
+std::vector<int> partitionMesh(const ControlVolumeMesh& mesh,
+                               int num_parts,
+                               const std::vector<double>& cell_weights) {
+    const size_t num_cells = mesh.numCells();
+    if (num_parts < 1) {
+        throw std::invalid_argument("Number of parts must be at least 1");
+    }
+    if (cell_weights.size() != num_cells ||
+        std::any_of(cell_weights.begin(), cell_weights.end(), [](double weight) {
+            return !(weight >= 0);
+        })) {
+        throw std::invalid_argument("Every cell must have a non-negative weight");
+    }
+    if (num_cells == 0) {
+        return {};
+    }
+
+    const std::vector<double>& cell_x     = mesh.getCellX();
+    const std::vector<double>& cell_y     = mesh.getCellY();
+    const std::vector<double>& cell_scale = mesh.getCellScale();
+    const double min_scale = *std::min_element(cell_scale.begin(), cell_scale.end());
+    const double min_x     = *std::min_element(cell_x.begin(), cell_x.end());
+    const double min_y     = *std::min_element(cell_y.begin(), cell_y.end());
+
+    std::vector<uint64_t> keys(num_cells);
+    for (size_t i = 0; i < num_cells; i++) {
+        const double centre_x = cell_x[i] - min_x + cell_scale[i] / 2;
+        const double centre_y = cell_y[i] - min_y + cell_scale[i] / 2;
+        keys[i] = spreadBits(static_cast<uint32_t>(centre_x / min_scale)) |
+                  (spreadBits(static_cast<uint32_t>(centre_y / min_scale)) << 1);
+    }
+    std::vector<int> order(num_cells);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(
+        order.begin(), order.end(), [&](int a, int b) { return keys[a] < keys[b]; });
+
+    // Each cell goes to the part the middle of it's weight falls in
+    const double total_weight =
+        std::accumulate(cell_weights.begin(), cell_weights.end(), 0.0);
+    std::vector<int> parts(num_cells, 0);
+    double weight_before = 0;
+    for (const int i : order) {
+        if (total_weight > 0) {
+            const double middle = (weight_before + cell_weights[i] / 2) / total_weight;
+            parts[i] = std::min(num_parts - 1, static_cast<int>(middle * num_parts));
+        }
+        weight_before += cell_weights[i];
+    }
+    return parts;
+}
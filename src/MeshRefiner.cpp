@@ -0,0 +1,330 @@
+#include "MeshRefiner.h"
+
+// STD Includes
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace {
+// What happens to each cell when the mesh is adapted
+enum class CellAction : uint8_t {
+    KEEP,
+    SPLIT,
+    // The bottom left cell of a group of four merged together, which becomes the
+    // merged cell
+    MERGE_INTO,
+    // The other cells of a group of four merged together
+    MERGE_AWAY
+};
+} // namespace
+
+MeshRefiner::MeshRefiner(std::shared_ptr<const ControlVolumeMesh> base_mesh,
+                         RefinementParameters parameters)
+  : base_mesh(base_mesh),
+    base_locator(base_mesh),
+    parameters(parameters),
+    mesh(base_mesh) {
+    if (parameters.max_level < 0 || parameters.max_level > MAX_LEVEL) {
+        throw std::invalid_argument("Refinement max level must be in [0, " +
+                                    std::to_string(MAX_LEVEL) + "]");
+    }
+
+    cells.resize(base_mesh->numCells());
+    for (size_t i = 0; i < cells.size(); i++) {
+        cells[i] = {static_cast<int>(i), 0, 0, 0};
+        cell_indices.emplace(cellKey(static_cast<int>(i), 0, 0, 0), i);
+    }
+}
+
+uint64_t MeshRefiner::cellKey(int base_cell, int level, int i, int j) {
+    // i and j are less than 2^MAX_LEVEL, and the level is at most MAX_LEVEL
+    return (static_cast<uint64_t>(base_cell) << 32) |
+           (static_cast<uint64_t>(level) << 2 * MAX_LEVEL) |
+           (static_cast<uint64_t>(i) << MAX_LEVEL) | static_cast<uint64_t>(j);
+}
+
+std::vector<int> MeshRefiner::getCellLevels() const {
+    std::vector<int> levels(cells.size());
+    for (size_t i = 0; i < cells.size(); i++) {
+        levels[i] = cells[i].level;
+    }
+    return levels;
+}
+
+bool MeshRefiner::adapt(const ControlVolumeFields& previous,
+                        ControlVolumeFields& fields,
+                        ThreadPool& thread_pool) {
+    const size_t num_cells = cells.size();
+    const std::vector<double> indicators =
+        computeIndicators(previous, fields, thread_pool);
+
+    // Groups of four cells split from the same cell are merged if they are all quiet.
+    // Each group is found from it's bottom left cell, and only merged if none of the
+    // four have been split further.
+    std::vector<CellAction> actions(num_cells, CellAction::KEEP);
+    std::vector<std::array<int, 4>> merge_groups(num_cells);
+    size_t num_merges = 0;
+    for (size_t c = 0; c < num_cells; c++) {
+        const Cell& cell = cells[c];
+        if (cell.level == 0 || cell.i % 2 != 0 || cell.j % 2 != 0) {
+            continue;
+        }
+
+        std::array<int, 4>& group = merge_groups[c];
+        bool mergeable            = true;
+        for (int k = 0; k < 4 && mergeable; k++) {
+            auto sibling = cell_indices.find(
+                cellKey(cell.base_cell, cell.level, cell.i + k % 2, cell.j + k / 2));
+            mergeable = sibling != cell_indices.end() &&
+                        indicators[sibling->second] < parameters.coarsen_threshold;
+            group[k] = mergeable ? sibling->second : -1;
+        }
+        if (!mergeable) {
+            continue;
+        }
+
+        for (int sibling : group) {
+            actions[sibling] = CellAction::MERGE_AWAY;
+        }
+        actions[c] = CellAction::MERGE_INTO;
+        num_merges++;
+    }
+
+    // Then the cells with the largest indicators are split, as long as there's room
+    std::vector<int> split_candidates;
+    for (size_t c = 0; c < num_cells; c++) {
+        if (actions[c] == CellAction::KEEP && cells[c].level < parameters.max_level &&
+            indicators[c] > parameters.refine_threshold) {
+            split_candidates.emplace_back(c);
+        }
+    }
+    std::sort(split_candidates.begin(), split_candidates.end(), [&](int a, int b) {
+        return indicators[a] != indicators[b] ? indicators[a] > indicators[b] : a < b;
+    });
+
+    size_t new_num_cells = num_cells - 3 * num_merges;
+    size_t num_splits    = 0;
+    for (int c : split_candidates) {
+        if (new_num_cells + 3 > parameters.max_cells) {
+            break;
+        }
+        actions[c] = CellAction::SPLIT;
+        new_num_cells += 3;
+        num_splits++;
+    }
+
+    if (num_merges == 0 && num_splits == 0) {
+        return false;
+    }
+
+    // Build the new cells in the order of the old ones, so cells stay close to their
+    // neighbours in memory
+    std::vector<Cell> new_cells;
+    ControlVolumeFields new_fields;
+    new_cells.reserve(new_num_cells);
+    new_fields.resize(new_num_cells);
+    size_t n = 0;
+    for (size_t c = 0; c < num_cells; c++) {
+        const Cell& cell = cells[c];
+        switch (actions[c]) {
+            case CellAction::KEEP:
+                new_cells.emplace_back(cell);
+                new_fields.pressure[n]   = fields.pressure[c];
+                new_fields.velocity_x[n] = fields.velocity_x[c];
+                new_fields.velocity_y[n] = fields.velocity_y[c];
+                n++;
+                break;
+            case CellAction::SPLIT:
+                // Every child gets the value of it's parent
+                for (int k = 0; k < 4; k++) {
+                    new_cells.push_back({cell.base_cell,
+                                         cell.level + 1,
+                                         2 * cell.i + k % 2,
+                                         2 * cell.j + k / 2});
+                    new_fields.pressure[n]   = fields.pressure[c];
+                    new_fields.velocity_x[n] = fields.velocity_x[c];
+                    new_fields.velocity_y[n] = fields.velocity_y[c];
+                    n++;
+                }
+                break;
+            case CellAction::MERGE_INTO: {
+                // The merged cell gets the mean of it's (equally sized) children
+                const std::array<int, 4>& group = merge_groups[c];
+                new_cells.push_back(
+                    {cell.base_cell, cell.level - 1, cell.i / 2, cell.j / 2});
+                new_fields.pressure[n] =
+                    (fields.pressure[group[0]] + fields.pressure[group[1]] +
+                     fields.pressure[group[2]] + fields.pressure[group[3]]) /
+                    4;
+                new_fields.velocity_x[n] =
+                    (fields.velocity_x[group[0]] + fields.velocity_x[group[1]] +
+                     fields.velocity_x[group[2]] + fields.velocity_x[group[3]]) /
+                    4;
+                new_fields.velocity_y[n] =
+                    (fields.velocity_y[group[0]] + fields.velocity_y[group[1]] +
+                     fields.velocity_y[group[2]] + fields.velocity_y[group[3]]) /
+                    4;
+                n++;
+                break;
+            }
+            case CellAction::MERGE_AWAY:
+                break;
+        }
+    }
+
+    cells  = std::move(new_cells);
+    fields = std::move(new_fields);
+    buildMesh(thread_pool);
+    return true;
+}
+
+std::vector<double> MeshRefiner::computeIndicators(const ControlVolumeFields& previous,
+                                                   const ControlVolumeFields& fields,
+                                                   ThreadPool& thread_pool) const {
+    std::vector<double> indicators(fields.size(), 0);
+    if (parameters.indicator == RefinementIndicator::PRESSURE_CHANGE) {
+        // There's nothing to compare against if the mesh changed since `previous`
+        if (previous.size() != fields.size()) {
+            return indicators;
+        }
+        thread_pool.parallelFor(fields.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                indicators[i] = std::abs(fields.pressure[i] - previous.pressure[i]);
+            }
+        });
+        return indicators;
+    }
+
+    const bool pressure = parameters.indicator == RefinementIndicator::PRESSURE_JUMP;
+    thread_pool.parallelFor(fields.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            double indicator = 0;
+            for (int direction = 0; direction < NUM_DIRECTIONS; direction++) {
+                const int neighbour =
+                    mesh->getNeighbours(static_cast<Direction>(direction))[i];
+                if (neighbour == ControlVolumeMesh::NO_NEIGHBOUR) {
+                    continue;
+                }
+                const double jump =
+                    pressure ? std::abs(fields.pressure[neighbour] - fields.pressure[i])
+                             : std::hypot(
+                                   fields.velocity_x[neighbour] - fields.velocity_x[i],
+                                   fields.velocity_y[neighbour] - fields.velocity_y[i]);
+                indicator = std::max(indicator, jump);
+            }
+            indicators[i] = indicator;
+        }
+    });
+    return indicators;
+}
+
+int MeshRefiner::findCell(int base_cell, double x, double y) const {
+    const double base_x     = base_mesh->getCellX()[base_cell];
+    const double base_y     = base_mesh->getCellY()[base_cell];
+    const double base_scale = base_mesh->getCellScale()[base_cell];
+    for (int level = 0; level <= parameters.max_level; level++) {
+        const int num_divisions = 1 << level;
+        const double scale      = base_scale / num_divisions;
+        const int i             = std::clamp(
+            static_cast<int>(std::floor((x - base_x) / scale)), 0, num_divisions - 1);
+        const int j = std::clamp(
+            static_cast<int>(std::floor((y - base_y) / scale)), 0, num_divisions - 1);
+
+        auto cell = cell_indices.find(cellKey(base_cell, level, i, j));
+        if (cell != cell_indices.end()) {
+            return cell->second;
+        }
+    }
+    return ControlVolumeMesh::NO_NEIGHBOUR;
+}
+
+void MeshRefiner::buildMesh(ThreadPool& thread_pool) {
+    const size_t num_cells = cells.size();
+
+    cell_indices.clear();
+    cell_indices.reserve(num_cells);
+    for (size_t c = 0; c < num_cells; c++) {
+        const Cell& cell = cells[c];
+        cell_indices.emplace(cellKey(cell.base_cell, cell.level, cell.i, cell.j), c);
+    }
+
+    std::vector<int> node_indices(num_cells);
+    std::vector<double> cell_x(num_cells);
+    std::vector<double> cell_y(num_cells);
+    std::vector<double> cell_scale(num_cells);
+    double min_scale = std::numeric_limits<double>::infinity();
+    for (size_t c = 0; c < num_cells; c++) {
+        const int base_cell = cells[c].base_cell;
+        node_indices[c]     = base_mesh->getNodeIndices()[base_cell];
+        cell_scale[c] = base_mesh->getCellScale()[base_cell] / (1 << cells[c].level);
+        cell_x[c]     = base_mesh->getCellX()[base_cell] + cells[c].i * cell_scale[c];
+        cell_y[c]     = base_mesh->getCellY()[base_cell] + cells[c].j * cell_scale[c];
+        min_scale     = std::min(min_scale, cell_scale[c]);
+    }
+
+    // The neighbour in each direction is the cell containing a point just past the
+    // middle of that face, close enough that it can't skip over the smallest cell
+    const double offset = min_scale / 4;
+    std::array<std::vector<int>, NUM_DIRECTIONS> neighbours;
+    for (std::vector<int>& direction_neighbours : neighbours) {
+        direction_neighbours.resize(num_cells);
+    }
+    thread_pool.parallelFor(num_cells, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; c++) {
+            const Cell& cell        = cells[c];
+            const int last_division = (1 << cell.level) - 1;
+            const double middle_x   = cell_x[c] + cell_scale[c] / 2;
+            const double middle_y   = cell_y[c] + cell_scale[c] / 2;
+            for (int direction = 0; direction < NUM_DIRECTIONS; direction++) {
+                double x = middle_x;
+                double y = middle_y;
+                bool inside_base_cell;
+                switch (static_cast<Direction>(direction)) {
+                    case LEFT:
+                        x                = cell_x[c] - offset;
+                        inside_base_cell = cell.i > 0;
+                        break;
+                    case RIGHT:
+                        x                = cell_x[c] + cell_scale[c] + offset;
+                        inside_base_cell = cell.i < last_division;
+                        break;
+                    case TOP:
+                        y                = cell_y[c] + cell_scale[c] + offset;
+                        inside_base_cell = cell.j < last_division;
+                        break;
+                    case BOTTOM:
+                    default:
+                        y                = cell_y[c] - offset;
+                        inside_base_cell = cell.j > 0;
+                        break;
+                }
+
+                int base_cell = cell.base_cell;
+                if (!inside_base_cell) {
+                    // The base neighbour may be one of several smaller cells along the
+                    // face, so find the one the point is actually in
+                    const int base_neighbour = base_mesh->getNeighbours(
+                        static_cast<Direction>(direction))[cell.base_cell];
+                    if (base_neighbour == ControlVolumeMesh::NO_NEIGHBOUR) {
+                        neighbours[direction][c] = ControlVolumeMesh::NO_NEIGHBOUR;
+                        continue;
+                    }
+                    base_cell = base_locator.locate(x, y, base_neighbour);
+                }
+                neighbours[direction][c] = findCell(base_cell, x, y);
+            }
+        }
+    });
+
+    mesh = std::make_shared<const ControlVolumeMesh>(base_mesh->getNodes(),
+                                                     std::move(node_indices),
+                                                     std::move(cell_x),
+                                                     std::move(cell_y),
+                                                     std::move(cell_scale),
+                                                     std::move(neighbours),
+                                                     base_mesh->getEdgeDistance());
+}
@@ -0,0 +1,319 @@
+#include "MultigridSolver.h"
+
+// STD Includes
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <utility>
+
+namespace {
+// The number of entries summed together before being combined with other blocks. This
+// is fixed, so the order of every sum is the same for any number of threads.
+constexpr size_t REDUCTION_BLOCK_SIZE = 4096;
+
+// Levels are coarsened until they have at most this many unknowns
+constexpr size_t MAX_COARSEST_UNKNOWNS = 16;
+
+// Coarsening stops if a level would have more than this fraction of the unknowns of
+// the level before it
+constexpr double MIN_COARSENING_RATIO = 0.9;
+
+// The damping of the Jacobi smoother, and how many sweeps it runs
+constexpr double JACOBI_DAMPING    = 2.0 / 3.0;
+constexpr int NUM_SMOOTHING_SWEEPS = 2;
+constexpr int NUM_COARSEST_SWEEPS  = 20;
+
+/**
+ * Sum f(i) over [0, num_items), in parallel but in a fixed order
+ *
+ * @param num_items the number of items to sum over
+ * @param f the function giving the value of each item
+ * @param thread_pool the threads to sum on
+ *
+ * @return the sum of f(i) over every item
+ */
+template <typename F>
+double deterministicSum(size_t num_items, const F& f, ThreadPool& thread_pool) {
+    const size_t num_blocks =
+        (num_items + REDUCTION_BLOCK_SIZE - 1) / REDUCTION_BLOCK_SIZE;
+    std::vector<double> block_sums(num_blocks);
+    thread_pool.parallelFor(num_blocks, [&](size_t begin, size_t end) {
+        for (size_t block = begin; block < end; block++) {
+            const size_t first = block * REDUCTION_BLOCK_SIZE;
+            const size_t last  = std::min(num_items, first + REDUCTION_BLOCK_SIZE);
+            double block_sum   = 0;
+            for (size_t i = first; i < last; i++) {
+                block_sum += f(i);
+            }
+            block_sums[block] = block_sum;
+        }
+    });
+
+    double sum = 0;
+    for (double block_sum : block_sums) {
+        sum += block_sum;
+    }
+    return sum;
+}
+
+/**
+ * Compute the dot product of the given vectors
+ *
+ * @param a the first vector
+ * @param b the second vector, the same size as `a`
+ * @param thread_pool the threads to compute on
+ *
+ * @return the dot product of `a` and `b`
+ */
+double dot(const std::vector<double>& a,
+           const std::vector<double>& b,
+           ThreadPool& thread_pool) {
+    return deterministicSum(
+        a.size(), [&](size_t i) { return a[i] * b[i]; }, thread_pool);
+}
+} // namespace
+
+void SparseMatrix::multiply(const std::vector<double>& x,
+                            std::vector<double>& y,
+                            ThreadPool& thread_pool) const {
+    y.resize(numRows());
+    thread_pool.parallelFor(numRows(), [&](size_t begin, size_t end) {
+        for (size_t row = begin; row < end; row++) {
+            double sum = 0;
+            for (int k = row_offsets[row]; k < row_offsets[row + 1]; k++) {
+                sum += values[k] * x[columns[k]];
+            }
+            y[row] = sum;
+        }
+    });
+}
+
+MultigridSolver::MultigridSolver(SparseMatrix matrix,
+                                 const std::vector<double>& position_x,
+                                 const std::vector<double>& position_y,
+                                 double bin_size,
+                                 bool singular)
+  : singular(singular) {
+    levels.emplace_back();
+    levels.back().matrix = std::move(matrix);
+
+    std::vector<double> level_x = position_x;
+    std::vector<double> level_y = position_y;
+    while (levels.back().matrix.numRows() > MAX_COARSEST_UNKNOWNS) {
+        Level& fine               = levels.back();
+        const size_t num_unknowns = fine.matrix.numRows();
+
+        // Merge the unknowns in each bin, numbering the coarse unknowns in the order
+        // their first member appears so the levels don't depend on anything but the
+        // order of the unknowns
+        std::map<std::pair<long long, long long>, int> bin_unknowns;
+        std::vector<int> coarse_unknown(num_unknowns);
+        for (size_t i = 0; i < num_unknowns; i++) {
+            const std::pair<long long, long long> bin = {
+                static_cast<long long>(std::floor(level_x[i] / bin_size)),
+                static_cast<long long>(std::floor(level_y[i] / bin_size))};
+            auto inserted = bin_unknowns.emplace(bin, bin_unknowns.size());
+            coarse_unknown[i] = inserted.first->second;
+        }
+        const size_t num_coarse_unknowns = bin_unknowns.size();
+        if (num_coarse_unknowns > MIN_COARSENING_RATIO * num_unknowns) {
+            break;
+        }
+
+        // The position of each coarse unknown is the mean of it's members
+        std::vector<double> coarse_x(num_coarse_unknowns, 0);
+        std::vector<double> coarse_y(num_coarse_unknowns, 0);
+        std::vector<int> num_members(num_coarse_unknowns, 0);
+        for (size_t i = 0; i < num_unknowns; i++) {
+            coarse_x[coarse_unknown[i]] += level_x[i];
+            coarse_y[coarse_unknown[i]] += level_y[i];
+            num_members[coarse_unknown[i]]++;
+        }
+        for (size_t c = 0; c < num_coarse_unknowns; c++) {
+            coarse_x[c] /= num_members[c];
+            coarse_y[c] /= num_members[c];
+        }
+
+        // The Galerkin product P^T A P just sums the entries of every pair of bins
+        std::vector<std::map<int, double>> coarse_rows(num_coarse_unknowns);
+        for (size_t i = 0; i < num_unknowns; i++) {
+            std::map<int, double>& coarse_row = coarse_rows[coarse_unknown[i]];
+            for (int k = fine.matrix.row_offsets[i]; k < fine.matrix.row_offsets[i + 1];
+                 k++) {
+                coarse_row[coarse_unknown[fine.matrix.columns[k]]] +=
+                    fine.matrix.values[k];
+            }
+        }
+        SparseMatrix coarse_matrix;
+        for (const std::map<int, double>& coarse_row : coarse_rows) {
+            for (const auto& entry : coarse_row) {
+                coarse_matrix.columns.emplace_back(entry.first);
+                coarse_matrix.values.emplace_back(entry.second);
+            }
+            coarse_matrix.row_offsets.emplace_back(coarse_matrix.columns.size());
+        }
+
+        fine.coarse_unknown = std::move(coarse_unknown);
+        levels.emplace_back();
+        levels.back().matrix = std::move(coarse_matrix);
+        level_x              = std::move(coarse_x);
+        level_y              = std::move(coarse_y);
+        bin_size *= 2;
+    }
+
+    for (Level& level : levels) {
+        const SparseMatrix& level_matrix = level.matrix;
+        const size_t num_unknowns        = level_matrix.numRows();
+        level.inverse_diagonal.assign(num_unknowns, 0);
+        for (size_t i = 0; i < num_unknowns; i++) {
+            for (int k = level_matrix.row_offsets[i];
+                 k < level_matrix.row_offsets[i + 1];
+                 k++) {
+                if (level_matrix.columns[k] == static_cast<int>(i) &&
+                    level_matrix.values[k] != 0) {
+                    level.inverse_diagonal[i] = 1 / level_matrix.values[k];
+                }
+            }
+        }
+        level.solution.resize(num_unknowns);
+        level.rhs.resize(num_unknowns);
+        level.product.resize(num_unknowns);
+    }
+}
+
+LinearSolveResult MultigridSolver::solve(const std::vector<double>& b,
+                                         std::vector<double>& x,
+                                         double tolerance,
+                                         int max_iterations,
+                                         ThreadPool& thread_pool) {
+    const SparseMatrix& matrix = levels.front().matrix;
+    const size_t num_unknowns  = matrix.numRows();
+    x.resize(num_unknowns, 0);
+
+    // For a singular matrix only the part of `b` outside the null space can be matched
+    residual = b;
+    removeNullSpace(residual, thread_pool);
+    const double b_norm = std::sqrt(dot(residual, residual, thread_pool));
+    if (b_norm == 0) {
+        std::fill(x.begin(), x.end(), 0);
+        return LinearSolveResult();
+    }
+
+    removeNullSpace(x, thread_pool);
+    matrix.multiply(x, product, thread_pool);
+    thread_pool.parallelFor(num_unknowns, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            residual[i] -= product[i];
+        }
+    });
+
+    // Apply the V-cycle to the current residual, giving `preconditioned`
+    auto precondition = [&]() {
+        levels.front().rhs = residual;
+        vCycle(0, thread_pool);
+        preconditioned = levels.front().solution;
+        removeNullSpace(preconditioned, thread_pool);
+    };
+
+    LinearSolveResult result;
+    result.relative_residual = std::sqrt(dot(residual, residual, thread_pool)) / b_norm;
+    if (result.relative_residual <= tolerance) {
+        return result;
+    }
+
+    precondition();
+    direction  = preconditioned;
+    double rho = dot(residual, preconditioned, thread_pool);
+    while (result.iterations < max_iterations) {
+        result.iterations++;
+
+        matrix.multiply(direction, product, thread_pool);
+        const double alpha = rho / dot(direction, product, thread_pool);
+        thread_pool.parallelFor(num_unknowns, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                x[i] += alpha * direction[i];
+                residual[i] -= alpha * product[i];
+            }
+        });
+
+        result.relative_residual =
+            std::sqrt(dot(residual, residual, thread_pool)) / b_norm;
+        if (result.relative_residual <= tolerance) {
+            return result;
+        }
+
+        precondition();
+        const double next_rho = dot(residual, preconditioned, thread_pool);
+        const double beta     = next_rho / rho;
+        rho                   = next_rho;
+        thread_pool.parallelFor(num_unknowns, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                direction[i] = preconditioned[i] + beta * direction[i];
+            }
+        });
+    }
+
+    result.converged = false;
+    return result;
+}
+
+void MultigridSolver::vCycle(size_t level_index, ThreadPool& thread_pool) {
+    Level& level = levels[level_index];
+    std::fill(level.solution.begin(), level.solution.end(), 0);
+
+    if (level_index + 1 == levels.size()) {
+        smooth(level, NUM_COARSEST_SWEEPS, thread_pool);
+        return;
+    }
+
+    smooth(level, NUM_SMOOTHING_SWEEPS, thread_pool);
+
+    // Restrict the residual to the coarser level, in order of the fine unknowns so the
+    // sums don't depend on the number of threads
+    Level& coarse = levels[level_index + 1];
+    level.matrix.multiply(level.solution, level.product, thread_pool);
+    std::fill(coarse.rhs.begin(), coarse.rhs.end(), 0);
+    for (size_t i = 0; i < level.solution.size(); i++) {
+        coarse.rhs[level.coarse_unknown[i]] += level.rhs[i] - level.product[i];
+    }
+
+    vCycle(level_index + 1, thread_pool);
+
+    thread_pool.parallelFor(level.solution.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            level.solution[i] += coarse.solution[level.coarse_unknown[i]];
+        }
+    });
+
+    // The same number of sweeps before and after keeps the V-cycle symmetric, which
+    // conjugate gradients relies on
+    smooth(level, NUM_SMOOTHING_SWEEPS, thread_pool);
+}
+
+void MultigridSolver::smooth(Level& level, int num_sweeps, ThreadPool& thread_pool) {
+    for (int sweep = 0; sweep < num_sweeps; sweep++) {
+        level.matrix.multiply(level.solution, level.product, thread_pool);
+        thread_pool.parallelFor(level.solution.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                level.solution[i] += JACOBI_DAMPING * level.inverse_diagonal[i] *
+                                     (level.rhs[i] - level.product[i]);
+            }
+        });
+    }
+}
+
+void MultigridSolver::removeNullSpace(std::vector<double>& vector,
+                                      ThreadPool& thread_pool) {
+    if (!singular || vector.empty()) {
+        return;
+    }
+
+    const double sum = deterministicSum(
+        vector.size(), [&](size_t i) { return vector[i]; }, thread_pool);
+    const double mean = sum / vector.size();
+    thread_pool.parallelFor(vector.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            vector[i] -= mean;
+        }
+    });
+}
@@ -0,0 +1,296 @@
+#include "Profiler.h"
+
+// STD Includes
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+// One phase or counter value kept for the trace
+struct ProfileEvent {
+    const char* name;
+    // When it started, relative to `Registry::origin` (ns)
+    int64_t start;
+    // How long the phase took (ns), or -1 for a counter value
+    int64_t duration;
+    // The value added, for a counter value
+    double value;
+};
+
+// Everything recorded on one thread
+struct ThreadProfile {
+    // The number of the thread
+    int thread;
+
+    // Guards everything below. Only the thread itself records, so this is only
+    // contended while the results are being read.
+    std::mutex mutex;
+
+    // The phases and counter values kept for the trace
+    std::vector<ProfileEvent> events;
+
+    // Every phase and counter, by name
+    std::unordered_map<const char*, ProfilePhaseStats> phases;
+    std::unordered_map<const char*, ProfileCounterStats> counters;
+};
+
+// Every thread that has recorded anything
+struct Registry {
+    // Guards `threads`
+    std::mutex mutex;
+
+    // Every thread that has recorded anything. These are never destroyed, so a
+    // thread's profile can still be read after it exits.
+    std::vector<std::unique_ptr<ThreadProfile>> threads;
+
+    // Whether recording is enabled
+    std::atomic<bool> enabled{true};
+
+    // The time every event is relative to
+    const std::chrono::steady_clock::time_point origin =
+        std::chrono::steady_clock::now();
+};
+
+/**
+ * Get the registry of every thread
+ *
+ * @return the registry of every thread
+ */
+Registry& getRegistry() {
+    static Registry registry;
+    return registry;
+}
+
+/**
+ * Get the profile of the calling thread, creating it if this is the first time this
+ * thread has recorded anything
+ *
+ * @return the profile of the calling thread
+ */
+ThreadProfile& getThreadProfile() {
+    thread_local ThreadProfile* thread_profile = nullptr;
+    if (!thread_profile) {
+        Registry& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.threads.emplace_back(std::make_unique<ThreadProfile>());
+        thread_profile         = registry.threads.back().get();
+        thread_profile->thread = static_cast<int>(registry.threads.size()) - 1;
+        thread_profile->events.reserve(1024);
+    }
+    return *thread_profile;
+}
+
+/**
+ * Get the time since the origin of the trace (ns)
+ *
+ * @param time the time to convert
+ *
+ * @return the time since the origin of the trace (ns)
+ */
+int64_t toTraceTime(std::chrono::steady_clock::time_point time) {
+    const auto since_origin = time - getRegistry().origin;
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(since_origin).count();
+}
+
+/**
+ * Write the given string as a JSON string
+ *
+ * @param output the stream to write to
+ * @param string the string to write
+ */
+void writeJsonString(std::ostream& output, const char* string) {
+    output << '"';
+    for (const char* c = string; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            output << '\\' << *c;
+        } else if (static_cast<unsigned char>(*c) < 0x20) {
+            output << ' ';
+        } else {
+            output << *c;
+        }
+    }
+    output << '"';
+}
+
+/**
+ * Combine the stats of every thread, and sort them by name (then thread)
+ *
+ * @param stats the stats of every thread, with their thread set
+ * @param per_thread whether to keep each thread separate
+ * @param combine adds the second stats to the first
+ *
+ * @return the combined, sorted stats
+ */
+template <typename Stats, typename Combine>
+std::vector<Stats> combineStats(std::vector<Stats> stats,
+                                bool per_thread,
+                                const Combine& combine) {
+    std::map<std::pair<std::string, int>, Stats> combined;
+    for (Stats& entry : stats) {
+        if (!per_thread) {
+            entry.thread = -1;
+        }
+        auto key      = std::make_pair(entry.name, entry.thread);
+        auto existing = combined.find(key);
+        if (existing == combined.end()) {
+            combined.emplace(key, entry);
+        } else {
+            combine(existing->second, entry);
+        }
+    }
+
+    std::vector<Stats> result;
+    for (auto& entry : combined) {
+        result.emplace_back(std::move(entry.second));
+    }
+    return result;
+}
+} // namespace
+
+void Profiler::setEnabled(bool enabled) {
+    getRegistry().enabled = enabled;
+}
+
+bool Profiler::isEnabled() {
+    return getRegistry().enabled.load(std::memory_order_relaxed);
+}
+
+void Profiler::reset() {
+    Registry& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (auto& thread : registry.threads) {
+        std::lock_guard<std::mutex> thread_lock(thread->mutex);
+        thread->events.clear();
+        thread->phases.clear();
+        thread->counters.clear();
+    }
+}
+
+std::vector<ProfilePhaseStats> Profiler::getPhaseStats(bool per_thread) {
+    std::vector<ProfilePhaseStats> stats;
+    {
+        Registry& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (auto& thread : registry.threads) {
+            std::lock_guard<std::mutex> thread_lock(thread->mutex);
+            for (const auto& phase : thread->phases) {
+                stats.emplace_back(phase.second);
+            }
+        }
+    }
+
+    return combineStats(std::move(stats),
+                        per_thread,
+                        [](ProfilePhaseStats& a, const ProfilePhaseStats& b) {
+                            a.num_calls += b.num_calls;
+                            a.total_time += b.total_time;
+                            a.min_time = std::min(a.min_time, b.min_time);
+                            a.max_time = std::max(a.max_time, b.max_time);
+                        });
+}
+
+std::vector<ProfileCounterStats> Profiler::getCounterStats(bool per_thread) {
+    std::vector<ProfileCounterStats> stats;
+    {
+        Registry& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (auto& thread : registry.threads) {
+            std::lock_guard<std::mutex> thread_lock(thread->mutex);
+            for (const auto& counter : thread->counters) {
+                stats.emplace_back(counter.second);
+            }
+        }
+    }
+
+    return combineStats(std::move(stats),
+                        per_thread,
+                        [](ProfileCounterStats& a, const ProfileCounterStats& b) {
+                            a.num_samples += b.num_samples;
+                            a.total += b.total;
+                        });
+}
+
+void Profiler::writeChromeTrace(std::ostream& output) {
+    Registry& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    // Times in a Chrome trace are in microseconds, which we write to the nanosecond
+    const std::ios_base::fmtflags flags = output.flags();
+    const std::streamsize precision     = output.precision();
+    output << std::fixed << std::setprecision(3);
+
+    output << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    for (auto& thread : registry.threads) {
+        std::lock_guard<std::mutex> thread_lock(thread->mutex);
+        output << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\","
+               << "\"pid\":1,\"tid\":" << thread->thread
+               << ",\"args\":{\"name\":\"thread " << thread->thread << "\"}}";
+        first = false;
+
+        for (const ProfileEvent& event : thread->events) {
+            output << ",\n{\"name\":";
+            writeJsonString(output, event.name);
+            output << ",\"cat\":\"simple_cfd\",\"pid\":1,\"tid\":" << thread->thread
+                   << ",\"ts\":" << event.start / 1e3;
+            if (event.duration >= 0) {
+                output << ",\"ph\":\"X\",\"dur\":" << event.duration / 1e3 << "}";
+            } else {
+                output << ",\"ph\":\"C\",\"args\":{\"value\":" << event.value << "}}";
+            }
+        }
+    }
+    output << "\n]}\n";
+
+    output.flags(flags);
+    output.precision(precision);
+}
+
+void Profiler::recordPhase(const char* name,
+                           std::chrono::steady_clock::time_point start,
+                           std::chrono::steady_clock::time_point end) {
+    ThreadProfile& profile = getThreadProfile();
+    const int64_t start_ns = toTraceTime(start);
+    const int64_t duration_ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    const double duration = duration_ns * 1e-9;
+
+    std::lock_guard<std::mutex> lock(profile.mutex);
+    if (profile.events.size() < MAX_EVENTS_PER_THREAD) {
+        profile.events.push_back({name, start_ns, duration_ns, 0});
+    }
+
+    ProfilePhaseStats& stats = profile.phases[name];
+    if (stats.num_calls == 0) {
+        stats.name     = name;
+        stats.thread   = profile.thread;
+        stats.min_time = duration;
+        stats.max_time = duration;
+    }
+    stats.num_calls++;
+    stats.total_time += duration;
+    stats.min_time = std::min(stats.min_time, duration);
+    stats.max_time = std::max(stats.max_time, duration);
+}
+
+void Profiler::addCount(const char* name, double value) {
+    ThreadProfile& profile = getThreadProfile();
+    const int64_t time_ns  = toTraceTime(std::chrono::steady_clock::now());
+
+    std::lock_guard<std::mutex> lock(profile.mutex);
+    if (profile.events.size() < MAX_EVENTS_PER_THREAD) {
+        profile.events.push_back({name, time_ns, -1, value});
+    }
+
+    ProfileCounterStats& stats = profile.counters[name];
+    if (stats.num_samples == 0) {
+        stats.name   = name;
+        stats.thread = profile.thread;
+    }
+    stats.num_samples++;
+    stats.total += value;
+}
@@ -0,0 +1,278 @@
+#include "ProjectionSolver.h"
+
+// STD Includes
+#include <algorithm>
+#include <limits>
+#include <set>
+#include <utility>
+
+ProjectionSolver::ProjectionSolver(std::shared_ptr<const ControlVolumeMesh> mesh,
+                                   const std::vector<uint8_t>& obstacle_cell_mask)
+  : mesh(std::move(mesh)) {
+    const ControlVolumeMesh& cells        = *this->mesh;
+    const size_t num_cells                = cells.numCells();
+    const std::vector<double>& cell_x     = cells.getCellX();
+    const std::vector<double>& cell_y     = cells.getCellY();
+    const std::vector<double>& cell_scale = cells.getCellScale();
+
+    unknown_index.assign(num_cells, -1);
+    for (size_t i = 0; i < num_cells; i++) {
+        if (!obstacle_cell_mask[i]) {
+            unknown_index[i] = static_cast<int>(fluid_cells.size());
+            fluid_cells.emplace_back(i);
+        }
+    }
+
+    for (int direction = 0; direction < NUM_DIRECTIONS; direction++) {
+        neighbours[direction] = cells.getNeighbours(static_cast<Direction>(direction));
+        for (int& neighbour : neighbours[direction]) {
+            if (neighbour != ControlVolumeMesh::NO_NEIGHBOUR &&
+                obstacle_cell_mask[neighbour]) {
+                neighbour = OBSTACLE_NEIGHBOUR;
+            }
+        }
+    }
+
+    // Every pair of adjacent uncovered cells is coupled by the flux through the face
+    // between them, (p_j - p_i) * face length / distance. On a multi-resolution mesh a
+    // large cell only stores one of it's smaller neighbours, so the pairs are gathered
+    // from both sides to keep the matrix symmetric.
+    std::set<std::pair<int, int>> faces;
+    std::vector<std::vector<std::pair<int, double>>> couplings(fluid_cells.size());
+    for (int cell : fluid_cells) {
+        for (int direction = 0; direction < NUM_DIRECTIONS; direction++) {
+            const int neighbour = neighbours[direction][cell];
+            if (neighbour < 0) {
+                continue;
+            }
+            if (!faces.emplace(std::min(cell, neighbour), std::max(cell, neighbour))
+                     .second) {
+                continue;
+            }
+
+            const double distance =
+                cells.getNeighbourDistances(static_cast<Direction>(direction))[cell];
+            const double weight =
+                std::min(cell_scale[cell], cell_scale[neighbour]) / distance;
+            const int cell_unknown      = unknown_index[cell];
+            const int neighbour_unknown = unknown_index[neighbour];
+            couplings[cell_unknown].emplace_back(neighbour_unknown, weight);
+            couplings[neighbour_unknown].emplace_back(cell_unknown, weight);
+        }
+    }
+
+    // This is minus the Laplacian (integrated over each cell), so it is positive
+    // semi-definite with the constant pressure as it's null space
+    SparseMatrix matrix;
+    for (std::vector<std::pair<int, double>>& row_couplings : couplings) {
+        const int row = static_cast<int>(matrix.numRows());
+        std::sort(row_couplings.begin(), row_couplings.end());
+
+        double diagonal = 0;
+        for (const std::pair<int, double>& coupling : row_couplings) {
+            diagonal += coupling.second;
+        }
+
+        bool diagonal_added = false;
+        for (const std::pair<int, double>& coupling : row_couplings) {
+            if (!diagonal_added && coupling.first > row) {
+                matrix.columns.emplace_back(row);
+                matrix.values.emplace_back(diagonal);
+                diagonal_added = true;
+            }
+            matrix.columns.emplace_back(coupling.first);
+            matrix.values.emplace_back(-coupling.second);
+        }
+        if (!diagonal_added) {
+            matrix.columns.emplace_back(row);
+            matrix.values.emplace_back(diagonal);
+        }
+        matrix.row_offsets.emplace_back(matrix.columns.size());
+    }
+
+    std::vector<double> centre_x(fluid_cells.size());
+    std::vector<double> centre_y(fluid_cells.size());
+    double min_scale = std::numeric_limits<double>::infinity();
+    for (size_t k = 0; k < fluid_cells.size(); k++) {
+        const int i = fluid_cells[k];
+        centre_x[k] = cell_x[i] + cell_scale[i] / 2;
+        centre_y[k] = cell_y[i] + cell_scale[i] / 2;
+        min_scale   = std::min(min_scale, cell_scale[i]);
+    }
+
+    pressure_solver = std::make_unique<MultigridSolver>(
+        std::move(matrix), centre_x, centre_y, 2 * min_scale, true);
+}
+
+LinearSolveResult ProjectionSolver::step(const ControlVolumeFields& current,
+                                         const StencilEdgeStates<double>& edges,
+                                         double dt,
+                                         double density,
+                                         double viscosity,
+                                         ThreadPool& thread_pool,
+                                         ControlVolumeFields& next,
+                                         ImplicitDiffusionSolver* diffusion_solver) {
+    const std::vector<int>& left_neighbours     = neighbours[LEFT];
+    const std::vector<int>& right_neighbours    = neighbours[RIGHT];
+    const std::vector<int>& top_neighbours      = neighbours[TOP];
+    const std::vector<int>& bottom_neighbours   = neighbours[BOTTOM];
+    const std::vector<double>& left_distances   = mesh->getNeighbourDistances(LEFT);
+    const std::vector<double>& right_distances  = mesh->getNeighbourDistances(RIGHT);
+    const std::vector<double>& top_distances    = mesh->getNeighbourDistances(TOP);
+    const std::vector<double>& bottom_distances = mesh->getNeighbourDistances(BOTTOM);
+    const std::vector<double>& cell_scale       = mesh->getCellScale();
+
+    // Advect and diffuse the velocity, ignoring pressure
+    const double explicit_viscosity = diffusion_solver ? 0 : viscosity;
+    thread_pool.parallelFor(fluid_cells.size(), [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            const int i    = fluid_cells[k];
+            const double u = current.velocity_x[i];
+            const double v = current.velocity_y[i];
+
+            double left_u, left_v, right_u, right_v, top_u, top_v, bottom_u, bottom_v;
+            neighbourVelocity(current, left_neighbours[i], edges.left, left_u, left_v);
+            neighbourVelocity(
+                current, right_neighbours[i], edges.right, right_u, right_v);
+            neighbourVelocity(current, top_neighbours[i], edges.top, top_u, top_v);
+            neighbourVelocity(
+                current, bottom_neighbours[i], edges.bottom, bottom_u, bottom_v);
+
+            const double h_left   = left_distances[i];
+            const double h_right  = right_distances[i];
+            const double h_top    = top_distances[i];
+            const double h_bottom = bottom_distances[i];
+
+            // First order upwind derivatives along the flow
+            const double u_dot_x =
+                u > 0 ? (u - left_u) / h_left : (right_u - u) / h_right;
+            const double v_dot_x =
+                u > 0 ? (v - left_v) / h_left : (right_v - v) / h_right;
+            const double u_dot_y =
+                v > 0 ? (u - bottom_u) / h_bottom : (top_u - u) / h_top;
+            const double v_dot_y =
+                v > 0 ? (v - bottom_v) / h_bottom : (top_v - v) / h_top;
+
+            const double u_dotdot =
+                2 / (h_left + h_right) *
+                    ((right_u - u) / h_right - (u - left_u) / h_left) +
+                2 / (h_bottom + h_top) *
+                    ((top_u - u) / h_top - (u - bottom_u) / h_bottom);
+            const double v_dotdot =
+                2 / (h_left + h_right) *
+                    ((right_v - v) / h_right - (v - left_v) / h_left) +
+                2 / (h_bottom + h_top) *
+                    ((top_v - v) / h_top - (v - bottom_v) / h_bottom);
+
+            next.velocity_x[i] =
+                u + dt * (explicit_viscosity * u_dotdot - u * u_dot_x - v * u_dot_y);
+            next.velocity_y[i] =
+                v + dt * (explicit_viscosity * v_dotdot - u * v_dot_x - v * v_dot_y);
+        }
+    });
+    if (diffusion_solver) {
+        diffusion_solver->diffuse(next, edges, dt, viscosity, thread_pool);
+    }
+
+    // Solve -lap(p) = -(density / dt) * div(u), integrated over each cell
+    // NOTE: The divergence is only needed until the pressure has been solved for, so
+    //       it is kept in the pressure field of `next`
+    std::vector<double>& divergence = next.pressure;
+    computeDivergence(next, edges, thread_pool, divergence);
+    pressure_rhs.resize(fluid_cells.size());
+    pressure_solution.resize(fluid_cells.size());
+    for (size_t k = 0; k < fluid_cells.size(); k++) {
+        const int i          = fluid_cells[k];
+        const double area    = cell_scale[i] * cell_scale[i];
+        pressure_rhs[k]      = -density / dt * divergence[i] * area;
+        pressure_solution[k] = current.pressure[i];
+    }
+    const LinearSolveResult result = pressure_solver->solve(pressure_rhs,
+                                                            pressure_solution,
+                                                            PRESSURE_TOLERANCE,
+                                                            MAX_PRESSURE_ITERATIONS,
+                                                            thread_pool);
+
+    std::fill(next.pressure.begin(), next.pressure.end(), 0);
+    for (size_t k = 0; k < fluid_cells.size(); k++) {
+        next.pressure[fluid_cells[k]] = pressure_solution[k];
+    }
+
+    // Subtract the pressure gradient, with no gradient across the boundary
+    auto neighbour_pressure = [&](int neighbour, int i) {
+        return neighbour >= 0 ? next.pressure[neighbour] : next.pressure[i];
+    };
+    thread_pool.parallelFor(fluid_cells.size(), [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            const int i = fluid_cells[k];
+            const double p_dot_x =
+                (neighbour_pressure(right_neighbours[i], i) -
+                 neighbour_pressure(left_neighbours[i], i)) /
+                (left_distances[i] + right_distances[i]);
+            const double p_dot_y =
+                (neighbour_pressure(top_neighbours[i], i) -
+                 neighbour_pressure(bottom_neighbours[i], i)) /
+                (bottom_distances[i] + top_distances[i]);
+            next.velocity_x[i] -= dt / density * p_dot_x;
+            next.velocity_y[i] -= dt / density * p_dot_y;
+        }
+    });
+
+    for (size_t i = 0; i < unknown_index.size(); i++) {
+        if (unknown_index[i] < 0) {
+            next.velocity_x[i] = 0;
+            next.velocity_y[i] = 0;
+        }
+    }
+
+    return result;
+}
+
+void ProjectionSolver::computeDivergence(const ControlVolumeFields& fields,
+                                         const StencilEdgeStates<double>& edges,
+                                         ThreadPool& thread_pool,
+                                         std::vector<double>& divergence) const {
+    const std::vector<double>& left_distances   = mesh->getNeighbourDistances(LEFT);
+    const std::vector<double>& right_distances  = mesh->getNeighbourDistances(RIGHT);
+    const std::vector<double>& top_distances    = mesh->getNeighbourDistances(TOP);
+    const std::vector<double>& bottom_distances = mesh->getNeighbourDistances(BOTTOM);
+
+    divergence.resize(unknown_index.size());
+    thread_pool.parallelFor(unknown_index.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            if (unknown_index[i] < 0) {
+                divergence[i] = 0;
+                continue;
+            }
+
+            double left_u, left_v, right_u, right_v, top_u, top_v, bottom_u, bottom_v;
+            neighbourVelocity(fields, neighbours[LEFT][i], edges.left, left_u, left_v);
+            neighbourVelocity(
+                fields, neighbours[RIGHT][i], edges.right, right_u, right_v);
+            neighbourVelocity(fields, neighbours[TOP][i], edges.top, top_u, top_v);
+            neighbourVelocity(
+                fields, neighbours[BOTTOM][i], edges.bottom, bottom_u, bottom_v);
+
+            divergence[i] =
+                (right_u - left_u) / (left_distances[i] + right_distances[i]) +
+                (top_v - bottom_v) / (bottom_distances[i] + top_distances[i]);
+        }
+    });
+}
+
+void ProjectionSolver::neighbourVelocity(const ControlVolumeFields& fields,
+                                         int neighbour,
+                                         const CellState& edge,
+                                         double& velocity_x,
+                                         double& velocity_y) {
+    if (neighbour >= 0) {
+        velocity_x = fields.velocity_x[neighbour];
+        velocity_y = fields.velocity_y[neighbour];
+    } else if (neighbour == OBSTACLE_NEIGHBOUR) {
+        velocity_x = 0;
+        velocity_y = 0;
+    } else {
+        velocity_x = edge.velocity_x;
+        velocity_y = edge.velocity_y;
+    }
+}
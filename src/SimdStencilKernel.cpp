@@ -0,0 +1,370 @@
+#include "SimdStencilKernel.h"
+
+// STD Includes
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMPLE_CFD_X86_SIMD
+#include <immintrin.h>
+#endif
+
+// Enabling AVX-512 also enables FMA, so stop the compiler from contracting separate
+// multiplies and adds into fused multiply-adds, which would change the rounding of the
+// results compared to the scalar kernel
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("fp-contract=off")
+#elif defined(__clang__)
+#pragma clang fp contract(off)
+#endif
+
+namespace {
+    /**
+     * Update the given uniform cells one at a time
+     *
+     * See `updateUniformCells` for a description of the arguments
+     */
+    void updateUniformCellsScalar(const UniformStencilCells& uniform_cells,
+                                  size_t begin,
+                                  size_t end,
+                                  const ControlVolumeFields& current,
+                                  const CellState* top_velocity_override,
+                                  double dt,
+                                  const FluidCoefficients& fluid,
+                                  ControlVolumeFields& next) {
+        auto cell_state = [&current](int i) -> CellState {
+            return {current.pressure[i], current.velocity_x[i], current.velocity_y[i]};
+        };
+
+        for (size_t k = begin; k < end; k++) {
+            const int cell = uniform_cells.cells[k];
+
+            CellState top_state = cell_state(uniform_cells.neighbours[TOP][k]);
+            if (top_velocity_override) {
+                top_state.velocity_x = top_velocity_override->velocity_x;
+                top_state.velocity_y = top_velocity_override->velocity_y;
+            }
+
+            const CellState updated =
+                updateCellState(cell_state(cell),
+                                cell_state(uniform_cells.neighbours[LEFT][k]),
+                                uniform_cells.distances[LEFT][k],
+                                cell_state(uniform_cells.neighbours[RIGHT][k]),
+                                uniform_cells.distances[RIGHT][k],
+                                top_state,
+                                uniform_cells.distances[TOP][k],
+                                cell_state(uniform_cells.neighbours[BOTTOM][k]),
+                                uniform_cells.distances[BOTTOM][k],
+                                dt,
+                                fluid);
+            next.pressure[cell]   = updated.pressure;
+            next.velocity_x[cell] = updated.velocity_x;
+            next.velocity_y[cell] = updated.velocity_y;
+        }
+    }
+
+#ifdef SIMPLE_CFD_X86_SIMD
+    /**
+     * Load four consecutive indices
+     *
+     * @param indices the indices to load from
+     * @param k the position of the first index to load
+     *
+     * @return the four indices starting at `k`
+     */
+    __attribute__((target("avx2"))) inline __m128i
+        loadIndicesAvx2(const std::vector<int>& indices, size_t k) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(&indices[k]));
+    }
+
+    /**
+     * Load eight consecutive indices
+     *
+     * @param indices the indices to load from
+     * @param k the position of the first index to load
+     *
+     * @return the eight indices starting at `k`
+     */
+    __attribute__((target("avx512f"))) inline __m256i
+        loadIndicesAvx512(const std::vector<int>& indices, size_t k) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&indices[k]));
+    }
+
+    /**
+     * Update the given uniform cells four at a time with AVX2
+     *
+     * See `updateUniformCells` for a description of the arguments
+     */
+    __attribute__((target("avx2"))) void
+        updateUniformCellsAvx2(const UniformStencilCells& uniform_cells,
+                               size_t begin,
+                               size_t end,
+                               const ControlVolumeFields& current,
+                               const CellState* top_velocity_override,
+                               double dt,
+                               const FluidCoefficients& fluid,
+                               ControlVolumeFields& next) {
+        const double* pressure   = current.pressure.data();
+        const double* velocity_x = current.velocity_x.data();
+        const double* velocity_y = current.velocity_y.data();
+
+        const __m256d two         = _mm256_set1_pd(2.0);
+        const __m256d dt_v        = _mm256_set1_pd(dt);
+        const __m256d dt_density  = _mm256_set1_pd(dt / fluid.density);
+        const __m256d dt_visc     = _mm256_set1_pd(dt * fluid.viscosity);
+        const __m256d dt_c_square = _mm256_set1_pd(dt * fluid.speed_of_sound_squared);
+
+        size_t k = begin;
+        for (; k + 4 <= end; k += 4) {
+            const __m128i c = loadIndicesAvx2(uniform_cells.cells, k);
+            const __m128i l = loadIndicesAvx2(uniform_cells.neighbours[LEFT], k);
+            const __m128i r = loadIndicesAvx2(uniform_cells.neighbours[RIGHT], k);
+            const __m128i t = loadIndicesAvx2(uniform_cells.neighbours[TOP], k);
+            const __m128i b = loadIndicesAvx2(uniform_cells.neighbours[BOTTOM], k);
+
+            const __m256d p  = _mm256_i32gather_pd(pressure, c, 8);
+            const __m256d vx = _mm256_i32gather_pd(velocity_x, c, 8);
+            const __m256d vy = _mm256_i32gather_pd(velocity_y, c, 8);
+
+            const __m256d l_vx = _mm256_i32gather_pd(velocity_x, l, 8);
+            const __m256d l_vy = _mm256_i32gather_pd(velocity_y, l, 8);
+            const __m256d r_p  = _mm256_i32gather_pd(pressure, r, 8);
+            const __m256d r_vx = _mm256_i32gather_pd(velocity_x, r, 8);
+            const __m256d r_vy = _mm256_i32gather_pd(velocity_y, r, 8);
+            const __m256d t_p  = _mm256_i32gather_pd(pressure, t, 8);
+            const __m256d b_vx = _mm256_i32gather_pd(velocity_x, b, 8);
+            const __m256d b_vy = _mm256_i32gather_pd(velocity_y, b, 8);
+            __m256d t_vx, t_vy;
+            if (top_velocity_override) {
+                t_vx = _mm256_set1_pd(top_velocity_override->velocity_x);
+                t_vy = _mm256_set1_pd(top_velocity_override->velocity_y);
+            } else {
+                t_vx = _mm256_i32gather_pd(velocity_x, t, 8);
+                t_vy = _mm256_i32gather_pd(velocity_y, t, 8);
+            }
+
+            const __m256d l_d  = _mm256_loadu_pd(&uniform_cells.distances[LEFT][k]);
+            const __m256d r_d  = _mm256_loadu_pd(&uniform_cells.distances[RIGHT][k]);
+            const __m256d t_d  = _mm256_loadu_pd(&uniform_cells.distances[TOP][k]);
+            const __m256d b_d  = _mm256_loadu_pd(&uniform_cells.distances[BOTTOM][k]);
+            const __m256d lr_d = _mm256_mul_pd(l_d, r_d);
+            const __m256d bt_d = _mm256_mul_pd(b_d, t_d);
+
+            const __m256d v_dot_x = _mm256_div_pd(_mm256_sub_pd(r_vx, vx), r_d);
+            const __m256d w_dot_y = _mm256_div_pd(_mm256_sub_pd(t_vy, vy), t_d);
+            const __m256d p_dot_x = _mm256_div_pd(_mm256_sub_pd(r_p, p), r_d);
+            const __m256d p_dot_y = _mm256_div_pd(_mm256_sub_pd(t_p, p), t_d);
+
+            const __m256d two_vx = _mm256_mul_pd(two, vx);
+            const __m256d two_vy = _mm256_mul_pd(two, vy);
+            const __m256d v_dotdot_x = _mm256_div_pd(
+                _mm256_add_pd(_mm256_sub_pd(l_vx, two_vx), r_vx), lr_d);
+            const __m256d v_dotdot_y = _mm256_div_pd(
+                _mm256_add_pd(_mm256_sub_pd(b_vx, two_vx), t_vx), bt_d);
+            const __m256d w_dotdot_x = _mm256_div_pd(
+                _mm256_add_pd(_mm256_sub_pd(l_vy, two_vy), r_vy), lr_d);
+            const __m256d w_dotdot_y = _mm256_div_pd(
+                _mm256_add_pd(_mm256_sub_pd(b_vy, two_vy), t_vy), bt_d);
+
+            const __m256d divergence    = _mm256_add_pd(v_dot_x, w_dot_y);
+            const __m256d dt_divergence = _mm256_mul_pd(dt_v, divergence);
+
+            const __m256d new_vx = _mm256_add_pd(
+                _mm256_sub_pd(_mm256_sub_pd(vx, _mm256_mul_pd(dt_divergence, vx)),
+                              _mm256_mul_pd(dt_density, p_dot_x)),
+                _mm256_mul_pd(dt_visc, _mm256_add_pd(v_dotdot_x, v_dotdot_y)));
+            const __m256d new_vy = _mm256_add_pd(
+                _mm256_sub_pd(_mm256_sub_pd(vy, _mm256_mul_pd(dt_divergence, vy)),
+                              _mm256_mul_pd(dt_density, p_dot_y)),
+                _mm256_mul_pd(dt_visc, _mm256_add_pd(w_dotdot_x, w_dotdot_y)));
+            const __m256d new_p =
+                _mm256_sub_pd(p, _mm256_mul_pd(dt_c_square, divergence));
+
+            // AVX2 has no scatter, so write each lane out individually
+            alignas(32) double new_p_lanes[4], new_vx_lanes[4], new_vy_lanes[4];
+            _mm256_store_pd(new_p_lanes, new_p);
+            _mm256_store_pd(new_vx_lanes, new_vx);
+            _mm256_store_pd(new_vy_lanes, new_vy);
+            for (int lane = 0; lane < 4; lane++) {
+                const int cell        = uniform_cells.cells[k + lane];
+                next.pressure[cell]   = new_p_lanes[lane];
+                next.velocity_x[cell] = new_vx_lanes[lane];
+                next.velocity_y[cell] = new_vy_lanes[lane];
+            }
+        }
+
+        updateUniformCellsScalar(
+            uniform_cells, k, end, current, top_velocity_override, dt, fluid, next);
+    }
+
+    /**
+     * Update the given uniform cells eight at a time with AVX-512
+     *
+     * See `updateUniformCells` for a description of the arguments
+     */
+    __attribute__((target("avx512f"))) void
+        updateUniformCellsAvx512(const UniformStencilCells& uniform_cells,
+                                 size_t begin,
+                                 size_t end,
+                                 const ControlVolumeFields& current,
+                                 const CellState* top_velocity_override,
+                                 double dt,
+                                 const FluidCoefficients& fluid,
+                                 ControlVolumeFields& next) {
+        const double* pressure   = current.pressure.data();
+        const double* velocity_x = current.velocity_x.data();
+        const double* velocity_y = current.velocity_y.data();
+
+        const __m512d two         = _mm512_set1_pd(2.0);
+        const __m512d dt_v        = _mm512_set1_pd(dt);
+        const __m512d dt_density  = _mm512_set1_pd(dt / fluid.density);
+        const __m512d dt_visc     = _mm512_set1_pd(dt * fluid.viscosity);
+        const __m512d dt_c_square = _mm512_set1_pd(dt * fluid.speed_of_sound_squared);
+
+        size_t k = begin;
+        for (; k + 8 <= end; k += 8) {
+            const __m256i c = loadIndicesAvx512(uniform_cells.cells, k);
+            const __m256i l = loadIndicesAvx512(uniform_cells.neighbours[LEFT], k);
+            const __m256i r = loadIndicesAvx512(uniform_cells.neighbours[RIGHT], k);
+            const __m256i t = loadIndicesAvx512(uniform_cells.neighbours[TOP], k);
+            const __m256i b = loadIndicesAvx512(uniform_cells.neighbours[BOTTOM], k);
+
+            const __m512d p  = _mm512_i32gather_pd(c, pressure, 8);
+            const __m512d vx = _mm512_i32gather_pd(c, velocity_x, 8);
+            const __m512d vy = _mm512_i32gather_pd(c, velocity_y, 8);
+
+            const __m512d l_vx = _mm512_i32gather_pd(l, velocity_x, 8);
+            const __m512d l_vy = _mm512_i32gather_pd(l, velocity_y, 8);
+            const __m512d r_p  = _mm512_i32gather_pd(r, pressure, 8);
+            const __m512d r_vx = _mm512_i32gather_pd(r, velocity_x, 8);
+            const __m512d r_vy = _mm512_i32gather_pd(r, velocity_y, 8);
+            const __m512d t_p  = _mm512_i32gather_pd(t, pressure, 8);
+            const __m512d b_vx = _mm512_i32gather_pd(b, velocity_x, 8);
+            const __m512d b_vy = _mm512_i32gather_pd(b, velocity_y, 8);
+            __m512d t_vx, t_vy;
+            if (top_velocity_override) {
+                t_vx = _mm512_set1_pd(top_velocity_override->velocity_x);
+                t_vy = _mm512_set1_pd(top_velocity_override->velocity_y);
+            } else {
+                t_vx = _mm512_i32gather_pd(t, velocity_x, 8);
+                t_vy = _mm512_i32gather_pd(t, velocity_y, 8);
+            }
+
+            const __m512d l_d  = _mm512_loadu_pd(&uniform_cells.distances[LEFT][k]);
+            const __m512d r_d  = _mm512_loadu_pd(&uniform_cells.distances[RIGHT][k]);
+            const __m512d t_d  = _mm512_loadu_pd(&uniform_cells.distances[TOP][k]);
+            const __m512d b_d  = _mm512_loadu_pd(&uniform_cells.distances[BOTTOM][k]);
+            const __m512d lr_d = _mm512_mul_pd(l_d, r_d);
+            const __m512d bt_d = _mm512_mul_pd(b_d, t_d);
+
+            const __m512d v_dot_x = _mm512_div_pd(_mm512_sub_pd(r_vx, vx), r_d);
+            const __m512d w_dot_y = _mm512_div_pd(_mm512_sub_pd(t_vy, vy), t_d);
+            const __m512d p_dot_x = _mm512_div_pd(_mm512_sub_pd(r_p, p), r_d);
+            const __m512d p_dot_y = _mm512_div_pd(_mm512_sub_pd(t_p, p), t_d);
+
+            const __m512d two_vx = _mm512_mul_pd(two, vx);
+            const __m512d two_vy = _mm512_mul_pd(two, vy);
+            const __m512d v_dotdot_x = _mm512_div_pd(
+                _mm512_add_pd(_mm512_sub_pd(l_vx, two_vx), r_vx), lr_d);
+            const __m512d v_dotdot_y = _mm512_div_pd(
+                _mm512_add_pd(_mm512_sub_pd(b_vx, two_vx), t_vx), bt_d);
+            const __m512d w_dotdot_x = _mm512_div_pd(
+                _mm512_add_pd(_mm512_sub_pd(l_vy, two_vy), r_vy), lr_d);
+            const __m512d w_dotdot_y = _mm512_div_pd(
+                _mm512_add_pd(_mm512_sub_pd(b_vy, two_vy), t_vy), bt_d);
+
+            const __m512d divergence    = _mm512_add_pd(v_dot_x, w_dot_y);
+            const __m512d dt_divergence = _mm512_mul_pd(dt_v, divergence);
+
+            const __m512d new_vx = _mm512_add_pd(
+                _mm512_sub_pd(_mm512_sub_pd(vx, _mm512_mul_pd(dt_divergence, vx)),
+                              _mm512_mul_pd(dt_density, p_dot_x)),
+                _mm512_mul_pd(dt_visc, _mm512_add_pd(v_dotdot_x, v_dotdot_y)));
+            const __m512d new_vy = _mm512_add_pd(
+                _mm512_sub_pd(_mm512_sub_pd(vy, _mm512_mul_pd(dt_divergence, vy)),
+                              _mm512_mul_pd(dt_density, p_dot_y)),
+                _mm512_mul_pd(dt_visc, _mm512_add_pd(w_dotdot_x, w_dotdot_y)));
+            const __m512d new_p =
+                _mm512_sub_pd(p, _mm512_mul_pd(dt_c_square, divergence));
+
+            _mm512_i32scatter_pd(next.pressure.data(), c, new_p, 8);
+            _mm512_i32scatter_pd(next.velocity_x.data(), c, new_vx, 8);
+            _mm512_i32scatter_pd(next.velocity_y.data(), c, new_vy, 8);
+        }
+
+        updateUniformCellsScalar(
+            uniform_cells, k, end, current, top_velocity_override, dt, fluid, next);
+    }
+#endif
+}
+
+SimdLevel getBestSimdLevel() {
+    if (isSimdLevelSupported(SimdLevel::AVX512)) {
+        return SimdLevel::AVX512;
+    }
+    if (isSimdLevelSupported(SimdLevel::AVX2)) {
+        return SimdLevel::AVX2;
+    }
+    return SimdLevel::SCALAR;
+}
+
+bool isSimdLevelSupported(SimdLevel simd_level) {
+    switch (simd_level) {
+        case SimdLevel::SCALAR:
+            return true;
+#ifdef SIMPLE_CFD_X86_SIMD
+        case SimdLevel::AVX2:
+            return __builtin_cpu_supports("avx2");
+        case SimdLevel::AVX512:
+            return __builtin_cpu_supports("avx512f");
+#endif
+        default:
+            return false;
+    }
+}
+
+void updateUniformCells(SimdLevel simd_level,
+                        const UniformStencilCells& uniform_cells,
+                        size_t begin,
+                        size_t end,
+                        const ControlVolumeFields& current,
+                        const CellState* top_velocity_override,
+                        double dt,
+                        const FluidCoefficients& fluid,
+                        ControlVolumeFields& next) {
+    switch (simd_level) {
+        case SimdLevel::SCALAR:
+            updateUniformCellsScalar(uniform_cells,
+                                     begin,
+                                     end,
+                                     current,
+                                     top_velocity_override,
+                                     dt,
+                                     fluid,
+                                     next);
+            return;
+#ifdef SIMPLE_CFD_X86_SIMD
+        case SimdLevel::AVX2:
+            updateUniformCellsAvx2(uniform_cells,
+                                   begin,
+                                   end,
+                                   current,
+                                   top_velocity_override,
+                                   dt,
+                                   fluid,
+                                   next);
+            return;
+        case SimdLevel::AVX512:
+            updateUniformCellsAvx512(uniform_cells,
+                                     begin,
+                                     end,
+                                     current,
+                                     top_velocity_override,
+                                     dt,
+                                     fluid,
+                                     next);
+            return;
+#endif
+        default:
+            throw std::invalid_argument("SIMD level not supported on this platform");
+    }
+}
@@ -0,0 +1,70 @@
+#include "SimulationThread.h"
+
+// STD Includes
+#include <stdexcept>
+
+SimulationThread::SimulationThread(FluidSimulator simulator,
+                                   units::time::second_t dt,
+                                   int steps_per_frame)
+  : simulator(std::move(simulator)),
+    dt(dt),
+    steps_per_frame(steps_per_frame),
+    num_steps(0),
+    running(false) {
+    if (steps_per_frame < 1) {
+        throw std::invalid_argument("Must take at least one step per frame");
+    }
+    publishSnapshot();
+}
+
+SimulationThread::~SimulationThread() {
+    stop();
+}
+
+void SimulationThread::start() {
+    if (running) {
+        return;
+    }
+    running = true;
+    thread  = std::thread([this]() {
+        while (running.load(std::memory_order_relaxed)) {
+            runFrame();
+        }
+    });
+}
+
+void SimulationThread::stop() {
+    running = false;
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+bool SimulationThread::isRunning() const {
+    return running;
+}
+
+void SimulationThread::runFrame() {
+    for (int i = 0; i < steps_per_frame; i++) {
+        simulator.updateControlVolumes(dt);
+        num_steps++;
+    }
+    publishSnapshot();
+}
+
+const FieldSnapshot& SimulationThread::getLatestSnapshot() {
+    snapshots.update();
+    return snapshots.getReadBuffer();
+}
+
+FluidSimulator& SimulationThread::getSimulator() {
+    return simulator;
+}
+
+void SimulationThread::publishSnapshot() {
+    FieldSnapshot& snapshot = snapshots.getWriteBuffer();
+    simulator.takeSnapshot(snapshot);
+    simulator.buildFieldPyramid(snapshot.pyramid);
+    snapshot.num_steps = num_steps;
+    snapshots.publish();
+}
@@ -0,0 +1,198 @@
+#include "StreamLines.h"
+
+// STD Includes
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+// Project Includes
+#include "Profiler.h"
+
+using namespace units::length;
+
+namespace {
+    // A velocity, or direction, in the plane
+    struct Vector2d {
+        double x;
+        double y;
+    };
+
+    /**
+     * Get the neighbour of a cell along one axis that is on the same side of the
+     * cell's centre as the given offset
+     *
+     * @param mesh the mesh the cell is in
+     * @param cell the index of the cell
+     * @param negative_direction the direction of the neighbour below the centre
+     * @param positive_direction the direction of the neighbour above the centre
+     * @param offset the offset of the point from the cell's centre along this axis
+     * @param centre the position of the cell's centre along this axis
+     * @param positions the position of every cell along this axis
+     *
+     * @return the neighbour on the same side as the offset, and how far along the
+     * line from the cell's centre to that neighbour's centre the point is (clamped
+     * to [0, 1]). The neighbour is NO_NEIGHBOUR if there is none.
+     */
+    std::pair<int, double>
+        getInterpolationNeighbour(const ControlVolumeMesh& mesh,
+                                  int cell,
+                                  Direction negative_direction,
+                                  Direction positive_direction,
+                                  double offset,
+                                  double centre,
+                                  const std::vector<double>& positions) {
+        const int neighbour = mesh.getNeighbours(
+            offset < 0 ? negative_direction : positive_direction)[cell];
+        if (neighbour == ControlVolumeMesh::NO_NEIGHBOUR) {
+            return {ControlVolumeMesh::NO_NEIGHBOUR, 0};
+        }
+        const double neighbour_centre =
+            positions[neighbour] + mesh.getCellScale()[neighbour] / 2;
+        const double centre_distance = neighbour_centre - centre;
+        if (centre_distance * offset <= 0) {
+            return {ControlVolumeMesh::NO_NEIGHBOUR, 0};
+        }
+        return {neighbour, std::min(1.0, offset / centre_distance)};
+    }
+
+    /**
+     * Get the velocity of the flow at the given point
+     *
+     * @param locator locates cells in the mesh the fields are for
+     * @param fields the fields to get the velocity from
+     * @param x the x coordinate of the point (m)
+     * @param y the y coordinate of the point (m)
+     * @param velocity_sampling how to find the velocity at the point
+     * @param hint the cell the last point was in, updated to the cell this point is in
+     *
+     * @return the velocity of the flow at the given point (m/s)
+     */
+    Vector2d sampleVelocity(const CellLocator& locator,
+                            const ControlVolumeFields& fields,
+                            double x,
+                            double y,
+                            VelocitySampling velocity_sampling,
+                            int& hint) {
+        const int cell = locator.locate(x, y, hint);
+        hint           = cell;
+
+        Vector2d velocity = {fields.velocity_x[cell], fields.velocity_y[cell]};
+        if (velocity_sampling == VelocitySampling::NEAREST_CELL) {
+            return velocity;
+        }
+
+        // Interpolate towards the closest neighbour along each axis
+        const ControlVolumeMesh& mesh = locator.getMesh();
+        const double half_scale       = mesh.getCellScale()[cell] / 2;
+        const double centre_x         = mesh.getCellX()[cell] + half_scale;
+        const double centre_y         = mesh.getCellY()[cell] + half_scale;
+        const std::pair<int, double> neighbour_x = getInterpolationNeighbour(
+            mesh, cell, LEFT, RIGHT, x - centre_x, centre_x, mesh.getCellX());
+        const std::pair<int, double> neighbour_y = getInterpolationNeighbour(
+            mesh, cell, BOTTOM, TOP, y - centre_y, centre_y, mesh.getCellY());
+        for (const std::pair<int, double>& neighbour : {neighbour_x, neighbour_y}) {
+            if (neighbour.first == ControlVolumeMesh::NO_NEIGHBOUR) {
+                continue;
+            }
+            velocity.x += neighbour.second * (fields.velocity_x[neighbour.first] -
+                                              fields.velocity_x[cell]);
+            velocity.y += neighbour.second * (fields.velocity_y[neighbour.first] -
+                                              fields.velocity_y[cell]);
+        }
+        return velocity;
+    }
+
+    /**
+     * Get the direction of the flow at the given point
+     *
+     * @return the unit vector in the direction of the flow at the given point, or
+     * zero if the flow is stopped there
+     */
+    Vector2d sampleDirection(const CellLocator& locator,
+                             const ControlVolumeFields& fields,
+                             double x,
+                             double y,
+                             VelocitySampling velocity_sampling,
+                             int& hint) {
+        const Vector2d velocity =
+            sampleVelocity(locator, fields, x, y, velocity_sampling, hint);
+        const double velocity_magnitude =
+            std::sqrt(std::pow(velocity.x, 2) + std::pow(velocity.y, 2));
+        if (velocity_magnitude == 0) {
+            return {0, 0};
+        }
+        return {velocity.x / velocity_magnitude, velocity.y / velocity_magnitude};
+    }
+}
+
+std::vector<Point2d> traceStreamLine(const CellLocator& locator,
+                                     const ControlVolumeFields& fields,
+                                     Point2d start_point,
+                                     meter_t line_length,
+                                     meter_t distance_between_points,
+                                     StreamLineOptions options) {
+    const double step = distance_between_points.to<double>();
+    const int num_points =
+        static_cast<int>(std::ceil(line_length.to<double>() / step));
+
+    std::vector<Point2d> points;
+    points.reserve(std::max(0, num_points));
+
+    double x = start_point.x.to<double>();
+    double y = start_point.y.to<double>();
+    int hint = CellLocator::NO_CELL;
+    for (int point_index = 0; point_index < num_points; point_index++) {
+        points.push_back({meter_t(x), meter_t(y)});
+
+        const Vector2d k1 =
+            sampleDirection(locator, fields, x, y, options.velocity_sampling, hint);
+        if (k1.x == 0 && k1.y == 0) {
+            // The flow is stopped here, so the rest of the line is just this point
+            continue;
+        }
+
+        if (options.integrator == StreamLineIntegrator::EULER) {
+            x += k1.x * step;
+            y += k1.y * step;
+            continue;
+        }
+
+        // The intermediate samples use their own hints, so `hint` stays on the cell
+        // of the last point on the line
+        int stage_hint    = hint;
+        const Vector2d k2 = sampleDirection(locator, fields, x + k1.x * step / 2,
+                                            y + k1.y * step / 2,
+                                            options.velocity_sampling, stage_hint);
+        const Vector2d k3 = sampleDirection(locator, fields, x + k2.x * step / 2,
+                                            y + k2.y * step / 2,
+                                            options.velocity_sampling, stage_hint);
+        const Vector2d k4 =
+            sampleDirection(locator, fields, x + k3.x * step, y + k3.y * step,
+                            options.velocity_sampling, stage_hint);
+        x += step / 6 * (k1.x + 2 * k2.x + 2 * k3.x + k4.x);
+        y += step / 6 * (k1.y + 2 * k2.y + 2 * k3.y + k4.y);
+    }
+
+    return points;
+}
+
+std::vector<std::vector<Point2d>>
+    traceStreamLines(const CellLocator& locator,
+                     const ControlVolumeFields& fields,
+                     const std::vector<Point2d>& start_points,
+                     meter_t line_length,
+                     meter_t distance_between_points,
+                     StreamLineOptions options,
+                     ThreadPool& thread_pool) {
+    SIMPLE_CFD_PROFILE_SCOPE("traceStreamLines");
+    std::vector<std::vector<Point2d>> stream_lines(start_points.size());
+    thread_pool.parallelFor(start_points.size(), [&](size_t begin, size_t end) {
+        SIMPLE_CFD_PROFILE_SCOPE("trace streamline chunk");
+        for (size_t i = begin; i < end; i++) {
+            stream_lines[i] = traceStreamLine(locator, fields, start_points[i],
+                                              line_length, distance_between_points,
+                                              options);
+        }
+    });
+    return stream_lines;
+}
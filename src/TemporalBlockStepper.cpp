@@ -0,0 +1,213 @@
+#include "TemporalBlockStepper.h"
+
+// STD Includes
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <stdexcept>
+#include <utility>
+
+TemporalBlockStepper::TemporalBlockStepper(
+    std::shared_ptr<const ControlVolumeMesh> mesh,
+    const std::vector<uint8_t>& obstacle_cell_mask,
+    const StencilEdgeStates<double>& edges,
+    TemporalBlockingParameters parameters)
+  : mesh(std::move(mesh)), edges(edges), parameters(parameters) {
+    if (parameters.tile_size < 1) {
+        throw std::invalid_argument("Tile size must be at least 1");
+    }
+    if (parameters.steps_per_block < 1) {
+        throw std::invalid_argument("Steps per block must be at least 1");
+    }
+
+    const ControlVolumeMesh& cells        = *this->mesh;
+    const size_t num_cells                = cells.numCells();
+    const std::vector<double>& cell_x     = cells.getCellX();
+    const std::vector<double>& cell_y     = cells.getCellY();
+    const std::vector<double>& cell_scale = cells.getCellScale();
+    if (num_cells == 0) {
+        return;
+    }
+
+    // Bin the cells into square tiles by their corner, in cell index order within each
+    // tile
+    const double min_scale   = *std::min_element(cell_scale.begin(), cell_scale.end());
+    const double tile_length = parameters.tile_size * min_scale;
+    std::map<std::pair<long, long>, std::vector<int>> tile_cells;
+    for (size_t i = 0; i < num_cells; i++) {
+        tile_cells[{std::lround(std::floor(cell_x[i] / tile_length)),
+                    std::lround(std::floor(cell_y[i] / tile_length))}]
+            .emplace_back(i);
+    }
+
+    const int max_hops = parameters.steps_per_block;
+    std::vector<int> local_index(num_cells, -1);
+    tiles.reserve(tile_cells.size());
+    for (auto& [tile_position, own_cells] : tile_cells) {
+        Tile& tile = tiles.emplace_back();
+        tile.cells = std::move(own_cells);
+
+        // Find the halo one hop at a time, following the neighbours each cell reads
+        for (size_t k = 0; k < tile.cells.size(); k++) {
+            local_index[tile.cells[k]] = static_cast<int>(k);
+        }
+        size_t hop_begin = 0;
+        tile.hop_offsets.emplace_back(tile.cells.size());
+        for (int hop = 1; hop <= max_hops; hop++) {
+            const size_t hop_end = tile.cells.size();
+            for (size_t k = hop_begin; k < hop_end; k++) {
+                for (int direction = 0; direction < NUM_DIRECTIONS; direction++) {
+                    const int neighbour = cells.getNeighbours(
+                        static_cast<Direction>(direction))[tile.cells[k]];
+                    if (neighbour != ControlVolumeMesh::NO_NEIGHBOUR &&
+                        local_index[neighbour] < 0) {
+                        local_index[neighbour] = static_cast<int>(tile.cells.size());
+                        tile.cells.emplace_back(neighbour);
+                    }
+                }
+            }
+            hop_begin = hop_end;
+            tile.hop_offsets.emplace_back(tile.cells.size());
+        }
+
+        // Every cell that is ever updated reads neighbours within the halo, or the
+        // edge states just past the cells
+        const int num_local      = static_cast<int>(tile.cells.size());
+        const int override_slot  = num_local + NUM_DIRECTIONS;
+        const size_t num_updated = tile.hop_offsets[max_hops - 1];
+        for (size_t k = 0; k < num_updated; k++) {
+            const int i = tile.cells[k];
+            for (int direction = 0; direction < NUM_DIRECTIONS; direction++) {
+                const Direction side = static_cast<Direction>(direction);
+                const int neighbour  = cells.getNeighbours(side)[i];
+                tile.neighbours[side].emplace_back(
+                    neighbour == ControlVolumeMesh::NO_NEIGHBOUR
+                        ? num_local + direction
+                        : local_index[neighbour]);
+                tile.distances[side].emplace_back(cells.getNeighbourDistances(side)[i]);
+            }
+            const bool has_top =
+                cells.getNeighbours(TOP)[i] != ControlVolumeMesh::NO_NEIGHBOUR;
+            tile.top_velocity_neighbours.emplace_back(
+                has_top && edges.override_top_velocity ? override_slot
+                                                       : tile.neighbours[TOP].back());
+        }
+
+        for (int k = 0; k < num_local; k++) {
+            if (obstacle_cell_mask[tile.cells[k]]) {
+                tile.obstacle_cells.emplace_back(k);
+            }
+            local_index[tile.cells[k]] = -1;
+        }
+    }
+}
+
+void TemporalBlockStepper::step(const ControlVolumeFields& current,
+                                double dt,
+                                const FluidCoefficients& fluid,
+                                int num_steps,
+                                ThreadPool& thread_pool,
+                                ControlVolumeFields& next) const {
+    num_steps = std::clamp(num_steps, 1, parameters.steps_per_block);
+
+    // Each tile only writes it's own cells, so any split of the tiles between threads
+    // gives the same result
+    thread_pool.parallelFor(tiles.size(), [&](size_t begin, size_t end) {
+        std::array<ControlVolumeFields, 2> buffers;
+        for (size_t t = begin; t < end; t++) {
+            stepTile(tiles[t], current, dt, fluid, num_steps, buffers, next);
+        }
+    });
+}
+
+uint64_t TemporalBlockStepper::getNumCellUpdates(int num_steps) const {
+    num_steps            = std::clamp(num_steps, 1, parameters.steps_per_block);
+    uint64_t num_updates = 0;
+    for (const Tile& tile : tiles) {
+        for (int step = 1; step <= num_steps; step++) {
+            num_updates += tile.hop_offsets[num_steps - step];
+        }
+    }
+    return num_updates;
+}
+
+void TemporalBlockStepper::stepTile(const Tile& tile,
+                                    const ControlVolumeFields& current,
+                                    double dt,
+                                    const FluidCoefficients& fluid,
+                                    int num_steps,
+                                    std::array<ControlVolumeFields, 2>& buffers,
+                                    ControlVolumeFields& next) const {
+    // Only the cells within `num_steps` hops of the tile are read
+    const size_t num_local = tile.cells.size();
+    const size_t num_read  = tile.hop_offsets[num_steps];
+
+    // The edge states, in direction order, then the top velocity override
+    const std::array<CellState, NUM_DIRECTIONS + 1> edge_states = {
+        edges.left, edges.right, edges.top, edges.bottom, edges.top_velocity_override};
+    for (ControlVolumeFields& buffer : buffers) {
+        buffer.resize(num_local + edge_states.size());
+        for (size_t slot = 0; slot < edge_states.size(); slot++) {
+            buffer.pressure[num_local + slot]   = edge_states[slot].pressure;
+            buffer.velocity_x[num_local + slot] = edge_states[slot].velocity_x;
+            buffer.velocity_y[num_local + slot] = edge_states[slot].velocity_y;
+        }
+    }
+    for (size_t k = 0; k < num_read; k++) {
+        const int i              = tile.cells[k];
+        buffers[0].pressure[k]   = current.pressure[i];
+        buffers[0].velocity_x[k] = current.velocity_x[i];
+        buffers[0].velocity_y[k] = current.velocity_y[i];
+    }
+
+    // Each step updates the cells the remaining steps still need
+    auto state = [](const ControlVolumeFields& fields, int k) -> CellState {
+        return {fields.pressure[k], fields.velocity_x[k], fields.velocity_y[k]};
+    };
+    for (int step = 1; step <= num_steps; step++) {
+        const ControlVolumeFields& in = buffers[(step - 1) % 2];
+        ControlVolumeFields& out      = buffers[step % 2];
+        const size_t num_updated      = tile.hop_offsets[num_steps - step];
+
+        for (size_t k = 0; k < num_updated; k++) {
+            const int top             = tile.neighbours[TOP][k];
+            const int top_velocity    = tile.top_velocity_neighbours[k];
+            const CellState top_state = {in.pressure[top],
+                                         in.velocity_x[top_velocity],
+                                         in.velocity_y[top_velocity]};
+            const CellState updated =
+                updateCellState(state(in, static_cast<int>(k)),
+                                state(in, tile.neighbours[LEFT][k]),
+                                tile.distances[LEFT][k],
+                                state(in, tile.neighbours[RIGHT][k]),
+                                tile.distances[RIGHT][k],
+                                top_state,
+                                tile.distances[TOP][k],
+                                state(in, tile.neighbours[BOTTOM][k]),
+                                tile.distances[BOTTOM][k],
+                                dt,
+                                fluid);
+            out.pressure[k]   = updated.pressure;
+            out.velocity_x[k] = updated.velocity_x;
+            out.velocity_y[k] = updated.velocity_y;
+        }
+
+        // As `FluidSimulator::commitNextFields` does after every step
+        for (const int k : tile.obstacle_cells) {
+            if (static_cast<size_t>(k) >= num_updated) {
+                break;
+            }
+            out.pressure[k]   = 0;
+            out.velocity_x[k] = 0;
+            out.velocity_y[k] = 0;
+        }
+    }
+
+    const ControlVolumeFields& result = buffers[num_steps % 2];
+    for (size_t k = 0; k < tile.hop_offsets[0]; k++) {
+        const int i        = tile.cells[k];
+        next.pressure[i]   = result.pressure[k];
+        next.velocity_x[i] = result.velocity_x[k];
+        next.velocity_y[i] = result.velocity_y[k];
+    }
+}
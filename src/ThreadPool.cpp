@@ -0,0 +1,117 @@
+#include "ThreadPool.h"
+
+// STD Includes
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+    // How many chunks to split each job into per thread, so threads that finish early
+    // can pick up work from slower ones
+    const size_t CHUNKS_PER_THREAD = 4;
+}
+
+ThreadPool::ThreadPool(int num_threads)
+  : num_threads(num_threads),
+    job_function(nullptr),
+    job_num_items(0),
+    job_num_chunks(0),
+    job_generation(0),
+    next_chunk(0),
+    num_busy_workers(0),
+    stopping(false) {
+    if (num_threads < 1) {
+        throw std::invalid_argument("ThreadPool needs at least one thread");
+    }
+
+    // The calling thread counts as one of the threads
+    for (int i = 1; i < num_threads; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> state_lock(state_mutex);
+        stopping = true;
+    }
+    job_available.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(size_t num_items,
+                             const std::function<void(size_t, size_t)>& function) {
+    if (num_items == 0) {
+        return;
+    }
+    if (workers.empty()) {
+        function(0, num_items);
+        return;
+    }
+
+    std::lock_guard<std::mutex> job_lock(job_mutex);
+    {
+        std::lock_guard<std::mutex> state_lock(state_mutex);
+        job_function     = &function;
+        job_num_items    = num_items;
+        job_num_chunks   = std::min(num_items, num_threads * CHUNKS_PER_THREAD);
+        next_chunk       = 0;
+        num_busy_workers = static_cast<int>(workers.size());
+        job_generation++;
+    }
+    job_available.notify_all();
+
+    runChunks();
+
+    // Even if a chunk threw, the workers may still be reading `function`
+    std::unique_lock<std::mutex> state_lock(state_mutex);
+    job_finished.wait(state_lock, [this]() { return num_busy_workers == 0; });
+    job_function = nullptr;
+    if (job_exception) {
+        std::rethrow_exception(std::exchange(job_exception, nullptr));
+    }
+}
+
+void ThreadPool::workerLoop() {
+    size_t last_generation = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> state_lock(state_mutex);
+            job_available.wait(state_lock, [&]() {
+                return stopping || job_generation != last_generation;
+            });
+            if (stopping) {
+                return;
+            }
+            last_generation = job_generation;
+        }
+
+        runChunks();
+
+        {
+            std::lock_guard<std::mutex> state_lock(state_mutex);
+            num_busy_workers--;
+        }
+        job_finished.notify_one();
+    }
+}
+
+void ThreadPool::runChunks() {
+    for (size_t chunk = next_chunk++; chunk < job_num_chunks; chunk = next_chunk++) {
+        const size_t begin = job_num_items * chunk / job_num_chunks;
+        const size_t end   = job_num_items * (chunk + 1) / job_num_chunks;
+        try {
+            (*job_function)(begin, end);
+        } catch (...) {
+            // Keep the first exception for `parallelFor` to rethrow, and stop the
+            // other threads from starting any more chunks
+            std::lock_guard<std::mutex> state_lock(state_mutex);
+            if (!job_exception) {
+                job_exception = std::current_exception();
+            }
+            next_chunk = job_num_chunks;
+        }
+    }
+}
@@ -0,0 +1,180 @@
+#include "Checkpoint.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+class CheckpointTest : public testing::Test {
+  protected:
+    void SetUp() override {
+        graph = std::make_shared<GraphNode<ControlVolume>>(15, 1.0);
+        path  = testing::TempDir() + "checkpoint_test.checkpoint";
+    }
+
+    void TearDown() override { std::remove(path.c_str()); }
+
+    /**
+     * Create a state on a mesh of the graph, with a different value in every cell
+     *
+     * @return a state on a mesh of the graph, with a different value in every cell
+     */
+    CheckpointState createState() {
+        CheckpointState state;
+        state.snapshot.mesh = std::make_shared<ControlVolumeMesh>(*graph);
+        const size_t num_cells = state.snapshot.mesh->numCells();
+        state.snapshot.fields.resize(num_cells);
+        state.snapshot.obstacle_cell_mask.resize(num_cells);
+        for (size_t i = 0; i < num_cells; i++) {
+            state.snapshot.fields.pressure[i]    = 100 + i;
+            state.snapshot.fields.velocity_x[i]  = 0.5 * i;
+            state.snapshot.fields.velocity_y[i]  = -0.25 * i;
+            state.snapshot.obstacle_cell_mask[i] = i % 3 == 0;
+        }
+        state.snapshot.simulation_size = 1;
+        state.snapshot.simulation_time = 0.125;
+        state.snapshot.num_steps       = 42;
+
+        state.density          = 1.2;
+        state.viscosity        = 1.5e-5;
+        state.speed_of_sound   = 100;
+        state.graph_resolution = 15;
+        state.num_graph_nodes  = graph->getAllSubNodes().size();
+        return state;
+    }
+
+    /**
+     * Replace the checkpoint with the first `size` bytes of itself
+     *
+     * @param size the number of bytes to keep
+     */
+    void truncateCheckpoint(size_t size) {
+        std::ifstream file(path, std::ios::binary);
+        std::string contents((std::istreambuf_iterator<char>(file)),
+                             std::istreambuf_iterator<char>());
+        file.close();
+        std::ofstream truncated(path, std::ios::binary | std::ios::trunc);
+        truncated.write(contents.data(), std::min(size, contents.size()));
+    }
+
+    // The graph every mesh is built from
+    std::shared_ptr<GraphNode<ControlVolume>> graph;
+
+    // The checkpoint file, removed after every test
+    std::string path;
+};
+
+// Test that every array and setting written to a checkpoint is read back unchanged
+TEST_F(CheckpointTest, checkpoint_round_trips_every_section) {
+    CheckpointState state = createState();
+    state.boundary_conditions.sides[LEFT]  = {BoundaryType::INFLOW, {0, 1, 0}};
+    state.boundary_conditions.sides[RIGHT] = {BoundaryType::OUTFLOW, {0, 0, 0}};
+    state.boundary_conditions.sides[TOP]   = {BoundaryType::WALL, {0, 0.5, 0}};
+    state.boundary_conditions.override_top_velocity = false;
+    state.solver_mode                         = SolverMode::PROJECTION;
+    state.implicit_diffusion                  = true;
+    state.diffusion_parameters.implicitness   = 0.75;
+    state.diffusion_parameters.max_iterations = 17;
+    writeCheckpoint(path, state);
+
+    const ControlVolumeMesh& mesh = *state.snapshot.mesh;
+    const MappedCheckpoint checkpoint(path);
+    ASSERT_EQ(mesh.numCells(), checkpoint.numCells());
+    EXPECT_EQ(state.num_graph_nodes, checkpoint.numGraphNodes());
+    EXPECT_EQ(15, checkpoint.getGraphResolution());
+    EXPECT_EQ(1, checkpoint.getSimulationSize());
+    EXPECT_EQ(0.125, checkpoint.getSimulationTime());
+    EXPECT_EQ(42u, checkpoint.getNumSteps());
+    EXPECT_EQ(1.2, checkpoint.getDensity());
+    EXPECT_EQ(1.5e-5, checkpoint.getViscosity());
+    EXPECT_EQ(100, checkpoint.getSpeedOfSound());
+    EXPECT_EQ(mesh.getEdgeDistance(), checkpoint.getEdgeDistance());
+
+    for (size_t i = 0; i < mesh.numCells(); i++) {
+        EXPECT_EQ(mesh.getCellX()[i], checkpoint.getCellX()[i]);
+        EXPECT_EQ(mesh.getCellY()[i], checkpoint.getCellY()[i]);
+        EXPECT_EQ(mesh.getCellScale()[i], checkpoint.getCellScale()[i]);
+        EXPECT_EQ(mesh.getNodeIndices()[i], checkpoint.getNodeIndices()[i]);
+        for (int direction = 0; direction < NUM_DIRECTIONS; direction++) {
+            EXPECT_EQ(mesh.getNeighbours(static_cast<Direction>(direction))[i],
+                      checkpoint.getNeighbours(static_cast<Direction>(direction))[i]);
+        }
+        EXPECT_EQ(state.snapshot.fields.pressure[i], checkpoint.getPressure()[i]);
+        EXPECT_EQ(state.snapshot.fields.velocity_x[i], checkpoint.getVelocityX()[i]);
+        EXPECT_EQ(state.snapshot.fields.velocity_y[i], checkpoint.getVelocityY()[i]);
+        EXPECT_EQ(state.snapshot.obstacle_cell_mask[i],
+                  checkpoint.getObstacleCellMask()[i]);
+    }
+
+    const BoundaryConditions conditions = checkpoint.getBoundaryConditions();
+    for (int side = 0; side < NUM_DIRECTIONS; side++) {
+        const BoundaryCondition& expected = state.boundary_conditions.sides[side];
+        EXPECT_EQ(expected.type, conditions.sides[side].type);
+        EXPECT_EQ(expected.state.pressure, conditions.sides[side].state.pressure);
+        EXPECT_EQ(expected.state.velocity_x, conditions.sides[side].state.velocity_x);
+        EXPECT_EQ(expected.state.velocity_y, conditions.sides[side].state.velocity_y);
+    }
+    EXPECT_FALSE(conditions.override_top_velocity);
+    EXPECT_EQ(SolverMode::PROJECTION, checkpoint.getSolverMode());
+    EXPECT_TRUE(checkpoint.isImplicitDiffusionEnabled());
+    const ImplicitDiffusionParameters parameters = checkpoint.getDiffusionParameters();
+    EXPECT_EQ(0.75, parameters.implicitness);
+    EXPECT_EQ(state.diffusion_parameters.tolerance, parameters.tolerance);
+    EXPECT_EQ(17, parameters.max_iterations);
+}
+
+// Test that the background writer writes every state it is given
+TEST_F(CheckpointTest, writer_writes_in_the_background) {
+    const std::string second_path = path + ".second";
+    CheckpointWriter writer;
+    CheckpointState state = createState();
+    state.snapshot.fields.pressure[0] = 1;
+    writer.write(path, state);
+    state.snapshot.fields.pressure[0] = 2;
+    writer.write(second_path, std::move(state));
+    writer.wait();
+    EXPECT_EQ(2u, writer.getNumWritten());
+    EXPECT_EQ(0u, writer.getNumPending());
+
+    EXPECT_EQ(1, MappedCheckpoint(path).getPressure()[0]);
+    EXPECT_EQ(2, MappedCheckpoint(second_path).getPressure()[0]);
+    std::remove(second_path.c_str());
+}
+
+// Test that files that aren't complete checkpoints are rejected rather than read out
+// of bounds
+TEST_F(CheckpointTest, corrupt_checkpoints_are_rejected) {
+    EXPECT_THROW(writeCheckpoint(path, CheckpointState()), std::runtime_error);
+    EXPECT_THROW(MappedCheckpoint(path + ".missing"), std::runtime_error);
+
+    CheckpointState state = createState();
+    writeCheckpoint(path, state);
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    const size_t size = file.tellg();
+    file.close();
+
+    truncateCheckpoint(size - 1);
+    EXPECT_THROW(MappedCheckpoint checkpoint(path), std::runtime_error);
+    truncateCheckpoint(16);
+    EXPECT_THROW(MappedCheckpoint checkpoint(path), std::runtime_error);
+
+    {
+        std::ofstream not_a_checkpoint(path, std::ios::binary | std::ios::trunc);
+        not_a_checkpoint << std::string(size, 'x');
+    }
+    EXPECT_THROW(MappedCheckpoint checkpoint(path), std::runtime_error);
+
+    // Node indices must lie within the graph
+    state.num_graph_nodes = 1;
+    writeCheckpoint(path, state);
+    EXPECT_THROW(MappedCheckpoint checkpoint(path), std::runtime_error);
+}
+
+int main(int argc, char** argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,174 @@
+#include "DistributedSimulator.h"
+#include "FluidSimulator.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <mpi.h>
+#include <multi_res_graph/Rectangle.h>
+
+using namespace units::literals;
+using namespace units::length;
+using namespace units::velocity;
+using namespace units::time;
+using namespace units::pressure;
+using namespace units::density;
+using namespace units::viscosity;
+
+class DistributedSimulatorTest : public testing::Test {
+  protected:
+    void SetUp() override {
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+        MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+    }
+
+    /**
+     * Create a simulator with a non-trivial initial pressure field and an obstacle,
+     * stepped with the scalar kernels
+     *
+     * @return a simulator with a non-trivial initial pressure field and an obstacle
+     */
+    std::unique_ptr<FluidSimulator> createSimulator() {
+        auto simulator = std::make_unique<FluidSimulator>(kg_per_cu_m_t(1),
+                                                          meters_squared_per_s_t(1),
+                                                          meters_per_second_t(100),
+                                                          meter_t(1),
+                                                          15);
+        simulator->setUpdateMethod(UpdateMethod::FLAT_ARRAYS);
+        simulator->setSimdLevel(SimdLevel::SCALAR);
+
+        for (auto& node : simulator->getControlVolumeGraph()->getAllSubNodes()) {
+            if (node->getCoordinates().x <= 0.25) {
+                node->containedValue().setPressure(pascal_t(100));
+            }
+        }
+
+        simulator->addObstacle(
+            std::make_shared<Rectangle<ControlVolume>>(0.2, 0.3, (Coordinates){0.4, 0.4}));
+
+        return simulator;
+    }
+
+    /**
+     * Step the given simulator (on the root) and a distributed copy of it side by side,
+     * and check the gathered fields are bit-identical to it
+     *
+     * @param simulator the simulator to distribute, only set on the root
+     * @param num_steps the number of steps to take
+     */
+    void expectMatchesSingleProcess(FluidSimulator* simulator, int num_steps) {
+        DistributedSimulator distributed(MPI_COMM_WORLD, simulator);
+
+        // Every cell is owned by exactly one rank, and every rank has a fair share
+        const uint64_t num_owned = distributed.getNumOwnedCells();
+        uint64_t total_owned     = 0;
+        MPI_Allreduce(
+            &num_owned, &total_owned, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+        EXPECT_EQ(distributed.getNumGlobalCells(), total_owned);
+        EXPECT_LE(num_owned, distributed.getNumGlobalCells() / num_ranks + 1);
+        if (num_ranks > 1) {
+            EXPECT_GT(distributed.getNumHaloCells(), 0u);
+        }
+
+        for (int i = 0; i < num_steps; i++) {
+            distributed.updateControlVolumes(second_t(1e-5));
+            if (rank == 0) {
+                simulator->updateControlVolumes(second_t(1e-5));
+            }
+        }
+
+        ControlVolumeFields fields;
+        distributed.gatherFields(fields);
+        if (rank != 0) {
+            EXPECT_EQ(0u, fields.size());
+            return;
+        }
+        EXPECT_EQ(simulator->getSimulationTime().to<double>(),
+                  distributed.getSimulationTime().to<double>());
+        FieldSnapshot expected;
+        simulator->takeSnapshot(expected);
+        ASSERT_EQ(expected.fields.size(), fields.size());
+        for (size_t i = 0; i < fields.size(); i++) {
+            ASSERT_EQ(expected.fields.pressure[i], fields.pressure[i]);
+            ASSERT_EQ(expected.fields.velocity_x[i], fields.velocity_x[i]);
+            ASSERT_EQ(expected.fields.velocity_y[i], fields.velocity_y[i]);
+        }
+    }
+
+    // The rank of this process
+    int rank = 0;
+
+    // The number of processes in the test
+    int num_ranks = 1;
+};
+
+// Test that stepping across every rank gives exactly the same result as stepping in
+// one process
+TEST_F(DistributedSimulatorTest, matches_single_process) {
+    std::unique_ptr<FluidSimulator> simulator;
+    if (rank == 0) {
+        simulator = createSimulator();
+    }
+    expectMatchesSingleProcess(simulator.get(), 20);
+}
+
+// Test that a mesh with several resolutions is split and stepped exactly as well
+TEST_F(DistributedSimulatorTest, matches_single_process_on_refined_mesh) {
+    std::unique_ptr<FluidSimulator> simulator;
+    if (rank == 0) {
+        simulator = createSimulator();
+        RefinementParameters parameters;
+        parameters.refine_threshold          = 5;
+        parameters.coarsen_threshold         = 0.5;
+        parameters.max_level                 = 2;
+        parameters.steps_between_adaptations = 5;
+        const size_t num_graph_volumes       = simulator->getNumControlVolumes();
+        parameters.max_cells                 = 2 * num_graph_volumes;
+        simulator->enableMeshRefinement(parameters);
+        for (int i = 0; i < 5; i++) {
+            simulator->updateControlVolumesAdaptive(second_t(1e-4));
+        }
+        EXPECT_GT(simulator->getNumControlVolumes(), num_graph_volumes);
+    }
+
+    // Stop before the simulator adapts again
+    expectMatchesSingleProcess(simulator.get(), 4);
+}
+
+// Test that a simulator that can't be distributed fails on every rank
+TEST_F(DistributedSimulatorTest, rejects_unsupported_simulators) {
+    std::unique_ptr<FluidSimulator> simulator;
+    if (rank == 0) {
+        simulator = createSimulator();
+        simulator->setSolverMode(SolverMode::PROJECTION);
+    }
+    EXPECT_THROW(DistributedSimulator(MPI_COMM_WORLD, simulator.get()),
+                 std::runtime_error);
+
+    if (rank == 0) {
+        simulator->setSolverMode(SolverMode::SLIGHTLY_COMPRESSIBLE);
+        BoundaryConditions conditions = legacyBoundaryConditions();
+        conditions.sides[RIGHT].type  = BoundaryType::OUTFLOW;
+        simulator->setBoundaryConditions(conditions);
+    }
+    EXPECT_THROW(DistributedSimulator(MPI_COMM_WORLD, simulator.get()),
+                 std::runtime_error);
+}
+
+int main(int argc, char** argv) {
+    MPI_Init(&argc, &argv);
+    testing::InitGoogleTest(&argc, argv);
+
+    // Only the root reports results
+    int rank = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank != 0) {
+        testing::TestEventListeners& listeners =
+            testing::UnitTest::GetInstance()->listeners();
+        delete listeners.Release(listeners.default_result_printer());
+    }
+
+    const int result = RUN_ALL_TESTS();
+    int any_failed   = 0;
+    MPI_Allreduce(&result, &any_failed, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    MPI_Finalize();
+    return any_failed;
+}
@@ -0,0 +1,124 @@
+#include "EnsembleRunner.h"
+#include "FluidSimulator.h"
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <memory>
+#include <multi_res_graph/Rectangle.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace units::literals;
+using namespace units::length;
+using namespace units::velocity;
+using namespace units::time;
+using namespace units::pressure;
+using namespace units::density;
+using namespace units::viscosity;
+
+class EnsembleRunnerTest : public testing::Test {
+  protected:
+    /**
+     * Add a member for every viscosity and obstacle position to the given ensemble,
+     * each with a non-trivial initial pressure field
+     *
+     * @param ensemble the ensemble to add the members to
+     */
+    void addMembers(EnsembleRunner& ensemble) {
+        for (double viscosity : viscosities) {
+            for (double x : obstacle_x) {
+                EnsembleMember member;
+                member.viscosity = viscosity;
+                member.obstacles.emplace_back(
+                    std::make_shared<Rectangle<ControlVolume>>(
+                        0.2, 0.3, (Coordinates){x, 0.4}));
+                const size_t index = ensemble.addMember(member);
+
+                const auto& nodes           = ensemble.getMesh()->getNodes();
+                ControlVolumeFields& fields = ensemble.getMemberFields(index);
+                for (size_t i = 0; i < nodes.size(); i++) {
+                    if (nodes[i]->getCoordinates().x <= 0.25) {
+                        fields.pressure[i] = 100;
+                    }
+                }
+            }
+        }
+    }
+
+    // The viscosities and obstacle positions swept over
+    const std::vector<double> viscosities = {0.5, 1, 2};
+    const std::vector<double> obstacle_x  = {0.4, 0.6};
+};
+
+// Test that every member gets the same result however many threads the ensemble is
+// run on, and is summarised
+TEST_F(EnsembleRunnerTest, members_match_on_any_number_of_threads) {
+    std::vector<std::vector<ControlVolumeFields>> results;
+    for (int num_threads : {1, 3}) {
+        EnsembleRunner ensemble(meter_t(1), 15, num_threads);
+        addMembers(ensemble);
+        ASSERT_EQ(viscosities.size() * obstacle_x.size(), ensemble.numMembers());
+        ensemble.run(second_t(1e-5), 10);
+
+        results.emplace_back();
+        for (size_t m = 0; m < ensemble.numMembers(); m++) {
+            results.back().emplace_back(ensemble.getMemberFields(m));
+        }
+
+        const std::vector<EnsembleMemberSummary> summaries = ensemble.getSummaries();
+        ASSERT_EQ(ensemble.numMembers(), summaries.size());
+        for (const EnsembleMemberSummary& summary : summaries) {
+            EXPECT_EQ(10u, summary.num_steps);
+            EXPECT_TRUE(summary.finite);
+            EXPECT_GT(summary.num_obstacle_cells, 0u);
+            EXPECT_GT(summary.max_speed, 0);
+        }
+        std::ostringstream csv;
+        ensemble.writeSummaries(csv);
+        const std::string rows = csv.str();
+        EXPECT_EQ(summaries.size() + 1, std::count(rows.begin(), rows.end(), '\n'));
+    }
+
+    for (size_t m = 0; m < results[0].size(); m++) {
+        EXPECT_EQ(results[0][m].pressure, results[1][m].pressure);
+        EXPECT_EQ(results[0][m].velocity_x, results[1][m].velocity_x);
+        EXPECT_EQ(results[0][m].velocity_y, results[1][m].velocity_y);
+    }
+}
+
+// Test that a member is stepped exactly like a simulator with the same parameters
+TEST_F(EnsembleRunnerTest, member_matches_separate_simulator) {
+    EnsembleRunner ensemble(meter_t(1), 15, 2);
+    addMembers(ensemble);
+    ensemble.run(second_t(1e-5), 10);
+
+    FluidSimulator simulator(kg_per_cu_m_t(1),
+                             meters_squared_per_s_t(viscosities.back()),
+                             meters_per_second_t(100),
+                             meter_t(1),
+                             15);
+    for (auto& node : simulator.getControlVolumeGraph()->getAllSubNodes()) {
+        if (node->getCoordinates().x <= 0.25) {
+            node->containedValue().setPressure(pascal_t(100));
+        }
+    }
+    simulator.addObstacle(std::make_shared<Rectangle<ControlVolume>>(
+        0.2, 0.3, (Coordinates){obstacle_x.back(), 0.4}));
+    for (int i = 0; i < 10; i++) {
+        simulator.updateControlVolumes(second_t(1e-5));
+    }
+
+    FieldSnapshot snapshot;
+    simulator.takeSnapshot(snapshot);
+    const size_t last_member          = ensemble.numMembers() - 1;
+    const ControlVolumeFields& fields = ensemble.getMemberFields(last_member);
+    EXPECT_EQ(snapshot.fields.pressure, fields.pressure);
+    EXPECT_EQ(snapshot.fields.velocity_x, fields.velocity_x);
+    EXPECT_EQ(snapshot.fields.velocity_y, fields.velocity_y);
+    EXPECT_EQ(snapshot.obstacle_cell_mask, ensemble.getObstacleCellMask(last_member));
+}
+
+int main(int argc, char** argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
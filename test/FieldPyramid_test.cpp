@@ -0,0 +1,205 @@
+#include "FieldPyramid.h"
+#include "MeshRefiner.h"
+#include <algorithm>
+#include <cmath>
+#include <gtest/gtest.h>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+class FieldPyramidTest : public testing::Test {
+  protected:
+    void SetUp() override {
+        graph = std::make_shared<GraphNode<ControlVolume>>(15, 1.0);
+        mesh  = std::make_shared<const ControlVolumeMesh>(*graph);
+        setFields();
+    }
+
+    /**
+     * Give every cell of the mesh a different state, and cover the cells in a
+     * rectangle with an obstacle
+     */
+    void setFields() {
+        const size_t num_cells = mesh->numCells();
+        fields.resize(num_cells);
+        obstacle_cell_mask.assign(num_cells, 0);
+        for (size_t i = 0; i < num_cells; i++) {
+            const double x        = mesh->getCellX()[i];
+            const double y        = mesh->getCellY()[i];
+            fields.pressure[i]    = 100 * x + 10 * y + 0.01 * i;
+            fields.velocity_x[i]  = x - y;
+            fields.velocity_y[i]  = x * y;
+            obstacle_cell_mask[i] = x > 0.3 && x < 0.5 && y > 0.3 && y < 0.6;
+        }
+    }
+
+    /**
+     * Check that the top of the pyramid holds the range and area weighted mean of the
+     * fluid, and every level covers the whole simulation
+     *
+     * @param pyramid the pyramid to check
+     */
+    void expectReducedFields(const FieldPyramid& pyramid) {
+        for (size_t l = 0; l < pyramid.numLevels(); l++) {
+            const FieldPyramidLevel& level = pyramid.getLevel(l);
+            double area                    = 0;
+            for (size_t bin = 0; bin < level.fluid_area.size(); bin++) {
+                area += level.fluid_area[bin] + level.obstacle_area[bin];
+            }
+            EXPECT_NEAR(1, area, 1e-9);
+        }
+
+        const std::vector<double>& cell_scale = mesh->getCellScale();
+        double min_pressure = std::numeric_limits<double>::infinity();
+        double max_pressure = -std::numeric_limits<double>::infinity();
+        double pressure_sum = 0;
+        double fluid_area   = 0;
+        for (size_t i = 0; i < mesh->numCells(); i++) {
+            if (obstacle_cell_mask[i]) {
+                continue;
+            }
+            const double area = cell_scale[i] * cell_scale[i];
+            min_pressure      = std::min(min_pressure, fields.pressure[i]);
+            max_pressure      = std::max(max_pressure, fields.pressure[i]);
+            pressure_sum += fields.pressure[i] * area;
+            fluid_area += area;
+        }
+        const FieldPyramidLevel& top = pyramid.getLevel(pyramid.numLevels() - 1);
+        ASSERT_EQ(1, top.resolution);
+        EXPECT_EQ(min_pressure, top.min_pressure[0]);
+        EXPECT_EQ(max_pressure, top.max_pressure[0]);
+        EXPECT_NEAR(fluid_area, top.fluid_area[0], 1e-9);
+        EXPECT_NEAR(pressure_sum / fluid_area, top.mean_pressure[0], 1e-6);
+        EXPECT_LT(0, top.obstacle_area[0]);
+    }
+
+    // The graph the mesh is built from
+    std::shared_ptr<GraphNode<ControlVolume>> graph;
+
+    // The mesh the fields are on
+    std::shared_ptr<const ControlVolumeMesh> mesh;
+
+    // A different state in every cell, and a rectangle of obstacle cells
+    ControlVolumeFields fields;
+    std::vector<uint8_t> obstacle_cell_mask;
+
+    // The threads to build the pyramids on
+    ThreadPool thread_pool{2};
+};
+
+// Test that the field pyramid reduces the fields of the fluid cells into every level
+TEST_F(FieldPyramidTest, pyramid_reduces_fields) {
+    FieldPyramid pyramid;
+    EXPECT_TRUE(pyramid.empty());
+    pyramid.build(mesh, fields, obstacle_cell_mask, 1, thread_pool);
+    EXPECT_FALSE(pyramid.empty());
+    EXPECT_EQ(mesh, pyramid.getMesh());
+    EXPECT_EQ(1, pyramid.getSimulationSize());
+
+    // The finest level has a bin for every cell, and the levels halve (rounding up)
+    // down to one
+    ASSERT_EQ(5u, pyramid.numLevels());
+    EXPECT_TRUE(pyramid.isFinestLevelExact());
+    const std::vector<int> resolutions = {15, 8, 4, 2, 1};
+    for (size_t level = 0; level < pyramid.numLevels(); level++) {
+        EXPECT_EQ(resolutions[level], pyramid.getLevel(level).resolution);
+        EXPECT_DOUBLE_EQ((1 << level) / 15.0, pyramid.getLevel(level).bin_size);
+    }
+
+    // So every bin of it holds exactly the values of one cell
+    const FieldPyramidLevel& finest = pyramid.getLevel(0);
+    for (size_t i = 0; i < mesh->numCells(); i++) {
+        const size_t bin =
+            static_cast<size_t>(std::lround(mesh->getCellY()[i] * 15)) * 15 +
+            std::lround(mesh->getCellX()[i] * 15);
+        if (obstacle_cell_mask[i]) {
+            EXPECT_EQ(0, finest.fluid_area[bin]);
+            continue;
+        }
+        EXPECT_DOUBLE_EQ(1 / 225.0, finest.fluid_area[bin]);
+        EXPECT_EQ(0, finest.obstacle_area[bin]);
+        EXPECT_EQ(fields.pressure[i], finest.min_pressure[bin]);
+        EXPECT_EQ(fields.pressure[i], finest.max_pressure[bin]);
+        EXPECT_DOUBLE_EQ(fields.pressure[i], finest.mean_pressure[bin]);
+        EXPECT_DOUBLE_EQ(fields.velocity_x[i], finest.mean_velocity_x[bin]);
+        EXPECT_DOUBLE_EQ(fields.velocity_y[i], finest.mean_velocity_y[bin]);
+    }
+    expectReducedFields(pyramid);
+
+    // The coarsest level with enough bins is picked for drawing
+    EXPECT_EQ(0u, pyramid.selectLevel(1000));
+    EXPECT_EQ(0u, pyramid.selectLevel(15));
+    EXPECT_EQ(0u, pyramid.selectLevel(8));
+    EXPECT_EQ(1u, pyramid.selectLevel(7));
+    EXPECT_EQ(2u, pyramid.selectLevel(3));
+    EXPECT_EQ(4u, pyramid.selectLevel(0.5));
+
+    // Too many cells for the finest level, so it's bins cover several cells along
+    // each side, and still fit the cell edges
+    FieldPyramid capped_pyramid;
+    capped_pyramid.build(mesh, fields, obstacle_cell_mask, 1, thread_pool, 4);
+    EXPECT_FALSE(capped_pyramid.isFinestLevelExact());
+    ASSERT_EQ(3u, capped_pyramid.numLevels());
+    EXPECT_EQ(4, capped_pyramid.getLevel(0).resolution);
+    EXPECT_DOUBLE_EQ(4 / 15.0, capped_pyramid.getLevel(0).bin_size);
+    EXPECT_DOUBLE_EQ(4 / 225.0 * 4, capped_pyramid.getLevel(0).fluid_area[0]);
+    EXPECT_EQ(pyramid.getLevel(4).max_pressure[0],
+              capped_pyramid.getLevel(2).max_pressure[0]);
+
+    EXPECT_THROW(pyramid.build(mesh, fields, obstacle_cell_mask, 1, thread_pool, 0),
+                 std::invalid_argument);
+}
+
+// Test that on a refined mesh the finest level is aligned to the smallest cells, and
+// the fields of the larger cells are spread over every bin they cover
+TEST_F(FieldPyramidTest, refined_mesh_fits_smallest_cells) {
+    // Refine along a pressure jump, leaving the cells away from it unsplit
+    RefinementParameters parameters;
+    parameters.refine_threshold = 5;
+    parameters.max_level        = 2;
+    MeshRefiner refiner(mesh, parameters);
+    for (size_t i = 0; i < mesh->numCells(); i++) {
+        fields.pressure[i] = mesh->getCellX()[i] <= 0.25 ? 100 : 0;
+    }
+    for (int i = 0; i < 2; i++) {
+        refiner.adapt(fields, fields, thread_pool);
+    }
+    mesh = refiner.getMesh();
+    setFields();
+    const std::vector<int> levels = refiner.getCellLevels();
+    ASSERT_EQ(2, *std::max_element(levels.begin(), levels.end()));
+    ASSERT_EQ(0, *std::min_element(levels.begin(), levels.end()));
+
+    FieldPyramid pyramid;
+    pyramid.build(mesh, fields, obstacle_cell_mask, 1, thread_pool);
+    EXPECT_TRUE(pyramid.isFinestLevelExact());
+    EXPECT_EQ(60, pyramid.getLevel(0).resolution);
+    EXPECT_DOUBLE_EQ(1 / 60.0, pyramid.getLevel(0).bin_size);
+
+    // Every bin of the finest level lies within one cell, so holds it's values
+    const FieldPyramidLevel& finest = pyramid.getLevel(0);
+    for (size_t i = 0; i < mesh->numCells(); i++) {
+        if (obstacle_cell_mask[i]) {
+            continue;
+        }
+        const long first_row    = std::lround(mesh->getCellY()[i] * 60);
+        const long first_column = std::lround(mesh->getCellX()[i] * 60);
+        const long num_bins     = std::lround(mesh->getCellScale()[i] * 60);
+        for (long row = first_row; row < first_row + num_bins; row++) {
+            for (long column = first_column; column < first_column + num_bins;
+                 column++) {
+                const size_t bin = row * 60 + column;
+                EXPECT_EQ(fields.pressure[i], finest.min_pressure[bin]);
+                EXPECT_DOUBLE_EQ(fields.velocity_x[i], finest.mean_velocity_x[bin]);
+                EXPECT_NEAR(1 / 3600.0, finest.fluid_area[bin], 1e-15);
+            }
+        }
+    }
+    expectReducedFields(pyramid);
+}
+
+int main(int argc, char** argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
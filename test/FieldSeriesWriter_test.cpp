@@ -0,0 +1,166 @@
+#include "FieldSeriesWriter.h"
+#include <cstdint>
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+class FieldSeriesWriterTest : public testing::Test {
+  protected:
+    void SetUp() override {
+        path = testing::TempDir() + "field_series_writer_test.series";
+    }
+
+    void TearDown() override {
+        std::remove(path.c_str());
+        std::remove((path + ".index").c_str());
+    }
+
+    /**
+     * Create a snapshot on a mesh of a graph with the given resolution, with a
+     * different value in every cell
+     *
+     * @param resolution the number of nodes along each side of the graph
+     * @param num_steps the number of steps the snapshot was taken after
+     *
+     * @return a snapshot with a different value in every cell
+     */
+    FieldSnapshot createSnapshot(int resolution, uint64_t num_steps) {
+        auto graph = std::make_shared<GraphNode<ControlVolume>>(resolution, 1.0);
+        graphs.emplace_back(graph);
+
+        FieldSnapshot snapshot;
+        snapshot.mesh         = std::make_shared<ControlVolumeMesh>(*graph);
+        snapshot.cell_locator = std::make_shared<CellLocator>(snapshot.mesh);
+        const size_t num_cells = snapshot.mesh->numCells();
+        snapshot.fields.resize(num_cells);
+        snapshot.obstacle_cell_mask.resize(num_cells);
+        for (size_t i = 0; i < num_cells; i++) {
+            snapshot.fields.pressure[i]   = 100 * num_steps + i;
+            snapshot.fields.velocity_x[i] = 0.5 * i;
+            snapshot.fields.velocity_y[i] = -0.25 * i;
+        }
+        snapshot.simulation_size = 1;
+        snapshot.simulation_time = 1e-5 * num_steps;
+        snapshot.num_steps       = num_steps;
+        return snapshot;
+    }
+
+    // The graphs the snapshots' meshes are built from
+    std::vector<std::shared_ptr<GraphNode<ControlVolume>>> graphs;
+
+    // The series file, removed (along with it's index) after every test
+    std::string path;
+};
+
+// Test that every frame is read back unchanged, in any order, including frames after
+// the mesh changes
+TEST_F(FieldSeriesWriterTest, frames_round_trip_in_any_order) {
+    std::vector<FieldSnapshot> snapshots = {
+        createSnapshot(15, 2), createSnapshot(15, 4), createSnapshot(10, 6)};
+
+    FieldSeriesParameters parameters;
+    parameters.compress = FieldSeriesWriter::isCompressionSupported();
+    {
+        FieldSeriesWriter writer(path, parameters);
+        for (const FieldSnapshot& snapshot : snapshots) {
+            FieldSnapshot queued = snapshot;
+            EXPECT_TRUE(writer.write(queued));
+        }
+        writer.flush();
+        EXPECT_EQ(3u, writer.getCounters().frames_written);
+        EXPECT_EQ(0u, writer.getCounters().frames_dropped);
+        EXPECT_GT(writer.getCounters().bytes_written, 0u);
+    }
+
+    FieldSeriesReader reader(path);
+    ASSERT_EQ(3u, reader.numFrames());
+    FieldSeriesFrame frame;
+    for (size_t i : {2, 0, 1}) {
+        const FieldSnapshot& snapshot = snapshots[i];
+        reader.readFrame(i, frame);
+        EXPECT_EQ(i, frame.frame);
+        EXPECT_EQ(snapshot.num_steps, frame.num_steps);
+        EXPECT_EQ(snapshot.simulation_time, frame.simulation_time);
+        EXPECT_EQ(snapshot.fields.pressure, frame.fields.pressure);
+        EXPECT_EQ(snapshot.fields.velocity_x, frame.fields.velocity_x);
+        EXPECT_EQ(snapshot.fields.velocity_y, frame.fields.velocity_y);
+
+        // Every value is at it's cell centre
+        const ControlVolumeMesh& mesh = *snapshot.mesh;
+        ASSERT_EQ(mesh.numCells(), frame.x.size());
+        for (size_t cell = 0; cell < mesh.numCells(); cell++) {
+            EXPECT_EQ(mesh.getCellX()[cell] + mesh.getCellScale()[cell] / 2,
+                      frame.x[cell]);
+            EXPECT_EQ(mesh.getCellY()[cell] + mesh.getCellScale()[cell] / 2,
+                      frame.y[cell]);
+        }
+    }
+    EXPECT_THROW(reader.readFrame(3, frame), std::out_of_range);
+}
+
+// Test that sampling a region on a coarser grid decimates the fields
+TEST_F(FieldSeriesWriterTest, sampling_decimates_fields) {
+    const FieldSnapshot snapshot = createSnapshot(15, 1);
+
+    FieldSeriesParameters parameters;
+    parameters.region_min_x   = 0.05;
+    parameters.region_min_y   = 0.05;
+    parameters.region_max_x   = 0.45;
+    parameters.region_max_y   = 0.45;
+    parameters.sample_spacing = 0.1;
+    {
+        FieldSeriesWriter writer(path, parameters);
+        FieldSnapshot queued = snapshot;
+        EXPECT_TRUE(writer.write(queued));
+    }
+
+    FieldSeriesReader reader(path);
+    ASSERT_EQ(1u, reader.numFrames());
+    FieldSeriesFrame frame;
+    reader.readFrame(0, frame);
+    ASSERT_EQ(25u, frame.x.size());
+    for (size_t i = 0; i < frame.x.size(); i++) {
+        const int cell = snapshot.cell_locator->locate(frame.x[i], frame.y[i]);
+        EXPECT_EQ(snapshot.fields.pressure[cell], frame.fields.pressure[i]);
+    }
+    EXPECT_DOUBLE_EQ(0.45, frame.x.back());
+    EXPECT_DOUBLE_EQ(0.45, frame.y.back());
+
+    // Sampling needs a finite region to lay the grid over
+    parameters.region_max_x = std::numeric_limits<double>::infinity();
+    EXPECT_THROW(FieldSeriesWriter writer(path, parameters), std::invalid_argument);
+}
+
+// Test that a full queue either drops frames or waits for room, and every frame is
+// counted
+TEST_F(FieldSeriesWriterTest, full_queue_drops_or_waits) {
+    const FieldSnapshot snapshot = createSnapshot(15, 1);
+    for (bool block_when_full : {false, true}) {
+        FieldSeriesParameters parameters;
+        parameters.queue_capacity  = 1;
+        parameters.block_when_full = block_when_full;
+        FieldSeriesWriter writer(path, parameters);
+        for (int i = 0; i < 20; i++) {
+            FieldSnapshot queued = snapshot;
+            writer.write(queued);
+        }
+        writer.flush();
+        const FieldSeriesWriter::Counters counters = writer.getCounters();
+        EXPECT_EQ(20u, counters.frames_written + counters.frames_dropped);
+        if (block_when_full) {
+            EXPECT_EQ(0u, counters.frames_dropped);
+        } else {
+            EXPECT_EQ(0u, counters.frames_backpressured);
+        }
+        EXPECT_EQ(counters.frames_written, FieldSeriesReader(path).numFrames());
+    }
+}
+
+int main(int argc, char** argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,1038 @@
+#include "FluidSimulator.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <map>
+#include <multi_res_graph/Circle.h>
+#include <multi_res_graph/Rectangle.h>
+
+using namespace units::literals;
+using namespace units::length;
+using namespace units::velocity;
+using namespace units::time;
+using namespace units::pressure;
+using namespace units::density;
+using namespace units::viscosity;
+
+class FluidSimulatorTest : public testing::Test {
+  protected:
+    /**
+     * Create a simulator with a non-trivial initial pressure field and an obstacle
+     *
+     * @param update_method the method the simulator should update with
+     *
+     * @return a simulator with a non-trivial initial pressure field and an obstacle
+     */
+    FluidSimulator createSimulator(UpdateMethod update_method) {
+        FluidSimulator simulator(kg_per_cu_m_t(1),
+                                 meters_squared_per_s_t(1),
+                                 meters_per_second_t(100),
+                                 meter_t(1),
+                                 15);
+        simulator.setUpdateMethod(update_method);
+
+        for (auto& node : simulator.getControlVolumeGraph()->getAllSubNodes()) {
+            if (node->getCoordinates().x <= 0.25) {
+                node->containedValue().setPressure(pascal_t(100));
+            }
+        }
+
+        simulator.addObstacle(
+            std::make_shared<Rectangle<ControlVolume>>(0.2, 0.3, (Coordinates){0.4, 0.4}));
+
+        return simulator;
+    }
+
+    /**
+     * Check that every control volume in the two given simulators is bit-identical
+     *
+     * @param expected
+     * @param actual
+     */
+    void expectIdenticalControlVolumes(FluidSimulator& expected, FluidSimulator& actual) {
+        auto expected_nodes = expected.getControlVolumeGraph()->getAllSubNodes();
+        auto actual_nodes   = actual.getControlVolumeGraph()->getAllSubNodes();
+        ASSERT_EQ(expected_nodes.size(), actual_nodes.size());
+
+        for (size_t i = 0; i < expected_nodes.size(); i++) {
+            ControlVolume& expected_volume = expected_nodes[i]->containedValue();
+            ControlVolume& actual_volume   = actual_nodes[i]->containedValue();
+            EXPECT_EQ(expected_volume.getPressure().to<double>(),
+                      actual_volume.getPressure().to<double>());
+            EXPECT_EQ(expected_volume.getVelocity().x.to<double>(),
+                      actual_volume.getVelocity().x.to<double>());
+            EXPECT_EQ(expected_volume.getVelocity().y.to<double>(),
+                      actual_volume.getVelocity().y.to<double>());
+        }
+    }
+};
+
+// Test that stepping on the flat arrays gives exactly the same result as stepping on
+// the graph
+TEST_F(FluidSimulatorTest, flat_arrays_bit_identical_to_legacy_graph) {
+    FluidSimulator legacy = createSimulator(UpdateMethod::LEGACY_GRAPH);
+    FluidSimulator flat   = createSimulator(UpdateMethod::FLAT_ARRAYS);
+
+    for (int i = 0; i < 50; i++) {
+        legacy.updateControlVolumes(second_t(0.00001));
+        flat.updateControlVolumes(second_t(0.00001));
+    }
+
+    expectIdenticalControlVolumes(legacy, flat);
+}
+
+// Test that modifying the graph between flat updates is picked up by the next update
+TEST_F(FluidSimulatorTest, flat_arrays_pick_up_graph_changes) {
+    FluidSimulator legacy = createSimulator(UpdateMethod::LEGACY_GRAPH);
+    FluidSimulator flat   = createSimulator(UpdateMethod::FLAT_ARRAYS);
+
+    for (FluidSimulator* simulator : {&legacy, &flat}) {
+        simulator->updateControlVolumes(second_t(0.00001));
+        simulator->getControlVolumeGraph()
+            ->getAllSubNodes()[20]
+            ->containedValue()
+            .setPressure(pascal_t(-50));
+        simulator->updateControlVolumes(second_t(0.00001));
+    }
+
+    expectIdenticalControlVolumes(legacy, flat);
+}
+
+// Test that stepping with multiple threads gives exactly the same result as stepping
+// with one thread
+TEST_F(FluidSimulatorTest, multi_threaded_bit_identical_to_single_threaded) {
+    FluidSimulator single_threaded = createSimulator(UpdateMethod::FLAT_ARRAYS);
+    FluidSimulator multi_threaded  = createSimulator(UpdateMethod::FLAT_ARRAYS);
+    multi_threaded.setNumThreads(4);
+
+    for (int i = 0; i < 50; i++) {
+        single_threaded.updateControlVolumes(second_t(0.00001));
+        multi_threaded.updateControlVolumes(second_t(0.00001));
+    }
+
+    expectIdenticalControlVolumes(single_threaded, multi_threaded);
+}
+
+// Test that adaptive steps never exceed the stable time step or the given maximum,
+// and keep the simulation finite
+TEST_F(FluidSimulatorTest, adaptive_steps_are_bounded_and_stable) {
+    FluidSimulator simulator = createSimulator(UpdateMethod::FLAT_ARRAYS);
+
+    EXPECT_EQ(second_t(0.00001).to<double>(),
+              simulator.updateControlVolumesAdaptive(second_t(0.00001)).to<double>());
+
+    for (int i = 0; i < 20; i++) {
+        second_t stable_dt = simulator.computeStableTimeStep();
+        second_t dt        = simulator.updateControlVolumesAdaptive(second_t(1));
+        EXPECT_GT(dt.to<double>(), 0);
+        EXPECT_LE(dt.to<double>(), stable_dt.to<double>());
+    }
+    EXPECT_EQ(0, simulator.getNumRejectedSteps());
+
+    for (auto& node : simulator.getControlVolumeGraph()->getAllSubNodes()) {
+        EXPECT_TRUE(std::isfinite(node->containedValue().getPressure().to<double>()));
+        EXPECT_TRUE(std::isfinite(node->containedValue().getVelocity().x.to<double>()));
+        EXPECT_TRUE(std::isfinite(node->containedValue().getVelocity().y.to<double>()));
+    }
+}
+
+// Test that an adaptive step that is far too large is rolled back and retried with a
+// smaller time step
+TEST_F(FluidSimulatorTest, adaptive_step_retries_unstable_steps) {
+    FluidSimulator simulator = createSimulator(UpdateMethod::FLAT_ARRAYS);
+
+    AdaptiveTimeStepParameters parameters;
+    parameters.cfl_number = 100;
+    simulator.setAdaptiveTimeStepParameters(parameters);
+
+    second_t stable_dt = simulator.computeStableTimeStep();
+    second_t dt        = simulator.updateControlVolumesAdaptive(second_t(1));
+
+    EXPECT_GT(simulator.getNumRejectedSteps(), 0);
+    EXPECT_LT(dt.to<double>(), stable_dt.to<double>());
+    EXPECT_DOUBLE_EQ(dt.to<double>(), simulator.getSimulationTime().to<double>());
+}
+
+// Test that the obstacle mask matches the obstacles, including obstacles added after
+// the simulation has started, and that covered cells are cleared every step
+TEST_F(FluidSimulatorTest, obstacle_mask_tracks_added_obstacles) {
+    FluidSimulator simulator = createSimulator(UpdateMethod::FLAT_ARRAYS);
+    simulator.updateControlVolumes(second_t(0.00001));
+
+    auto circle =
+        std::make_shared<Circle<ControlVolume>>(0.15, (Coordinates){0.2, 0.7});
+    simulator.addObstacle(circle);
+    simulator.updateControlVolumes(second_t(0.00001));
+
+    auto rectangle = std::make_shared<Rectangle<ControlVolume>>(
+        0.2, 0.3, (Coordinates){0.4, 0.4});
+    const std::vector<uint8_t>& mask = simulator.getObstacleCellMask();
+    const auto& nodes                = simulator.getControlVolumeNodes();
+    ASSERT_EQ(nodes.size(), mask.size());
+
+    int num_covered = 0;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        bool covered = circle->overlapsNode(*nodes[i]) ||
+                       rectangle->overlapsNode(*nodes[i]);
+        EXPECT_EQ(covered, mask[i] != 0);
+        if (covered) {
+            num_covered++;
+            EXPECT_EQ(0, nodes[i]->containedValue().getPressure().to<double>());
+            EXPECT_EQ(0, nodes[i]->containedValue().getVelocity().x.to<double>());
+            EXPECT_EQ(0, nodes[i]->containedValue().getVelocity().y.to<double>());
+        }
+    }
+    EXPECT_GT(num_covered, 0);
+}
+
+// Test that the cell locator finds the control volume containing a point, and the
+// closest control volume to points outside the simulation
+TEST_F(FluidSimulatorTest, cell_locator_finds_containing_cell) {
+    FluidSimulator simulator = createSimulator(UpdateMethod::FLAT_ARRAYS);
+    auto mesh =
+        std::make_shared<const ControlVolumeMesh>(*simulator.getControlVolumeGraph());
+    CellLocator locator(mesh);
+
+    int hint = CellLocator::NO_CELL;
+    for (double x = -0.2; x < 1.2; x += 0.013) {
+        for (double y = -0.2; y < 1.2; y += 0.017) {
+            const double clamped_x = std::min(std::max(x, 0.0), 0.999999);
+            const double clamped_y = std::min(std::max(y, 0.0), 0.999999);
+            const int cell         = locator.locate(x, y, hint);
+            ASSERT_NE(CellLocator::NO_CELL, cell);
+            EXPECT_LE(mesh->getCellX()[cell], clamped_x);
+            EXPECT_GT(mesh->getCellX()[cell] + mesh->getCellScale()[cell], clamped_x);
+            EXPECT_LE(mesh->getCellY()[cell], clamped_y);
+            EXPECT_GT(mesh->getCellY()[cell] + mesh->getCellScale()[cell], clamped_y);
+            EXPECT_EQ(cell, locator.locate(x, y));
+            hint = cell;
+        }
+    }
+}
+
+// Test that streamlines are traced the same way however they are requested
+TEST_F(FluidSimulatorTest, batched_streamlines_match_single_streamlines) {
+    FluidSimulator simulator = createSimulator(UpdateMethod::FLAT_ARRAYS);
+    for (int i = 0; i < 10; i++) {
+        simulator.updateControlVolumes(second_t(0.00001));
+    }
+    simulator.setNumThreads(3);
+
+    std::vector<Point2d> start_points;
+    for (int i = 0; i < 7; i++) {
+        start_points.push_back({meter_t(0.1 + 0.1 * i), meter_t(0.9 - 0.1 * i)});
+    }
+
+    StreamLineOptions nearest_euler;
+    nearest_euler.integrator        = StreamLineIntegrator::EULER;
+    nearest_euler.velocity_sampling = VelocitySampling::NEAREST_CELL;
+    auto nearest_lines = simulator.getStreamLines(
+        start_points, meter_t(0.5), meter_t(0.02), nearest_euler);
+    auto rk4_lines =
+        simulator.getStreamLines(start_points, meter_t(0.5), meter_t(0.02));
+    ASSERT_EQ(start_points.size(), nearest_lines.size());
+    ASSERT_EQ(start_points.size(), rk4_lines.size());
+
+    for (size_t i = 0; i < start_points.size(); i++) {
+        auto single_line =
+            simulator.getStreamLinePoints(start_points[i], meter_t(0.5), meter_t(0.02));
+        ASSERT_EQ(25, single_line.size());
+        ASSERT_EQ(single_line.size(), nearest_lines[i].size());
+        ASSERT_EQ(single_line.size(), rk4_lines[i].size());
+        EXPECT_EQ(start_points[i].x.to<double>(), rk4_lines[i][0].x.to<double>());
+        EXPECT_EQ(start_points[i].y.to<double>(), rk4_lines[i][0].y.to<double>());
+        for (size_t j = 0; j < single_line.size(); j++) {
+            EXPECT_EQ(single_line[j].x.to<double>(),
+                      nearest_lines[i][j].x.to<double>());
+            EXPECT_EQ(single_line[j].y.to<double>(),
+                      nearest_lines[i][j].y.to<double>());
+        }
+    }
+}
+
+// Test that a projection step removes most of the divergence of a smooth velocity
+// field, with the pressure solve converging in a handful of iterations
+TEST_F(FluidSimulatorTest, projection_removes_divergence) {
+    GraphNode<ControlVolume> graph(32, 1);
+    auto mesh = std::make_shared<const ControlVolumeMesh>(graph);
+    ProjectionSolver projection(mesh, std::vector<uint8_t>(mesh->numCells(), 0));
+
+    // A divergent field, with walls on every side
+    ControlVolumeFields current, next;
+    current.resize(mesh->numCells());
+    next.resize(mesh->numCells());
+    for (size_t i = 0; i < mesh->numCells(); i++) {
+        const double x        = mesh->getCellX()[i] + mesh->getCellScale()[i] / 2;
+        const double y        = mesh->getCellY()[i] + mesh->getCellScale()[i] / 2;
+        current.pressure[i]   = 0;
+        current.velocity_x[i] = std::sin(M_PI * x) * std::sin(M_PI * y);
+        current.velocity_y[i] = std::sin(2 * M_PI * x) * std::sin(M_PI * y);
+    }
+    StencilEdgeStates<double> walls = legacyEdgeStates<double>();
+    walls.left = walls.right = walls.top = walls.bottom = {0, 0, 0};
+
+    ThreadPool thread_pool(1);
+    std::vector<double> divergence;
+    auto divergence_norm = [&](const ControlVolumeFields& fields) {
+        projection.computeDivergence(fields, walls, thread_pool, divergence);
+        double norm = 0;
+        for (double d : divergence) {
+            norm += d * d;
+        }
+        return std::sqrt(norm);
+    };
+
+    const double initial_divergence = divergence_norm(current);
+    LinearSolveResult result =
+        projection.step(current, walls, 1e-3, 1, 0, thread_pool, next);
+
+    EXPECT_TRUE(result.converged);
+    EXPECT_LT(result.iterations, 30);
+    EXPECT_LE(result.relative_residual, ProjectionSolver::PRESSURE_TOLERANCE);
+    EXPECT_GT(projection.getPressureSolver().numLevels(), 2);
+    EXPECT_LT(divergence_norm(next), 0.1 * initial_divergence);
+}
+
+// Test that projection mode steps stably with time steps far beyond the acoustic limit,
+// and gives exactly the same result on any number of threads
+TEST_F(FluidSimulatorTest, projection_mode_ignores_acoustic_limit) {
+    FluidSimulator single_threaded = createSimulator(UpdateMethod::FLAT_ARRAYS);
+    FluidSimulator multi_threaded  = createSimulator(UpdateMethod::FLAT_ARRAYS);
+    const double acoustic_dt = single_threaded.computeStableTimeStep().to<double>();
+
+    single_threaded.setSolverMode(SolverMode::PROJECTION);
+    multi_threaded.setSolverMode(SolverMode::PROJECTION);
+    multi_threaded.setNumThreads(4);
+
+    // The first step projects the fluid at rest onto the flow in through the edges,
+    // so it speeds up a little more than the default growth factor allows
+    AdaptiveTimeStepParameters parameters;
+    parameters.max_growth_factor = 4;
+    single_threaded.setAdaptiveTimeStepParameters(parameters);
+    EXPECT_GT(single_threaded.computeStableTimeStep().to<double>(), acoustic_dt);
+
+    for (int i = 0; i < 20; i++) {
+        second_t dt = single_threaded.updateControlVolumesAdaptive(second_t(1));
+        EXPECT_GT(dt.to<double>(), acoustic_dt);
+        multi_threaded.updateControlVolumes(dt);
+        EXPECT_TRUE(single_threaded.getLastPressureSolveResult().converged);
+    }
+    EXPECT_EQ(0, single_threaded.getNumRejectedSteps());
+
+    for (auto& node : single_threaded.getControlVolumeGraph()->getAllSubNodes()) {
+        EXPECT_TRUE(std::isfinite(node->containedValue().getPressure().to<double>()));
+        EXPECT_TRUE(std::isfinite(node->containedValue().getVelocity().x.to<double>()));
+        EXPECT_TRUE(std::isfinite(node->containedValue().getVelocity().y.to<double>()));
+    }
+    expectIdenticalControlVolumes(single_threaded, multi_threaded);
+}
+
+// Test that the mesh refiner splits cells along a pressure jump up to the cell limit,
+// keeps the integral of the fields unchanged, links cells to their actual neighbours,
+// and merges the cells back together once the jump is gone
+TEST_F(FluidSimulatorTest, mesh_refiner_splits_and_merges_conservatively) {
+    GraphNode<ControlVolume> graph(16, 1);
+    auto base_mesh = std::make_shared<const ControlVolumeMesh>(graph);
+
+    RefinementParameters parameters;
+    parameters.refine_threshold  = 10;
+    parameters.coarsen_threshold = 1;
+    parameters.max_level         = 2;
+    parameters.max_cells         = 400;
+    MeshRefiner refiner(base_mesh, parameters);
+    ThreadPool thread_pool(3);
+
+    // A pressure jump at x = 0.5, with a smooth velocity
+    ControlVolumeFields fields;
+    fields.resize(base_mesh->numCells());
+    for (size_t i = 0; i < base_mesh->numCells(); i++) {
+        const double x       = base_mesh->getCellX()[i];
+        fields.pressure[i]   = x < 0.5 ? 100 : 0;
+        fields.velocity_x[i] = x;
+        fields.velocity_y[i] = base_mesh->getCellY()[i];
+    }
+    auto integral = [&](const std::vector<double>& values) {
+        const std::vector<double>& cell_scale = refiner.getMesh()->getCellScale();
+        double sum                            = 0;
+        for (size_t i = 0; i < values.size(); i++) {
+            sum += values[i] * cell_scale[i] * cell_scale[i];
+        }
+        return sum;
+    };
+    const double pressure_integral   = integral(fields.pressure);
+    const double velocity_x_integral = integral(fields.velocity_x);
+
+    // The two columns either side of the jump are split, then the jump is still
+    // between two columns of the split cells which are split again until the limit
+    EXPECT_TRUE(refiner.adapt(fields, fields, thread_pool));
+    EXPECT_EQ(256u + 32 * 3, refiner.getMesh()->numCells());
+    EXPECT_TRUE(refiner.adapt(fields, fields, thread_pool));
+    EXPECT_LE(refiner.getMesh()->numCells(), parameters.max_cells);
+    const std::vector<int> levels = refiner.getCellLevels();
+    EXPECT_EQ(2, *std::max_element(levels.begin(), levels.end()));
+    EXPECT_DOUBLE_EQ(pressure_integral, integral(fields.pressure));
+    EXPECT_DOUBLE_EQ(velocity_x_integral, integral(fields.velocity_x));
+
+    // Every neighbour shares (part of) a face with it's cell
+    const ControlVolumeMesh& mesh    = *refiner.getMesh();
+    const std::vector<double>& x     = mesh.getCellX();
+    const std::vector<double>& y     = mesh.getCellY();
+    const std::vector<double>& scale = mesh.getCellScale();
+    for (size_t i = 0; i < mesh.numCells(); i++) {
+        const int left   = mesh.getNeighbours(LEFT)[i];
+        const int right  = mesh.getNeighbours(RIGHT)[i];
+        const int top    = mesh.getNeighbours(TOP)[i];
+        const int bottom = mesh.getNeighbours(BOTTOM)[i];
+        EXPECT_EQ(x[i] == 0, left == ControlVolumeMesh::NO_NEIGHBOUR);
+        EXPECT_EQ(y[i] == 0, bottom == ControlVolumeMesh::NO_NEIGHBOUR);
+        if (left >= 0) {
+            EXPECT_DOUBLE_EQ(x[i], x[left] + scale[left]);
+            EXPECT_TRUE(y[left] < y[i] + scale[i] && y[i] < y[left] + scale[left]);
+        }
+        if (right >= 0) {
+            EXPECT_DOUBLE_EQ(x[i] + scale[i], x[right]);
+            EXPECT_TRUE(y[right] < y[i] + scale[i] && y[i] < y[right] + scale[right]);
+        }
+        if (top >= 0) {
+            EXPECT_DOUBLE_EQ(y[i] + scale[i], y[top]);
+            EXPECT_TRUE(x[top] < x[i] + scale[i] && x[i] < x[top] + scale[top]);
+        }
+        if (bottom >= 0) {
+            EXPECT_DOUBLE_EQ(y[i], y[bottom] + scale[bottom]);
+            EXPECT_TRUE(x[bottom] < x[i] + scale[i] && x[i] < x[bottom] + scale[bottom]);
+        }
+    }
+
+    // Without the jump every cell is merged back, one level at a time
+    std::fill(fields.pressure.begin(), fields.pressure.end(), 0);
+    std::fill(fields.velocity_x.begin(), fields.velocity_x.end(), 0);
+    std::fill(fields.velocity_y.begin(), fields.velocity_y.end(), 0);
+    EXPECT_TRUE(refiner.adapt(fields, fields, thread_pool));
+    EXPECT_TRUE(refiner.adapt(fields, fields, thread_pool));
+    EXPECT_FALSE(refiner.adapt(fields, fields, thread_pool));
+    EXPECT_EQ(base_mesh->numCells(), refiner.getMesh()->numCells());
+}
+
+// Test that refinement follows the flow as the simulation is stepped, gives exactly the
+// same result on any number of threads, and merges back into the graph when disabled
+TEST_F(FluidSimulatorTest, mesh_refinement_follows_solution) {
+    FluidSimulator single_threaded = createSimulator(UpdateMethod::FLAT_ARRAYS);
+    FluidSimulator multi_threaded  = createSimulator(UpdateMethod::FLAT_ARRAYS);
+    multi_threaded.setNumThreads(4);
+    const size_t num_graph_volumes = single_threaded.getNumControlVolumes();
+
+    RefinementParameters parameters;
+    parameters.refine_threshold          = 5;
+    parameters.coarsen_threshold         = 0.5;
+    parameters.max_level                 = 2;
+    parameters.max_cells                 = 2 * num_graph_volumes;
+    parameters.steps_between_adaptations = 5;
+    single_threaded.enableMeshRefinement(parameters);
+    multi_threaded.enableMeshRefinement(parameters);
+
+    // Split cells need smaller time steps
+    for (int i = 0; i < 40; i++) {
+        second_t dt = single_threaded.updateControlVolumesAdaptive(second_t(1e-4));
+        multi_threaded.updateControlVolumes(dt);
+    }
+    EXPECT_GT(single_threaded.getNumControlVolumes(), num_graph_volumes);
+    EXPECT_LE(single_threaded.getNumControlVolumes(), parameters.max_cells);
+    EXPECT_EQ(single_threaded.getNumControlVolumes(),
+              multi_threaded.getNumControlVolumes());
+
+    // Split cells lie within the node they were split from, so they keep it's
+    // obstacles
+    const std::vector<uint8_t>& mask = single_threaded.getObstacleCellMask();
+    const auto& nodes                = single_threaded.getControlVolumeNodes();
+    ASSERT_EQ(nodes.size(), mask.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        for (size_t j = 0; j < nodes.size(); j++) {
+            if (nodes[i] == nodes[j]) {
+                EXPECT_EQ(mask[i], mask[j]);
+                break;
+            }
+        }
+    }
+
+    FieldSnapshot single_snapshot, multi_snapshot;
+    single_threaded.takeSnapshot(single_snapshot);
+    multi_threaded.takeSnapshot(multi_snapshot);
+    for (size_t i = 0; i < single_snapshot.fields.size(); i++) {
+        EXPECT_TRUE(std::isfinite(single_snapshot.fields.pressure[i]));
+        EXPECT_EQ(single_snapshot.fields.pressure[i], multi_snapshot.fields.pressure[i]);
+        EXPECT_EQ(single_snapshot.fields.velocity_x[i],
+                  multi_snapshot.fields.velocity_x[i]);
+    }
+
+    // Handing out the graph keeps the split cells, except those of nodes changed
+    // through it, which all take the new value
+    std::shared_ptr<RealNode<ControlVolume>> changed_node;
+    for (size_t i = 0; i < nodes.size() && !changed_node; i++) {
+        for (size_t j = i + 1; j < nodes.size(); j++) {
+            if (nodes[i] == nodes[j] && single_snapshot.fields.pressure[i] !=
+                                            single_snapshot.fields.pressure[j]) {
+                changed_node = nodes[i];
+                break;
+            }
+        }
+    }
+    ASSERT_TRUE(changed_node);
+    single_threaded.getControlVolumeGraph();
+    changed_node->containedValue().setPressure(pascal_t(12345));
+
+    FieldSnapshot changed_snapshot;
+    single_threaded.takeSnapshot(changed_snapshot);
+    ASSERT_EQ(single_snapshot.fields.size(), changed_snapshot.fields.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (nodes[i] == changed_node) {
+            EXPECT_EQ(12345, changed_snapshot.fields.pressure[i]);
+        } else {
+            EXPECT_EQ(single_snapshot.fields.pressure[i],
+                      changed_snapshot.fields.pressure[i]);
+            EXPECT_EQ(single_snapshot.fields.velocity_x[i],
+                      changed_snapshot.fields.velocity_x[i]);
+        }
+    }
+    std::vector<std::shared_ptr<RealNode<ControlVolume>>> multi_nodes =
+        multi_threaded.getControlVolumeNodes();
+    multi_threaded.getControlVolumeGraph();
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (nodes[i] == changed_node) {
+            multi_nodes[i]->containedValue().setPressure(pascal_t(12345));
+        }
+    }
+
+    single_threaded.disableMeshRefinement();
+    multi_threaded.disableMeshRefinement();
+    EXPECT_EQ(num_graph_volumes, single_threaded.getNumControlVolumes());
+    expectIdenticalControlVolumes(single_threaded, multi_threaded);
+}
+
+// Test that a simulator restored from a checkpoint (including a refined mesh and
+// obstacles) continues exactly as the original would have
+TEST_F(FluidSimulatorTest, checkpoint_restarts_bit_identically) {
+    FluidSimulator original = createSimulator(UpdateMethod::FLAT_ARRAYS);
+    RefinementParameters parameters;
+    parameters.refine_threshold          = 5;
+    parameters.coarsen_threshold         = 0.5;
+    parameters.steps_between_adaptations = 3;
+    original.enableMeshRefinement(parameters);
+    const size_t num_graph_volumes = original.getNumControlVolumes();
+    for (int i = 0; i < 3; i++) {
+        original.updateControlVolumes(second_t(1e-5));
+    }
+    EXPECT_GT(original.getNumControlVolumes(), num_graph_volumes);
+
+    const std::string path = testing::TempDir() + "fluid_simulator_test.checkpoint";
+    original.writeCheckpoint(path);
+
+    FluidSimulator restored = FluidSimulator::restoreCheckpoint(path);
+    EXPECT_EQ(original.getNumControlVolumes(), restored.getNumControlVolumes());
+    EXPECT_EQ(original.getSimulationTime().to<double>(),
+              restored.getSimulationTime().to<double>());
+    EXPECT_EQ(original.getObstacleCellMask(), restored.getObstacleCellMask());
+
+    // The restored simulator isn't refining, so stop before the original adapts again
+    for (int i = 0; i < 2; i++) {
+        original.updateControlVolumes(second_t(1e-5));
+        restored.updateControlVolumes(second_t(1e-5));
+    }
+    FieldSnapshot original_snapshot, restored_snapshot;
+    original.takeSnapshot(original_snapshot);
+    restored.takeSnapshot(restored_snapshot);
+    EXPECT_EQ(original_snapshot.fields.pressure, restored_snapshot.fields.pressure);
+    EXPECT_EQ(original_snapshot.fields.velocity_x, restored_snapshot.fields.velocity_x);
+    EXPECT_EQ(original_snapshot.fields.velocity_y, restored_snapshot.fields.velocity_y);
+
+    // Stepping doesn't need the graph, so it isn't built until it's read
+    EXPECT_FALSE(restored_snapshot.mesh->hasNodes());
+    CheckpointState original_state, restored_state;
+    original.takeCheckpoint(original_state);
+    restored.takeCheckpoint(restored_state);
+    EXPECT_EQ(original_state.num_graph_nodes, restored_state.num_graph_nodes);
+    expectIdenticalControlVolumes(original, restored);
+    restored.takeSnapshot(restored_snapshot);
+    EXPECT_TRUE(restored_snapshot.mesh->hasNodes());
+    std::remove(path.c_str());
+}
+
+// Test that the settings that change the equations being solved are restored from a
+// checkpoint along with the state
+TEST_F(FluidSimulatorTest, checkpoint_restores_solver_settings) {
+    const std::string path = testing::TempDir() + "fluid_simulator_test.checkpoint";
+    auto expect_same_conditions = [](const BoundaryConditions& expected,
+                                     const BoundaryConditions& actual) {
+        for (int side = 0; side < NUM_DIRECTIONS; side++) {
+            EXPECT_EQ(expected.sides[side].type, actual.sides[side].type);
+            EXPECT_EQ(expected.sides[side].state.pressure,
+                      actual.sides[side].state.pressure);
+            EXPECT_EQ(expected.sides[side].state.velocity_x,
+                      actual.sides[side].state.velocity_x);
+            EXPECT_EQ(expected.sides[side].state.velocity_y,
+                      actual.sides[side].state.velocity_y);
+        }
+        EXPECT_EQ(expected.override_top_velocity, actual.override_top_velocity);
+        EXPECT_EQ(expected.top_velocity_override.velocity_x,
+                  actual.top_velocity_override.velocity_x);
+    };
+
+    FluidSimulator original = createSimulator(UpdateMethod::FLAT_ARRAYS);
+    BoundaryConditions conditions = legacyBoundaryConditions();
+    conditions.sides[LEFT].state     = {0, 1, 0};
+    conditions.override_top_velocity = false;
+    original.setBoundaryConditions(conditions);
+    original.setSolverMode(SolverMode::PROJECTION);
+    ImplicitDiffusionParameters parameters;
+    parameters.implicitness = 0.75;
+    original.enableImplicitDiffusion(parameters);
+    for (int i = 0; i < 3; i++) {
+        original.updateControlVolumes(second_t(1e-4));
+    }
+
+    original.writeCheckpoint(path);
+    FluidSimulator restored = FluidSimulator::restoreCheckpoint(path);
+    EXPECT_EQ(SolverMode::PROJECTION, restored.getSolverMode());
+    EXPECT_TRUE(restored.isImplicitDiffusionEnabled());
+    expect_same_conditions(conditions, restored.getBoundaryConditions());
+
+    // The implicitness isn't visible, but changes the result of every step
+    for (int i = 0; i < 2; i++) {
+        original.updateControlVolumes(second_t(1e-4));
+        restored.updateControlVolumes(second_t(1e-4));
+    }
+    FieldSnapshot original_snapshot, restored_snapshot;
+    original.takeSnapshot(original_snapshot);
+    restored.takeSnapshot(restored_snapshot);
+    EXPECT_EQ(original_snapshot.fields.pressure, restored_snapshot.fields.pressure);
+    EXPECT_EQ(original_snapshot.fields.velocity_x, restored_snapshot.fields.velocity_x);
+    EXPECT_EQ(original_snapshot.fields.velocity_y, restored_snapshot.fields.velocity_y);
+
+    conditions.sides[LEFT].type  = BoundaryType::PERIODIC;
+    conditions.sides[RIGHT].type = BoundaryType::PERIODIC;
+    conditions.sides[TOP]        = {BoundaryType::WALL, {0, 1, 0}};
+    conditions.sides[BOTTOM]     = {BoundaryType::OUTFLOW, {0, 0, 0}};
+    original.setBoundaryConditions(conditions);
+    original.setSolverMode(SolverMode::SLIGHTLY_COMPRESSIBLE);
+    original.disableImplicitDiffusion();
+    original.writeCheckpoint(path);
+    FluidSimulator restored_again = FluidSimulator::restoreCheckpoint(path);
+    EXPECT_EQ(SolverMode::SLIGHTLY_COMPRESSIBLE, restored_again.getSolverMode());
+    EXPECT_FALSE(restored_again.isImplicitDiffusionEnabled());
+    expect_same_conditions(conditions, restored_again.getBoundaryConditions());
+    std::remove(path.c_str());
+}
+
+// Test that a simulator given a field series writes every nth step to it
+TEST_F(FluidSimulatorTest, field_output_writes_every_nth_step) {
+    FluidSimulator simulator = createSimulator(UpdateMethod::FLAT_ARRAYS);
+    const std::string path   = testing::TempDir() + "fluid_simulator_test.series";
+
+    auto writer = std::make_shared<FieldSeriesWriter>(path, FieldSeriesParameters());
+    simulator.setFieldOutput(writer, 2);
+    for (int i = 0; i < 6; i++) {
+        simulator.updateControlVolumes(second_t(1e-5));
+    }
+    writer->flush();
+    EXPECT_EQ(3u, writer->getCounters().frames_written);
+
+    FieldSnapshot snapshot;
+    simulator.takeSnapshot(snapshot);
+    FieldSeriesReader reader(path);
+    ASSERT_EQ(3u, reader.numFrames());
+    FieldSeriesFrame frame;
+    reader.readFrame(2, frame);
+    EXPECT_EQ(6u, frame.num_steps);
+    EXPECT_EQ(snapshot.simulation_time, frame.simulation_time);
+    EXPECT_EQ(snapshot.fields.pressure, frame.fields.pressure);
+    EXPECT_EQ(snapshot.fields.velocity_x, frame.fields.velocity_x);
+    EXPECT_EQ(snapshot.fields.velocity_y, frame.fields.velocity_y);
+    reader.readFrame(0, frame);
+    EXPECT_EQ(2u, frame.num_steps);
+
+    std::remove(path.c_str());
+    std::remove((path + ".index").c_str());
+}
+
+TEST_F(FluidSimulatorTest, shared_snapshot_is_unchanged_by_stepping) {
+    FluidSimulator simulator = createSimulator(UpdateMethod::FLAT_ARRAYS);
+    const SharedFieldSnapshot first = simulator.shareSnapshot();
+
+    // Sharing again without stepping shares the same buffers
+    EXPECT_EQ(first.fields, simulator.shareSnapshot().fields);
+    EXPECT_EQ(first.obstacle_cell_mask, simulator.shareSnapshot().obstacle_cell_mask);
+
+    const ControlVolumeFields first_fields = *first.fields;
+    const std::vector<uint8_t> first_mask  = *first.obstacle_cell_mask;
+    for (int i = 0; i < 3; i++) {
+        simulator.updateControlVolumes(second_t(1e-5));
+    }
+    simulator.addObstacle(
+        std::make_shared<Circle<ControlVolume>>(0.1, (Coordinates){0.8, 0.8}));
+
+    // The first snapshot still holds the state it was taken in
+    EXPECT_EQ(first_fields.pressure, first.fields->pressure);
+    EXPECT_EQ(first_fields.velocity_x, first.fields->velocity_x);
+    EXPECT_EQ(first_fields.velocity_y, first.fields->velocity_y);
+    EXPECT_EQ(first_mask, *first.obstacle_cell_mask);
+    EXPECT_EQ(0, first.simulation_time);
+
+    // And a new one holds the current state
+    const SharedFieldSnapshot second = simulator.shareSnapshot();
+    FieldSnapshot copied;
+    simulator.takeSnapshot(copied);
+    EXPECT_NE(first_fields.pressure, second.fields->pressure);
+    EXPECT_EQ(copied.fields.pressure, second.fields->pressure);
+    EXPECT_EQ(copied.obstacle_cell_mask, *second.obstacle_cell_mask);
+    EXPECT_NE(first_mask, *second.obstacle_cell_mask);
+    EXPECT_EQ(copied.simulation_time, second.simulation_time);
+}
+
+// Test that with every control volume the same size, local time stepping takes the
+// same steps as stepping every control volume together
+TEST_F(FluidSimulatorTest, local_time_stepping_on_uniform_mesh_matches_global_steps) {
+    FluidSimulator legacy = createSimulator(UpdateMethod::LEGACY_GRAPH);
+    FluidSimulator local  = createSimulator(UpdateMethod::FLAT_ARRAYS);
+    local.setNumThreads(3);
+    const size_t num_volumes = local.getNumControlVolumes();
+
+    for (int i = 0; i < 20; i++) {
+        const second_t stable_dt = local.computeStableTimeStep();
+        const second_t dt        = local.updateControlVolumesLocal(second_t(1));
+        EXPECT_EQ(stable_dt.to<double>(), dt.to<double>());
+        legacy.updateControlVolumes(dt);
+    }
+    expectIdenticalControlVolumes(legacy, local);
+    EXPECT_EQ(20 * num_volumes, local.getNumCellUpdates());
+    EXPECT_EQ(legacy.getSimulationTime().to<double>(),
+              local.getSimulationTime().to<double>());
+
+    local.setSolverMode(SolverMode::PROJECTION);
+    EXPECT_THROW(local.updateControlVolumesLocal(second_t(1)), std::runtime_error);
+}
+
+// Test that on a refined mesh, local time stepping closely follows stepping every
+// control volume with the smallest time step, while updating far fewer of them
+TEST_F(FluidSimulatorTest, local_time_stepping_subcycles_refined_cells) {
+    RefinementParameters parameters;
+    parameters.refine_threshold          = 5;
+    parameters.coarsen_threshold         = 0.5;
+    parameters.max_level                 = 2;
+    parameters.steps_between_adaptations = 5;
+
+    // Refine both the same way, then stop before either adapts again
+    FluidSimulator global = createSimulator(UpdateMethod::FLAT_ARRAYS);
+    FluidSimulator local  = createSimulator(UpdateMethod::FLAT_ARRAYS);
+    const size_t num_graph_volumes = global.getNumControlVolumes();
+    parameters.max_cells           = 2 * num_graph_volumes;
+    global.enableMeshRefinement(parameters);
+    local.enableMeshRefinement(parameters);
+    for (int i = 0; i < 5; i++) {
+        const second_t dt = global.updateControlVolumesAdaptive(second_t(1e-4));
+        local.updateControlVolumes(dt);
+    }
+    const size_t num_volumes = local.getNumControlVolumes();
+    ASSERT_GT(num_volumes, num_graph_volumes);
+    FieldSnapshot before;
+    global.takeSnapshot(before);
+
+    // The finest cells are at most two levels below the coarsest, so take at most 4
+    // steps for each step of the coarsest
+    const uint64_t global_updates = global.getNumCellUpdates();
+    const uint64_t local_updates  = local.getNumCellUpdates();
+    const second_t dt             = local.updateControlVolumesLocal(second_t(1));
+    for (int i = 0; i < 4; i++) {
+        global.updateControlVolumes(dt / 4);
+    }
+    EXPECT_EQ(4 * num_volumes, global.getNumCellUpdates() - global_updates);
+    EXPECT_LT(local.getNumCellUpdates() - local_updates, 2 * num_volumes);
+    EXPECT_DOUBLE_EQ(global.getSimulationTime().to<double>(),
+                     local.getSimulationTime().to<double>());
+
+    FieldSnapshot global_after, local_after;
+    global.takeSnapshot(global_after);
+    local.takeSnapshot(local_after);
+    ASSERT_EQ(num_volumes, local_after.fields.size());
+    double max_change = 0, max_difference = 0;
+    for (size_t i = 0; i < num_volumes; i++) {
+        ASSERT_TRUE(std::isfinite(local_after.fields.pressure[i]));
+        max_change = std::max(
+            max_change,
+            std::abs(global_after.fields.pressure[i] - before.fields.pressure[i]));
+        max_difference = std::max(max_difference,
+                                  std::abs(global_after.fields.pressure[i] -
+                                           local_after.fields.pressure[i]));
+    }
+    EXPECT_GT(max_change, 0);
+    EXPECT_LT(max_difference, 0.1 * max_change);
+}
+
+// Test that the cached view of the control volumes matches the nodes, and is only
+// rebuilt when the topology changes
+TEST_F(FluidSimulatorTest, control_volume_cells_are_cached_until_topology_changes) {
+    FluidSimulator simulator = createSimulator(UpdateMethod::FLAT_ARRAYS);
+    const NodeSpan<ControlVolume> cells = simulator.getControlVolumeCells();
+    const auto& nodes                   = simulator.getControlVolumeNodes();
+    ASSERT_EQ(nodes.size(), cells.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        EXPECT_EQ(nodes[i].get(), &cells[i]);
+    }
+
+    // Stepping (either way) keeps the same view, with the values in the nodes
+    simulator.updateControlVolumes(second_t(1e-5));
+    simulator.setUpdateMethod(UpdateMethod::LEGACY_GRAPH);
+    simulator.updateControlVolumes(second_t(1e-5));
+    simulator.setUpdateMethod(UpdateMethod::FLAT_ARRAYS);
+    simulator.updateControlVolumes(second_t(1e-5));
+    const NodeSpan<ControlVolume> stepped_cells = simulator.getControlVolumeCells();
+    EXPECT_EQ(cells.begin(), stepped_cells.begin());
+    FieldSnapshot snapshot;
+    simulator.takeSnapshot(snapshot);
+    size_t i = 0;
+    for (RealNode<ControlVolume>* node : stepped_cells) {
+        EXPECT_EQ(snapshot.fields.pressure[i],
+                  node->containedValue().getPressure().to<double>());
+        i++;
+    }
+    EXPECT_EQ(cells.size(), i);
+
+    // Changing the topology rebuilds it, from the same graph nodes
+    const std::vector<RealNode<ControlVolume>*> node_pointers(cells.begin(),
+                                                             cells.end());
+    simulator.invalidateTopology();
+    const NodeSpan<ControlVolume> rebuilt_cells = simulator.getControlVolumeCells();
+    ASSERT_EQ(node_pointers.size(), rebuilt_cells.size());
+    EXPECT_TRUE(std::equal(
+        node_pointers.begin(), node_pointers.end(), rebuilt_cells.begin()));
+}
+
+// Test that implicit diffusion lifts the viscous limit on the time step, and closely
+// follows explicit diffusion with a small time step
+TEST_F(FluidSimulatorTest, implicit_diffusion_removes_viscous_time_step_limit) {
+    FluidSimulator explicit_simulator = createSimulator(UpdateMethod::FLAT_ARRAYS);
+    FluidSimulator implicit_simulator = createSimulator(UpdateMethod::FLAT_ARRAYS);
+    explicit_simulator.setSolverMode(SolverMode::PROJECTION);
+    implicit_simulator.setSolverMode(SolverMode::PROJECTION);
+    implicit_simulator.enableImplicitDiffusion();
+
+    const second_t dt = explicit_simulator.computeStableTimeStep();
+    EXPECT_GT(implicit_simulator.computeStableTimeStep().to<double>(),
+              10 * dt.to<double>());
+    for (int i = 0; i < 10; i++) {
+        explicit_simulator.updateControlVolumes(dt);
+        implicit_simulator.updateControlVolumes(dt);
+    }
+    const DiffusionSolveResult result =
+        implicit_simulator.getLastDiffusionSolveResult();
+    EXPECT_TRUE(result.velocity_x.converged);
+    EXPECT_TRUE(result.velocity_y.converged);
+    EXPECT_GT(result.velocity_x.iterations, 0);
+
+    FieldSnapshot explicit_fields, implicit_fields;
+    explicit_simulator.takeSnapshot(explicit_fields);
+    implicit_simulator.takeSnapshot(implicit_fields);
+    double max_speed = 0, max_difference = 0;
+    for (size_t i = 0; i < explicit_fields.fields.size(); i++) {
+        max_speed = std::max(max_speed, std::abs(explicit_fields.fields.velocity_x[i]));
+        max_difference = std::max(max_difference,
+                                  std::abs(explicit_fields.fields.velocity_x[i] -
+                                           implicit_fields.fields.velocity_x[i]));
+    }
+    EXPECT_GT(max_speed, 0);
+    EXPECT_LT(max_difference, 0.1 * max_speed);
+
+    // Far beyond the explicit limit the implicit steps stay finite
+    const second_t large_dt = implicit_simulator.computeStableTimeStep();
+    for (int i = 0; i < 5; i++) {
+        implicit_simulator.updateControlVolumes(large_dt);
+    }
+    implicit_simulator.takeSnapshot(implicit_fields);
+    for (size_t i = 0; i < implicit_fields.fields.size(); i++) {
+        ASSERT_TRUE(std::isfinite(implicit_fields.fields.velocity_x[i]));
+        ASSERT_TRUE(std::isfinite(implicit_fields.fields.velocity_y[i]));
+    }
+    EXPECT_TRUE(implicit_simulator.getLastDiffusionSolveResult().velocity_x.converged);
+
+    EXPECT_THROW(
+        implicit_simulator.enableImplicitDiffusion(ImplicitDiffusionParameters{1.5}),
+        std::invalid_argument);
+}
+
+// Test that outflow and wall boundaries leave a state that matches them unchanged, and
+// periodic boundaries keep a flow that is the same along them the same
+TEST_F(FluidSimulatorTest, boundary_conditions_apply_each_type) {
+    FluidSimulator simulator(kg_per_cu_m_t(1),
+                             meters_squared_per_s_t(1),
+                             meters_per_second_t(100),
+                             meter_t(1),
+                             15);
+    simulator.setUpdateMethod(UpdateMethod::LEGACY_GRAPH);
+    for (auto& node : simulator.getControlVolumeGraph()->getAllSubNodes()) {
+        node->containedValue().setPressure(pascal_t(5));
+        node->containedValue().setVelocity(
+            {meters_per_second_t(1), meters_per_second_t(0.5)});
+    }
+
+    BoundaryConditions conditions    = legacyBoundaryConditions();
+    conditions.override_top_velocity = false;
+    for (BoundaryCondition& side : conditions.sides) {
+        side.type = BoundaryType::OUTFLOW;
+    }
+    simulator.setBoundaryConditions(conditions);
+    for (int i = 0; i < 10; i++) {
+        simulator.updateControlVolumes(second_t(1e-5));
+    }
+    FieldSnapshot snapshot;
+    simulator.takeSnapshot(snapshot);
+    for (size_t i = 0; i < snapshot.fields.size(); i++) {
+        ASSERT_EQ(5, snapshot.fields.pressure[i]);
+        ASSERT_EQ(1, snapshot.fields.velocity_x[i]);
+        ASSERT_EQ(0.5, snapshot.fields.velocity_y[i]);
+    }
+
+    // A lid driven flow between two walls, periodic from left to right
+    for (auto& node : simulator.getControlVolumeGraph()->getAllSubNodes()) {
+        node->containedValue().setPressure(pascal_t(10 * node->getCoordinates().y));
+        node->containedValue().setVelocity(
+            {meters_per_second_t(0), meters_per_second_t(0)});
+    }
+    conditions.sides[LEFT].type  = BoundaryType::PERIODIC;
+    conditions.sides[RIGHT].type = BoundaryType::PERIODIC;
+    conditions.sides[TOP]        = {BoundaryType::WALL, {0, 1, 0}};
+    conditions.sides[BOTTOM]     = {BoundaryType::WALL, {0, 0, 0}};
+    simulator.setBoundaryConditions(conditions);
+    for (int i = 0; i < 20; i++) {
+        simulator.updateControlVolumes(second_t(1e-5));
+    }
+    simulator.takeSnapshot(snapshot);
+    const ControlVolumeMesh& mesh = *snapshot.mesh;
+    std::map<long, size_t> row_starts;
+    double max_speed = 0;
+    for (size_t i = 0; i < snapshot.fields.size(); i++) {
+        const long row     = std::lround(mesh.getCellY()[i] / mesh.getCellScale()[i]);
+        const size_t first = row_starts.emplace(row, i).first->second;
+        EXPECT_NEAR(
+            snapshot.fields.pressure[first], snapshot.fields.pressure[i], 1e-9);
+        EXPECT_NEAR(
+            snapshot.fields.velocity_x[first], snapshot.fields.velocity_x[i], 1e-9);
+        EXPECT_NEAR(
+            snapshot.fields.velocity_y[first], snapshot.fields.velocity_y[i], 1e-9);
+        max_speed = std::max(max_speed, std::abs(snapshot.fields.velocity_x[i]));
+    }
+    EXPECT_EQ(15u, row_starts.size());
+    EXPECT_GT(max_speed, 0);
+
+    // Only INFLOW boundaries have a fixed state outside the mesh
+    EXPECT_THROW(simulator.updateControlVolumesLocal(second_t(1)), std::runtime_error);
+    simulator.setSolverMode(SolverMode::PROJECTION);
+    EXPECT_THROW(simulator.updateControlVolumes(second_t(1e-5)), std::runtime_error);
+
+    conditions.sides[RIGHT].type = BoundaryType::OUTFLOW;
+    EXPECT_THROW(simulator.setBoundaryConditions(conditions), std::invalid_argument);
+}
+
+// Test that stepping in blocks with temporal blocking gives exactly the same result as
+// stepping one step at a time, for any tiling and number of threads
+TEST_F(FluidSimulatorTest, temporal_blocking_matches_step_by_step) {
+    FluidSimulator reference = createSimulator(UpdateMethod::FLAT_ARRAYS);
+    reference.setSimdLevel(SimdLevel::SCALAR);
+    const size_t num_volumes = reference.getNumControlVolumes();
+
+    for (const int num_threads : {1, 3}) {
+        FluidSimulator blocked = createSimulator(UpdateMethod::FLAT_ARRAYS);
+        blocked.setNumThreads(num_threads);
+        TemporalBlockingParameters parameters;
+        parameters.tile_size       = 4;
+        parameters.steps_per_block = 3;
+        blocked.setTemporalBlockingParameters(parameters);
+        const std::string path = testing::TempDir() + "temporal_blocking_test.series";
+        auto writer =
+            std::make_shared<FieldSeriesWriter>(path, FieldSeriesParameters());
+        blocked.setFieldOutput(writer, 4);
+
+        // Blocks of three steps, cut short at every fourth step to output a frame
+        blocked.updateControlVolumesBlocked(second_t(1e-5), 10);
+        EXPECT_EQ(10 * num_volumes, blocked.getNumCellUpdates());
+        EXPECT_DOUBLE_EQ(1e-4, blocked.getSimulationTime().to<double>());
+        blocked.setFieldOutput(nullptr, 1);
+        writer->flush();
+
+        FluidSimulator step_by_step = createSimulator(UpdateMethod::FLAT_ARRAYS);
+        step_by_step.setSimdLevel(SimdLevel::SCALAR);
+        FieldSnapshot frame_snapshot;
+        for (int i = 0; i < 10; i++) {
+            step_by_step.updateControlVolumes(second_t(1e-5));
+            if (i + 1 == 8) {
+                step_by_step.takeSnapshot(frame_snapshot);
+            }
+        }
+        expectIdenticalControlVolumes(step_by_step, blocked);
+
+        // Frames are output after the same steps as when stepping one at a time
+        FieldSeriesReader reader(path);
+        ASSERT_EQ(2u, reader.numFrames());
+        FieldSeriesFrame frame;
+        reader.readFrame(0, frame);
+        EXPECT_EQ(4u, frame.num_steps);
+        reader.readFrame(1, frame);
+        EXPECT_EQ(8u, frame.num_steps);
+        EXPECT_EQ(frame_snapshot.fields.pressure, frame.fields.pressure);
+        EXPECT_EQ(frame_snapshot.fields.velocity_x, frame.fields.velocity_x);
+        std::remove(path.c_str());
+    }
+
+    // Halos reach past several tiles, and every tile is stepped
+    auto mesh = reference.shareSnapshot().mesh;
+    TemporalBlockingParameters parameters;
+    parameters.tile_size       = 2;
+    parameters.steps_per_block = 5;
+    TemporalBlockStepper stepper(mesh,
+                                 reference.getObstacleCellMask(),
+                                 legacyEdgeStates<double>(),
+                                 parameters);
+    EXPECT_EQ(64u, stepper.getNumTiles());
+    EXPECT_EQ(num_volumes, stepper.getNumCellUpdates(1));
+    EXPECT_GT(stepper.getNumCellUpdates(5), 5 * num_volumes);
+
+    parameters.steps_per_block = 0;
+    EXPECT_THROW(reference.setTemporalBlockingParameters(parameters),
+                 std::invalid_argument);
+    reference.setSolverMode(SolverMode::PROJECTION);
+    EXPECT_THROW(reference.updateControlVolumesBlocked(second_t(1e-5), 1),
+                 std::runtime_error);
+}
+
+// Test that the simulator reduces it's current fields into a field pyramid
+TEST_F(FluidSimulatorTest, field_pyramid_holds_current_fields) {
+    FluidSimulator simulator = createSimulator(UpdateMethod::FLAT_ARRAYS);
+    for (int i = 0; i < 5; i++) {
+        simulator.updateControlVolumes(second_t(1e-5));
+    }
+    FieldSnapshot snapshot;
+    simulator.takeSnapshot(snapshot);
+    FieldPyramid pyramid;
+    simulator.buildFieldPyramid(pyramid);
+    EXPECT_EQ(snapshot.mesh, pyramid.getMesh());
+
+    ThreadPool thread_pool(1);
+    FieldPyramid expected;
+    expected.build(snapshot.mesh,
+                   snapshot.fields,
+                   snapshot.obstacle_cell_mask,
+                   snapshot.simulation_size,
+                   thread_pool);
+    ASSERT_EQ(expected.numLevels(), pyramid.numLevels());
+    for (size_t level = 0; level < pyramid.numLevels(); level++) {
+        EXPECT_EQ(expected.getLevel(level).min_pressure,
+                  pyramid.getLevel(level).min_pressure);
+        EXPECT_EQ(expected.getLevel(level).max_pressure,
+                  pyramid.getLevel(level).max_pressure);
+        EXPECT_EQ(expected.getLevel(level).fluid_area,
+                  pyramid.getLevel(level).fluid_area);
+    }
+}
+
+int main(int argc, char** argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,134 @@
+#include "GhostCellLayer.h"
+#include "ScalarStencilKernel.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+class GhostCellLayerTest : public testing::Test {
+  protected:
+    void SetUp() override {
+        graph = std::make_shared<GraphNode<ControlVolume>>(15, 1.0);
+        mesh  = std::make_shared<const ControlVolumeMesh>(*graph);
+
+        const size_t num_cells = mesh->numCells();
+        current.resize(num_cells);
+        for (size_t i = 0; i < num_cells; i++) {
+            current.pressure[i]   = 100 + i;
+            current.velocity_x[i] = 1 + 0.5 * i;
+            current.velocity_y[i] = -0.25 * i;
+        }
+    }
+
+    /**
+     * Check that the given neighbour state is the state of the given cell
+     *
+     * @param states the neighbour states to check
+     * @param slot the slot of the neighbour state to check
+     * @param cell the cell it should be the state of
+     */
+    void expectStateOf(const ControlVolumeFields& states, size_t slot, int cell) {
+        EXPECT_EQ(current.pressure[cell], states.pressure[slot]);
+        EXPECT_EQ(current.velocity_x[cell], states.velocity_x[slot]);
+        EXPECT_EQ(current.velocity_y[cell], states.velocity_y[slot]);
+    }
+
+    // The graph the mesh is built from
+    std::shared_ptr<GraphNode<ControlVolume>> graph;
+
+    // A uniform mesh of the graph
+    std::shared_ptr<const ControlVolumeMesh> mesh;
+
+    // A different state in every cell of the mesh
+    ControlVolumeFields current;
+};
+
+// Test that stepping the edge cells through the ghost layer gives exactly the same
+// result as the boundary kernel, for fixed edge states
+TEST_F(GhostCellLayerTest, matches_boundary_kernel) {
+    const FluidCoefficients fluid(1, 1, 100);
+
+    BoundaryConditions no_override    = legacyBoundaryConditions();
+    no_override.override_top_velocity = false;
+    for (const BoundaryConditions& conditions :
+         {legacyBoundaryConditions(), no_override}) {
+        GhostCellLayer layer(mesh, conditions);
+        ASSERT_EQ(mesh->getEdgeCells(), layer.getCells());
+        EXPECT_GT(layer.numGhosts(), layer.numCells());
+
+        ControlVolumeFields expected = current, actual = current;
+        const std::vector<int>& edge_cells = mesh->getEdgeCells();
+        updateScalarCells<double, false, true>(*mesh,
+                                               edge_cells,
+                                               0,
+                                               edge_cells.size(),
+                                               current,
+                                               toEdgeStates(conditions),
+                                               1e-5,
+                                               fluid,
+                                               expected);
+        layer.fill(current);
+        layer.updateCells(0, layer.numCells(), current, 1e-5, fluid, actual);
+        for (const int i : edge_cells) {
+            EXPECT_EQ(expected.pressure[i], actual.pressure[i]);
+            EXPECT_EQ(expected.velocity_x[i], actual.velocity_x[i]);
+            EXPECT_EQ(expected.velocity_y[i], actual.velocity_y[i]);
+        }
+    }
+}
+
+// Test that every ghost cell takes it's state from the condition at it's side, and
+// every real neighbour is copied from the fields
+TEST_F(GhostCellLayerTest, ghosts_follow_each_type) {
+    BoundaryConditions conditions    = legacyBoundaryConditions();
+    conditions.override_top_velocity = false;
+    conditions.sides[LEFT]           = {BoundaryType::PERIODIC, {0, 0, 0}};
+    conditions.sides[RIGHT]          = {BoundaryType::PERIODIC, {0, 0, 0}};
+    conditions.sides[TOP]            = {BoundaryType::WALL, {0, 1, 0.5}};
+    conditions.sides[BOTTOM]         = {BoundaryType::OUTFLOW, {0, 0, 0}};
+    GhostCellLayer layer(mesh, conditions);
+    layer.fill(current);
+
+    const ControlVolumeFields& top_states    = layer.getNeighbourStates(TOP);
+    const std::vector<int>& right_neighbours = mesh->getNeighbours(RIGHT);
+    size_t num_ghosts                        = 0;
+    for (size_t k = 0; k < layer.numCells(); k++) {
+        const int cell = layer.getCells()[k];
+        for (int direction = 0; direction < NUM_DIRECTIONS; direction++) {
+            const Direction side              = static_cast<Direction>(direction);
+            const ControlVolumeFields& states = layer.getNeighbourStates(side);
+            const int neighbour               = mesh->getNeighbours(side)[cell];
+            if (neighbour != ControlVolumeMesh::NO_NEIGHBOUR) {
+                expectStateOf(states, k, neighbour);
+                continue;
+            }
+            num_ghosts++;
+
+            if (side == BOTTOM) {
+                expectStateOf(states, k, cell);
+            } else if (side == TOP) {
+                EXPECT_EQ(current.pressure[cell], top_states.pressure[k]);
+                EXPECT_EQ(2 - current.velocity_x[cell], top_states.velocity_x[k]);
+                EXPECT_EQ(1 - current.velocity_y[cell], top_states.velocity_y[k]);
+            } else if (side == LEFT) {
+                // The last cell of the same row
+                int partner = cell;
+                while (right_neighbours[partner] != ControlVolumeMesh::NO_NEIGHBOUR) {
+                    partner = right_neighbours[partner];
+                }
+                expectStateOf(states, k, partner);
+            }
+        }
+    }
+    EXPECT_EQ(num_ghosts, layer.numGhosts());
+    EXPECT_EQ(4u * 15, layer.numGhosts());
+
+    // Periodic sides must come in pairs
+    conditions.sides[RIGHT].type = BoundaryType::OUTFLOW;
+    EXPECT_THROW(GhostCellLayer invalid_layer(mesh, conditions), std::invalid_argument);
+}
+
+int main(int argc, char** argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
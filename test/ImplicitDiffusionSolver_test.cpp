@@ -0,0 +1,130 @@
+#include "ImplicitDiffusionSolver.h"
+#include "MeshRefiner.h"
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+class ImplicitDiffusionSolverTest : public testing::Test {
+  protected:
+    void SetUp() override {
+        graph     = std::make_shared<GraphNode<ControlVolume>>(15, 1.0);
+        base_mesh = std::make_shared<const ControlVolumeMesh>(*graph);
+    }
+
+    /**
+     * Refine the base mesh along a pressure jump, so it has cells of several sizes
+     *
+     * @return the refined mesh
+     */
+    std::shared_ptr<const ControlVolumeMesh> createRefinedMesh() {
+        RefinementParameters parameters;
+        parameters.refine_threshold = 5;
+        parameters.max_level        = 2;
+        MeshRefiner refiner(base_mesh, parameters);
+
+        ControlVolumeFields fields;
+        fields.resize(base_mesh->numCells());
+        for (size_t i = 0; i < base_mesh->numCells(); i++) {
+            fields.pressure[i] = base_mesh->getCellX()[i] <= 0.25 ? 100 : 0;
+        }
+        for (int i = 0; i < 2; i++) {
+            refiner.adapt(fields, fields, thread_pool);
+        }
+        return refiner.getMesh();
+    }
+
+    // The graph the base mesh is built from
+    std::shared_ptr<GraphNode<ControlVolume>> graph;
+
+    // A uniform mesh of the graph
+    std::shared_ptr<const ControlVolumeMesh> base_mesh;
+
+    // The threads to refine and solve on
+    ThreadPool thread_pool{2};
+};
+
+// Test that a very long step reaches the steady state set by the edges, on uniform
+// and multi-resolution meshes
+TEST_F(ImplicitDiffusionSolverTest, long_step_reaches_steady_state) {
+    const std::shared_ptr<const ControlVolumeMesh> refined_mesh = createRefinedMesh();
+    ASSERT_GT(refined_mesh->numCells(), base_mesh->numCells());
+
+    StencilEdgeStates<double> edges = {};
+    edges.left.velocity_x = edges.right.velocity_x = 1;
+    edges.top.velocity_x = edges.bottom.velocity_x = 1;
+
+    ImplicitDiffusionParameters parameters;
+    parameters.implicitness = 1;
+    for (const auto& mesh : {base_mesh, refined_mesh}) {
+        const size_t num_cells = mesh->numCells();
+        ImplicitDiffusionSolver solver(
+            mesh, std::vector<uint8_t>(num_cells, 0), parameters);
+        EXPECT_EQ(0, solver.getLastResult().velocity_x.iterations);
+
+        ControlVolumeFields fields;
+        fields.resize(num_cells);
+        const DiffusionSolveResult result =
+            solver.diffuse(fields, edges, 1e6, 1, thread_pool);
+        EXPECT_TRUE(result.velocity_x.converged);
+        EXPECT_TRUE(result.velocity_y.converged);
+        EXPECT_GT(result.velocity_x.iterations, 0);
+        EXPECT_EQ(result.velocity_x.iterations,
+                  solver.getLastResult().velocity_x.iterations);
+        for (size_t i = 0; i < num_cells; i++) {
+            EXPECT_NEAR(1, fields.velocity_x[i], 1e-4);
+            EXPECT_NEAR(0, fields.velocity_y[i], 1e-4);
+        }
+    }
+
+    EXPECT_THROW(ImplicitDiffusionSolver(base_mesh,
+                                         std::vector<uint8_t>(base_mesh->numCells(), 0),
+                                         ImplicitDiffusionParameters{0.25}),
+                 std::invalid_argument);
+}
+
+// Test that cells covered by obstacles are brought to rest and slow the fluid around
+// them, without the pressure changing
+TEST_F(ImplicitDiffusionSolverTest, obstacles_slow_the_fluid) {
+    const size_t num_cells = base_mesh->numCells();
+    std::vector<uint8_t> obstacle_cell_mask(num_cells, 0);
+    for (size_t i = 0; i < num_cells; i++) {
+        const double x        = base_mesh->getCellX()[i];
+        const double y        = base_mesh->getCellY()[i];
+        obstacle_cell_mask[i] = x > 0.4 && x < 0.6 && y > 0.4 && y < 0.6;
+    }
+    ImplicitDiffusionSolver solver(base_mesh, obstacle_cell_mask, {});
+
+    StencilEdgeStates<double> edges = {};
+    edges.left.velocity_x = edges.right.velocity_x = 1;
+    edges.top.velocity_x = edges.bottom.velocity_x = 1;
+    ControlVolumeFields fields;
+    fields.resize(num_cells);
+    for (size_t i = 0; i < num_cells; i++) {
+        fields.pressure[i]   = i;
+        fields.velocity_x[i] = 1;
+    }
+    const DiffusionSolveResult result =
+        solver.diffuse(fields, edges, 1e-3, 1, thread_pool);
+    EXPECT_TRUE(result.velocity_x.converged);
+
+    double min_fluid_speed = 1;
+    for (size_t i = 0; i < num_cells; i++) {
+        EXPECT_EQ(static_cast<double>(i), fields.pressure[i]);
+        if (obstacle_cell_mask[i]) {
+            EXPECT_EQ(0, fields.velocity_x[i]);
+            EXPECT_EQ(0, fields.velocity_y[i]);
+        } else {
+            EXPECT_GT(fields.velocity_x[i], 0);
+            EXPECT_LE(fields.velocity_x[i], 1 + 1e-9);
+            min_fluid_speed = std::min(min_fluid_speed, fields.velocity_x[i]);
+        }
+    }
+    EXPECT_LT(min_fluid_speed, 0.9);
+}
+
+int main(int argc, char** argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,70 @@
+#include "MeshPartition.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+// Test that the mesh is split into compact parts of (nearly) equal weight
+TEST(MeshPartitionTest, partition_balances_cell_weights) {
+    auto graph             = std::make_shared<GraphNode<ControlVolume>>(15, 1.0);
+    auto mesh              = std::make_shared<ControlVolumeMesh>(*graph);
+    const size_t num_cells = mesh->numCells();
+
+    // The cells read from another part are the halo a process has to exchange
+    auto count_halo_cells = [&](const std::vector<int>& parts) {
+        size_t num_halo_cells = 0;
+        for (size_t i = 0; i < num_cells; i++) {
+            bool in_halo = false;
+            for (int direction = 0; direction < NUM_DIRECTIONS; direction++) {
+                const int neighbour =
+                    mesh->getNeighbours(static_cast<Direction>(direction))[i];
+                in_halo |= neighbour != ControlVolumeMesh::NO_NEIGHBOUR &&
+                           parts[neighbour] != parts[i];
+            }
+            num_halo_cells += in_halo;
+        }
+        return num_halo_cells;
+    };
+
+    // Equal weights give equal numbers of cells
+    std::vector<int> parts =
+        partitionMesh(*mesh, 4, std::vector<double>(num_cells, 1.0));
+    ASSERT_EQ(num_cells, parts.size());
+    std::vector<size_t> part_sizes(4, 0);
+    for (const int part : parts) {
+        ASSERT_GE(part, 0);
+        ASSERT_LT(part, 4);
+        part_sizes[part]++;
+    }
+    for (const size_t part_size : part_sizes) {
+        EXPECT_LE(part_size, num_cells / 4 + 1);
+        EXPECT_GE(part_size, num_cells / 4 - 1);
+    }
+    EXPECT_LT(count_halo_cells(parts), num_cells / 2);
+
+    // Costlier cells (eg. finer cells, which take more steps) are spread out
+    std::vector<double> weights(num_cells, 1.0);
+    for (size_t i = 0; i < num_cells; i++) {
+        if (mesh->getCellX()[i] < 0.5) {
+            weights[i] = 3;
+        }
+    }
+    parts = partitionMesh(*mesh, 4, weights);
+    std::vector<double> part_weights(4, 0);
+    for (size_t i = 0; i < num_cells; i++) {
+        part_weights[parts[i]] += weights[i];
+    }
+    const double total_weight =
+        part_weights[0] + part_weights[1] + part_weights[2] + part_weights[3];
+    for (const double part_weight : part_weights) {
+        EXPECT_NEAR(total_weight / 4, part_weight, 3);
+    }
+
+    EXPECT_THROW(partitionMesh(*mesh, 0, weights), std::invalid_argument);
+    EXPECT_THROW(partitionMesh(*mesh, 2, {}), std::invalid_argument);
+}
+
+int main(int argc, char** argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
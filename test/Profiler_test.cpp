@@ -0,0 +1,120 @@
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <thread>
+
+class ProfilerTest : public testing::Test {
+  protected:
+    void SetUp() override {
+        Profiler::setEnabled(true);
+        Profiler::reset();
+    }
+
+    /**
+     * Find the stats of the given phase
+     *
+     * @param stats the stats to search
+     * @param name the name of the phase
+     *
+     * @return the stats of the given phase, with no calls if there are none
+     */
+    ProfilePhaseStats findPhase(const std::vector<ProfilePhaseStats>& stats,
+                                const std::string& name) {
+        for (const ProfilePhaseStats& phase : stats) {
+            if (phase.name == name) {
+                return phase;
+            }
+        }
+        return ProfilePhaseStats();
+    }
+};
+
+TEST_F(ProfilerTest, scopes_and_counters_are_aggregated) {
+    EXPECT_TRUE(Profiler::isCompiledIn());
+
+    for (int i = 0; i < 3; i++) {
+        SIMPLE_CFD_PROFILE_SCOPE("outer");
+        {
+            SIMPLE_CFD_PROFILE_SCOPE("inner");
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        SIMPLE_CFD_PROFILE_COUNT("cells", 10);
+    }
+
+    const std::vector<ProfilePhaseStats> phases = Profiler::getPhaseStats();
+    ASSERT_EQ(2u, phases.size());
+    const ProfilePhaseStats inner = findPhase(phases, "inner");
+    const ProfilePhaseStats outer = findPhase(phases, "outer");
+    EXPECT_EQ(3u, inner.num_calls);
+    EXPECT_EQ(3u, outer.num_calls);
+    EXPECT_GE(inner.min_time, 1e-3);
+    EXPECT_LE(inner.min_time, inner.max_time);
+    EXPECT_GE(outer.total_time, inner.total_time);
+
+    const std::vector<ProfileCounterStats> counters = Profiler::getCounterStats();
+    ASSERT_EQ(1u, counters.size());
+    EXPECT_EQ("cells", counters[0].name);
+    EXPECT_EQ(3u, counters[0].num_samples);
+    EXPECT_EQ(30, counters[0].total);
+
+    // Nothing is recorded while disabled, and everything is forgotten on reset
+    Profiler::setEnabled(false);
+    {
+        SIMPLE_CFD_PROFILE_SCOPE("outer");
+        SIMPLE_CFD_PROFILE_COUNT("cells", 10);
+    }
+    EXPECT_EQ(3u, findPhase(Profiler::getPhaseStats(), "outer").num_calls);
+    EXPECT_EQ(30, Profiler::getCounterStats()[0].total);
+    Profiler::reset();
+    EXPECT_TRUE(Profiler::getPhaseStats().empty());
+    EXPECT_TRUE(Profiler::getCounterStats().empty());
+}
+
+TEST_F(ProfilerTest, threads_are_recorded_separately) {
+    ThreadPool thread_pool(4);
+    const size_t num_items = 1000;
+    thread_pool.parallelFor(num_items, [&](size_t begin, size_t end) {
+        SIMPLE_CFD_PROFILE_SCOPE("chunk");
+        SIMPLE_CFD_PROFILE_COUNT("items", end - begin);
+    });
+
+    // Combined, every item is counted once
+    const std::vector<ProfileCounterStats> counters = Profiler::getCounterStats();
+    ASSERT_EQ(1u, counters.size());
+    EXPECT_EQ(num_items, counters[0].total);
+    EXPECT_EQ(-1, counters[0].thread);
+
+    // Per thread, the chunks add up to the same
+    const std::vector<ProfilePhaseStats> combined = Profiler::getPhaseStats();
+    const std::vector<ProfilePhaseStats> per_thread = Profiler::getPhaseStats(true);
+    ASSERT_EQ(1u, combined.size());
+    ASSERT_FALSE(per_thread.empty());
+    uint64_t num_calls = 0;
+    for (const ProfilePhaseStats& phase : per_thread) {
+        EXPECT_EQ("chunk", phase.name);
+        EXPECT_GE(phase.thread, 0);
+        num_calls += phase.num_calls;
+    }
+    EXPECT_EQ(combined[0].num_calls, num_calls);
+
+    // The trace has a track for each thread, and an event for each chunk
+    std::ostringstream trace;
+    Profiler::writeChromeTrace(trace);
+    const std::string json = trace.str();
+    EXPECT_EQ(0u, json.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+    EXPECT_EQ("]}\n", json.substr(json.size() - 3));
+    size_t num_chunk_events = 0;
+    for (size_t i = json.find("\"name\":\"chunk\""); i != std::string::npos;
+         i         = json.find("\"name\":\"chunk\"", i + 1)) {
+        num_chunk_events++;
+    }
+    EXPECT_EQ(num_calls, num_chunk_events);
+    EXPECT_NE(std::string::npos, json.find("\"ph\":\"C\""));
+}
+
+int main(int argc, char** argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
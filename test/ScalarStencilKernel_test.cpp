@@ -0,0 +1,190 @@
+#include "ScalarStencilKernel.h"
+#include <algorithm>
+#include <cmath>
+#include <gtest/gtest.h>
+#include <random>
+
+using namespace units::literals;
+using namespace units::length;
+using namespace units::velocity;
+using namespace units::time;
+using namespace units::pressure;
+using namespace units::density;
+using namespace units::viscosity;
+
+// A compile-time specialisation of `updateScalarCells` to test
+template <typename ScalarType, bool UNIFORM_SPACING_VALUE, bool BOUNDARY_VALUE>
+struct KernelVariant {
+    using Scalar                         = ScalarType;
+    static constexpr bool UNIFORM_SPACING = UNIFORM_SPACING_VALUE;
+    static constexpr bool BOUNDARY        = BOUNDARY_VALUE;
+};
+
+template <typename Variant>
+class ScalarStencilKernelTest : public testing::Test {
+  protected:
+    using Scalar = typename Variant::Scalar;
+
+    virtual void SetUp() {
+        graph = std::make_shared<GraphNode<ControlVolume>>(20, 1.0);
+        mesh  = std::make_shared<ControlVolumeMesh>(*graph);
+
+        // Random, but reproducible, fields
+        std::mt19937 random_generator(42);
+        std::uniform_real_distribution<double> pressure_distribution(-100, 100);
+        std::uniform_real_distribution<double> velocity_distribution(-5, 5);
+        current.resize(mesh->numCells());
+        for (size_t i = 0; i < mesh->numCells(); i++) {
+            current.pressure[i]   = pressure_distribution(random_generator);
+            current.velocity_x[i] = velocity_distribution(random_generator);
+            current.velocity_y[i] = velocity_distribution(random_generator);
+        }
+    }
+
+    /**
+     * Get the given cell as a ControlVolume
+     *
+     * @param cell the index of the cell
+     *
+     * @return the given cell as a ControlVolume
+     */
+    ControlVolume getControlVolume(int cell) {
+        return createControlVolume({current.pressure[cell],
+                                    current.velocity_x[cell],
+                                    current.velocity_y[cell]});
+    }
+
+    /**
+     * Create a ControlVolume with the given state
+     *
+     * @param state the state of the ControlVolume
+     *
+     * @return a ControlVolume with the given state
+     */
+    ControlVolume createControlVolume(const CellState& state) {
+        return ControlVolume(pascal_t(state.pressure),
+                             Velocity2d{meters_per_second_t(state.velocity_x),
+                                        meters_per_second_t(state.velocity_y)},
+                             kg_per_cu_m_t(1.2),
+                             meters_squared_per_s_t(0.3),
+                             meters_per_second_t(100));
+    }
+
+    /**
+     * Get the neighbour of the given cell in the given direction as a ControlVolume,
+     * the same way the legacy update does
+     *
+     * @param cell the index of the cell
+     * @param direction the direction of the neighbour
+     *
+     * @return the neighbour and the distance to it
+     */
+    std::pair<ControlVolume, meter_t> getNeighbour(int cell, Direction direction) {
+        const StencilEdgeStates<double> edges = legacyEdgeStates<double>();
+        const int neighbour = mesh->getNeighbours(direction)[cell];
+        const meter_t distance(mesh->getNeighbourDistances(direction)[cell]);
+        if (neighbour == ControlVolumeMesh::NO_NEIGHBOUR) {
+            const CellState edge_states[NUM_DIRECTIONS] = {
+                edges.left, edges.right, edges.top, edges.bottom};
+            return {createControlVolume(edge_states[direction]), distance};
+        }
+
+        ControlVolume neighbour_volume = getControlVolume(neighbour);
+        if (direction == TOP) {
+            neighbour_volume.setVelocity(
+                {meters_per_second_t(edges.top_velocity_override.velocity_x),
+                 meters_per_second_t(edges.top_velocity_override.velocity_y)});
+        }
+        return {neighbour_volume, distance};
+    }
+
+    std::shared_ptr<GraphNode<ControlVolume>> graph;
+    std::shared_ptr<ControlVolumeMesh> mesh;
+    ControlVolumeFields current;
+    const double dt = 0.0001;
+};
+
+using KernelVariants = testing::Types<KernelVariant<double, false, false>,
+                                      KernelVariant<double, false, true>,
+                                      KernelVariant<double, true, false>,
+                                      KernelVariant<double, true, true>,
+                                      KernelVariant<float, false, false>,
+                                      KernelVariant<float, false, true>,
+                                      KernelVariant<float, true, false>,
+                                      KernelVariant<float, true, true>>;
+TYPED_TEST_CASE(ScalarStencilKernelTest, KernelVariants);
+
+// Test that every specialisation of the kernel matches `ControlVolume::update` on
+// every cell it can be used for. Double precision kernels with per-neighbour
+// distances must match exactly.
+TYPED_TEST(ScalarStencilKernelTest, matches_control_volume_update) {
+    using Scalar = typename TypeParam::Scalar;
+
+    // Kernels for the interior can only be used on cells with every neighbour, kernels
+    // for the boundary can be used on every cell
+    std::vector<int> cells = this->mesh->getUniformCells().cells;
+    if (TypeParam::BOUNDARY) {
+        const std::vector<int>& edge_cells = this->mesh->getEdgeCells();
+        ASSERT_EQ(4u * 19u, edge_cells.size());
+        cells.insert(cells.end(), edge_cells.begin(), edge_cells.end());
+    }
+
+    BasicControlVolumeFields<Scalar> current, next;
+    current.resize(this->mesh->numCells());
+    next.resize(this->mesh->numCells());
+    for (size_t i = 0; i < this->mesh->numCells(); i++) {
+        current.pressure[i]   = static_cast<Scalar>(this->current.pressure[i]);
+        current.velocity_x[i] = static_cast<Scalar>(this->current.velocity_x[i]);
+        current.velocity_y[i] = static_cast<Scalar>(this->current.velocity_y[i]);
+    }
+    updateScalarCells<Scalar, TypeParam::UNIFORM_SPACING, TypeParam::BOUNDARY>(
+        *this->mesh,
+        cells,
+        0,
+        cells.size(),
+        current,
+        legacyEdgeStates<Scalar>(),
+        static_cast<Scalar>(this->dt),
+        BasicFluidCoefficients<Scalar>(1.2, 0.3, 100),
+        next);
+
+    // How far from `ControlVolume::update` each specialisation may be, relative to
+    // the size of the result
+    double relative_tolerance = 0;
+    if (std::is_same<Scalar, float>::value) {
+        relative_tolerance = 1e-3;
+    } else if (TypeParam::UNIFORM_SPACING) {
+        relative_tolerance = 1e-9;
+    }
+
+    for (int cell : cells) {
+        ControlVolume expected = this->getControlVolume(cell);
+        expected.update(this->getNeighbour(cell, LEFT),
+                        this->getNeighbour(cell, RIGHT),
+                        this->getNeighbour(cell, TOP),
+                        this->getNeighbour(cell, BOTTOM),
+                        second_t(this->dt));
+
+        const double expected_values[3] = {expected.getPressure().to<double>(),
+                                           expected.getVelocity().x.to<double>(),
+                                           expected.getVelocity().y.to<double>()};
+        const double actual_values[3]   = {next.pressure[cell],
+                                         next.velocity_x[cell],
+                                         next.velocity_y[cell]};
+        for (int value = 0; value < 3; value++) {
+            if (relative_tolerance == 0) {
+                EXPECT_EQ(expected_values[value], actual_values[value]);
+            } else {
+                EXPECT_NEAR(expected_values[value],
+                            actual_values[value],
+                            relative_tolerance *
+                                std::max(1.0, std::abs(expected_values[value])));
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,166 @@
+#include "SimdStencilKernel.h"
+#include <cstdint>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <random>
+
+using namespace units::literals;
+using namespace units::length;
+using namespace units::velocity;
+using namespace units::time;
+using namespace units::pressure;
+using namespace units::density;
+using namespace units::viscosity;
+
+class SimdStencilKernelTest : public testing::TestWithParam<SimdLevel> {
+  protected:
+    virtual void SetUp() {
+        graph = std::make_shared<GraphNode<ControlVolume>>(20, 1.0);
+        mesh  = std::make_shared<ControlVolumeMesh>(*graph);
+
+        // Random, but reproducible, fields
+        std::mt19937 random_generator(42);
+        std::uniform_real_distribution<double> pressure_distribution(-100, 100);
+        std::uniform_real_distribution<double> velocity_distribution(-5, 5);
+        current.resize(mesh->numCells());
+        for (size_t i = 0; i < mesh->numCells(); i++) {
+            current.pressure[i]   = pressure_distribution(random_generator);
+            current.velocity_x[i] = velocity_distribution(random_generator);
+            current.velocity_y[i] = velocity_distribution(random_generator);
+        }
+    }
+
+    /**
+     * Get the given cell as a ControlVolume
+     *
+     * @param cell the index of the cell
+     *
+     * @return the given cell as a ControlVolume
+     */
+    ControlVolume getControlVolume(int cell) {
+        return ControlVolume(pascal_t(current.pressure[cell]),
+                             Velocity2d{meters_per_second_t(current.velocity_x[cell]),
+                                        meters_per_second_t(current.velocity_y[cell])},
+                             kg_per_cu_m_t(1.2),
+                             meters_squared_per_s_t(0.3),
+                             meters_per_second_t(100));
+    }
+
+    /**
+     * Get the distance between two doubles in units in the last place
+     *
+     * @param a
+     * @param b
+     *
+     * @return the distance between `a` and `b` in units in the last place
+     */
+    static int64_t ulpDistance(double a, double b) {
+        auto to_ordered = [](double value) {
+            int64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            return bits < 0 ? INT64_MIN - bits : bits;
+        };
+        int64_t ordered_a = to_ordered(a);
+        int64_t ordered_b = to_ordered(b);
+        return ordered_a > ordered_b ? ordered_a - ordered_b : ordered_b - ordered_a;
+    }
+
+    std::shared_ptr<GraphNode<ControlVolume>> graph;
+    std::shared_ptr<ControlVolumeMesh> mesh;
+    ControlVolumeFields current;
+    const FluidCoefficients fluid = FluidCoefficients(1.2, 0.3, 100);
+    const double dt               = 0.0001;
+};
+
+// Test that the vectorised kernel matches `ControlVolume::update` on every uniform
+// cell, with and without overriding the velocity of top neighbours
+TEST_P(SimdStencilKernelTest, matches_control_volume_update) {
+    SimdLevel simd_level = GetParam();
+    if (!isSimdLevelSupported(simd_level)) {
+        GTEST_SKIP();
+    }
+
+    const UniformStencilCells& uniform_cells = mesh->getUniformCells();
+    ASSERT_EQ(18u * 18u, uniform_cells.size());
+
+    const CellState top_velocity_override = {0, 0.5, -1.5};
+    for (const CellState* override_ptr : {(const CellState*) nullptr,
+                                          &top_velocity_override}) {
+        ControlVolumeFields next;
+        next.resize(mesh->numCells());
+        updateUniformCells(simd_level,
+                           uniform_cells,
+                           0,
+                           uniform_cells.size(),
+                           current,
+                           override_ptr,
+                           dt,
+                           fluid,
+                           next);
+
+        for (size_t k = 0; k < uniform_cells.size(); k++) {
+            const int cell    = uniform_cells.cells[k];
+            ControlVolume top = getControlVolume(uniform_cells.neighbours[TOP][k]);
+            if (override_ptr) {
+                top.setVelocity({meters_per_second_t(override_ptr->velocity_x),
+                                 meters_per_second_t(override_ptr->velocity_y)});
+            }
+
+            ControlVolume expected = getControlVolume(cell);
+            expected.update(
+                std::make_pair(getControlVolume(uniform_cells.neighbours[LEFT][k]),
+                               meter_t(uniform_cells.distances[LEFT][k])),
+                std::make_pair(getControlVolume(uniform_cells.neighbours[RIGHT][k]),
+                               meter_t(uniform_cells.distances[RIGHT][k])),
+                std::make_pair(top, meter_t(uniform_cells.distances[TOP][k])),
+                std::make_pair(getControlVolume(uniform_cells.neighbours[BOTTOM][k]),
+                               meter_t(uniform_cells.distances[BOTTOM][k])),
+                second_t(dt));
+
+            EXPECT_LE(ulpDistance(expected.getPressure().to<double>(),
+                                  next.pressure[cell]),
+                      SIMD_STENCIL_ULP_TOLERANCE);
+            EXPECT_LE(ulpDistance(expected.getVelocity().x.to<double>(),
+                                  next.velocity_x[cell]),
+                      SIMD_STENCIL_ULP_TOLERANCE);
+            EXPECT_LE(ulpDistance(expected.getVelocity().y.to<double>(),
+                                  next.velocity_y[cell]),
+                      SIMD_STENCIL_ULP_TOLERANCE);
+        }
+    }
+}
+
+// Test that updating a sub-range (with a remainder that doesn't fill a vector) only
+// writes the cells in that range
+TEST_P(SimdStencilKernelTest, only_updates_given_range) {
+    SimdLevel simd_level = GetParam();
+    if (!isSimdLevelSupported(simd_level)) {
+        GTEST_SKIP();
+    }
+
+    const UniformStencilCells& uniform_cells = mesh->getUniformCells();
+    ControlVolumeFields next;
+    next.resize(mesh->numCells());
+    updateUniformCells(
+        simd_level, uniform_cells, 3, 14, current, nullptr, dt, fluid, next);
+
+    for (size_t k = 0; k < uniform_cells.size(); k++) {
+        const int cell = uniform_cells.cells[k];
+        if (k < 3 || k >= 14) {
+            EXPECT_EQ(0, next.pressure[cell]);
+        } else {
+            EXPECT_NE(0, next.pressure[cell]);
+        }
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(AllSimdLevels,
+                        SimdStencilKernelTest,
+                        testing::Values(SimdLevel::SCALAR,
+                                        SimdLevel::AVX2,
+                                        SimdLevel::AVX512));
+
+int main(int argc, char** argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
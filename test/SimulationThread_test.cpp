@@ -0,0 +1,103 @@
+#include "SimulationThread.h"
+#include <array>
+#include <atomic>
+#include <gtest/gtest.h>
+#include <thread>
+
+using namespace units::literals;
+using namespace units::length;
+using namespace units::velocity;
+using namespace units::time;
+using namespace units::pressure;
+using namespace units::density;
+using namespace units::viscosity;
+
+/**
+ * Create a small simulator with a non-trivial initial pressure field
+ *
+ * @return a small simulator with a non-trivial initial pressure field
+ */
+FluidSimulator createSimulator() {
+    FluidSimulator simulator(kg_per_cu_m_t(1),
+                             meters_squared_per_s_t(1),
+                             meters_per_second_t(100),
+                             meter_t(1),
+                             15);
+    for (auto& node : simulator.getControlVolumeGraph()->getAllSubNodes()) {
+        if (node->getCoordinates().x <= 0.25) {
+            node->containedValue().setPressure(pascal_t(100));
+        }
+    }
+    return simulator;
+}
+
+// Test that the reader never sees a value the writer is part way through writing, and
+// never goes back to an older value
+TEST(TripleBufferTest, reader_never_sees_partial_or_old_writes) {
+    TripleBuffer<std::array<uint64_t, 256>> buffer;
+    buffer.getWriteBuffer().fill(0);
+    buffer.publish();
+
+    const uint64_t num_writes = 100000;
+    std::thread writer([&]() {
+        for (uint64_t value = 1; value <= num_writes; value++) {
+            buffer.getWriteBuffer().fill(value);
+            buffer.publish();
+        }
+    });
+
+    uint64_t last_value = 0;
+    while (last_value < num_writes) {
+        buffer.update();
+        const std::array<uint64_t, 256>& values = buffer.getReadBuffer();
+        for (uint64_t value : values) {
+            ASSERT_EQ(values[0], value);
+        }
+        ASSERT_GE(values[0], last_value);
+        last_value = values[0];
+    }
+    writer.join();
+}
+
+// Test that every snapshot published by the dedicated thread matches stepping the same
+// simulator the same number of times on this thread
+TEST(SimulationThreadTest, snapshots_match_stepping_directly) {
+    const second_t dt = second_t(0.0000001);
+    SimulationThread simulation_thread(createSimulator(), dt, 3);
+    EXPECT_EQ(0, simulation_thread.getLatestSnapshot().num_steps);
+
+    simulation_thread.start();
+    std::vector<FieldSnapshot> snapshots;
+    while (snapshots.size() < 5) {
+        const FieldSnapshot& snapshot = simulation_thread.getLatestSnapshot();
+        if (snapshots.empty() || snapshot.num_steps != snapshots.back().num_steps) {
+            EXPECT_EQ(0, snapshot.num_steps % 3);
+            snapshots.emplace_back(snapshot);
+        }
+    }
+    simulation_thread.stop();
+    EXPECT_FALSE(simulation_thread.isRunning());
+
+    FluidSimulator expected_simulator = createSimulator();
+    FieldSnapshot expected_snapshot;
+    uint64_t num_steps = 0;
+    for (const FieldSnapshot& snapshot : snapshots) {
+        for (; num_steps < snapshot.num_steps; num_steps++) {
+            expected_simulator.updateControlVolumes(dt);
+        }
+        expected_simulator.takeSnapshot(expected_snapshot);
+        EXPECT_EQ(expected_snapshot.simulation_time, snapshot.simulation_time);
+        EXPECT_EQ(expected_snapshot.fields.pressure, snapshot.fields.pressure);
+        EXPECT_EQ(expected_snapshot.fields.velocity_x, snapshot.fields.velocity_x);
+        EXPECT_EQ(expected_snapshot.fields.velocity_y, snapshot.fields.velocity_y);
+
+        // Every snapshot is published ready to draw
+        EXPECT_EQ(snapshot.mesh, snapshot.pyramid.getMesh());
+        EXPECT_FALSE(snapshot.pyramid.empty());
+    }
+}
+
+int main(int argc, char** argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,55 @@
+#include "ThreadPool.h"
+#include <atomic>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// Test that every item is run exactly once, whatever the number of threads
+TEST(ThreadPoolTest, parallel_for_runs_every_item_once) {
+    for (const int num_threads : {1, 2, 5}) {
+        ThreadPool thread_pool(num_threads);
+        std::vector<std::atomic<int>> num_runs(1000);
+        thread_pool.parallelFor(num_runs.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                num_runs[i]++;
+            }
+        });
+        for (const std::atomic<int>& item_runs : num_runs) {
+            EXPECT_EQ(1, item_runs);
+        }
+    }
+    EXPECT_THROW(ThreadPool(0), std::invalid_argument);
+}
+
+// Test that an exception thrown by a chunk is rethrown once every thread has stopped
+// running chunks, and leaves the pool usable
+TEST(ThreadPoolTest, parallel_for_rethrows_after_every_chunk_stops) {
+    ThreadPool thread_pool(4);
+    for (int attempt = 0; attempt < 20; attempt++) {
+        std::atomic<int> num_running(0);
+        EXPECT_THROW(thread_pool.parallelFor(
+                         64,
+                         [&](size_t begin, size_t end) {
+                             num_running++;
+                             std::this_thread::sleep_for(std::chrono::microseconds(50));
+                             num_running--;
+                             if (begin == 0) {
+                                 throw std::runtime_error("chunk failed");
+                             }
+                         }),
+                     std::runtime_error);
+        EXPECT_EQ(0, num_running);
+    }
+
+    std::atomic<size_t> num_items(0);
+    thread_pool.parallelFor(
+        1000, [&](size_t begin, size_t end) { num_items += end - begin; });
+    EXPECT_EQ(1000u, num_items);
+}
+
+int main(int argc, char** argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}